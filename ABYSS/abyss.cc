@@ -7,6 +7,7 @@
 #endif
 #include "Assembly/AssemblyAlgorithms.h"
 #include "Assembly/DotWriter.h"
+#include "Assembly/KmerBuckets.h"
 #include "DataBase/DB.h"
 
 #include <algorithm>
@@ -54,18 +55,39 @@ write_graph(const string& path, const SequenceCollectionHash& c)
 	DotWriter::write(out, c);
 }
 
+/** Load the k-mer of the contigs pathIn, if any, and of the input
+ * files into g. */
+template <typename Graph>
 static void
-assemble(const string& pathIn, const string& pathOut)
+loadReads(Graph& g, const string& pathIn)
 {
-	Timer timer(__func__);
-	SequenceCollectionHash g;
-
 	if (!pathIn.empty())
 		AssemblyAlgorithms::loadSequences(&g, pathIn.c_str());
 	for_each(opt::inFiles.begin(), opt::inFiles.end(), [&g](std::string s) {
 		AssemblyAlgorithms::loadSequences(&g, s);
 	});
-	size_t numLoaded = g.size();
+}
+
+static void
+assemble(const string& pathIn, const string& pathOut)
+{
+	Timer timer(__func__);
+	SequenceCollectionHash g;
+
+	// The coverage histogram of k-mer counted on disk
+	Histogram countedHist;
+	size_t numLoaded;
+	if (opt::kcBuckets > 0) {
+		KmerBuckets<SequenceCollectionHash::key_type>
+			buckets(opt::kcBuckets);
+		loadReads(buckets, pathIn);
+		cout << "Counting k-mer in " << opt::kcBuckets
+			<< " buckets" << endl;
+		numLoaded = buckets.count(g, opt::kc, countedHist);
+	} else {
+		loadReads(g, pathIn);
+		numLoaded = g.size();
+	}
 	if (!opt::db.empty())
 		addToDb(db, "loadedKmer", numLoaded);
 	cout << "Loaded " << numLoaded << " k-mer\n";
@@ -76,12 +98,15 @@ assemble(const string& pathIn, const string& pathOut)
 		exit(EXIT_FAILURE);
 	}
 
-	AssemblyAlgorithms::setCoverageParameters(AssemblyAlgorithms::coverageHistogram(g));
+	AssemblyAlgorithms::setCoverageParameters(opt::kcBuckets > 0
+			? countedHist : AssemblyAlgorithms::coverageHistogram(g));
 
 	if (opt::kc > 0) {
 		cout << "Minimum k-mer multiplicity kc is " << opt::kc << endl;
 		cout << "Removing low-multiplicity k-mers" << endl;
-		size_t removed = AssemblyAlgorithms::applyKmerCoverageThreshold(g, opt::kc);
+		// k-mer counted on disk have already been filtered.
+		size_t removed = opt::kcBuckets > 0 ? numLoaded - g.size()
+			: AssemblyAlgorithms::applyKmerCoverageThreshold(g, opt::kc);
 		cout << "Removed " << removed << " low-multiplicity k-mers, " << g.size()
 		     << " k-mers remaining" << std::endl;
 	}
@@ -97,6 +122,7 @@ erode:
 	if (opt::erode > 0) {
 		cout << "Eroding tips" << endl;
 		AssemblyAlgorithms::erodeEnds(&g);
+		g.compact();
 		assert(AssemblyAlgorithms::erodeEnds(&g) == 0);
 		g.cleanup();
 	}
@@ -111,8 +137,10 @@ erode:
 		goto erode;
 	}
 
-	if (opt::bubbleLen > 0)
+	if (opt::bubbleLen > 0) {
 		popBubbles(g);
+		g.compact();
+	}
 
 	write_graph(opt::graphPath, g);
 
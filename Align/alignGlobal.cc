@@ -10,6 +10,7 @@
 #include <cctype>
 #include <climits>
 #include <cstdlib> // for abort
+#include <vector>
 
 using namespace std;
 
@@ -28,6 +29,9 @@ static const int GAP_OPEN = -12;
 /** The penalty of extending a gap. */
 static const int GAP_EXTEND = -4;
 
+/** The score of a cell that is not reachable. */
+static const int NEG_INF = INT_MIN/2;
+
 /** Return the score of the alignment of a and b.
  * @param [out] consensus the consensus of a and b
  * @return the score
@@ -50,21 +54,88 @@ static int score(char a, char b)
 	return score(a, b, c);
 }
 
+/** The score matrices of a banded alignment. Only the cells (i, j)
+ * whose diagonal j - i is within [kmin, kmax] are stored. The cells
+ * outside of the band are not reachable. When the band includes every
+ * diagonal, the matrices are the usual full matrices.
+ */
+class ScoreMatrices
+{
+  public:
+	ScoreMatrices(unsigned lenA, unsigned lenB, int kmin, int kmax)
+		: m_lenB(lenB), m_kmin(kmin), m_kmax(kmax),
+		m_width(min(lenB, (unsigned)(kmax - kmin)) + 1),
+		m_f((size_t)(lenA + 1) * m_width),
+		m_g(m_f.size()), m_h(m_f.size())
+	{
+		assert(kmin <= 0 && kmax >= 0);
+	}
+
+	/** Return the first column of row i within the band. */
+	unsigned first(unsigned i) const
+	{
+		int j = (int)i + m_kmin;
+		return j < 0 ? 0 : j;
+	}
+
+	/** Return the last column of row i within the band. */
+	unsigned last(unsigned i) const
+	{
+		int j = (int)i + m_kmax;
+		return j > (int)m_lenB ? m_lenB : j;
+	}
+
+	/** The best score of an alignment ending at (i, j). */
+	int F(unsigned i, unsigned j) const { return get(m_f, i, j); }
+
+	/** The best score of an alignment ending with a gap in b. */
+	int G(unsigned i, unsigned j) const { return get(m_g, i, j); }
+
+	/** The best score of an alignment ending with a gap in a. */
+	int H(unsigned i, unsigned j) const { return get(m_h, i, j); }
+
+	/** Set the scores of the cell (i, j), which must be in the band. */
+	void set(unsigned i, unsigned j, int f, int g, int h)
+	{
+		size_t x = index(i, j);
+		m_f[x] = f;
+		m_g[x] = g;
+		m_h[x] = h;
+	}
+
+  private:
+	size_t index(unsigned i, unsigned j) const
+	{
+		assert(j >= first(i) && j <= last(i));
+		return (size_t)i * m_width + (j - first(i));
+	}
+
+	int get(const vector<int>& m, unsigned i, unsigned j) const
+	{
+		return j < first(i) || j > last(i) ? NEG_INF : m[index(i, j)];
+	}
+
+	unsigned m_lenB;
+	int m_kmin, m_kmax;
+	unsigned m_width;
+	vector<int> m_f, m_g, m_h;
+};
+
 /** Find the optimal alignment from the score matrices.
  * @param[out] align the alignment
  * @return the number of matches
  */
-static unsigned backtrack(int** f, int** g, int** h,
+static unsigned backtrack(const ScoreMatrices& m,
 		const string& seqA, const string& seqB, NWAlignment& align)
 {
 	string alignmentA, alignmentB, consensus;
 	unsigned matches = 0;
 	unsigned i = seqA.size(), j = seqB.size();
 	while (i > 0 && j > 0) {
-		int fij = f[i][j];
+		int fij = m.F(i, j);
 		char a = seqA[i-1], b = seqB[j-1], c;
 		int s = score(a, b, c);
-		if (fij == f[i-1][j-1] + s) {
+		if (fij == m.F(i-1, j-1) + s) {
 			alignmentA += a;
 			alignmentB += b;
 			consensus += c;
@@ -72,9 +143,9 @@ static unsigned backtrack(int** f, int** g, int** h,
 				matches++;
 			i--;
 			j--;
-		} else if (fij == f[i-1][j] + GAP_OPEN
-				|| fij == g[i-1][j] + GAP_EXTEND) {
-			while (g[i][j] == g[i-1][j] + GAP_EXTEND) {
+		} else if (fij == m.F(i-1, j) + GAP_OPEN
+				|| fij == m.G(i-1, j) + GAP_EXTEND) {
+			while (m.G(i, j) == m.G(i-1, j) + GAP_EXTEND) {
 				char a = seqA[i-1];
 				alignmentA += a;
 				alignmentB += GAP;
@@ -82,15 +153,15 @@ static unsigned backtrack(int** f, int** g, int** h,
 				i--;
 				assert(i > 0);
 			}
-			assert(g[i][j] == f[i-1][j] + GAP_OPEN);
+			assert(m.G(i, j) == m.F(i-1, j) + GAP_OPEN);
 			char a = seqA[i-1];
 			alignmentA += a;
 			alignmentB += GAP;
 			consensus += tolower(a);
 			i--;
-		} else if (fij == f[i][j-1] + GAP_OPEN
-				|| fij == h[i][j-1] + GAP_EXTEND) {
-			while (h[i][j] == h[i][j-1] + GAP_EXTEND) {
+		} else if (fij == m.F(i, j-1) + GAP_OPEN
+				|| fij == m.H(i, j-1) + GAP_EXTEND) {
+			while (m.H(i, j) == m.H(i, j-1) + GAP_EXTEND) {
 				char b = seqB[j-1];
 				alignmentA += GAP;
 				alignmentB += b;
@@ -98,7 +169,7 @@ static unsigned backtrack(int** f, int** g, int** h,
 				j--;
 				assert(j > 0);
 			}
-			assert(h[i][j] == f[i][j-1] + GAP_OPEN);
+			assert(m.H(i, j) == m.F(i, j-1) + GAP_OPEN);
 			char b = seqB[j-1];
 			alignmentA += GAP;
 			alignmentB += b;
@@ -135,64 +206,106 @@ static unsigned backtrack(int** f, int** g, int** h,
 	return matches;
 }
 
+/** Calculate the score matrices of the two sequences. */
+static void fillMatrices(ScoreMatrices& m,
+		const string& seqA, const string& seqB)
+{
+	unsigned lenA = seqA.size();
+	for (unsigned i = 0; i <= lenA; i++) {
+		unsigned j = m.first(i), last = m.last(i);
+		if (j == 0) {
+			// Initialize the first column.
+			if (i == 0)
+				m.set(0, 0, 0, NEG_INF, 0);
+			else {
+				int gap = GAP_OPEN + GAP_EXTEND * ((int)i - 1);
+				m.set(i, 0, gap, gap, NEG_INF);
+			}
+			j++;
+		}
+		for (; j <= last; j++) {
+			if (i == 0) {
+				// Initialize the first row.
+				int gap = GAP_OPEN + GAP_EXTEND * ((int)j - 1);
+				m.set(0, j, gap, NEG_INF, gap);
+				continue;
+			}
+			int g = max(
+					m.F(i-1, j) + GAP_OPEN,
+					m.G(i-1, j) + GAP_EXTEND);
+			int h = max(
+					m.F(i, j-1) + GAP_OPEN,
+					m.H(i, j-1) + GAP_EXTEND);
+			int f = max(
+					m.F(i-1, j-1) + score(seqA[i-1], seqB[j-1]),
+					max(g, h));
+			m.set(i, j, f, g, h);
+		}
+	}
+}
+
+/** Return an upper bound on the score of any alignment of sequences
+ * of lengths lenA and lenB that has at least the specified number of
+ * gap characters.
+ */
+static long long maxScoreWithGaps(
+		unsigned lenA, unsigned lenB, unsigned gaps)
+{
+	if (gaps > lenA + lenB)
+		return NEG_INF;
+	long long pairs = (lenA + lenB - gaps) / 2;
+	return MATCH * pairs + GAP_OPEN + GAP_EXTEND * ((long long)gaps - 1);
+}
+
 /** Find the optimal global alignment of the two sequences using the
  * Needleman-Wunsch algorithm and the improvement by Gotoh to use an
  * affine gap penalty rather than a linear gap penalty.
+ *
+ * Only the diagonals within band of the diagonals of the two ends of
+ * the alignment are calculated. If an alignment leaving the band
+ * could score as well as the best alignment within the band, the band
+ * is doubled and the alignment repeated, so the result is identical
+ * to that of the full alignment.
+ *
+ * @param band the initial number of diagonals on either side
  * @param[out] align the alignment
  * @return the number of matches
  */
 unsigned alignGlobal(const string& seqA, const string& seqB,
-		NWAlignment& align)
+		NWAlignment& align, unsigned band)
 {
-	unsigned lenA = seqA.size();
-	unsigned lenB = seqB.size();
-	int** f = new int*[lenA + 1];
-	int** g = new int*[lenA + 1];
-	int** h = new int*[lenA + 1];
-	for (unsigned i = 0; i <= lenA; i++) {
-		f[i] = new int[lenB + 1];
-		g[i] = new int[lenB + 1];
-		h[i] = new int[lenB + 1];
-	}
-
-	// Initialize the score matrix.
-	for (unsigned i = 0; i <= lenA; i++) {
-		f[i][0] = g[i][0] = i == 0 ? 0
-			: GAP_OPEN + GAP_EXTEND * ((int)i - 1);
-		h[i][0] = INT_MIN/2;
-	}
-	for (unsigned j = 0; j <= lenB; j++) {
-		f[0][j] = h[0][j] = j == 0 ? 0
-			: GAP_OPEN + GAP_EXTEND * ((int)j - 1);
-		g[0][j] = INT_MIN/2;
-	}
-
-	// Calculate the score matrix.
-	for (unsigned i = 1; i <= lenA; i++) {
-		for (unsigned j = 1; j <= lenB; j++) {
-			g[i][j] = max(
-					f[i-1][j] + GAP_OPEN,
-					g[i-1][j] + GAP_EXTEND);
-			h[i][j] = max(
-					f[i][j-1] + GAP_OPEN,
-					h[i][j-1] + GAP_EXTEND);
-			f[i][j] = max(
-					f[i-1][j-1] + score(seqA[i-1], seqB[j-1]),
-					max(g[i][j], h[i][j]));
+	int lenA = seqA.size();
+	int lenB = seqB.size();
+	int delta = lenB - lenA;
+	for (band = max(band, 1U);; band *= 2) {
+		int kmin = min(0, delta) - (int)band;
+		int kmax = max(0, delta) + (int)band;
+		bool full = kmin <= -lenA && kmax >= lenB;
+		if (full) {
+			kmin = -lenA;
+			kmax = lenB;
 		}
-	}
 
-	// Find the best alignment.
-	unsigned matches = backtrack(f, g, h, seqA, seqB, align);
+		ScoreMatrices m(lenA, lenB, kmin, kmax);
+		fillMatrices(m, seqA, seqB);
 
-	for (unsigned i = 0; i <= lenA; i++) {
-		delete[] f[i];
-		delete[] g[i];
-		delete[] h[i];
+		// An alignment that leaves the band has at least this many
+		// gap characters.
+		unsigned gaps = abs(delta) + 2 * (band + 1);
+		if (full || m.F(lenA, lenB) > maxScoreWithGaps(lenA, lenB, gaps))
+			return backtrack(m, seqA, seqB, align);
 	}
-	delete[] f;
-	delete[] g;
-	delete[] h;
+}
 
-	return matches;
+/** Find the optimal global alignment of the two sequences using the
+ * Needleman-Wunsch algorithm and the improvement by Gotoh to use an
+ * affine gap penalty rather than a linear gap penalty.
+ * @param[out] align the alignment
+ * @return the number of matches
+ */
+unsigned alignGlobal(const string& seqA, const string& seqB,
+		NWAlignment& align)
+{
+	return alignGlobal(seqA, seqB, align,
+			max(seqA.size(), seqB.size()));
 }
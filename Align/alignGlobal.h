@@ -41,6 +41,10 @@ unsigned alignGlobal(
 		const std::string& a, const std::string& b,
 		NWAlignment& align);
 
+unsigned alignGlobal(
+		const std::string& a, const std::string& b,
+		NWAlignment& align, unsigned band);
+
 /** Align the specified pair of sequences.
  * @return the number of matches and size of the consensus
  */
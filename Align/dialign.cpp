@@ -268,12 +268,13 @@ static string get_alignment_consensus(struct alignment *algn)
 	return consensus;
 }
 
-/** Align multiple sequences using DIALIGN-TX.
+/** Align multiple sequences using DIALIGN-TX, which is not
+ * reentrant.
  * @param [out] alignment the alignment
  * @param [out] matches the minimum number of matches
  * @return the consensus sequence
  */
-string dialign(const vector<string>& amb_seqs,
+static string dialignSerial(const vector<string>& amb_seqs,
 		string& alignment, unsigned& matches)
 {
 	int i;
@@ -421,3 +422,19 @@ string dialign(const vector<string>& amb_seqs,
 	free_seq_col(in_seq_col);
 	return consensus;
 }
+
+/** Align multiple sequences using DIALIGN-TX. DIALIGN-TX modifies
+ * its global parameters and score tables, so only one thread aligns
+ * at a time.
+ * @param [out] alignment the alignment
+ * @param [out] matches the minimum number of matches
+ * @return the consensus sequence
+ */
+string dialign(const vector<string>& amb_seqs,
+		string& alignment, unsigned& matches)
+{
+	string consensus;
+#pragma omp critical(dialign)
+	consensus = dialignSerial(amb_seqs, alignment, matches);
+	return consensus;
+}
@@ -1,6 +1,20 @@
 #ifndef ASSEMBLY_BRANCHRECORD_H
 #define ASSEMBLY_BRANCHRECORD_H 1
 
+#include <stdint.h>
+
+/** The base that extends a branch of k-mer by one k-mer. */
+struct BranchStep
+{
+	typedef uint8_t value_type;
+
+	/** The number of bits of a packed step */
+	static const unsigned BITS = 2;
+
+	static unsigned pack(value_type x) { return x; }
+	static value_type unpack(unsigned x) { return x; }
+};
+
 /** Generate the sequence of this contig. */
 template <typename It, typename OutIt>
 void branchRecordToStr(It it, It last, OutIt out)
@@ -5,6 +5,8 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstddef>
+#include <stdint.h>
 #include <utility>
 #include <vector>
 #include <iterator>
@@ -25,7 +27,11 @@ enum BranchState
 	BS_TOO_LONG,
 };
 
-/** A sequence of vertices. */
+/** A sequence of vertices. The vertices are not stored. Each
+ * vertex is stored as the base that extends the branch to that
+ * vertex, packed in BranchStep::BITS bits, and its properties. The
+ * vertices are reconstructed by rolling from either end.
+ */
 class BranchRecord
 {
 	public:
@@ -34,18 +40,118 @@ class BranchRecord
 		typedef vertex_bundle_type<Graph>::type VP;
 
 		typedef std::pair<V, VP> value_type;
-		typedef std::vector<value_type> BranchData;
-		typedef BranchData::iterator iterator;
-		typedef BranchData::const_iterator const_iterator;
+		typedef std::vector<VP> BranchData;
+
+		/** An iterator of the vertices of a branch. The vertex is
+		 * rolled as the iterator is moved. */
+		class const_iterator
+		{
+			public:
+				typedef std::bidirectional_iterator_tag
+					iterator_category;
+				typedef BranchRecord::value_type value_type;
+				typedef ptrdiff_t difference_type;
+				typedef const value_type* pointer;
+				typedef const value_type& reference;
+
+				const_iterator() : m_branch(NULL), m_i(0), m_step(1) { }
+
+				const_iterator(const BranchRecord* branch,
+						ptrdiff_t i, int step)
+					: m_branch(branch), m_i(i), m_step(step)
+				{
+					if (valid())
+						m_value = m_branch->at(m_i);
+				}
+
+				reference operator*() const
+				{
+					assert(valid());
+					return m_value;
+				}
+
+				pointer operator->() const { return &**this; }
+
+				const_iterator& operator++()
+				{
+					move(m_step);
+					return *this;
+				}
+
+				const_iterator operator++(int)
+				{
+					const_iterator it = *this;
+					++*this;
+					return it;
+				}
+
+				const_iterator& operator--()
+				{
+					move(-m_step);
+					return *this;
+				}
+
+				const_iterator operator--(int)
+				{
+					const_iterator it = *this;
+					--*this;
+					return it;
+				}
 
-		BranchRecord() : m_dir(SENSE), m_state(BS_ACTIVE) { }
+				bool operator==(const const_iterator& o) const
+				{
+					return m_i == o.m_i;
+				}
+
+				bool operator!=(const const_iterator& o) const
+				{
+					return m_i != o.m_i;
+				}
+
+				bool operator<(const const_iterator& o) const
+				{
+					return m_step > 0 ? m_i < o.m_i : m_i > o.m_i;
+				}
+
+			private:
+				/** Return whether this iterator refers to a vertex. */
+				bool valid() const
+				{
+					return m_i >= 0 && (size_t)m_i < m_branch->size();
+				}
+
+				/** Move to the adjacent vertex in the direction delta. */
+				void move(int delta)
+				{
+					bool wasValid = valid();
+					m_i += delta;
+					if (!valid())
+						return;
+					if (wasValid)
+						m_branch->roll(m_value, m_i - delta, m_i);
+					else
+						m_value = m_branch->at(m_i);
+				}
+
+				const BranchRecord* m_branch;
+				ptrdiff_t m_i;
+				int m_step;
+				value_type m_value;
+		};
+		typedef const_iterator iterator;
+
+		BranchRecord() : m_numSteps(0), m_dir(SENSE), m_state(BS_ACTIVE) { }
 
 		explicit BranchRecord(extDirection dir)
-			: m_dir(dir), m_state(BS_ACTIVE) { }
+			: m_numSteps(0), m_dir(dir), m_state(BS_ACTIVE) { }
 
 		void swap(BranchRecord& o)
 		{
+			std::swap(m_steps, o.m_steps);
+			std::swap(m_numSteps, o.m_numSteps);
 			std::swap(m_data, o.m_data);
+			std::swap(m_front, o.m_front);
+			std::swap(m_back, o.m_back);
 			std::swap(m_dir, o.m_dir);
 			std::swap(m_state, o.m_state);
 		}
@@ -56,28 +162,70 @@ class BranchRecord
 		/** Return the number of elements. */
 		size_t size() const { return m_data.size(); }
 
-		/** Add the element x at the end. */
-		void push_back(const value_type& x) { m_data.push_back(x); }
+		/** Add the element x at the end. The vertex of x must be
+		 * adjacent to the last vertex in the direction of this
+		 * branch. */
+		void push_back(const value_type& x)
+		{
+			V v = x.first;
+			if (m_data.empty()) {
+				// Store every base of the first vertex.
+				for (unsigned i = 0; i < Kmer::length(); ++i)
+					pushStep(v.shift(m_dir));
+				m_front = x;
+			} else {
+				// Store the base that extends this branch.
+				BranchStep::value_type step = v.shift(!m_dir);
+				assert(shifted(m_back.first, step) == x.first);
+				pushStep(step);
+			}
+			m_data.push_back(x.second);
+			m_back = x;
+		}
 
 		/** Remove the last k-mer. */
 		void pop_back()
 		{
 			assert(!m_data.empty());
+			if (m_data.size() > 1)
+				roll(m_back, m_data.size() - 1, m_data.size() - 2);
 			m_data.pop_back();
+			if (m_data.empty()) {
+				m_steps.clear();
+				m_numSteps = 0;
+			} else
+				popStep();
 		}
 
 		/** Return the first element. */
 		const value_type& front() const
 		{
 			assert(!m_data.empty());
-			return m_data.front();
+			return m_front;
 		}
 
 		/** Return the last element. */
 		const value_type& back() const
 		{
 			assert(!m_data.empty());
-			return m_data.back();
+			return m_back;
+		}
+
+		/** Return the element at position i. */
+		value_type at(size_t i) const
+		{
+			assert(i < m_data.size());
+			value_type x;
+			if (i < m_data.size() / 2) {
+				x = m_front;
+				for (size_t j = 0; j < i; ++j)
+					roll(x, j, j + 1);
+			} else {
+				x = m_back;
+				for (size_t j = m_data.size() - 1; j > i; --j)
+					roll(x, j, j - 1);
+			}
+			return x;
 		}
 
 		/** Terminate this branch with the specified reason. */
@@ -99,21 +247,32 @@ class BranchRecord
 		/** Set the properties of the last element. */
 		void setData(const value_type& o)
 		{
-			assert(m_data.back().first == o.first);
-			m_data.back().second = o.second;
+			assert(m_back.first == o.first);
+			m_back.second = o.second;
+			m_data.back() = o.second;
+			if (m_data.size() == 1)
+				m_front.second = o.second;
+		}
+
+		const_iterator begin() const { return const_iterator(this, 0, 1); }
+		const_iterator end() const
+		{
+			return const_iterator(this, m_data.size(), 1);
 		}
 
-		iterator begin() { return m_data.begin(); }
-		iterator end() { return m_data.end(); }
-		const_iterator begin() const { return m_data.begin(); }
-		const_iterator end() const { return m_data.end(); }
+		/** Return an iterator of the elements in reverse order. */
+		const_iterator rbegin() const
+		{
+			return const_iterator(this, (ptrdiff_t)m_data.size() - 1, -1);
+		}
+		const_iterator rend() const { return const_iterator(this, -1, -1); }
 
 		/** Return true if the k-mer at position i is the specified
 		 * k-mer. */
 		bool exists(unsigned i, const V& kmer) const
 		{
 			assert(i < m_data.size());
-			return m_data[i].first == kmer;
+			return at(i).first == kmer;
 		}
 
 		/** Return true if this branch is longer than maxLength. */
@@ -129,7 +288,7 @@ int calculateBranchMultiplicity() const
 	int total = 0;
 	for (BranchData::const_iterator it = m_data.begin();
 			it != m_data.end(); ++it) {
-		int m = it->second.getMultiplicity();
+		int m = it->getMultiplicity();
 		assert(m >= 0);
 		total += m;
 	}
@@ -159,15 +318,76 @@ bool isCanonical() const
 operator Sequence() const
 {
 	assert(!m_data.empty());
-	Sequence s(m_data.front().first.length() + m_data.size() - 1, 'N');
+	Sequence s(m_front.first.length() + m_data.size() - 1, 'N');
 	m_dir == SENSE
-		? branchRecordToStr(m_data.begin(), m_data.end(), s.begin())
-		: branchRecordToStr(m_data.rbegin(), m_data.rend(), s.begin());
+		? branchRecordToStr(begin(), end(), s.begin())
+		: branchRecordToStr(rbegin(), rend(), s.begin());
 	return s;
 }
 
 	private:
+		/** The number of steps packed in a byte */
+		static const unsigned STEPS_PER_BYTE = 8 / BranchStep::BITS;
+
+		/** Return the step i. Steps [i, i+k) are the vertex i. */
+		BranchStep::value_type step(size_t i) const
+		{
+			assert(i < m_numSteps);
+			unsigned shift = i % STEPS_PER_BYTE * BranchStep::BITS;
+			return BranchStep::unpack(m_steps[i / STEPS_PER_BYTE]
+					>> shift & ((1 << BranchStep::BITS) - 1));
+		}
+
+		/** Add a step at the end. */
+		void pushStep(BranchStep::value_type x)
+		{
+			unsigned i = m_numSteps++ % STEPS_PER_BYTE;
+			if (i == 0)
+				m_steps.push_back(0);
+			m_steps.back() |= BranchStep::pack(x) << (i * BranchStep::BITS);
+		}
+
+		/** Remove the last step. */
+		void popStep()
+		{
+			assert(m_numSteps > 0);
+			unsigned i = --m_numSteps % STEPS_PER_BYTE;
+			if (i == 0)
+				m_steps.pop_back();
+			else
+				m_steps.back() &= (1 << (i * BranchStep::BITS)) - 1;
+		}
+
+		/** Return the vertex u extended by the specified step. */
+		V shifted(V u, BranchStep::value_type x) const
+		{
+			u.shift(m_dir, x);
+			return u;
+		}
+
+		/** Roll the element x at position i to the adjacent position
+		 * j. */
+		void roll(value_type& x, size_t i, size_t j) const
+		{
+			if (j == i + 1)
+				x.first.shift(m_dir, step(j + Kmer::length() - 1));
+			else {
+				assert(j + 1 == i);
+				x.first.shift(!m_dir, step(j));
+			}
+			x.second = m_data[j];
+		}
+
+		/** The packed steps */
+		std::vector<uint8_t> m_steps;
+		/** The number of steps */
+		size_t m_numSteps;
+		/** The properties of each vertex */
 		BranchData m_data;
+		/** The first element */
+		value_type m_front;
+		/** The last element */
+		value_type m_back;
 		extDirection m_dir;
 		BranchState m_state;
 };
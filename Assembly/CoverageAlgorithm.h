@@ -122,7 +122,7 @@ size_t applyKmerCoverageThreshold(SequenceCollectionHash& c, unsigned kc)
 	for (SequenceCollectionHash::iterator it = c.begin();
 		it != c.end(); ++it) {
 		if (it->second.getMultiplicity() < kc)
-			it->second.setFlag(SF_DELETE);
+			c.remove(it);
 	}
 
 	return c.cleanup();
@@ -46,6 +46,15 @@ class SequenceCollectionHash
 			setFlag(seq, SF_DELETE);
 		}
 
+		/** Remove the sequence at the specified position. */
+		void remove(iterator it)
+		{
+			if (!it->second.deleted()) {
+				it->second.setFlag(SF_DELETE);
+				m_numDeleted++;
+			}
+		}
+
 		/** Shrink the hash table. */
 		void shrink() {
 			m_data.rehash(0);
@@ -97,7 +106,8 @@ class SequenceCollectionHash
 		bool isAdjacencyLoaded() const { return m_adjacencyLoaded; }
 
 SequenceCollectionHash()
-	: m_seqObserver(NULL), m_adjacencyLoaded(false)
+	: m_seqObserver(NULL), m_adjacencyLoaded(false),
+	m_numDeleted(0), m_numErased(0)
 {
 #if HAVE_GOOGLE_SPARSE_HASH_MAP
 	// sparse_hash_set uses 2.67 bits per element on a 64-bit
@@ -169,12 +179,17 @@ void add(const key_type& seq, unsigned coverage = 1)
 	}
 }
 
-/** Clean up by erasing sequences flagged as deleted.
+/** Erase the sequences flagged as deleted, so that later iteration
+ * visits only the remaining sequences. The remaining sequences keep
+ * their order, and the hash table is not rebuilt. Iterators to the
+ * erased sequences are invalidated, so this function must not be
+ * called while any sequence may still refer to a deleted sequence.
  * @return the number of sequences erased
  */
-size_t cleanup()
+size_t compact()
 {
-	Timer(__func__);
+	if (m_numDeleted == 0)
+		return 0;
 	size_t count = 0;
 	for (iterator it = m_data.begin(); it != m_data.end();) {
 		if (it->second.deleted()) {
@@ -183,7 +198,33 @@ size_t cleanup()
 		} else
 			++it;
 	}
-	shrink();
+	assert(count == m_numDeleted);
+	m_numDeleted = 0;
+	m_numErased += count;
+#if HAVE_GOOGLE_SPARSE_HASH_MAP
+	// sparse_hash_map leaves a marker in the place of each erased
+	// element, which is visited by iteration until the table is
+	// rebuilt.
+	if (4 * m_numErased > m_data.size()) {
+		m_data.rehash(0);
+		m_numErased = 0;
+	}
+#endif
+	return count;
+}
+
+/** Clean up by erasing sequences flagged as deleted, and shrink the
+ * hash table if any sequences have been erased.
+ * @return the number of sequences erased
+ */
+size_t cleanup()
+{
+	Timer timer(__func__);
+	size_t count = compact();
+	if (m_numErased > 0) {
+		shrink();
+		m_numErased = 0;
+	}
 	return count;
 }
 
@@ -239,6 +280,8 @@ void setFlag(const key_type& key, SeqFlag flag)
 	bool rc;
 	iterator it = find(key, rc);
 	assert(it != m_data.end());
+	if ((flag & SF_DELETE) && !it->second.deleted())
+		m_numDeleted++;
 	it->second.setFlag(rc ? complement(flag) : flag);
 }
 
@@ -392,6 +435,9 @@ void load(const char* path)
 	m_data.read_nopointer_data(f);
 	fclose(f);
 	m_adjacencyLoaded = true;
+	for (const_iterator it = m_data.begin(); it != m_data.end(); ++it)
+		if (it->second.deleted())
+			m_numDeleted++;
 #else
 	(void)path;
 	// Not supported.
@@ -424,6 +470,14 @@ void setColourSpace(bool flag)
 
 		/** Whether adjacency information has been loaded. */
 		bool m_adjacencyLoaded;
+
+		/** The number of sequences flagged as deleted that have not
+		 * been erased. */
+		size_t m_numDeleted;
+
+		/** The number of sequences erased since the hash table was
+		 * last rebuilt. */
+		size_t m_numErased;
 };
 
 // Forward declaration
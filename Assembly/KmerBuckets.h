@@ -0,0 +1,239 @@
+#ifndef ASSEMBLY_KMERBUCKETS_H
+#define ASSEMBLY_KMERBUCKETS_H 1
+
+#include "Assembly/Options.h"
+#include "Assembly/VertexData.h"
+#include "Common/Histogram.h"
+#include "Common/Kmer.h"
+#include "Common/Log.h"
+#include "Common/MemoryUtil.h"
+#include "Common/Options.h"
+#include "Common/StringUtil.h" // for toSI
+#include "Common/Timer.h"
+#include "Common/UnorderedMap.h"
+#include <boost/graph/graph_traits.hpp>
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <stdint.h>
+#include <string>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+/** Count k-mer on disk rather than in memory.
+ * The k-mer of the reads are written to temporary files, partitioned
+ * by their canonical minimizer, and each file is then counted in
+ * memory in turn. Only the k-mer whose multiplicity meets a threshold
+ * are added to the graph, so that the memory required depends on the
+ * number of solid k-mer rather than the number of distinct k-mer.
+ * This class may be passed to AssemblyAlgorithms::loadSequences in
+ * place of the graph.
+ */
+template <typename V>
+class KmerBuckets
+{
+  public:
+	typedef V vertex_descriptor;
+	typedef std::pair<V, V> edge_descriptor;
+	typedef boost::directed_tag directed_category;
+	typedef boost::disallow_parallel_edge_tag edge_parallel_category;
+	typedef boost::vertex_list_graph_tag traversal_category;
+
+	/** Create n buckets in a new directory of $TMPDIR. */
+	KmerBuckets(unsigned n) : m_count(0)
+	{
+		assert(n > 0);
+		const char* tmpdir = getenv("TMPDIR");
+		std::string dir = std::string(tmpdir != NULL && *tmpdir != '\0'
+				? tmpdir : "/tmp") + "/abyss-kmer-XXXXXX";
+		std::vector<char> path(dir.begin(), dir.end());
+		path.push_back('\0');
+		if (mkdtemp(&path[0]) == NULL) {
+			perror(dir.c_str());
+			exit(EXIT_FAILURE);
+		}
+		m_dir = &path[0];
+
+		m_buckets.resize(n);
+		for (unsigned i = 0; i < n; ++i) {
+			m_buckets[i] = fopen(bucketPath(i).c_str(), "w+");
+			if (m_buckets[i] == NULL) {
+				perror(bucketPath(i).c_str());
+				exit(EXIT_FAILURE);
+			}
+		}
+	}
+
+	~KmerBuckets()
+	{
+		for (unsigned i = 0; i < m_buckets.size(); ++i) {
+			if (m_buckets[i] != NULL)
+				fclose(m_buckets[i]);
+			remove(bucketPath(i).c_str());
+		}
+		rmdir(m_dir.c_str());
+	}
+
+	/** Write the specified k-mer to its bucket. */
+	void add(const V& kmer, unsigned coverage = 1)
+	{
+		unsigned m = std::min(Kmer::length(), 15U);
+		FILE* f = m_buckets[kmer.getMinimizerCode(m)
+			% m_buckets.size()];
+		assert(f != NULL);
+		uint16_t cov = std::min(coverage, COVERAGE_MAX);
+		if (fwrite(&kmer, sizeof kmer, 1, f) != 1
+				|| fwrite(&cov, sizeof cov, 1, f) != 1) {
+			perror(m_dir.c_str());
+			exit(EXIT_FAILURE);
+		}
+		m_count++;
+	}
+
+	/** Return true if no k-mer have been written. */
+	bool empty() const { return m_count == 0; }
+
+	/** Indicate that this is a colour-space collection. */
+	void setColourSpace(bool flag)
+	{
+		if (!empty())
+			assert(opt::colourSpace == flag);
+		opt::colourSpace = flag;
+	}
+
+	// Not a network sequence collection. Nothing to do.
+	size_t pumpNetwork() { return 0; }
+
+	/** A k-mer file cannot be counted on disk. */
+	void load(const char* path)
+	{
+		std::cerr << "error: `" << path << "': "
+			"a k-mer file cannot be counted on disk\n";
+		exit(EXIT_FAILURE);
+	}
+
+	/** Print the number of k-mer written. */
+	void printLoad() const
+	{
+		logger(1) << "Wrote " << m_count << " k-mer to "
+			<< m_buckets.size() << " buckets using "
+			<< toSI(getMemoryUsage()) << "B" << std::endl;
+	}
+
+	/** Count the k-mer of each bucket, and add to g those whose
+	 * multiplicity is at least kc. Record the multiplicity of every
+	 * distinct k-mer in h.
+	 * @return the number of distinct k-mer
+	 */
+	template <typename Graph>
+	size_t count(Graph& g, unsigned kc, Histogram& h)
+	{
+		Timer timer("CountKmer");
+		size_t distinct = 0;
+		for (unsigned i = 0; i < m_buckets.size(); ++i) {
+			distinct += countBucket(i, g, kc, h);
+			logger(1) << "Counted bucket " << i + 1 << " of "
+				<< m_buckets.size() << ". ";
+			g.printLoad();
+		}
+		return distinct;
+	}
+
+  private:
+	KmerBuckets(const KmerBuckets&);
+	KmerBuckets& operator=(const KmerBuckets&);
+
+	/** The multiplicity of a k-mer on each strand. */
+	struct Count {
+		/** The orientation in which the k-mer was first seen */
+		V first;
+		/** The multiplicity of that orientation and of its reverse
+		 * complement */
+		unsigned multiplicity[2];
+	};
+
+	std::string bucketPath(unsigned i) const
+	{
+		std::ostringstream s;
+		s << m_dir << '/' << i;
+		return s.str();
+	}
+
+	/** Count the k-mer of bucket i and delete the bucket.
+	 * @return the number of distinct k-mer
+	 */
+	template <typename Graph>
+	size_t countBucket(unsigned i, Graph& g, unsigned kc, Histogram& h)
+	{
+		typedef unordered_map<V, Count, hash<V> > Map;
+
+		FILE* f = m_buckets[i];
+		if (fflush(f) != 0 || fseek(f, 0, SEEK_SET) != 0) {
+			perror(bucketPath(i).c_str());
+			exit(EXIT_FAILURE);
+		}
+
+		// The reads are written to each bucket in order, so the
+		// first occurrence of a k-mer determines its orientation as
+		// it would when loading the reads into the graph.
+		Map counts;
+		V kmer;
+		uint16_t cov;
+		while (fread(&kmer, sizeof kmer, 1, f) == 1) {
+			if (fread(&cov, sizeof cov, 1, f) != 1)
+				break;
+			V key = kmer;
+			bool rc = false;
+			if (!opt::ss) {
+				V kmerRC = reverseComplement(kmer);
+				rc = kmerRC < kmer;
+				if (rc)
+					key = kmerRC;
+			}
+			std::pair<typename Map::iterator, bool> inserted
+				= counts.insert(std::make_pair(key, Count()));
+			Count& c = inserted.first->second;
+			if (inserted.second) {
+				c.first = kmer;
+				c.multiplicity[0] = c.multiplicity[1] = 0;
+			}
+			unsigned& n = c.multiplicity[rc != (c.first != key)];
+			n = std::min(n + cov, COVERAGE_MAX);
+		}
+		if (ferror(f)) {
+			perror(bucketPath(i).c_str());
+			exit(EXIT_FAILURE);
+		}
+		fclose(f);
+		m_buckets[i] = NULL;
+		remove(bucketPath(i).c_str());
+
+		for (typename Map::const_iterator it = counts.begin();
+				it != counts.end(); ++it) {
+			const Count& c = it->second;
+			unsigned multiplicity = c.multiplicity[0] + c.multiplicity[1];
+			h.insert(multiplicity);
+			if (multiplicity < kc)
+				continue;
+			g.add(c.first, c.multiplicity[0]);
+			if (c.multiplicity[1] > 0)
+				g.add(reverseComplement(c.first), c.multiplicity[1]);
+		}
+		return counts.size();
+	}
+
+	/** The directory of the buckets */
+	std::string m_dir;
+
+	/** The bucket files */
+	std::vector<FILE*> m_buckets;
+
+	/** The number of k-mer written */
+	size_t m_count;
+};
+
+#endif
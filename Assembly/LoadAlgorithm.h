@@ -69,15 +69,23 @@ bool loadSequence(Graph* seqCollection, Sequence& seq)
 	return discarded;
 }
 
-/** Load sequence data into the collection. */
+/** Load sequence data into the collection.
+ * When nsections is greater than one, load only the records of the
+ * specified section of the file, numbered from 1.
+ */
 template <typename Graph>
-void loadSequences(Graph* seqCollection, std::string inFile)
+void loadSequences(Graph* seqCollection, std::string inFile,
+		unsigned section = 1, unsigned nsections = 1)
 {
 	typedef typename graph_traits<Graph>::vertex_descriptor V;
 
 	Timer timer("LoadSequences " + inFile);
 
-	logger(0) << "Reading `" << inFile << "'...\n";
+	if (nsections > 1)
+		logger(0) << "Reading `" << inFile << "' section " << section
+			<< " of " << nsections << "...\n";
+	else
+		logger(0) << "Reading `" << inFile << "'...\n";
 
 	if (inFile.find(".kmer") != std::string::npos) {
 		if (opt::rank <= 0)
@@ -92,6 +100,8 @@ void loadSequences(Graph* seqCollection, std::string inFile)
 	int fastaFlags = opt::maskCov ?  FastaReader::NO_FOLD_CASE :
 			FastaReader::FOLD_CASE;
 	FastaReader reader(inFile.c_str(), fastaFlags);
+	if (nsections > 1)
+		reader.split(section, nsections);
 	if (endsWith(inFile, ".jf") || endsWith(inFile, ".jfq")) {
 		// Load k-mer with coverage data.
 		count = loadKmer(*seqCollection, reader);
@@ -58,6 +58,13 @@ static const char USAGE_MESSAGE[] =
 "  -c, --coverage=FLOAT  remove contigs with mean k-mer coverage\n"
 "                        less than this threshold\n"
 "      --kc=N            remove all k-mers with multiplicity < N [0]\n"
+"      --kc-buckets=N    count k-mers on disk in N buckets and load only\n"
+"                        those with multiplicity >= kc, which reduces\n"
+"                        the memory used [0, disabled] (ABYSS only)\n"
+"      --minimizer=N     assign each k-mer to the process of its canonical\n"
+"                        minimizer of length N, so that adjacent k-mers\n"
+"                        are usually on the same process [0, disabled]\n"
+"                        (ABYSS-P only)\n"
 "  -b, --bubbles=N       pop bubbles shorter than N bp [3*k]\n"
 "  -b0, --no-bubbles     do not pop bubbles\n"
 "  -e, --erode=N         erode bases at the ends of blunt contigs with coverage\n"
@@ -114,6 +121,16 @@ float coverage = -1;
 /** Minimum k-mer multiplicity cutoff. */
 unsigned kc = 0;
 
+/** The number of buckets in which to count k-mers on disk.
+ * When 0, k-mers are counted in memory.
+ */
+unsigned kcBuckets = 0;
+
+/** The length of the minimizer used to assign k-mers to processes.
+ * When 0, k-mers are assigned by a hash of the whole k-mer.
+ */
+unsigned minimizer = 0;
+
 /** Pop bubbles shorter than N bp. */
 int bubbleLen = -1;
 
@@ -154,7 +171,8 @@ string assemblyCmd;
 
 static const char shortopts[] = "b:c:e:E:g:k:K:mo:Q:q:s:t:v";
 
-enum { OPT_HELP = 1, OPT_VERSION, COVERAGE_HIST, OPT_DB, OPT_LIBRARY, OPT_STRAIN, OPT_SPECIES, OPT_KC };
+enum { OPT_HELP = 1, OPT_VERSION, COVERAGE_HIST, OPT_DB, OPT_LIBRARY, OPT_STRAIN, OPT_SPECIES, OPT_KC,
+	OPT_MINIMIZER, OPT_KC_BUCKETS };
 
 static const struct option longopts[] = {
 	{ "out",         required_argument, NULL, 'o' },
@@ -172,6 +190,8 @@ static const struct option longopts[] = {
 	{ "no-SS",       no_argument,       &opt::ss, 0 },
 	{ "coverage",    required_argument, NULL, 'c' },
 	{ "kc",          required_argument, NULL, OPT_KC },
+	{ "kc-buckets",  required_argument, NULL, OPT_KC_BUCKETS },
+	{ "minimizer",   required_argument, NULL, OPT_MINIMIZER },
 	{ "coverage-hist", required_argument, NULL, COVERAGE_HIST },
 	{ "bubble-length", required_argument, NULL, 'b' },
 	{ "no-bubbles",  no_argument,       &opt::bubbleLen, 0 },
@@ -313,6 +333,12 @@ void parse(int argc, char* const* argv)
 			case OPT_KC:
 				arg >> opt::kc;
 				break;
+			case OPT_MINIMIZER:
+				arg >> opt::minimizer;
+				break;
+			case OPT_KC_BUCKETS:
+				arg >> opt::kcBuckets;
+				break;
 		}
 		if (optarg != NULL && !arg.eof()) {
 			cerr << PROGRAM ": invalid option: `-"
@@ -329,6 +355,15 @@ void parse(int argc, char* const* argv)
 		cerr << PROGRAM ": missing -k,--kmer option\n";
 		die = true;
 	}
+	if (minimizer > 32 || (int)minimizer > (singleKmerSize > 0
+				? singleKmerSize : kmerSize)) {
+		cerr << PROGRAM ": --minimizer must be no more than k and 32\n";
+		die = true;
+	}
+	if (kcBuckets > 0 && kc == 0) {
+		cerr << PROGRAM ": --kc-buckets requires --kc\n";
+		die = true;
+	}
 	if (contigsPath.empty()) {
 		cerr << PROGRAM ": missing -o,--out option\n";
 		die = true;
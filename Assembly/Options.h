@@ -15,6 +15,8 @@ namespace opt {
 	extern unsigned trimLen;
 	extern float coverage;
 	extern unsigned kc;
+	extern unsigned kcBuckets;
+	extern unsigned minimizer;
 	extern unsigned bubbleLen;
 	extern unsigned ss;
 	extern bool maskCov;
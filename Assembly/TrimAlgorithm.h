@@ -8,7 +8,12 @@ bool processTerminatedBranchTrim(Graph* seqCollection, BranchRecord& branch);
 
 static inline
 size_t trimSequences(SequenceCollectionHash* seqCollection,
-		unsigned maxBranchCull);
+		unsigned maxBranchCull,
+		std::vector<SequenceCollectionHash::key_type>& tips);
+
+static inline
+void findTips(const SequenceCollectionHash& g,
+		std::vector<SequenceCollectionHash::key_type>& tips);
 
 /** Trimming driver function */
 static inline
@@ -16,14 +21,22 @@ void performTrim(SequenceCollectionHash* seqCollection)
 {
 	if (opt::trimLen == 0)
 		return;
+
+	// The whole graph is scanned once for tips. Each round thereafter
+	// considers only the tips of the previous round that remain and
+	// the neighbours of the removed k-mer.
+	std::vector<SequenceCollectionHash::key_type> tips;
+	findTips(*seqCollection, tips);
+
 	unsigned rounds = 0;
 	size_t total = 0;
 	for (unsigned trim = 1; trim < opt::trimLen; trim *= 2) {
 		rounds++;
-		total += trimSequences(seqCollection, trim);
+		total += trimSequences(seqCollection, trim, tips);
 	}
 	size_t count;
-	while ((count = trimSequences(seqCollection, opt::trimLen)) > 0) {
+	while ((count = trimSequences(seqCollection, opt::trimLen, tips))
+			> 0) {
 		rounds++;
 		total += count;
 	}
@@ -33,10 +46,101 @@ void performTrim(SequenceCollectionHash* seqCollection)
 	tempCounter[2] = rounds;
 }
 
-/** Prune tips shorter than maxBranchCull. */
+/** Add the k-mer that have no edges in at least one direction to
+ * tips, and sort them.
+ * @param candidates the k-mer to consider, which may be deleted
+ */
+static inline
+void findTips(const SequenceCollectionHash& g,
+		const std::vector<SequenceCollectionHash::key_type>& candidates,
+		std::vector<SequenceCollectionHash::key_type>& tips)
+{
+	typedef SequenceCollectionHash Graph;
+	typedef graph_traits<Graph>::vertex_descriptor V;
+
+	for (std::vector<V>::const_iterator it = candidates.begin();
+			it != candidates.end(); ++it) {
+		bool rc;
+		Graph::const_iterator seq = g.find(*it, rc);
+		if (seq == g.end() || seq->second.deleted())
+			continue;
+		extDirection dir;
+		if (checkSeqContiguity(*seq, dir) != SC_CONTIGUOUS)
+			tips.push_back(seq->first);
+	}
+	std::sort(tips.begin(), tips.end());
+	tips.erase(std::unique(tips.begin(), tips.end()), tips.end());
+}
+
+/** Find the k-mer of the graph that have no edges in at least one
+ * direction.
+ */
+static inline
+void findTips(const SequenceCollectionHash& g,
+		std::vector<SequenceCollectionHash::key_type>& tips)
+{
+	typedef SequenceCollectionHash Graph;
+
+	Timer timer(__func__);
+	tips.clear();
+	for (Graph::const_iterator it = g.begin(); it != g.end(); ++it) {
+		if (it->second.deleted())
+			continue;
+		extDirection dir;
+		if (checkSeqContiguity(*it, dir) != SC_CONTIGUOUS)
+			tips.push_back(it->first);
+	}
+	std::sort(tips.begin(), tips.end());
+}
+
+/** Remove the specified marked k-mer, and replace tips with the k-mer
+ * that have no edges in at least one direction after their removal.
+ * @return the number of removed k-mer
+ */
+static inline
+size_t removeMarkedTips(SequenceCollectionHash* seqCollection,
+		const std::vector<SequenceCollectionHash::key_type>& marked,
+		std::vector<SequenceCollectionHash::key_type>& tips)
+{
+	typedef SequenceCollectionHash Graph;
+	typedef graph_traits<Graph>::vertex_descriptor V;
+
+	Timer timer("removeMarked");
+	const Graph& g = *seqCollection;
+	// The removed k-mer change only the edges of their neighbours.
+	std::vector<V> candidates;
+	candidates.swap(tips);
+	size_t count = 0;
+	for (std::vector<V>::const_iterator it = marked.begin();
+			it != marked.end(); ++it) {
+		bool rc;
+		Graph::const_iterator seq = g.find(*it, rc);
+		assert(seq != g.end());
+		if (seq->second.deleted())
+			continue;
+		assert(seq->second.marked());
+		generateSequencesFromExtension(seq->first, SENSE,
+				seq->second.getExtension(SENSE), candidates);
+		generateSequencesFromExtension(seq->first, ANTISENSE,
+				seq->second.getExtension(ANTISENSE), candidates);
+		removeSequenceAndExtensions(seqCollection, *seq);
+		count++;
+	}
+	if (count > 0)
+		logger(1) << "Removed " << count << " marked k-mer.\n";
+
+	findTips(g, candidates, tips);
+	return count;
+}
+
+/** Prune tips shorter than maxBranchCull.
+ * @param tips [in,out] the k-mer that have no edges in at least one
+ * direction
+ */
 static inline
 size_t trimSequences(SequenceCollectionHash* seqCollection,
-		unsigned maxBranchCull)
+		unsigned maxBranchCull,
+		std::vector<SequenceCollectionHash::key_type>& tips)
 {
 	typedef SequenceCollectionHash Graph;
 	typedef graph_traits<Graph>::vertex_descriptor V;
@@ -45,12 +149,16 @@ size_t trimSequences(SequenceCollectionHash* seqCollection,
 	Timer timer("TrimSequences");
 	std::cout << "Pruning tips shorter than "
 		<< maxBranchCull << " bp...\n";
+	const Graph& g = *seqCollection;
 	size_t numBranchesRemoved = 0;
+	std::vector<V> marked;
 
-	for (Graph::iterator iter = seqCollection->begin();
-			iter != seqCollection->end(); ++iter) {
-		if (iter->second.deleted())
-			continue;
+	for (std::vector<V>::const_iterator tip = tips.begin();
+			tip != tips.end(); ++tip) {
+		bool rc;
+		Graph::const_iterator iter = g.find(*tip, rc);
+		assert(iter != g.end());
+		assert(!iter->second.deleted());
 
 		extDirection dir;
 		// dir will be set to the trimming direction if the sequence
@@ -63,6 +171,7 @@ size_t trimSequences(SequenceCollectionHash* seqCollection,
 		{
 			// remove this sequence, it has no extensions
 			seqCollection->mark(iter->first);
+			marked.push_back(iter->first);
 			numBranchesRemoved++;
 			continue;
 		}
@@ -86,11 +195,14 @@ size_t trimSequences(SequenceCollectionHash* seqCollection,
 		if(processTerminatedBranchTrim(seqCollection, currBranch))
 		{
 			numBranchesRemoved++;
+			for (BranchRecord::iterator it = currBranch.begin();
+					it != currBranch.end(); ++it)
+				marked.push_back(it->first);
 		}
-		seqCollection->pumpNetwork();
 	}
 
-	size_t numSweeped = removeMarked(seqCollection);
+	size_t numSweeped = removeMarkedTips(seqCollection, marked, tips);
+	seqCollection->compact();
 
 	if (numBranchesRemoved > 0)
 		logger(0) << "Pruned " << numSweeped << " k-mer in "
@@ -1,5 +1,81 @@
+#include "config.h"
 #include "ContigID.h"
+#include "HashFunction.h"
+#include "Uncompress.h"
+#include <cstdio>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
 
 Dictionary g_contigNames;
 
 unsigned g_nextContigName;
+
+/** The graph file whose contig names are being read into
+ * g_contigNames, which may be saved by saveContigNames.
+ */
+static string s_graphPath;
+
+/** The key of the file s_graphPath. */
+static uint64_t s_graphKey;
+
+/** Return a key that changes when the specified file is modified.
+ * @return false if the file is not a regular file
+ */
+static bool getFileKey(const string& path, uint64_t& key)
+{
+	if (path == "-" || uncompress_isPipe(path.c_str()))
+		return false;
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+		return false;
+	// Include the fraction of a second of the modification time
+	// where available, so that a file rewritten within the same
+	// second is not mistaken for the original.
+#if HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+	uint64_t nsec = st.st_mtim.tv_nsec;
+#elif HAVE_STRUCT_STAT_ST_MTIMESPEC_TV_NSEC
+	uint64_t nsec = st.st_mtimespec.tv_nsec;
+#else
+	uint64_t nsec = 0;
+#endif
+	uint64_t a[5] = { (uint64_t)st.st_dev, (uint64_t)st.st_ino,
+		(uint64_t)st.st_size, (uint64_t)st.st_mtime, nsec };
+	key = hashmem(a, sizeof a);
+	return true;
+}
+
+/** Map the contig names of the specified graph file from its name
+ * dictionary, graphPath.names, if it is up to date. Otherwise the
+ * dictionary is written by saveContigNames after reading the graph.
+ * @return whether the names were mapped
+ */
+bool loadContigNames(const string& graphPath)
+{
+	s_graphPath.clear();
+	if (!g_contigNames.empty() || !getFileKey(graphPath, s_graphKey))
+		return false;
+	if (g_contigNames.load(graphPath + ".names", s_graphKey))
+		return true;
+	s_graphPath = graphPath;
+	return false;
+}
+
+/** Write the name dictionary of the specified graph file, if its
+ * names were read by the preceding call to loadContigNames. Errors are
+ * ignored, since the dictionary only speeds up reading the graph.
+ */
+void saveContigNames(const string& graphPath)
+{
+	if (graphPath.empty() || graphPath != s_graphPath)
+		return;
+	s_graphPath.clear();
+	string path = graphPath + ".names";
+	ostringstream tmp;
+	tmp << path << '.' << getpid();
+	if (g_contigNames.save(tmp.str(), s_graphKey))
+		rename(tmp.str().c_str(), path.c_str());
+	else
+		unlink(tmp.str().c_str());
+}
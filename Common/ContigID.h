@@ -14,6 +14,9 @@ extern Dictionary g_contigNames;
 /** The next unique contig name. */
 extern unsigned g_nextContigName;
 
+bool loadContigNames(const std::string& graphPath);
+void saveContigNames(const std::string& graphPath);
+
 /** Set the next contig name returned by createContigName. */
 static inline void setNextContigName(cstring s)
 {
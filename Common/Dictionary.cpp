@@ -0,0 +1,154 @@
+#include "Dictionary.h"
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+/** The header of a dictionary file. The header is followed by the
+ * offsets of the names, the hash table, and the null-terminated
+ * names.
+ */
+struct DictionaryHeader {
+	char magic[8];
+	/** Identifies the source of the names. */
+	uint64_t key;
+	uint64_t numNames;
+	/** The number of slots in the hash table, a power of two. */
+	uint64_t tableSize;
+};
+
+static const char DICTIONARY_MAGIC[8] = { 'A', 'B', 'Y', 'S', 'S',
+	'D', 'I', '1' };
+
+/** Write this dictionary to the specified file, which may be mapped
+ * by load. The file is specific to this machine's byte order.
+ * @param key identifies the source of the names
+ * @return whether the file was written
+ */
+bool Dictionary::save(const string& path, uint64_t key) const
+{
+	uint64_t n = size();
+	if (n >= NOT_FOUND)
+		return false;
+
+	DictionaryHeader header;
+	memcpy(header.magic, DICTIONARY_MAGIC, sizeof header.magic);
+	header.key = key;
+	header.numNames = n;
+	header.tableSize = 1;
+	while (header.tableSize < 2 * n)
+		header.tableSize *= 2;
+	uint64_t mask = header.tableSize - 1;
+
+	vector<uint64_t> offsets(n);
+	vector<uint32_t> table(header.tableSize);
+	uint64_t offset = sizeof header
+		+ n * sizeof offsets[0] + header.tableSize * sizeof table[0];
+	for (index_type i = 0; i < n; ++i) {
+		cstring name = getName(i);
+		size_t length = strlen(name);
+		offsets[i] = offset;
+		offset += length + 1;
+		uint64_t j = hashmem(name, length) & mask;
+		while (table[j] != 0)
+			j = (j + 1) & mask;
+		table[j] = i + 1;
+	}
+
+	ofstream out(path.c_str(), ios::binary);
+	out.write(reinterpret_cast<const char*>(&header), sizeof header);
+	out.write(reinterpret_cast<const char*>(offsets.data()),
+			n * sizeof offsets[0]);
+	out.write(reinterpret_cast<const char*>(table.data()),
+			header.tableSize * sizeof table[0]);
+	for (index_type i = 0; i < n; ++i) {
+		cstring name = getName(i);
+		out.write(name, strlen(name) + 1);
+	}
+	out.close();
+	return out.good();
+}
+
+/** Map the specified dictionary file into memory, if it exists and
+ * its key matches. This dictionary must be empty.
+ * @return whether the file was mapped
+ */
+bool Dictionary::load(const string& path, uint64_t key)
+{
+	assert(empty());
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)
+			|| (uint64_t)st.st_size < sizeof (DictionaryHeader)) {
+		close(fd);
+		return false;
+	}
+	void* p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED)
+		return false;
+
+	const char* base = static_cast<const char*>(p);
+	const DictionaryHeader& header
+		= *reinterpret_cast<const DictionaryHeader*>(base);
+	uint64_t tableSize = header.tableSize;
+	bool good = memcmp(header.magic, DICTIONARY_MAGIC,
+				sizeof header.magic) == 0
+		&& header.key == key
+		&& header.numNames < NOT_FOUND
+		&& tableSize > 0 && (tableSize & (tableSize - 1)) == 0
+		&& tableSize > header.numNames && tableSize <= 1ULL << 40
+		&& sizeof header + header.numNames * sizeof (uint64_t)
+			+ tableSize * sizeof (uint32_t)
+			<= (uint64_t)st.st_size
+		&& (header.numNames == 0 || base[st.st_size - 1] == '\0');
+	if (!good) {
+		munmap(p, st.st_size);
+		return false;
+	}
+
+	// Check that every name and slot is within the file, so that a
+	// corrupt file cannot cause a read out of bounds.
+	const uint64_t* offsets
+		= reinterpret_cast<const uint64_t*>(base + sizeof header);
+	const uint32_t* table
+		= reinterpret_cast<const uint32_t*>(offsets + header.numNames);
+	uint64_t namesStart = (const char*)(table + tableSize) - base;
+	for (uint64_t i = 0; good && i < header.numNames; ++i)
+		good = offsets[i] >= namesStart
+			&& offsets[i] < (uint64_t)st.st_size;
+	for (uint64_t i = 0; good && i < tableSize; ++i)
+		good = table[i] <= header.numNames;
+	if (!good) {
+		munmap(p, st.st_size);
+		return false;
+	}
+
+	m_path = path;
+	m_mapped = base;
+	m_numMapped = header.numNames;
+	m_offsets = offsets;
+	m_table = table;
+	m_tableMask = tableSize - 1;
+	return true;
+}
+
+/** Report that the name of the specified index differs from the
+ * mapped file, remove the stale file and exit. The names read so far
+ * depend on the mapped file, so they cannot be read again here.
+ */
+void Dictionary::staleMapping(index_type index, const name_type& name)
+{
+	cerr << "error: `" << m_path << "' does not match the graph: "
+		"expected the name `" << name << "' at index " << index
+		<< " but found `" << getName(index) << "'.\n"
+		"The stale file has been removed. Run the command again.\n";
+	unlink(m_path.c_str());
+	exit(EXIT_FAILURE);
+}
@@ -5,11 +5,17 @@
 #include "UnorderedMap.h"
 #include <cassert>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <stdint.h>
 #include <string>
 #include <vector>
 
-/** A bidirectional map of indices and names. */
+/** A bidirectional map of indices and names.
+ * The dictionary may be saved to a file, which is later mapped into
+ * memory rather than parsed and hashed. Names inserted after mapping
+ * the file are stored in memory.
+ */
 class Dictionary
 {
 	public:
@@ -22,15 +28,22 @@ class Dictionary
 		typedef unordered_map<name_reference, index_type,
 			hash<name_reference> > Map;
 
-		Dictionary() : m_locked(false) { }
+		Dictionary()
+			: m_locked(false), m_mapped(NULL), m_numMapped(0),
+			m_offsets(NULL), m_table(NULL), m_tableMask(0) { }
 
 		/** Insert the specified name. */
 		index_reference insert(const name_type& name)
 		{
+			if (findMapped(name) != NOT_FOUND) {
+				std::cerr << "error: duplicate ID: `"
+					<< name << "'\n";
+				abort();
+			}
 			m_vec.push_back(name);
 			std::pair<Map::const_iterator, bool> inserted
 				= m_map.insert(Map::value_type(
-							m_vec.back(), m_map.size()));
+							m_vec.back(), size() - 1));
 			if (!inserted.second) {
 				std::cerr << "error: duplicate ID: `"
 					<< name << "'\n";
@@ -41,15 +54,19 @@ class Dictionary
 
 		/** If the specified index is within this dictionary, ensure
 		 * that the name is identical, otherwise append the name to
-		 * this dictionary.
+		 * this dictionary. A mapped name that differs means that the
+		 * mapped file is stale, which is a fatal error.
 		 */
 		void put(index_type index, const name_type& name)
 		{
-			if (index < m_vec.size()) {
+			if (index < m_numMapped) {
+				if (strcmp(getName(index), name.c_str()) != 0)
+					staleMapping(index, name);
+			} else if (index < size()) {
 				assert(getName(index) == name);
 			} else {
 				assert(!m_locked);
-				assert(index == m_vec.size());
+				assert(index == size());
 				index_type i = insert(name);
 				assert(i == index);
 				(void)i;
@@ -59,6 +76,9 @@ class Dictionary
 		/** Return the index of the specified name. */
 		index_reference getIndex(const name_type& name) const
 		{
+			index_type i = findMapped(name);
+			if (i != NOT_FOUND)
+				return i;
 			Map::const_iterator it = m_map.find(name);
 			if (it == m_map.end()) {
 				std::cerr << "error: unexpected ID: `"
@@ -71,8 +91,10 @@ class Dictionary
 		/** Return the name of the specified index. */
 		name_reference getName(index_type index) const
 		{
-			assert(index < m_vec.size());
-			return m_vec[index];
+			if (index < m_numMapped)
+				return m_mapped + m_offsets[index];
+			assert(index - m_numMapped < m_vec.size());
+			return m_vec[index - m_numMapped];
 		}
 
 		/** Lock this dictionary. No further elements may be added. */
@@ -82,28 +104,77 @@ class Dictionary
 		void unlock() { m_locked = false; }
 
 		/** Return true if this dictionary is empty. */
-		bool empty() const { return m_vec.empty(); }
+		bool empty() const { return size() == 0; }
 
 		/** Return the number of elements in this dictionary. */
-		size_t size() const { return m_vec.size(); }
+		size_t size() const { return m_numMapped + m_vec.size(); }
 
 		/** Return the number of elements with the specified name. */
 		size_t count(const name_type& name) const
 		{
-			return m_map.count(name);
+			return findMapped(name) != NOT_FOUND ? 1
+				: m_map.count(name);
 		}
 
 		/** Return the last name in this dictionary. */
 		name_reference back() const
 		{
-			assert(!m_vec.empty());
-			return m_vec.back();
+			assert(!empty());
+			return getName(size() - 1);
 		}
 
+		/** Return whether this dictionary is mapped from a file. */
+		bool mapped() const { return m_mapped != NULL; }
+
+		bool save(const std::string& path, uint64_t key) const;
+		bool load(const std::string& path, uint64_t key);
+
 	private:
+		static const index_type NOT_FOUND = ~0U;
+
+		void staleMapping(index_type index, const name_type& name);
+
+		/** Return the index of the specified name in the mapped
+		 * file, or NOT_FOUND.
+		 */
+		index_type findMapped(const name_type& name) const
+		{
+			if (m_table == NULL)
+				return NOT_FOUND;
+			uint64_t i = hashmem(name.data(), name.size())
+				& m_tableMask;
+			for (uint64_t n = 0; n <= m_tableMask;
+					++n, i = (i + 1) & m_tableMask) {
+				uint32_t slot = m_table[i];
+				if (slot == 0)
+					return NOT_FOUND;
+				if (name == m_mapped + m_offsets[slot - 1])
+					return slot - 1;
+			}
+			return NOT_FOUND;
+		}
+
 		Map m_map;
 		Vector m_vec;
 		bool m_locked;
+
+		/** The path of the mapped file. */
+		std::string m_path;
+
+		/** The mapped file, which is never unmapped. */
+		const char* m_mapped;
+
+		/** The number of names in the mapped file. */
+		index_type m_numMapped;
+
+		/** The offsets of the names in the mapped file. */
+		const uint64_t* m_offsets;
+
+		/** The hash table of the mapped file. Each slot is one plus
+		 * the index of a name, or zero when empty.
+		 */
+		const uint32_t* m_table;
+		uint64_t m_tableMask;
 };
 
 static inline Dictionary::name_reference get(
@@ -10,3 +10,22 @@ int setCloexec(int fd)
 	flags |= FD_CLOEXEC;
 	return fcntl(fd, F_SETFD, flags);
 }
+
+/* Set the buffer size of the specified pipe, if supported. */
+int setPipeSize(int fd, int size)
+{
+#ifdef F_SETPIPE_SZ
+	return fcntl(fd, F_SETPIPE_SZ, size);
+#else
+	(void)fd;
+	(void)size;
+	return -1;
+#endif
+}
+
+/* Open the specified file for reading. Use openat rather than open,
+ * which is hooked by Uncompress.cpp to uncompress the file. */
+int openReadOnly(const char* path)
+{
+	return openat(AT_FDCWD, path, O_RDONLY);
+}
@@ -2,5 +2,7 @@
 #define FCONTROL_H 1
 
 int setCloexec(int fd);
+int setPipeSize(int fd, int size);
+int openReadOnly(const char* path);
 
 #endif
@@ -10,10 +10,12 @@ using namespace std;
 Histogram Histogram::trimLow(T threshold) const
 {
 	Histogram h;
-	for (Histogram::Map::const_iterator it = m_map.begin();
-			it != m_map.end(); it++)
-		if (it->first >= threshold)
-			h.insert(it->first, it->second);
+	h.m_map.insert(m_map.lower_bound(threshold), m_map.end());
+	if ((size_type)std::max(threshold, 0) < m_dense.size()) {
+		h.m_dense = m_dense;
+		std::fill(h.m_dense.begin(),
+				h.m_dense.begin() + std::max(threshold, 0), 0);
+	}
 	return h;
 }
 
@@ -28,8 +30,7 @@ Histogram Histogram::trimFraction(double fraction) const
 
 	double cumulative = 0;
 	Histogram newHist;
-	for (Histogram::Map::const_iterator it = m_map.begin();
-			it != m_map.end(); it++) {
+	for (const_iterator it = begin(); it != end(); ++it) {
 		double temp_total = cumulative + (double)it->second / n;
 		if (temp_total > low_cutoff && cumulative < high_cutoff)
 			newHist.insert(it->first, it->second);
@@ -49,8 +50,7 @@ Histogram::Bins Histogram::bin(unsigned n) const
 	T nperbucket = (T)ceilf((float)(maximum() - minimum()) / n);
 	T next = minimum() + nperbucket;
 	Histogram::Bins::value_type count = 0;
-	for (Histogram::Map::const_iterator it = m_map.begin();
-			it != m_map.end(); it++) {
+	for (const_iterator it = begin(); it != end(); ++it) {
 		if (it->first >= next) {
 			bins.push_back(count);
 			count = 0;
@@ -4,10 +4,13 @@
 #include "Common/Exception.h"
 #include "StringUtil.h" // for toEng
 #include "VectorUtil.h" // for make_vector
+#include <algorithm>
 #include <cassert>
 #include <climits> // for INT_MAX
 #include <cmath>
+#include <cstddef>
 #include <istream>
+#include <iterator>
 #include <map>
 #include <ostream>
 #include <string>
@@ -16,16 +19,113 @@
 /** A histogram of type T, which is int be default.
  * A histogram may be implemented as a multiset. This class aims
  * to provide a similar interface to a multiset.
+ *
+ * A histogram counts its samples in a sparse map until the samples
+ * in the range [0, MAX_DENSE) would fill at least a quarter of a dense
+ * array. Those samples are then counted in a dense array, which grows
+ * as needed, and the other samples remain in the map. A small
+ * histogram, such as the distances between one pair of contigs, stays
+ * sparse, so that iterating over it visits only its distinct samples.
  */
 class Histogram
 {
 	typedef int T;
 	typedef size_t size_type;
+	typedef std::vector<size_type> Dense;
 	typedef std::map<T, size_type> Map;
 	typedef long long unsigned accumulator;
 
+	/** The size limit of the dense array. */
+	enum { MAX_DENSE = 65536 };
+
+	/** The minimum number of distinct samples of a dense array. */
+	enum { MIN_DENSE = 64 };
+
   public:
-	typedef Map::const_iterator const_iterator;
+	typedef std::pair<T, size_type> value_type;
+
+	/** Iterate over the samples whose count is not zero in
+	 * increasing order: the negative samples of the sparse map, the
+	 * dense array, and then the large samples of the sparse map.
+	 */
+	class const_iterator
+	{
+	  public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef Histogram::value_type value_type;
+		typedef ptrdiff_t difference_type;
+		typedef const value_type* pointer;
+		typedef const value_type& reference;
+
+		const_iterator(const Histogram& h, size_type i,
+				Map::const_iterator it)
+			: m_h(&h), m_i(i), m_it(it)
+		{
+			skipZero();
+			update();
+		}
+
+		reference operator*() const { return m_value; }
+		pointer operator->() const { return &m_value; }
+
+		const_iterator& operator++()
+		{
+			if (inMap())
+				++m_it;
+			else {
+				++m_i;
+				skipZero();
+			}
+			update();
+			return *this;
+		}
+
+		const_iterator operator++(int)
+		{
+			const_iterator it = *this;
+			++*this;
+			return it;
+		}
+
+		bool operator==(const const_iterator& it) const
+		{
+			return m_i == it.m_i && m_it == it.m_it;
+		}
+
+		bool operator!=(const const_iterator& it) const
+		{
+			return !(*this == it);
+		}
+
+	  private:
+		/** Return whether this iterator points into the map. */
+		bool inMap() const
+		{
+			return m_it != m_h->m_map.end()
+				&& (m_it->first < 0 || m_i == m_h->m_dense.size());
+		}
+
+		/** Skip the empty elements of the dense array. */
+		void skipZero()
+		{
+			const Dense& dense = m_h->m_dense;
+			while (m_i < dense.size() && dense[m_i] == 0)
+				++m_i;
+		}
+
+		void update()
+		{
+			if (inMap())
+				m_value = *m_it;
+			else if (m_i < m_h->m_dense.size())
+				m_value = value_type(m_i, m_h->m_dense[m_i]);
+		}
+
+		const Histogram* m_h;
+		size_type m_i;
+		Map::const_iterator m_it;
+		value_type m_value;
+	};
 
 	Histogram() { }
 
@@ -41,19 +141,52 @@ class Histogram
 	 * vector is the sample, and the value at that index is the number
 	 * of times that sample was observed.
 	 */
-	explicit Histogram(std::vector<size_type> v)
+	explicit Histogram(const std::vector<size_type>& v)
+		: m_dense(v.begin(),
+				v.size() < MAX_DENSE ? v.end() : v.begin() + MAX_DENSE)
 	{
-		for (T i = 0; i < (T)v.size(); i++)
+		for (T i = MAX_DENSE; i < (T)v.size(); i++)
 			if (v[i] > 0)
 				m_map.insert(std::make_pair(i, v[i]));
 	}
 
-	void insert(T value) { m_map[value]++; }
+	void insert(T value) { insert(value, 1); }
 
-	void insert(T value, size_type count) { m_map[value] += count; }
+	void insert(T value, size_type count)
+	{
+		if ((size_type)value < m_dense.size())
+			m_dense[value] += count;
+		else if (!m_dense.empty() && value >= 0 && value < MAX_DENSE) {
+			grow(value);
+			m_dense[value] += count;
+		} else if (count > 0) {
+			size_type n = m_map.size();
+			m_map[value] += count;
+			if (m_dense.empty() && m_map.size() > n)
+				densifyIfFull();
+		}
+	}
+
+	/** Add the samples of the specified histogram to this one. */
+	Histogram& operator+=(const Histogram& h)
+	{
+		if (!h.m_dense.empty()) {
+			densify();
+			if (m_dense.size() < h.m_dense.size())
+				m_dense.resize(h.m_dense.size());
+			for (size_type i = 0; i < h.m_dense.size(); ++i)
+				m_dense[i] += h.m_dense[i];
+		}
+		for (Map::const_iterator it = h.m_map.begin();
+				it != h.m_map.end(); ++it)
+			insert(it->first, it->second);
+		return *this;
+	}
 
 	size_type count(T value) const
 	{
+		if ((size_type)value < m_dense.size())
+			return m_dense[value];
 		Map::const_iterator iter = m_map.find(value);
 		return iter == m_map.end() ? 0 : iter->second;
 	}
@@ -67,24 +200,38 @@ class Histogram
 		for (Map::const_iterator it = m_map.lower_bound(lo);
 				it != last; ++it)
 			n += it->second;
+		if (hi >= 0 && !m_dense.empty()) {
+			size_type first = lo < 0 ? 0 : lo;
+			size_type end = std::min((size_type)hi + 1,
+					m_dense.size());
+			for (size_type i = first; i < end; ++i)
+				n += m_dense[i];
+		}
 		return n;
 	}
 
 	T minimum() const
 	{
-		return empty() ? 0 : m_map.begin()->first;
+		return empty() ? 0 : begin()->first;
 	}
 
 	T maximum() const
 	{
-		return empty() ? 0 : m_map.rbegin()->first;
+		if (!m_map.empty() && m_map.rbegin()->first >= 0)
+			return m_map.rbegin()->first;
+		for (size_type i = m_dense.size(); i > 0; --i)
+			if (m_dense[i - 1] > 0)
+				return i - 1;
+		return m_map.empty() ? 0 : m_map.rbegin()->first;
 	}
 
-	bool empty() const { return m_map.empty(); }
+	bool empty() const { return begin() == end(); }
 
 	size_type size() const
 	{
 		size_type n = 0;
+		for (size_type i = 0; i < m_dense.size(); ++i)
+			n += m_dense[i];
 		for (Map::const_iterator it = m_map.begin();
 				it != m_map.end(); ++it)
 			n += it->second;
@@ -95,6 +242,8 @@ class Histogram
 	accumulator sum() const
 	{
 		accumulator total = 0;
+		for (size_type i = 0; i < m_dense.size(); ++i)
+			total += (accumulator)i * m_dense[i];
 		for (Map::const_iterator it = m_map.begin();
 				it != m_map.end(); ++it)
 			total += (accumulator)it->first * it->second;
@@ -104,18 +253,17 @@ class Histogram
 	/** Return the mean. */
 	double mean() const
 	{
-		accumulator n = 0, total = 0;
-		for (Map::const_iterator it = m_map.begin();
-				it != m_map.end(); ++it) {
-			n += it->second;
-			total += (accumulator)it->first * it->second;
-		}
-		return (double)total / n;
+		return (double)sum() / size();
 	}
 
 	double variance() const
 	{
 		accumulator n = 0, total = 0, squares = 0;
+		for (size_type i = 0; i < m_dense.size(); ++i) {
+			n += m_dense[i];
+			total += (accumulator)i * m_dense[i];
+			squares += (accumulator)i * i * m_dense[i];
+		}
 		for (Map::const_iterator it = m_map.begin();
 				it != m_map.end(); ++it) {
 			n += it->second;
@@ -136,8 +284,7 @@ class Histogram
 	{
 		size_type x = (size_type)ceil(p * size());
 		size_type n = 0;
-		for (Map::const_iterator it = m_map.begin();
-				it != m_map.end(); ++it) {
+		for (const_iterator it = begin(); it != end(); ++it) {
 			n += it->second;
 			if (n >= x)
 				return it->first;
@@ -156,8 +303,7 @@ class Histogram
 	T argMin(accumulator x) const
 	{
 		accumulator total = 0;
-		for (Map::const_iterator it = m_map.begin();
-				it != m_map.end(); ++it) {
+		for (const_iterator it = begin(); it != end(); ++it) {
 			total += (accumulator)it->first * it->second;
 			if (total >= x)
 				return it->first;
@@ -176,8 +322,7 @@ class Histogram
 	{
 		double value = 0;
 		accumulator acc = sum();
-		for (Map::const_iterator it = m_map.begin();
-				it != m_map.end(); it++) {
+		for (const_iterator it = begin(); it != end(); ++it) {
 			value += (double)it->first * it->first
 				* it->second / acc;
 		}
@@ -193,28 +338,23 @@ class Histogram
 	{
 		const unsigned SMOOTHING = 4;
 		assert(!empty());
-		Map::const_iterator minimum = m_map.begin();
+		value_type minimum = *begin();
 		size_type count = 0;
-		for (Map::const_iterator it = m_map.begin();
-				it != m_map.end(); ++it) {
-			if (it->second <= minimum->second) {
-				minimum = it;
+		for (const_iterator it = begin(); it != end(); ++it) {
+			if (it->second <= minimum.second) {
+				minimum = *it;
 				count = 0;
 			} else if (++count >= SMOOTHING)
 				break;
 		}
-		if (minimum->first == maximum())
+		if (minimum.first == maximum())
 			return 0;
-		return minimum->first;
+		return minimum.first;
 	}
 
 	void eraseNegative()
 	{
-		for (Map::iterator it = m_map.begin(); it != m_map.end();)
-			if (it->first < 0)
-				m_map.erase(it++);
-			else
-				++it;
+		m_map.erase(m_map.begin(), m_map.lower_bound(0));
 	}
 
 	/** Remove noise from the histogram. Noise is defined as a
@@ -222,13 +362,17 @@ class Histogram
 	 */
 	void removeNoise()
 	{
-		for (Map::iterator it = m_map.begin(); it != m_map.end();) {
-			if (m_map.count(it->first - 1) == 0
-					&& m_map.count(it->first + 1) == 0
-					&& m_map.size() > 1)
-				m_map.erase(it++);
-			else
-				++it;
+		std::vector<T> samples;
+		for (const_iterator it = begin(); it != end(); ++it)
+			samples.push_back(it->first);
+		size_type n = samples.size();
+		for (std::vector<T>::const_iterator it = samples.begin();
+				it != samples.end(); ++it) {
+			if (count(*it - 1) == 0 && count(*it + 1) == 0
+					&& n > 1) {
+				erase(*it);
+				n--;
+			}
 		}
 	}
 
@@ -242,21 +386,19 @@ class Histogram
 		T q3 = percentile(0.75);
 		T l = q1 - 20 * (q3 - q1);
 		T u = q3 + 20 * (q3 - q1);
-		for (Map::iterator it = m_map.begin(); it != m_map.end();) {
-			if (it->first < l || it->first > u)
-				m_map.erase(it++);
-			else
-				++it;
-		}
+		m_map.erase(m_map.begin(), m_map.lower_bound(l));
+		m_map.erase(m_map.upper_bound(u), m_map.end());
+		for (size_type i = 0; i < m_dense.size(); ++i)
+			if ((T)i < l || (T)i > u)
+				m_dense[i] = 0;
 	}
 
 	/** Negate each element of this histogram. */
 	Histogram negate() const
 	{
 		Histogram h;
-		for (Map::const_iterator it = m_map.begin();
-				it != m_map.end(); ++it)
-			h.m_map.insert(std::make_pair(-it->first, it->second));
+		for (const_iterator it = begin(); it != end(); ++it)
+			h.insert(-it->first, it->second);
 		return h;
 	}
 
@@ -268,8 +410,15 @@ class Histogram
 	std::string barplot() const;
 	std::string barplot(unsigned nbins) const;
 
-	const_iterator begin() const { return m_map.begin(); }
-	const_iterator end() const { return m_map.end(); }
+	const_iterator begin() const
+	{
+		return const_iterator(*this, 0, m_map.begin());
+	}
+
+	const_iterator end() const
+	{
+		return const_iterator(*this, m_dense.size(), m_map.end());
+	}
 
 	/** Return a vector representing this histogram. */
 	std::vector<size_type> toVector() const
@@ -282,6 +431,7 @@ class Histogram
 		std::vector<size_type> v(65536);
 		assert(maximum() < (T)v.size());
 #endif
+		std::copy(m_dense.begin(), m_dense.end(), v.begin());
 		for (Map::const_iterator it = m_map.begin();
 				it != m_map.end(); ++it)
 			v[it->first] = it->second;
@@ -291,8 +441,7 @@ class Histogram
 	friend std::ostream& operator<<(std::ostream& o,
 			const Histogram& h)
 	{
-		for (Map::const_iterator it = h.m_map.begin();
-				it != h.m_map.end(); ++it)
+		for (const_iterator it = h.begin(); it != h.end(); ++it)
 			o << it->first << '\t' << it->second << '\n';
 		return o;
 	}
@@ -308,6 +457,68 @@ class Histogram
 	}
 
   private:
+	/** Move the samples in the range [0, MAX_DENSE) from the map to
+	 * the dense array, if they would fill at least a quarter of it.
+	 * The fill is checked each time the number of distinct samples
+	 * doubles, so that the cost of checking is amortized.
+	 */
+	void densifyIfFull()
+	{
+		size_type n = m_map.size();
+		if (n < MIN_DENSE || (n & (n - 1)) != 0)
+			return;
+		Map::const_iterator first = m_map.lower_bound(0);
+		Map::const_iterator last = m_map.lower_bound(MAX_DENSE);
+		if (first == last)
+			return;
+		size_type distinct = std::distance(first, last);
+		Map::const_iterator back = last;
+		--back;
+		if (4 * distinct >= (size_type)back->first + 1)
+			densify();
+	}
+
+	/** Move the samples in the range [0, MAX_DENSE) from the map to
+	 * the dense array. */
+	void densify()
+	{
+		Map::iterator first = m_map.lower_bound(0);
+		Map::iterator last = m_map.lower_bound(MAX_DENSE);
+		if (first == last)
+			return;
+		Map::iterator back = last;
+		--back;
+		if (m_dense.size() <= (size_type)back->first)
+			grow(back->first);
+		for (Map::iterator it = first; it != last; ++it)
+			m_dense[it->first] += it->second;
+		m_map.erase(first, last);
+	}
+
+	/** Grow the dense array to hold the specified sample. */
+	void grow(T value)
+	{
+		assert(value >= 0 && value < MAX_DENSE);
+		m_dense.resize(std::min((size_type)MAX_DENSE,
+				std::max((size_type)value + 1, 2 * m_dense.size())));
+	}
+
+	/** Remove the specified sample. */
+	void erase(T value)
+	{
+		if ((size_type)value < m_dense.size())
+			m_dense[value] = 0;
+		else
+			m_map.erase(value);
+	}
+
+	/** The counts of the samples in the range [0, MAX_DENSE), once
+	 * this histogram is dense */
+	Dense m_dense;
+
+	/** The counts of the other samples. No sample of the map is in
+	 * the range [0, m_dense.size()), and none is in the range
+	 * [0, MAX_DENSE) unless the dense array is empty. */
 	Map m_map;
 };
 
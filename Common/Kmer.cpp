@@ -3,6 +3,7 @@
 #include "Common/Options.h"
 #include "HashFunction.h"
 #include <algorithm>
+#include <cassert>
 #include <cstring>
 
 using namespace std;
@@ -62,6 +63,36 @@ unsigned Kmer::getCode() const
 	return sum;
 }
 
+/** Return a hash of the canonical minimizer of length m of this
+ * k-mer, which is the m-mer whose canonical form has the smallest
+ * hash value. Adjacent k-mers usually share their minimizer, and a
+ * k-mer and its reverse complement always do.
+ */
+unsigned Kmer::getMinimizerCode(unsigned m) const
+{
+	assert(m > 0 && m <= 32 && m <= s_length);
+	const uint64_t mask = m == 32 ? ~uint64_t(0)
+		: (uint64_t(1) << 2 * m) - 1;
+	const unsigned shift = 2 * (m - 1);
+	uint64_t fwd = 0, rc = 0;
+	uint64_t minHash = ~uint64_t(0);
+	for (unsigned i = 0; i < s_length; i++) {
+		uint8_t base = at(i);
+		fwd = (fwd << 2 | base) & mask;
+		rc = rc >> 2
+			| uint64_t(opt::colourSpace ? base : 3 - base) << shift;
+		if (i + 1 < m)
+			continue;
+		// Mix the bits of the canonical m-mer (splitmix64).
+		uint64_t h = min(fwd, rc);
+		h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+		h ^= h >> 31;
+		minHash = min(minHash, h);
+	}
+	return minHash >> 32;
+}
+
 size_t Kmer::getHashCode() const
 {
 	// Hash numbytes - 1 to avoid getting different hash values for
@@ -36,6 +36,7 @@ class Kmer
 	Sequence str() const;
 
 	unsigned getCode() const;
+	unsigned getMinimizerCode(unsigned m) const;
 	size_t getHashCode() const;
 
 	static unsigned length() { return s_length; }
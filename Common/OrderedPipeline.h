@@ -0,0 +1,131 @@
+#ifndef ORDEREDPIPELINE_H
+#define ORDEREDPIPELINE_H 1
+
+#include <cassert>
+#include <cstddef>
+#include <map>
+#include <pthread.h>
+#include <utility>
+#include <vector>
+#if _OPENMP
+# include <omp.h>
+#endif
+
+/** Process a stream of items in parallel and write the results in
+ * the order in which the items were read, so that the output does not
+ * depend on the number of threads.
+ *
+ * Items are read serially in batches of batchSize. Each batch is
+ * numbered and processed by one thread. A completed batch is stored
+ * in a reorder buffer until every batch before it has been written.
+ * Whichever thread completes the next batch in sequence becomes the
+ * writer and writes all the batches that are ready, so that no thread
+ * waits on another to write.
+ *
+ * At most maxPending batches are read and not yet written. A thread
+ * that would exceed that limit sleeps on a condition variable until
+ * the writer takes the next batch, so that one slow batch does not
+ * let the other threads read the rest of the input into the reorder
+ * buffer.
+ *
+ * @param read a functor bool read(Reader::value_type&), which is
+ * called serially and returns false at the end of the input
+ * @param process a functor void process(Reader::value_type&,
+ * Processor::result_type&), which is called in parallel
+ * @param write a functor void write(Processor::result_type&), which
+ * is called serially in input order
+ * @param maxPending the maximum number of batches in flight, by
+ * default four per thread
+ */
+template <typename Reader, typename Processor, typename Writer>
+void orderedPipeline(Reader& read, const Processor& process,
+		Writer& write, unsigned batchSize = 64, unsigned maxPending = 0)
+{
+	typedef typename Reader::value_type Item;
+	typedef typename Processor::result_type Result;
+	typedef std::map<size_t, std::vector<Result>*> ReorderBuffer;
+
+	assert(batchSize > 0);
+	if (maxPending == 0) {
+#if _OPENMP
+		maxPending = 4 * omp_get_max_threads();
+#else
+		maxPending = 4;
+#endif
+	}
+	size_t nextRead = 0, nextWrite = 0;
+	bool eof = false, writing = false;
+	ReorderBuffer ready;
+
+	// Guards nextWrite, writing and ready.
+	pthread_mutex_t mutex;
+	pthread_mutex_init(&mutex, NULL);
+	// Signalled when nextWrite is incremented.
+	pthread_cond_t taken;
+	pthread_cond_init(&taken, NULL);
+
+#pragma omp parallel
+	for (std::vector<Item> items;;) {
+		// Read a batch.
+		bool good = false;
+		size_t seq = 0;
+#pragma omp critical(orderedPipelineRead)
+		if (!eof) {
+			// Wait for the writer to catch up. Only the thread that
+			// holds the read lock waits here.
+			pthread_mutex_lock(&mutex);
+			while (nextRead - nextWrite >= maxPending)
+				pthread_cond_wait(&taken, &mutex);
+			pthread_mutex_unlock(&mutex);
+
+			items.assign(batchSize, Item());
+			size_t n = 0;
+			while (n < batchSize && read(items[n]))
+				n++;
+			items.resize(n);
+			eof = n < batchSize;
+			seq = nextRead++;
+			good = true;
+		}
+		if (!good)
+			break;
+
+		// Process the batch.
+		std::vector<Result>* results
+			= new std::vector<Result>(items.size());
+		for (size_t i = 0; i < items.size(); ++i)
+			process(items[i], (*results)[i]);
+
+		// Write the ready batches in order.
+		pthread_mutex_lock(&mutex);
+		ready.insert(std::make_pair(seq, results));
+		bool writer = !writing && ready.begin()->first == nextWrite;
+		if (writer)
+			writing = true;
+		pthread_mutex_unlock(&mutex);
+		while (writer) {
+			std::vector<Result>* batch = NULL;
+			pthread_mutex_lock(&mutex);
+			typename ReorderBuffer::iterator it = ready.begin();
+			if (it != ready.end() && it->first == nextWrite) {
+				batch = it->second;
+				ready.erase(it);
+				nextWrite++;
+				pthread_cond_signal(&taken);
+			} else
+				writer = writing = false;
+			pthread_mutex_unlock(&mutex);
+			if (batch == NULL)
+				break;
+			for (size_t i = 0; i < batch->size(); ++i)
+				write((*batch)[i]);
+			delete batch;
+		}
+	}
+	pthread_cond_destroy(&taken);
+	pthread_mutex_destroy(&mutex);
+	assert(ready.empty());
+	assert(nextWrite == nextRead);
+}
+
+#endif
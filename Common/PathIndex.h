@@ -0,0 +1,142 @@
+#ifndef PATHINDEX_H
+#define PATHINDEX_H 1
+
+#include "ContigNode.h"
+#include "ContigPath.h"
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+/** Return the node at offset i of the specified path, or of its
+ * reverse complement if rc is true, without copying the path.
+ */
+static inline ContigNode orientedNode(const ContigPath& path,
+		bool rc, size_t i)
+{
+	assert(i < path.size());
+	if (!rc)
+		return path[i];
+	ContigNode u = path[path.size() - 1 - i];
+	return u.ambiguous() ? u : u ^ 1;
+}
+
+/** Return the first node of the specified oriented path. */
+static inline ContigNode orientedFront(const ContigPath& path, bool rc)
+{
+	return orientedNode(path, rc, 0);
+}
+
+/** Return the last node of the specified oriented path. */
+static inline ContigNode orientedBack(const ContigPath& path, bool rc)
+{
+	return orientedNode(path, rc, path.size() - 1);
+}
+
+/** Return whether the suffix of the oriented path a, which starts at
+ * offset i, is a prefix of the oriented path b.
+ */
+static inline bool suffixIsPrefix(
+		const ContigPath& a, bool rca, size_t i,
+		const ContigPath& b, bool rcb)
+{
+	assert(i < a.size());
+	size_t n = a.size() - i;
+	if (n > b.size())
+		return false;
+	for (size_t j = 0; j < n; ++j)
+		if (orientedNode(a, rca, i + j) != orientedNode(b, rcb, j))
+			return false;
+	return true;
+}
+
+/** An index of the contigs of a collection of paths. Each contig
+ * maps to its postings, the paths in which it occurs, its offset in
+ * each path and its orientation there.
+ */
+class PathIndex
+{
+  public:
+	/** An occurrence of a contig in a path. */
+	struct Posting
+	{
+		/** The ID of the path */
+		unsigned path;
+		/** The offset of the contig in the path */
+		unsigned offset;
+		/** The orientation of the contig in the path */
+		bool sense;
+
+		Posting(unsigned path, unsigned offset, bool sense)
+			: path(path), offset(offset), sense(sense) { }
+
+		bool operator<(const Posting& o) const
+		{
+			return path != o.path ? path < o.path
+				: offset < o.offset;
+		}
+
+		/** Return the orientation of the path in which the contig
+		 * has the orientation u, and the offset of the contig in that
+		 * oriented path.
+		 */
+		std::pair<bool, unsigned> orient(ContigNode u,
+				unsigned pathSize) const
+		{
+			bool rc = sense != u.sense();
+			return std::make_pair(rc,
+					rc ? pathSize - 1 - offset : offset);
+		}
+	};
+
+	typedef std::vector<Posting> Postings;
+
+	/** Add the unambiguous contigs of the specified path. The paths
+	 * must be added in increasing order of their ID.
+	 */
+	void insert(unsigned id, const ContigPath& path)
+	{
+		for (ContigPath::const_iterator it = path.begin();
+				it != path.end(); ++it) {
+			if (it->ambiguous())
+				continue;
+			unsigned contig = it->id();
+			if (contig >= m_postings.size())
+				m_postings.resize(contig + 1);
+			Postings& postings = m_postings[contig];
+			assert(postings.empty() || postings.back().path <= id);
+			postings.push_back(Posting(id, it - path.begin(),
+						it->sense()));
+		}
+	}
+
+	/** Return the occurrences of the contig of u, sorted by path. */
+	const Postings& postings(ContigNode u) const
+	{
+		static const Postings s_empty;
+		assert(!u.ambiguous());
+		return u.id() < m_postings.size() ? m_postings[u.id()]
+			: s_empty;
+	}
+
+	/** Return whether the path id, reverse complemented if rc is
+	 * true, contains u.
+	 */
+	bool contains(unsigned id, bool rc, ContigNode u) const
+	{
+		const Postings& v = postings(u);
+		for (Postings::const_iterator it = std::lower_bound(v.begin(),
+					v.end(), Posting(id, 0, false));
+				it != v.end() && it->path == id; ++it)
+			if ((it->sense != rc) == u.sense())
+				return true;
+		return false;
+	}
+
+  private:
+	/** The postings indexed by contig ID */
+	std::vector<Postings> m_postings;
+};
+
+#endif
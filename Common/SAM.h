@@ -4,11 +4,13 @@
 #include "config.h" // for SAM_SEQ_QUAL
 #include "IOUtil.h"
 #include "Alignment.h"
+#include "ConstString.h"
 #include "ContigID.h" // for g_contigNames
 #include <algorithm> // for swap
+#include <cctype>
 #include <cstdlib> // for exit
+#include <cstring>
 #include <iostream>
-#include <limits> // for numeric_limits
 #include <sstream>
 #include <string>
 
@@ -100,17 +102,32 @@ struct SAMAlignment {
 		/** The length of the alignment on the target. */
 		unsigned tspan;
 
+		CigarCoord() : qlen(0), qstart(0), qspan(0), tspan(0) { }
+
 		/** Parse the specified CIGAR string. */
 		CigarCoord(const std::string& cigar)
 			: qlen(0), qstart(0), qspan(0), tspan(0)
 		{
-			if (cigar == "*")
+			parse(cigar.c_str());
+		}
+
+		/** Parse the specified CIGAR string. */
+		CigarCoord(const char* cigar)
+			: qlen(0), qstart(0), qspan(0), tspan(0)
+		{
+			parse(cigar);
+		}
+
+	  private:
+		void parse(const char* cigar)
+		{
+			if (strcmp(cigar, "*") == 0)
 				return;
-			std::istringstream in(cigar);
 			bool first = true;
 			unsigned len;
 			char type;
-			while (in >> len >> type) {
+			for (const char* p = cigar;
+					nextCigarOp(p, cigar, len, type);) {
 				switch (type) {
 				  case 'H': case 'S':
 					if (first)
@@ -130,13 +147,10 @@ struct SAMAlignment {
 					tspan += len;
 					break;
 				  default:
-					std::cerr << "error: invalid CIGAR: `"
-						<< cigar << "'\n";
-					exit(EXIT_FAILURE);
+					invalidCigar(cigar);
 				}
 				first = false;
 			}
-			assert(in.eof());
 		}
 	};
 
@@ -158,16 +172,21 @@ struct SAMAlignment {
 	 * align_length, and read_length. The other fields will be
 	 * uninitialized.
 	 */
-	static Alignment parseCigar(const std::string& cigar, bool isRC) {
+	static Alignment parseCigar(const std::string& cigar, bool isRC)
+	{
+		return parseCigar(cigar.c_str(), isRC);
+	}
+
+	/** Parse the specified CIGAR string. */
+	static Alignment parseCigar(const char* cigar, bool isRC) {
 		Alignment a;
-		std::istringstream in(cigar);
 		unsigned len;
 		char type;
 		unsigned clip0 = 0;
 		a.align_length = 0;
 		unsigned qlen = 0;
 		unsigned clip1 = 0;
-		while (in >> len >> type) {
+		for (const char* p = cigar; nextCigarOp(p, cigar, len, type);) {
 			switch (type) {
 			  case 'I': case 'X': case '=':
 				qlen += len;
@@ -195,21 +214,41 @@ struct SAMAlignment {
 				clip1 += len;
 				break;
 			  default:
-				std::cerr << "error: invalid CIGAR: `"
-					<< cigar << "'\n";
-				exit(EXIT_FAILURE);
+				invalidCigar(cigar);
 			}
 		}
 		a.read_start_pos = isRC ? clip1 : clip0;
 		a.read_length = qlen;
-		if (!in.eof()){
-			std::cerr << "error: invalid CIGAR: `"
-				<< cigar << "'\n";
-			exit(EXIT_FAILURE);
-		}
 		return a;
 	}
 
+	/** Parse the next operation of a CIGAR string.
+	 * @param[in,out] p the position in the CIGAR string
+	 * @return false at the end of the CIGAR string
+	 */
+	static bool nextCigarOp(const char*& p, const char* cigar,
+			unsigned& len, char& type)
+	{
+		if (*p == '\0')
+			return false;
+		if (!isdigit(*p))
+			invalidCigar(cigar);
+		for (len = 0; isdigit(*p); ++p)
+			len = 10 * len + (*p - '0');
+		type = *p;
+		if (type == '\0')
+			invalidCigar(cigar);
+		++p;
+		return true;
+	}
+
+	/** Report an invalid CIGAR string and exit. */
+	static void invalidCigar(const char* cigar)
+	{
+		std::cerr << "error: invalid CIGAR: `" << cigar << "'\n";
+		exit(EXIT_FAILURE);
+	}
+
 	operator Alignment() const {
 		assert(~flag & FUNMAP);
 		bool isRC = flag & FREVERSE; // strand of the query
@@ -221,6 +260,167 @@ struct SAMAlignment {
 	}
 };
 
+/** A SAM alignment whose fields point into a line buffer. The line
+ * is tokenized in place. The numeric fields and the CIGAR string are
+ * decoded when they are used, so that an alignment may be filtered
+ * without copying its fields.
+ */
+class SAMRecordView {
+  public:
+	SAMRecordView() : m_pairFlags(0), m_checkSpan(true), m_flag(-1),
+		m_hasCigarCoord(false) { }
+
+	/** Tokenize the specified SAM alignment line in place. The line
+	 * must outlive this view.
+	 * @return false if the line has fewer than nine fields
+	 */
+	bool parse(std::string& line)
+	{
+		if (line.empty())
+			return false;
+		char* p = &line[0];
+		char* end = p + line.size();
+		m_fields[QNAME] = p;
+		unsigned n = 1;
+		for (; n < NFIELDS; ++n) {
+			char* tab = (char*)memchr(p, '\t', end - p);
+			if (tab == NULL)
+				break;
+			*tab = '\0';
+			p = tab + 1;
+			m_fields[n] = p;
+		}
+		if (n <= ISIZE)
+			return false;
+		for (; n < NFIELDS; ++n)
+			m_fields[n] = n == TAGS ? "" : "*";
+
+		// Set the paired flags if qname ends in /1 or /2.
+		m_pairFlags = 0;
+		m_checkSpan = true;
+		m_flag = -1;
+		m_hasCigarCoord = false;
+		char* qname = &line[0];
+		size_t l = strlen(qname);
+		if (l >= 2 && qname[l-2] == '/') {
+			switch (qname[l-1]) {
+				case '1':
+					m_pairFlags = SAMAlignment::FPAIRED
+						| SAMAlignment::FREAD1;
+					break;
+				case '2':
+				case '3':
+					m_pairFlags = SAMAlignment::FPAIRED
+						| SAMAlignment::FREAD2;
+					break;
+				default:
+					m_checkSpan = false;
+					return true;
+			}
+			qname[l-2] = '\0';
+			assert(l > 2);
+		}
+		return true;
+	}
+
+	cstring qname() const { return m_fields[QNAME]; }
+	cstring rname() const { return m_fields[RNAME]; }
+	cstring cigar() const { return m_fields[CIGAR]; }
+	cstring seq() const { return m_fields[SEQ]; }
+	cstring qual() const { return m_fields[QUAL]; }
+	cstring tags() const { return m_fields[TAGS]; }
+
+	/** Return the name of the target of the mate. */
+	cstring mrnm() const
+	{
+		const char* s = m_fields[MRNM];
+		return strcmp(s, "=") == 0 ? rname() : cstring(s);
+	}
+
+	/** Return the zero-based position of the alignment. */
+	int pos() const { return strtol(m_fields[POS], NULL, 10) - 1; }
+
+	/** Return the zero-based position of the mate. */
+	int mpos() const { return strtol(m_fields[MPOS], NULL, 10) - 1; }
+
+	int isize() const { return strtol(m_fields[ISIZE], NULL, 10); }
+
+	unsigned short mapq() const
+	{
+		return strtoul(m_fields[MAPQ], NULL, 10);
+	}
+
+	/** Return the flag, including the paired flags of the query
+	 * name and the unmapped flag of an alignment shorter than
+	 * opt::minAlign.
+	 */
+	unsigned short flag() const
+	{
+		if (m_flag >= 0)
+			return m_flag;
+		unsigned short flag = strtoul(m_fields[FLAG], NULL, 10)
+			| m_pairFlags;
+		if (m_checkSpan && (~flag & SAMAlignment::FUNMAP)) {
+			const SAMAlignment::CigarCoord& a = cigarCoord();
+			if (a.qspan < opt::minAlign || a.tspan < opt::minAlign)
+				flag |= SAMAlignment::FUNMAP;
+		}
+		m_flag = flag;
+		return flag;
+	}
+
+	/** Return the coordinates of the CIGAR string. */
+	const SAMAlignment::CigarCoord& cigarCoord() const
+	{
+		if (!m_hasCigarCoord) {
+			m_cigarCoord = SAMAlignment::CigarCoord(m_fields[CIGAR]);
+			m_hasCigarCoord = true;
+		}
+		return m_cigarCoord;
+	}
+
+	bool isPaired() const { return flag() & SAMAlignment::FPAIRED; }
+	bool isUnmapped() const { return flag() & SAMAlignment::FUNMAP; }
+	bool isMateUnmapped() const
+	{
+		return flag() & SAMAlignment::FMUNMAP;
+	}
+	bool isReverse() const { return flag() & SAMAlignment::FREVERSE; }
+	bool isRead1() const { return flag() & SAMAlignment::FREAD1; }
+	bool isRead2() const { return flag() & SAMAlignment::FREAD2; }
+
+	operator Alignment() const {
+		assert(!isUnmapped());
+		bool isRC = isReverse(); // strand of the query
+		Alignment a = SAMAlignment::parseCigar(cigar(), isRC);
+		a.contig = rname();
+		a.contig_start_pos = pos();
+		a.isRC = isRC;
+		return a;
+	}
+
+  private:
+	/** The fields of a SAM alignment */
+	enum { QNAME, FLAG, RNAME, POS, MAPQ, CIGAR, MRNM, MPOS, ISIZE,
+		SEQ, QUAL, TAGS, NFIELDS };
+
+	/** The fields of the tokenized line */
+	const char* m_fields[NFIELDS];
+
+	/** The flags set by the suffix of the query name */
+	unsigned short m_pairFlags;
+
+	/** Whether to set the unmapped flag of a short alignment */
+	bool m_checkSpan;
+
+	/** The decoded flag or -1 */
+	mutable int m_flag;
+
+	/** The decoded CIGAR string */
+	mutable bool m_hasCigarCoord;
+	mutable SAMAlignment::CigarCoord m_cigarCoord;
+};
+
 /** A SAM alignment of a query and its mate. */
 struct SAMRecord : SAMAlignment {
 	std::string qname;
@@ -332,45 +532,51 @@ struct SAMRecord : SAMAlignment {
 		return out;
 	}
 
-	friend std::istream& operator >>(std::istream& in, SAMRecord& o)
+	/** Copy the fields of the specified view. */
+	void assign(const SAMRecordView& o)
 	{
-		in >> o.qname
-			>> o.flag >> o.rname >> o.pos >> o.mapq
-			>> o.cigar >> o.mrnm >> o.mpos >> o.isize;
+		qname = o.qname().c_str();
+		flag = o.flag();
+		rname = o.rname().c_str();
+		pos = o.pos();
+		mapq = o.mapq();
+		cigar = o.cigar().c_str();
+		mrnm = o.mrnm().c_str();
+		mpos = o.mpos();
+		isize = o.isize();
 #if SAM_SEQ_QUAL
-		in >> o.seq >> o.qual;
-		getline(in >> Skip('\t'), o.tags);
-#else
-		in.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+		seq = o.seq().c_str();
+		qual = o.qual().c_str();
+		tags = o.tags().c_str();
 #endif
-		if (!in)
-			return in;
-		o.pos--;
-		o.mpos--;
-		if (o.mrnm == "=")
-			o.mrnm = o.rname;
-
-		// Set the paired flags if qname ends in /1 or /2.
-		unsigned l = o.qname.length();
-		if (l >= 2 && o.qname[l-2] == '/') {
-			switch (o.qname[l-1]) {
-				case '1': o.flag |= FPAIRED | FREAD1; break;
-				case '2':
-				case '3': o.flag |= FPAIRED | FREAD2; break;
-				default: return in;
-			}
-			o.qname.resize(l - 2);
-			assert(!o.qname.empty());
-		}
-
-		// Set the unmapped flag if the alignment is not long enough.
-		CigarCoord a(o.cigar);
-		if (a.qspan < opt::minAlign || a.tspan < opt::minAlign)
-			o.flag |= FUNMAP;
-		return in;
 	}
 };
 
+/** Read a SAM alignment line into the specified buffer and tokenize
+ * it in place.
+ * @return false at the end of the input or if the line is malformed
+ */
+static inline bool readSAMRecord(std::istream& in,
+		std::string& line, SAMRecordView& o)
+{
+	if (!getline(in >> std::ws, line))
+		return false;
+	if (!o.parse(line)) {
+		in.setstate(std::ios::failbit);
+		return false;
+	}
+	return true;
+}
+
+inline std::istream& operator >>(std::istream& in, SAMRecord& o)
+{
+	std::string line;
+	SAMRecordView view;
+	if (readSAMRecord(in, line, view))
+		o.assign(view);
+	return in;
+}
+
 /** Set the mate mapping fields of a0 and a1. */
 static inline void fixMate(SAMRecord& a0, SAMRecord& a1)
 {
@@ -1,18 +1,239 @@
 #include "Timer.h"
 #include "Log.h"
+#include "Common/Options.h"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <fstream>
 #include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <vector>
 
 using namespace std;
 
+/** The file to which to append the trace, or NULL. */
+static const char* tracePath()
+{
+	static const char* path = getenv("ABYSS_TRACE");
+	return path != NULL && *path != '\0' ? path : NULL;
+}
+
+/** The names of the enclosing phases of this thread. */
+static thread_local vector<string> t_phases;
+
 // Constructor starts the timer
 Timer::Timer(string funcString)
-	: m_funcStr(funcString), m_start(clock())
+	: m_funcStr(funcString),
+	m_start(chrono::steady_clock::now()),
+	m_startTime(chrono::system_clock::now()),
+	m_depth(t_phases.size())
 {
+	for (vector<string>::const_iterator it = t_phases.begin();
+			it != t_phases.end(); ++it)
+		m_phase += *it + '/';
+	m_phase += m_funcStr;
+	t_phases.push_back(m_funcStr);
+	getUsage(m_usage, tracePath() != NULL);
 }
 
 // Destructor stops it and prints
 Timer::~Timer()
 {
+	double wall = chrono::duration<double>(
+			chrono::steady_clock::now() - m_start).count();
+	Usage end;
+	getUsage(end, tracePath() != NULL);
+	if (!t_phases.empty())
+		t_phases.pop_back();
+
 	logger(2) << m_funcStr << ": " << setprecision(3)
-		<< (double)(clock() - m_start) / CLOCKS_PER_SEC << " s\n";
+		<< wall << " s, CPU "
+		<< end.user + end.sys - m_usage.user - m_usage.sys << " s\n";
+	if (tracePath() != NULL)
+		trace(end, wall);
+}
+
+/** Read the CPU time in clock ticks of the specified thread. */
+static bool getThreadTicks(const string& stat, unsigned long long& ticks)
+{
+	ifstream in(stat.c_str());
+	string s;
+	if (!getline(in, s))
+		return false;
+	// The command name is in parentheses and may contain spaces.
+	size_t i = s.rfind(')');
+	if (i == string::npos)
+		return false;
+	istringstream ss(s.substr(i + 1));
+	// Skip the fields state through cmajflt, which precede utime.
+	string field;
+	for (unsigned j = 0; j < 11; ++j)
+		ss >> field;
+	unsigned long long utime, stime;
+	if (!(ss >> utime >> stime))
+		return false;
+	ticks = utime + stime;
+	return true;
+}
+
+/** Measure the resource usage of this process. The bytes read and
+ * written and the time of each thread are measured only when traced.
+ */
+void Timer::getUsage(Usage& usage, bool traced)
+{
+	struct rusage ru;
+	if (getrusage(RUSAGE_SELF, &ru) == 0) {
+		usage.user = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6;
+		usage.sys = ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+	}
+	if (!traced)
+		return;
+
+	ifstream io("/proc/self/io");
+	for (string key; io >> key;) {
+		unsigned long long value;
+		if (!(io >> value))
+			break;
+		if (key == "rchar:")
+			usage.rchar = value;
+		else if (key == "wchar:")
+			usage.wchar = value;
+	}
+
+	DIR* dir = opendir("/proc/self/task");
+	if (dir == NULL)
+		return;
+	while (struct dirent* entry = readdir(dir)) {
+		if (entry->d_name[0] == '.')
+			continue;
+		unsigned long long ticks;
+		if (getThreadTicks(string("/proc/self/task/")
+					+ entry->d_name + "/stat", ticks))
+			usage.threads[atoi(entry->d_name)] = ticks;
+	}
+	closedir(dir);
+}
+
+/** Return the name of this program. */
+static string programName()
+{
+	ifstream in("/proc/self/comm");
+	string s;
+	return in >> s ? s : string("-");
+}
+
+/** Return the peak resident set size of this process in bytes. */
+static long long peakRSS()
+{
+	struct rusage ru;
+	if (getrusage(RUSAGE_SELF, &ru) != 0)
+		return 0;
+#if __APPLE__
+	return ru.ru_maxrss;
+#else
+	return (long long)ru.ru_maxrss * 1024;
+#endif
+}
+
+/** Create the specified file containing data, unless the file
+ * exists. The file appears complete, so that no other process may
+ * append to it before data is written.
+ * @return 0 if the file was created, or an error number, which is
+ * EEXIST if the file exists
+ */
+static int createFile(const char* path, const string& data)
+{
+	static unsigned s_count;
+	ostringstream ss;
+	ss << path << '.' << getpid() << '.'
+		<< __sync_fetch_and_add(&s_count, 1) << ".tmp";
+	string tmp = ss.str();
+	int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0666);
+	if (fd < 0)
+		return errno;
+	int err = 0;
+	ssize_t n = write(fd, data.data(), data.size());
+	if (n < 0)
+		err = errno;
+	else if ((size_t)n != data.size())
+		err = EIO;
+	if (close(fd) != 0 && err == 0)
+		err = errno;
+	if (err == 0 && link(tmp.c_str(), path) != 0)
+		err = errno;
+	unlink(tmp.c_str());
+	return err;
+}
+
+/** Append a record of this phase to the trace file. */
+void Timer::trace(const Usage& end, double wall) const
+{
+	static const char* header = "program\tpid\trank\tphase\tdepth"
+		"\tstart\twall\tuser\tsys\tmaxrss\trchar\twchar"
+		"\tthreads\tbusy\tidle\n";
+	const double tick = sysconf(_SC_CLK_TCK);
+
+	ostringstream busy, idle;
+	busy << fixed << setprecision(2);
+	idle << fixed << setprecision(2);
+	unsigned nthreads = 0;
+	typedef map<pid_t, unsigned long long> ThreadTicks;
+	for (ThreadTicks::const_iterator it = end.threads.begin();
+			it != end.threads.end(); ++it) {
+		ThreadTicks::const_iterator start
+			= m_usage.threads.find(it->first);
+		double t = (it->second - (start == m_usage.threads.end()
+					? 0 : start->second)) / tick;
+		if (nthreads++ > 0) {
+			busy << ',';
+			idle << ',';
+		}
+		busy << t;
+		idle << max(wall - t, 0.0);
+	}
+
+	ostringstream ss;
+	ss << fixed << setprecision(3)
+		<< programName() << '\t' << getpid() << '\t' << opt::rank
+		<< '\t' << m_phase << '\t' << m_depth
+		<< '\t' << chrono::duration<double>(
+				m_startTime.time_since_epoch()).count()
+		<< '\t' << wall
+		<< '\t' << end.user - m_usage.user
+		<< '\t' << end.sys - m_usage.sys
+		<< '\t' << peakRSS()
+		<< '\t' << end.rchar - m_usage.rchar
+		<< '\t' << end.wchar - m_usage.wchar
+		<< '\t' << nthreads
+		<< '\t' << busy.str() << '\t' << idle.str() << '\n';
+	string line = ss.str();
+
+	// The process that creates the file writes the header with its
+	// first record. Each record is written atomically, so that the
+	// processes of a pipeline may share one trace file.
+	const char* path = tracePath();
+	int fd = open(path, O_WRONLY | O_APPEND);
+	if (fd < 0 && errno == ENOENT) {
+		int err = createFile(path, header + line);
+		if (err == 0)
+			return;
+		if (err == EEXIST)
+			fd = open(path, O_WRONLY | O_APPEND);
+		else
+			errno = err;
+	}
+	if (fd < 0) {
+		cerr << "warning: `" << path << "': " << strerror(errno)
+			<< '\n';
+		return;
+	}
+	if (write(fd, line.data(), line.size()) != (ssize_t)line.size())
+		cerr << "warning: `" << path << "': " << strerror(errno)
+			<< '\n';
+	close(fd);
 }
@@ -1,20 +1,54 @@
 #ifndef TIMER_H
 #define TIMER_H 1
 
+#include <chrono>
+#include <map>
 #include <string>
+#include <sys/types.h>
 
 /**
  * Time the duration between the construction and destruction of this
  * timer object and log that duration.
+ *
+ * The elapsed wall-clock time and the CPU time of the process are
+ * logged. When the environment variable ABYSS_TRACE names a file, a
+ * line is appended to that tab-separated file for each timed phase,
+ * recording its wall-clock and CPU time, the peak resident memory,
+ * the bytes read and written, and the busy and idle time of each
+ * thread. Nested timers are named by the path of their phases, such
+ * as Total/LoadSequences.
  */
 class Timer
 {
 	public:
 		Timer(std::string funcString);
 		~Timer();
+
 	private:
+		Timer(const Timer&);
+		Timer& operator=(const Timer&);
+
+		/** Resource usage of the process. */
+		struct Usage {
+			/** User and system CPU time in seconds */
+			double user, sys;
+			/** Bytes read and written */
+			unsigned long long rchar, wchar;
+			/** CPU time in clock ticks of each thread */
+			std::map<pid_t, unsigned long long> threads;
+			Usage() : user(0), sys(0), rchar(0), wchar(0) { }
+		};
+
+		static void getUsage(Usage& usage, bool traced);
+		void trace(const Usage& end, double wall) const;
+
 		std::string m_funcStr;
-		clock_t m_start;
+		/** The path of the nested phases of this timer */
+		std::string m_phase;
+		std::chrono::steady_clock::time_point m_start;
+		std::chrono::system_clock::time_point m_startTime;
+		Usage m_usage;
+		unsigned m_depth;
 };
 
 #endif
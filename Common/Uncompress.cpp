@@ -1,24 +1,52 @@
-/** Uncompress input files using pipes.
+/** Uncompress input files.
  * Hook the standard file opening functions, open, fopen and fopen64.
  * If the extension of the file being opened indicates the file is
- * compressed (.gz, .bz2, .xz), open a pipe to a program that
- * decompresses that file (gunzip, bunzip2 or xzdec) and return a
- * handle to the open pipe.
+ * compressed (.gz, .bz2, .xz), return a handle to a pipe from which
+ * the uncompressed file may be read. Files compressed with gzip, bzip2
+ * or xz are uncompressed by a thread of this process, when ABySS is
+ * linked with zlib, libbz2 or liblzma. The blocks of a BGZF file are
+ * uncompressed in parallel. An error in a compressed file is reported
+ * when the reader closes the pipe, by hooking close and fclose.
+ * Other files are uncompressed by a child process running a program
+ * such as gunzip, bunzip2 or xzdec.
  * @author Shaun Jackman <sjackman@bcgsc.ca>
  */
 
 #include "config.h"
-#if HAVE_LIBDL
-
+#include "Uncompress.h"
 #include "Fcontrol.h"
 #include "SignalHandler.h"
 #include "StringUtil.h"
+#include <algorithm>
 #include <cassert>
+#include <cerrno>
+#include <csignal>
 #include <cstdio> // for perror
 #include <cstdlib>
-#include <dlfcn.h>
+#include <cstring>
+#include <map>
+#include <stdint.h>
 #include <string>
 #include <unistd.h>
+#include <vector>
+#if HAVE_LIBDL
+# include <dlfcn.h>
+#endif
+#if HAVE_LIBPTHREAD
+# include <pthread.h>
+#endif
+#if HAVE_ZLIB_H && HAVE_LIBZ
+# define USE_ZLIB 1
+# include <zlib.h>
+#endif
+#if HAVE_BZLIB_H && HAVE_LIBBZ2
+# define USE_BZLIB 1
+# include <bzlib.h>
+#endif
+#if HAVE_LZMA_H && HAVE_LIBLZMA
+# define USE_LZMA 1
+# include <lzma.h>
+#endif
 
 using namespace std;
 
@@ -56,14 +84,760 @@ static const char* zcatExec(const string& path)
 		NULL;
 }
 
+/** The compression formats that are uncompressed in this process. */
+enum Format { NOT_COMPRESSED, GZIP, BZIP2, XZ };
+
+/** Return the compression format of the specified file if it may be
+ * uncompressed in this process, and NOT_COMPRESSED otherwise.
+ */
+static Format zcatFormat(const string& path)
+{
+	const char* zcat = zcatExec(path);
+	if (wgetExec(path) != NULL || zcat == NULL
+			|| startsWith(zcat, "tar"))
+		return NOT_COMPRESSED;
+	return
+#if USE_ZLIB
+		endsWith(path, ".gz") ? GZIP :
+#endif
+#if USE_BZLIB
+		endsWith(path, ".bz2") ? BZIP2 :
+#endif
+#if USE_LZMA
+		endsWith(path, ".xz") ? XZ :
+#endif
+		NOT_COMPRESSED;
+}
+
+/** A source of uncompressed data. */
+class Decompressor {
+  public:
+	/** The size of the input buffer and of an output block */
+	static const size_t BUFFER_SIZE = 1 << 20;
+
+	/** Read the file descriptor fd, which was opened from path, and
+	 * whose first n bytes have already been read into head.
+	 */
+	Decompressor(const char* path, int fd, const char* head, size_t n)
+		: m_path(path), m_fd(fd),
+		m_in(n > BUFFER_SIZE ? n : BUFFER_SIZE), m_pos(0), m_end(n)
+	{
+		copy(head, head + n, m_in.begin());
+	}
+
+	virtual ~Decompressor() { close(m_fd); }
+
+	/** Return the next block of uncompressed data, which is valid
+	 * until the next call.
+	 * @return false at the end of the file or at an error
+	 */
+	bool read(const char*& p, size_t& n)
+	{
+		return m_error.empty() && readBlock(p, n);
+	}
+
+	/** Return the error that stopped reading, or an empty string. */
+	const std::string& error() const { return m_error; }
+
+  protected:
+	/** Return the next block of uncompressed data.
+	 * @return false at the end of the file or at an error
+	 */
+	virtual bool readBlock(const char*& p, size_t& n) = 0;
+
+	/** Make at least n bytes of input available, or fewer only at
+	 * the end of the file.
+	 * @return the number of bytes of input available
+	 */
+	size_t fill(size_t n = 1)
+	{
+		if (m_end - m_pos >= n)
+			return m_end - m_pos;
+		copy(m_in.begin() + m_pos, m_in.begin() + m_end, m_in.begin());
+		m_end -= m_pos;
+		m_pos = 0;
+		if (m_in.size() < n)
+			m_in.resize(n);
+		while (m_end < n) {
+			ssize_t bytes = ::read(m_fd, &m_in[m_end],
+					m_in.size() - m_end);
+			if (bytes < 0 && errno == EINTR)
+				continue;
+			if (bytes < 0) {
+				fail(strerror(errno));
+				break;
+			}
+			if (bytes == 0)
+				break;
+			m_end += bytes;
+		}
+		return m_end - m_pos;
+	}
+
+	/** Return the available input. */
+	const char* input() const { return &m_in[m_pos]; }
+
+	/** Consume n bytes of input. */
+	void consume(size_t n)
+	{
+		assert(m_pos + n <= m_end);
+		m_pos += n;
+	}
+
+	/** Record an error, which stops reading. Only the first error
+	 * is kept. The error is reported by the reader of the data.
+	 * @return false
+	 */
+	bool fail(const char* message)
+	{
+		if (m_error.empty())
+			m_error = "`" + m_path + "': " + message;
+		return false;
+	}
+
+	std::string m_path;
+
+  private:
+	Decompressor(const Decompressor&);
+	Decompressor& operator=(const Decompressor&);
+
+	int m_fd;
+	std::vector<char> m_in;
+	size_t m_pos, m_end;
+	std::string m_error;
+};
+
+/** Read a file that is not compressed. */
+class PlainReader : public Decompressor {
+  public:
+	PlainReader(const char* path, int fd)
+		: Decompressor(path, fd, NULL, 0) { }
+
+	bool readBlock(const char*& p, size_t& n)
+	{
+		n = fill();
+		p = input();
+		consume(n);
+		return n > 0;
+	}
+};
+
+#if USE_ZLIB
+/** Uncompress a gzip file, which may have multiple members. */
+class GzipDecompressor : public Decompressor {
+  public:
+	GzipDecompressor(const char* path, int fd,
+			const char* head, size_t n)
+		: Decompressor(path, fd, head, n), m_members(0),
+		m_out(BUFFER_SIZE), m_inMember(false), m_done(false)
+	{
+		memset(&m_z, 0, sizeof m_z);
+		int err = inflateInit2(&m_z, 15 + 16);
+		assert(err == Z_OK);
+		(void)err;
+	}
+
+	~GzipDecompressor() { inflateEnd(&m_z); }
+
+	bool readBlock(const char*& p, size_t& n)
+	{
+		m_z.next_out = (Bytef*)&m_out[0];
+		m_z.avail_out = m_out.size();
+		while (!m_done && m_z.avail_out == m_out.size()) {
+			size_t avail = fill();
+			if (avail == 0) {
+				if (m_inMember)
+					return fail("unexpected end of file");
+				return false;
+			}
+			m_z.next_in = (Bytef*)input();
+			m_z.avail_in = avail;
+			int ret = inflate(&m_z, Z_NO_FLUSH);
+			consume(avail - m_z.avail_in);
+			if (ret == Z_STREAM_END) {
+				// Read the next member.
+				inflateReset(&m_z);
+				m_members++;
+				m_inMember = false;
+			} else if (ret == Z_DATA_ERROR && m_members > 0
+					&& !m_inMember) {
+				fprintf(stderr, "warning: `%s': "
+						"trailing garbage ignored\n", m_path.c_str());
+				m_done = true;
+			} else if (ret == Z_OK || ret == Z_BUF_ERROR)
+				m_inMember = true;
+			else
+				return fail(m_z.msg != NULL ? m_z.msg
+						: "invalid gzip data");
+		}
+		p = &m_out[0];
+		n = m_out.size() - m_z.avail_out;
+		return n > 0;
+	}
+
+  protected:
+	/** The number of members read */
+	unsigned m_members;
+
+  private:
+	z_stream m_z;
+	std::vector<char> m_out;
+
+	/** Whether a member has been started but not finished */
+	bool m_inMember;
+
+	/** Whether trailing garbage follows the last member */
+	bool m_done;
+};
+
+/** Uncompress a BGZF file, whose blocks are uncompressed in
+ * parallel. Each block is a gzip member. If a member that is not a
+ * BGZF block follows, as when a gzip file is appended to a BGZF file,
+ * the rest of the file is uncompressed as a stream.
+ */
+class BgzfDecompressor : public GzipDecompressor {
+  public:
+	/** The number of bytes of a block header */
+	static const size_t HEADER_SIZE = 18;
+
+	/** The maximum size of an uncompressed block */
+	static const size_t MAX_BLOCK_SIZE = 1 << 16;
+
+	/** Return whether the specified block header is BGZF. */
+	static bool isBgzf(const char* head, size_t n)
+	{
+		const unsigned char* p = (const unsigned char*)head;
+		return n >= HEADER_SIZE
+			&& p[0] == 31 && p[1] == 139 && p[2] == 8 && (p[3] & 4)
+			&& p[10] == 6 && p[11] == 0
+			&& p[12] == 'B' && p[13] == 'C'
+			&& p[14] == 2 && p[15] == 0;
+	}
+
+	BgzfDecompressor(const char* path, int fd,
+			const char* head, size_t n)
+		: GzipDecompressor(path, fd, head, n),
+		m_threads(numThreads()), m_blocks(64 * m_threads), m_next(0),
+		m_size(0), m_streaming(false)
+	{
+	}
+
+	bool readBlock(const char*& p, size_t& n)
+	{
+		while (m_next == m_size || m_blocks[m_next].out.empty()) {
+			if (m_next == m_size && !readBatch())
+				return m_streaming && error().empty()
+					&& GzipDecompressor::readBlock(p, n);
+			if (m_blocks[m_next].out.empty())
+				m_next++;
+		}
+		const Block& block = m_blocks[m_next++];
+		p = &block.out[0];
+		n = block.out.size();
+		return true;
+	}
+
+  private:
+	/** A compressed block and its uncompressed data */
+	struct Block {
+		std::vector<char> in;
+		std::vector<char> out;
+		uint32_t crc;
+		/** The error found uncompressing this block, or NULL */
+		const char* error;
+	};
+
+	/** The maximum number of threads with which to uncompress */
+	static const int MAX_THREADS = 8;
+
+	/** Return the number of threads with which to uncompress, which
+	 * is the number of OpenMP threads of the caller, as set by its
+	 * -j option. A program without OpenMP uses one thread.
+	 */
+	static unsigned numThreads()
+	{
+#if HAVE_LIBPTHREAD && HAVE_LIBDL
+		typedef int (*omp_get_max_threads_t)();
+		omp_get_max_threads_t getMaxThreads = (omp_get_max_threads_t)
+			dlsym(RTLD_DEFAULT, "omp_get_max_threads");
+		int n = getMaxThreads == NULL ? 1 : getMaxThreads();
+		return n < 1 ? 1 : n > MAX_THREADS ? MAX_THREADS : n;
+#else
+		return 1;
+#endif
+	}
+
+	static uint32_t get32(const char* s)
+	{
+		const unsigned char* p = (const unsigned char*)s;
+		return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+	}
+
+	/** Read the next batch of compressed blocks and uncompress them.
+	 * Stop at a member that is not a BGZF block, and uncompress the
+	 * rest of the file as a stream.
+	 * @return false at the end of the file, at an error, or when
+	 * there are no more BGZF blocks
+	 */
+	bool readBatch()
+	{
+		m_next = m_size = 0;
+		while (!m_streaming && m_size < m_blocks.size()) {
+			size_t avail = fill(HEADER_SIZE);
+			if (avail == 0)
+				break;
+			if (!isBgzf(input(), avail)) {
+				m_streaming = true;
+				break;
+			}
+			const unsigned char* p = (const unsigned char*)input();
+			size_t blockSize = (p[16] | p[17] << 8) + 1;
+			if (fill(blockSize) < blockSize)
+				return fail("unexpected end of file");
+			Block& block = m_blocks[m_size++];
+			// The compressed data, CRC32 and ISIZE
+			const char* data = input() + HEADER_SIZE;
+			size_t dataSize = blockSize - HEADER_SIZE;
+			if (blockSize <= HEADER_SIZE + 8)
+				return fail("invalid BGZF block");
+			uint32_t isize = get32(data + dataSize - 4);
+			if (isize > MAX_BLOCK_SIZE)
+				return fail("invalid BGZF block");
+			block.in.assign(data, data + dataSize - 8);
+			block.crc = get32(data + dataSize - 8);
+			block.out.resize(isize);
+			block.error = NULL;
+			consume(blockSize);
+			m_members++;
+		}
+		if (m_size == 0)
+			return false;
+
+#if HAVE_LIBPTHREAD
+		unsigned nthreads = std::min<size_t>(m_threads, m_size);
+		std::vector<pthread_t> threads(nthreads);
+		std::vector<Worker> workers(nthreads);
+		std::vector<bool> started(nthreads);
+		for (unsigned i = 0; i < nthreads; ++i) {
+			workers[i].self = this;
+			workers[i].first = i;
+			workers[i].step = nthreads;
+			started[i] = i > 0 && pthread_create(&threads[i], NULL,
+					inflateWorker, &workers[i]) == 0;
+		}
+		// Uncompress the blocks of any thread that failed to start.
+		for (unsigned i = 0; i < nthreads; ++i)
+			if (!started[i])
+				inflateWorker(&workers[i]);
+		for (unsigned i = 1; i < nthreads; ++i)
+			if (started[i])
+				pthread_join(threads[i], NULL);
+#else
+		for (size_t i = 0; i < m_size; ++i)
+			inflateBlock(m_blocks[i]);
+#endif
+		for (size_t i = 0; i < m_size; ++i)
+			if (m_blocks[i].error != NULL)
+				return fail(m_blocks[i].error);
+		return true;
+	}
+
+	/** Uncompress a single block. An error is stored in the block,
+	 * because this function is called by the worker threads.
+	 */
+	static void inflateBlock(Block& block)
+	{
+		if (block.out.empty())
+			return;
+		z_stream z;
+		memset(&z, 0, sizeof z);
+		int err = inflateInit2(&z, -15);
+		assert(err == Z_OK);
+		(void)err;
+		z.next_in = (Bytef*)&block.in[0];
+		z.avail_in = block.in.size();
+		z.next_out = (Bytef*)&block.out[0];
+		z.avail_out = block.out.size();
+		int ret = inflate(&z, Z_FINISH);
+		inflateEnd(&z);
+		if (ret != Z_STREAM_END || z.avail_out != 0)
+			block.error = "invalid BGZF block";
+		else if (crc32(crc32(0, NULL, 0), (const Bytef*)&block.out[0],
+					block.out.size()) != block.crc)
+			block.error = "BGZF block CRC mismatch";
+	}
+
+	/** The blocks uncompressed by a single thread */
+	struct Worker {
+		BgzfDecompressor* self;
+		size_t first, step;
+	};
+
+	static void* inflateWorker(void* arg)
+	{
+		const Worker& w = *static_cast<Worker*>(arg);
+		for (size_t i = w.first; i < w.self->m_size; i += w.step)
+			w.self->inflateBlock(w.self->m_blocks[i]);
+		return NULL;
+	}
+
+	unsigned m_threads;
+	std::vector<Block> m_blocks;
+	size_t m_next, m_size;
+
+	/** Whether the BGZF blocks are done, and the rest of the file is
+	 * uncompressed as a stream */
+	bool m_streaming;
+};
+#endif // USE_ZLIB
+
+#if USE_BZLIB
+/** Uncompress a bzip2 file, which may have multiple streams. */
+class Bzip2Decompressor : public Decompressor {
+  public:
+	Bzip2Decompressor(const char* path, int fd)
+		: Decompressor(path, fd, NULL, 0), m_out(BUFFER_SIZE),
+		m_streams(0), m_inStream(false), m_done(false)
+	{
+		memset(&m_bz, 0, sizeof m_bz);
+		int err = BZ2_bzDecompressInit(&m_bz, 0, 0);
+		assert(err == BZ_OK);
+		(void)err;
+	}
+
+	~Bzip2Decompressor() { BZ2_bzDecompressEnd(&m_bz); }
+
+	bool readBlock(const char*& p, size_t& n)
+	{
+		m_bz.next_out = &m_out[0];
+		m_bz.avail_out = m_out.size();
+		while (!m_done && m_bz.avail_out == m_out.size()) {
+			size_t avail = fill();
+			if (avail == 0) {
+				if (m_inStream)
+					return fail("unexpected end of file");
+				return false;
+			}
+			m_bz.next_in = const_cast<char*>(input());
+			m_bz.avail_in = avail;
+			int ret = BZ2_bzDecompress(&m_bz);
+			consume(avail - m_bz.avail_in);
+			if (ret == BZ_STREAM_END) {
+				// Read the next stream.
+				BZ2_bzDecompressEnd(&m_bz);
+				int err = BZ2_bzDecompressInit(&m_bz, 0, 0);
+				assert(err == BZ_OK);
+				(void)err;
+				m_streams++;
+				m_inStream = false;
+			} else if (ret == BZ_DATA_ERROR_MAGIC && m_streams > 0
+					&& !m_inStream) {
+				fprintf(stderr, "warning: `%s': "
+						"trailing garbage ignored\n", m_path.c_str());
+				m_done = true;
+			} else if (ret == BZ_OK)
+				m_inStream = true;
+			else
+				return fail("invalid bzip2 data");
+		}
+		p = &m_out[0];
+		n = m_out.size() - m_bz.avail_out;
+		return n > 0;
+	}
+
+  private:
+	bz_stream m_bz;
+	std::vector<char> m_out;
+
+	/** The number of streams read */
+	unsigned m_streams;
+
+	/** Whether a stream has been started but not finished */
+	bool m_inStream;
+
+	/** Whether trailing garbage follows the last stream */
+	bool m_done;
+};
+#endif // USE_BZLIB
+
+#if USE_LZMA
+/** Uncompress an xz file, which may have multiple streams. */
+class XzDecompressor : public Decompressor {
+  public:
+	XzDecompressor(const char* path, int fd)
+		: Decompressor(path, fd, NULL, 0), m_out(BUFFER_SIZE),
+		m_done(false)
+	{
+		lzma_stream init = LZMA_STREAM_INIT;
+		m_lzma = init;
+		if (lzma_stream_decoder(&m_lzma, UINT64_MAX,
+					LZMA_CONCATENATED) != LZMA_OK)
+			fail("lzma_stream_decoder failed");
+	}
+
+	~XzDecompressor() { lzma_end(&m_lzma); }
+
+	bool readBlock(const char*& p, size_t& n)
+	{
+		m_lzma.next_out = (uint8_t*)&m_out[0];
+		m_lzma.avail_out = m_out.size();
+		while (!m_done && m_lzma.avail_out == m_out.size()) {
+			size_t avail = fill();
+			m_lzma.next_in = (const uint8_t*)input();
+			m_lzma.avail_in = avail;
+			lzma_ret ret = lzma_code(&m_lzma,
+					avail == 0 ? LZMA_FINISH : LZMA_RUN);
+			consume(avail - m_lzma.avail_in);
+			if (ret == LZMA_STREAM_END)
+				m_done = true;
+			else if (ret != LZMA_OK)
+				return fail("invalid xz data");
+		}
+		p = &m_out[0];
+		n = m_out.size() - m_lzma.avail_out;
+		return n > 0;
+	}
+
+  private:
+	lzma_stream m_lzma;
+	std::vector<char> m_out;
+	bool m_done;
+};
+#endif // USE_LZMA
+
+/** Return a decompressor of the file descriptor fd, which was opened
+ * from the specified path.
+ */
+static Decompressor* newDecompressor(const char* path, int fd,
+		Format format)
+{
+	switch (format) {
+#if USE_ZLIB
+	  case GZIP: {
+		char head[BgzfDecompressor::HEADER_SIZE];
+		size_t n = 0;
+		while (n < sizeof head) {
+			ssize_t bytes = read(fd, head + n, sizeof head - n);
+			if (bytes < 0 && errno == EINTR)
+				continue;
+			if (bytes <= 0)
+				break;
+			n += bytes;
+		}
+		if (BgzfDecompressor::isBgzf(head, n))
+			return new BgzfDecompressor(path, fd, head, n);
+		return new GzipDecompressor(path, fd, head, n);
+	  }
+#endif
+#if USE_BZLIB
+	  case BZIP2:
+		return new Bzip2Decompressor(path, fd);
+#endif
+#if USE_LZMA
+	  case XZ:
+		return new XzDecompressor(path, fd);
+#endif
+	  default:
+		return new PlainReader(path, fd);
+	}
+}
+
 extern "C" {
 
+#if HAVE_LIBPTHREAD
+/** A pipe written by a decompressor thread. The state is shared by
+ * the writer and the reader of the pipe, and is deleted by whichever
+ * is done last.
+ */
+struct PipeState {
+	/** The error that stopped the decompressor */
+	std::string error;
+	bool writerDone, readerDone;
+	PipeState() : writerDone(false), readerDone(false) { }
+};
+
+/** Pipes indexed by the file descriptor of the reading end */
+typedef std::map<int, PipeState*> PipeMap;
+
+/** Guards the pipes and their state */
+static pthread_mutex_t g_pipeMutex = PTHREAD_MUTEX_INITIALIZER;
+
+/** Whether any pipe has been written by a decompressor thread */
+static volatile bool g_pipesUsed;
+
+/** Return the pipes written by decompressor threads. The map is
+ * never destroyed, so that a pipe may be closed at exit.
+ */
+static PipeMap& pipes()
+{
+	static PipeMap* p = new PipeMap;
+	return *p;
+}
+
+/** Stop tracking the reading end fd of a pipe, which is about to be
+ * closed. If its decompressor stopped at an error, report it and
+ * exit. The reader has seen the end of the pipe, so this error is
+ * reported by the thread that reads the file.
+ */
+static void closePipe(int fd)
+{
+	if (!g_pipesUsed || fd < 0)
+		return;
+	std::string error;
+	pthread_mutex_lock(&g_pipeMutex);
+	PipeMap::iterator it = pipes().find(fd);
+	if (it != pipes().end()) {
+		PipeState* state = it->second;
+		pipes().erase(it);
+		error = state->error;
+		state->readerDone = true;
+		if (state->writerDone)
+			delete state;
+	}
+	pthread_mutex_unlock(&g_pipeMutex);
+	if (!error.empty()) {
+		fprintf(stderr, "error: %s\n", error.c_str());
+		exit(EXIT_FAILURE);
+	}
+}
+
+/** Report an error of a pipe whose reader did not close it. */
+static void checkPipesAtExit()
+{
+	pthread_mutex_lock(&g_pipeMutex);
+	for (PipeMap::const_iterator it = pipes().begin();
+			it != pipes().end(); ++it) {
+		if (!it->second->error.empty()) {
+			fprintf(stderr, "error: %s\n", it->second->error.c_str());
+			_exit(EXIT_FAILURE);
+		}
+	}
+	pthread_mutex_unlock(&g_pipeMutex);
+}
+
+/** Write the output of a decompressor to a pipe. */
+struct PipeWriter {
+	Decompressor* decompressor;
+	int fd;
+	PipeState* state;
+};
+
+/** Write the output of a decompressor to a pipe, and close the pipe
+ * at the end of the file, at an error, or when the reader closes the
+ * pipe. An error is stored in the state of the pipe, and reported
+ * when the reader closes the pipe.
+ */
+static void* writePipe(void* arg)
+{
+	PipeWriter* w = static_cast<PipeWriter*>(arg);
+
+	// Report EPIPE rather than raising SIGPIPE when the reader closes
+	// the pipe before the end of the file.
+	sigset_t sigpipe;
+	sigemptyset(&sigpipe);
+	sigaddset(&sigpipe, SIGPIPE);
+	pthread_sigmask(SIG_BLOCK, &sigpipe, NULL);
+
+	bool good = true;
+	std::string error;
+	const char* p;
+	size_t n;
+	while (good && w->decompressor->read(p, n)) {
+		while (n > 0) {
+			ssize_t bytes = write(w->fd, p, n);
+			if (bytes < 0 && errno == EINTR)
+				continue;
+			if (bytes < 0) {
+				if (errno != EPIPE)
+					error = std::string("write: ") + strerror(errno);
+				good = false;
+				break;
+			}
+			p += bytes;
+			n -= bytes;
+		}
+	}
+	if (good)
+		error = w->decompressor->error();
+
+	// Store the error before closing the pipe, so that the reader
+	// finds it after reading the end of the pipe.
+	pthread_mutex_lock(&g_pipeMutex);
+	PipeState* state = w->state;
+	state->error = error;
+	state->writerDone = true;
+	bool readerDone = state->readerDone;
+	pthread_mutex_unlock(&g_pipeMutex);
+	if (readerDone)
+		delete state;
+
+	close(w->fd);
+	delete w->decompressor;
+	delete w;
+	return NULL;
+}
+
+/** Open a pipe to uncompress the specified file using a thread of
+ * this process.
+ * @return a file descriptor
+ */
+static int uncompressInProcess(const char* path, Format format)
+{
+	int in = openReadOnly(path);
+	if (in == -1)
+		return -1;
+	int err = setCloexec(in);
+	assert(err == 0);
+
+	int fd[2];
+	if (pipe(fd) == -1) {
+		close(in);
+		return -1;
+	}
+	err = setCloexec(fd[0]);
+	assert(err == 0);
+	err = setCloexec(fd[1]);
+	assert(err == 0);
+	(void)err;
+	// A larger pipe buffer reduces the number of context switches.
+	(void)setPipeSize(fd[1], Decompressor::BUFFER_SIZE);
+
+	PipeWriter* w = new PipeWriter;
+	w->decompressor = newDecompressor(path, in, format);
+	w->fd = fd[1];
+	w->state = new PipeState;
+	pthread_mutex_lock(&g_pipeMutex);
+	if (!g_pipesUsed) {
+		g_pipesUsed = true;
+		atexit(checkPipesAtExit);
+	}
+	pipes()[fd[0]] = w->state;
+	pthread_mutex_unlock(&g_pipeMutex);
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	pthread_t thread;
+	if (pthread_create(&thread, &attr, writePipe, w) != 0) {
+		perror("pthread_create");
+		exit(EXIT_FAILURE);
+	}
+	pthread_attr_destroy(&attr);
+	return fd[0];
+}
+#endif // HAVE_LIBPTHREAD
+
 /** Open a pipe to uncompress the specified file.
  * Not thread safe.
  * @return a file descriptor
  */
-static int uncompress(const char *path)
+static int uncompressPipe(const char *path)
 {
+#if HAVE_LIBPTHREAD
+	Format format = zcatFormat(path);
+	if (format != NOT_COMPRESSED)
+		return uncompressInProcess(path, format);
+#endif
+
 	const char *wget = wgetExec(path);
 	const char *zcat = wget != NULL ? wget : zcatExec(path);
 	assert(zcat != NULL);
@@ -112,12 +886,14 @@ static int uncompress(const char *path)
 	}
 }
 
+#if HAVE_LIBDL
+
 /** Open a pipe to uncompress the specified file.
  * @return a FILE pointer
  */
 static FILE* funcompress(const char* path)
 {
-	int fd = uncompress(path);
+	int fd = uncompressPipe(path);
 	if (fd == -1) {
 		perror(path);
 		exit(EXIT_FAILURE);
@@ -143,7 +919,7 @@ FILE *fopen(const char *path, const char *mode)
 	// open a web address
 	if (wgetExec(path) != NULL)
 		return funcompress(path);
-	
+
 	// to check if the file exists, we need to attempt to open it
 	FILE* stream = real_fopen(path, mode);
 	if (string(mode) != "r" || !stream || zcatExec(path) == NULL)
@@ -170,7 +946,7 @@ FILE *fopen64(const char *path, const char *mode)
 	// open a web address
 	if (wgetExec(path) != NULL)
 		return funcompress(path);
-	
+
 	// to check if the file exists, we need to attempt to open it
 	FILE* stream = real_fopen64(path, mode);
 	if (string(mode) != "r" || !stream || zcatExec(path) == NULL)
@@ -198,8 +974,8 @@ int open(const char *path, int flags, mode_t mode)
 
 	// open a web address
 	if (wgetExec(path) != NULL)
-		return uncompress(path);
-	
+		return uncompressPipe(path);
+
 	// to check if the file exists, we need to attempt to open it
 	int filedesc = real_open(path, flags, mode);
 	if (mode != ios_base::in || filedesc < 0
@@ -207,14 +983,103 @@ int open(const char *path, int flags, mode_t mode)
 		return filedesc;
 	else {
 		close(filedesc);
-		return uncompress(path);
+		return uncompressPipe(path);
 	}
 }
 
-} // extern "C"
+typedef int (*fclose_t)(FILE* stream);
+
+/** Close the specified stream. If it is a pipe whose decompressor
+ * stopped at an error, report the error and exit.
+ */
+int fclose(FILE* stream)
+{
+	static fclose_t real_fclose;
+	if (real_fclose == NULL)
+		real_fclose = (fclose_t)dlsym(RTLD_NEXT, "fclose");
+	if (real_fclose == NULL) {
+		fprintf(stderr, "error: dlsym fclose: %s\n", dlerror());
+		exit(EXIT_FAILURE);
+	}
+#if HAVE_LIBPTHREAD
+	// Stop tracking the pipe before its descriptor may be reused.
+	closePipe(fileno(stream));
+#endif
+	return real_fclose(stream);
+}
+
+typedef int (*close_t)(int fd);
+
+/** Close the specified file descriptor. If it is a pipe whose
+ * decompressor stopped at an error, report the error and exit.
+ */
+int close(int fd)
+{
+	static close_t real_close;
+	if (real_close == NULL)
+		real_close = (close_t)dlsym(RTLD_NEXT, "close");
+	if (real_close == NULL) {
+		fprintf(stderr, "error: dlsym close: %s\n", dlerror());
+		exit(EXIT_FAILURE);
+	}
+#if HAVE_LIBPTHREAD
+	closePipe(fd);
+#endif
+	return real_close(fd);
+}
 
 #endif // HAVE_LIBDL
 
+} // extern "C"
+
+/** Open the specified file, which may be compressed. */
+UncompressReader::UncompressReader(const char* path)
+	: m_decompressor(NULL)
+{
+	Format format = zcatFormat(path);
+	int fd;
+	if (wgetExec(path) != NULL) {
+		// Download the file using a child process.
+		fd = uncompressPipe(path);
+	} else {
+		fd = openReadOnly(path);
+		if (fd != -1 && format == NOT_COMPRESSED
+				&& zcatExec(path) != NULL) {
+			// Uncompress the file using a child process.
+			close(fd);
+			fd = uncompressPipe(path);
+		}
+	}
+	if (fd == -1)
+		return;
+	int err = setCloexec(fd);
+	assert(err == 0);
+	(void)err;
+	m_decompressor = newDecompressor(path, fd, format);
+}
+
+UncompressReader::~UncompressReader()
+{
+	delete m_decompressor;
+}
+
+/** Return the next block of the uncompressed file, which is valid
+ * until the next call.
+ * @return false at the end of the file
+ */
+bool UncompressReader::read(const char*& p, size_t& n)
+{
+	assert(m_decompressor != NULL);
+	if (m_decompressor->read(p, n))
+		return true;
+	if (!m_decompressor->error().empty()) {
+		fprintf(stderr, "error: %s\n",
+				m_decompressor->error().c_str());
+		exit(EXIT_FAILURE);
+	}
+	return false;
+}
+
 /** Initialize the uncompress module. */
 bool uncompress_init()
 {
@@ -223,3 +1088,16 @@ bool uncompress_init()
 #endif
 	return HAVE_LIBDL;
 }
+
+/** Return whether the specified file is read through a pipe, because
+ * it is compressed or remote.
+ */
+bool uncompress_isPipe(const char* path)
+{
+#if HAVE_LIBDL
+	return wgetExec(path) != NULL || zcatExec(path) != NULL;
+#else
+	(void)path;
+	return false;
+#endif
+}
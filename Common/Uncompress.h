@@ -1,7 +1,10 @@
 #ifndef UNCOMPRESS_H
 #define UNCOMPRESS_H 1
 
+#include <cstddef>
+
 bool uncompress_init();
+bool uncompress_isPipe(const char* path);
 
 namespace {
 const bool uncompressInitialized = uncompress_init();
@@ -9,4 +12,27 @@ bool getUncompressInitialized() __attribute__((unused));
 bool getUncompressInitialized() { return uncompressInitialized; }
 }
 
+class Decompressor;
+
+/** Read a file in blocks, which are uncompressed in this process
+ * when the file is compressed with gzip, bzip2 or xz. The blocks are
+ * read directly from the buffer of the decompressor.
+ */
+class UncompressReader {
+  public:
+	explicit UncompressReader(const char* path);
+	~UncompressReader();
+
+	/** Return whether the file was opened. */
+	bool good() const { return m_decompressor != NULL; }
+
+	bool read(const char*& p, size_t& n);
+
+  private:
+	UncompressReader(const UncompressReader&);
+	UncompressReader& operator=(const UncompressReader&);
+
+	Decompressor* m_decompressor;
+};
+
 #endif
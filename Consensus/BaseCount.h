@@ -0,0 +1,46 @@
+#ifndef CONSENSUS_BASECOUNT_H
+#define CONSENSUS_BASECOUNT_H 1
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <ostream>
+#include <stdint.h>
+
+/** The number of reads of each base at a position. The counts
+ * saturate at the largest value of a uint16_t. */
+struct BaseCount {
+	uint16_t count[4];
+	BaseCount() { std::fill(count, count + 4, 0); }
+
+	/** Count a read of the specified base. This function is
+	 * thread safe. */
+	void increment(uint8_t base)
+	{
+		uint16_t n;
+#pragma omp atomic capture
+		n = ++count[base];
+		if (n == 0) {
+			// Saturate rather than overflow.
+#pragma omp atomic write
+			count[base] = std::numeric_limits<uint16_t>::max();
+		}
+	}
+
+	/** Return the number of reads at this position. */
+	unsigned sum() const
+	{
+		return std::accumulate(count, count + 4, 0);
+	}
+
+	friend std::ostream& operator <<(std::ostream& out,
+			const BaseCount& base)
+	{
+		out << base.count[0];
+		for (int x = 1; x < 4; x++)
+			out << '\t' << base.count[x];
+		return out;
+	}
+};
+
+#endif
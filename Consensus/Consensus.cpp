@@ -1,4 +1,5 @@
 #include "Alignment.h"
+#include "BaseCount.h"
 #include "Common/Options.h"
 #include "ContigID.h"
 #include "FastaReader.h"
@@ -10,9 +11,13 @@
 #include <cstdlib>
 #include <getopt.h>
 #include <iostream>
-#include <numeric>
 #include <sstream>
+#include <stdint.h>
 #include <string>
+#include <vector>
+#if _OPENMP
+# include <omp.h>
+#endif
 
 using namespace std;
 
@@ -43,6 +48,7 @@ static const char USAGE_MESSAGE[] =
 "      --nt              output nucleotide contigs [default]\n"
 "      --cs              output colour-space contigs\n"
 "  -V, --variants        print only variants in the pileup\n"
+"  -j, --threads=N       use N parallel threads [1]\n"
 "  -v, --verbose         display verbose output\n"
 "      --help            display this help and exit\n"
 "      --version         output version information and exit\n"
@@ -55,9 +61,10 @@ namespace opt {
 	static bool csToNt;
 	static int outputCS;
 	static int onlyVariants;
+	static int threads = 1;
 }
 
-static const char shortopts[] = "o:p:vV";
+static const char shortopts[] = "j:o:p:vV";
 
 enum { OPT_HELP = 1, OPT_VERSION };
 
@@ -68,39 +75,42 @@ static const struct option longopts[] = {
 	{ "variants",    no_argument,		&opt::onlyVariants, 1 },
 	{ "nt",			 no_argument,		&opt::outputCS, 0 },
 	{ "cs",			 no_argument,		&opt::outputCS, 1 },
+	{ "threads",     required_argument, NULL, 'j' },
 	{ "help",        no_argument,       NULL, OPT_HELP },
 	{ "version",     no_argument,       NULL, OPT_VERSION },
 	{ NULL, 0, NULL, 0 }
 };
 
-struct BaseCount {
-	unsigned count[4];
-	BaseCount() { fill(count, count + 4, 0); }
-
-	/** Return the number of reads at this position. */
-	unsigned sum() const { return accumulate(count, count+4, 0); }
-
-	friend ostream& operator <<(ostream& out, const BaseCount& base)
-	{
-		out << base.count[0];
-		for (int x = 1; x < 4; x++)
-			out << '\t' << base.count[x];
-		return out;
-	}
-};
-
+/** The pile-up of every contig, stored end to end. */
 typedef vector<BaseCount> BaseCounts;
+static BaseCounts g_baseCounts;
 
 struct ContigCount {
 	Sequence seq;
 	unsigned coverage;
 	string comment;
-	BaseCounts counts;
+	/** The index of the first position of this contig in
+	 * g_baseCounts */
+	size_t offset;
+	/** The number of positions of this contig in g_baseCounts */
+	unsigned length;
+
+	/** Return the pile-up at the specified position. */
+	BaseCount& counts(unsigned pos) const
+	{
+		assert(pos < length);
+		return g_baseCounts[offset + pos];
+	}
 };
 
-/** A map of contigs. The alignments reference the contig by name. */
-typedef unordered_map<string, ContigCount> ContigMap;
-static ContigMap g_contigs;
+/** The contigs indexed by their dense ID, in input order. */
+typedef vector<ContigCount> ContigCounts;
+static ContigCounts g_contigs;
+
+/** A map of contig names to their ID. The alignments reference the
+ * contig by name. */
+typedef unordered_map<string, unsigned> ContigMap;
+static ContigMap g_contigIDs;
 
 /** Read all contigs in and store the contigs in g_contigs and make a
  * g_baseCounts, to store pile-up for each base. */
@@ -109,9 +119,14 @@ static void readContigs(const string& contigsPath)
 	FastaReader contigsFile(contigsPath.c_str(),
 			FastaReader::NO_FOLD_CASE);
 	int count = 0;
+	size_t offset = 0;
 	for (FastaRecord rec; contigsFile >> rec;) {
 		const Sequence& seq = rec.seq;
-		ContigCount& contig = g_contigs[rec.id];
+		pair<ContigMap::iterator, bool> inserted = g_contigIDs.insert(
+				make_pair(rec.id, (unsigned)g_contigs.size()));
+		if (inserted.second)
+			g_contigs.push_back(ContigCount());
+		ContigCount& contig = g_contigs[inserted.first->second];
 		contig.seq = seq;
 
 		istringstream ss(rec.comment);
@@ -137,14 +152,16 @@ static void readContigs(const string& contigsPath)
 				assert(isalpha(seq[0]));
 		}
 
-		contig.counts = BaseCounts(contig.seq.length()
-				+ (opt::csToNt ? 1 : 0));
+		contig.offset = offset;
+		contig.length = contig.seq.length() + (opt::csToNt ? 1 : 0);
+		offset += contig.length;
 
 		count++;
 	}
 	cerr << "Read " << count << " contigs\n";
 	assert(contigsFile.eof());
 	assert(count > 0);
+	g_baseCounts.resize(offset);
 }
 
 typedef vector<Alignment> AlignmentVector;
@@ -169,104 +186,130 @@ static void readAlignment(string& line, string& readID,
 		seq = colourToNucleotideSpace(anchor, seq);
 }
 
-/** Builds the pile up of all reads based on the alignments and
- * read sequence */
-static void buildBaseQuality()
+/** Add the alignments of one read to the pile-up. This function is
+ * called in parallel. */
+static void pileupRead(string& line)
 {
-	if (opt::csToNt)
-		opt::colourSpace = false;
+	string readID;
+	Sequence seq;
+	AlignmentVector alignments;
 
-	// for each read and/or set of alignments.
-	for (string line; getline(cin, line);) {
-		string readID;
-		Sequence seq;
-		AlignmentVector alignments;
-
-		readAlignment(line, readID, seq, alignments);
-
-		// If converting to NT space, check that at least one of the
-		// alignments starts at read location 0. Otherwise, it is
-		// likely to introduce a frameshift or erroneous sequence in
-		// the final consensus.
-		if (opt::csToNt) {
-			bool good = false;
-			for (AlignmentVector::const_iterator
-					alignIter = alignments.begin();
-					alignIter != alignments.end(); ++alignIter) {
-				if (alignIter->read_start_pos == 0) {
-					good = true;
-					break;
-				}
-			}
-			if (!good)
-				continue;
-		}
+	readAlignment(line, readID, seq, alignments);
 
-		// For each alignment for the read.
+	// If converting to NT space, check that at least one of the
+	// alignments starts at read location 0. Otherwise, it is
+	// likely to introduce a frameshift or erroneous sequence in
+	// the final consensus.
+	if (opt::csToNt) {
+		bool good = false;
 		for (AlignmentVector::const_iterator
 				alignIter = alignments.begin();
 				alignIter != alignments.end(); ++alignIter) {
-			string seqrc;
-			Alignment a;
-			if (alignIter->isRC) {
-				seqrc = reverseComplement(seq);
-				a = alignIter->flipQuery();
-			} else {
-				seqrc = seq;
-				a = *alignIter;
+			if (alignIter->read_start_pos == 0) {
+				good = true;
+				break;
 			}
-			const char* s = seqrc.c_str();
+		}
+		if (!good)
+			return;
+	}
 
-			ContigMap::iterator contigIt = g_contigs.find(a.contig);
-			if (contigIt == g_contigs.end()) {
-				cerr << "error: unexpected contig ID: `" << a.contig
-					<< "'\n";
-				exit(EXIT_FAILURE);
-			}
+	// For each alignment for the read.
+	for (AlignmentVector::const_iterator
+			alignIter = alignments.begin();
+			alignIter != alignments.end(); ++alignIter) {
+		string seqrc;
+		Alignment a;
+		if (alignIter->isRC) {
+			seqrc = reverseComplement(seq);
+			a = alignIter->flipQuery();
+		} else {
+			seqrc = seq;
+			a = *alignIter;
+		}
+		const char* s = seqrc.c_str();
+
+		ContigMap::const_iterator contigIt
+			= g_contigIDs.find(a.contig);
+		if (contigIt == g_contigIDs.end()) {
+#pragma omp critical(cerr)
+			cerr << "error: unexpected contig ID: `" << a.contig
+				<< "'\n";
+			exit(EXIT_FAILURE);
+		}
 
-			BaseCounts& countsVec = contigIt->second.counts;
+		const ContigCount& contig = g_contigs[contigIt->second];
 
-			int read_min;
-			int read_max;
-			if (!opt::csToNt) {
-				read_min = a.read_start_pos - a.contig_start_pos;
-				read_min = read_min > 0 ? read_min : 0;
+		int read_min;
+		int read_max;
+		if (!opt::csToNt) {
+			read_min = a.read_start_pos - a.contig_start_pos;
+			read_min = read_min > 0 ? read_min : 0;
 
-				read_max = a.read_start_pos + countsVec.size() -
-					a.contig_start_pos;
-				read_max = read_max < a.read_length
-					? read_max : a.read_length;
-			} else {
-				read_min = a.read_start_pos;
-				read_max = read_min + a.align_length + 1;
-			}
+			read_max = a.read_start_pos + contig.length -
+				a.contig_start_pos;
+			read_max = read_max < a.read_length
+				? read_max : a.read_length;
+		} else {
+			read_min = a.read_start_pos;
+			read_max = read_min + a.align_length + 1;
+		}
 
-			if ((int)countsVec.size() < a.contig_start_pos
-					- a.read_start_pos + read_max - 1)
-				cerr << countsVec.size() << '\n';
-
-			// Assertions to make sure alignment math was done right.
-			assert((int)countsVec.size() >= a.contig_start_pos
-					- a.read_start_pos + read_max - 1);
-			assert(read_max <= (int)seq.length());
-			assert(read_min >= 0);
-
-			// Pile-up every base in the read to the contig.
-			for (int x = read_min; x < read_max; x++) {
-				char c = toupper(s[x]);
-				switch (c) {
-				  case 'A': case 'C': case 'G': case 'T':
-				  case '0': case '1': case '2': case '3':
-					unsigned pos
-						= a.contig_start_pos - a.read_start_pos + x;
-					assert(pos < countsVec.size());
-					countsVec[pos].count[baseToCode(c)]++;
-				}
+		if ((int)contig.length < a.contig_start_pos
+				- a.read_start_pos + read_max - 1)
+#pragma omp critical(cerr)
+			cerr << contig.length << '\n';
+
+		// Assertions to make sure alignment math was done right.
+		assert((int)contig.length >= a.contig_start_pos
+				- a.read_start_pos + read_max - 1);
+		assert(read_max <= (int)seq.length());
+		assert(read_min >= 0);
+
+		// Pile-up every base in the read to the contig.
+		for (int x = read_min; x < read_max; x++) {
+			char c = toupper(s[x]);
+			switch (c) {
+			  case 'A': case 'C': case 'G': case 'T':
+			  case '0': case '1': case '2': case '3':
+				unsigned pos
+					= a.contig_start_pos - a.read_start_pos + x;
+				contig.counts(pos).increment(baseToCode(c));
 			}
 		}
 	}
 }
 
+/** Builds the pile up of all reads based on the alignments and
+ * read sequence */
+static void buildBaseQuality()
+{
+	if (opt::csToNt)
+		opt::colourSpace = false;
+
+	// Read batches of lines serially and pile up the reads of each
+	// batch in parallel.
+	const unsigned BATCH_SIZE = 4096;
+	bool eof = false;
+#pragma omp parallel
+	for (vector<string> lines(BATCH_SIZE);;) {
+		size_t n = 0;
+#pragma omp critical(cin)
+		while (!eof && n < BATCH_SIZE) {
+			if (getline(cin, lines[n]))
+				n++;
+			else
+				eof = true;
+		}
+		if (n == 0)
+			break;
+
+		// for each read and/or set of alignments.
+		for (size_t i = 0; i < n; ++i)
+			pileupRead(lines[i]);
+	}
+}
+
 /** Returns the most likely base found by the pile up count. */
 static char selectBase(const BaseCount& count, unsigned& sumBest,
 		unsigned& sumSecond)
@@ -377,17 +420,17 @@ static void consensus(const string& outPath, const string& pileupPath)
 	assert_good(pileupOut, pileupPath);
 
 	unsigned numIgnored = 0;
-	for (ContigMap::const_iterator it = g_contigs.begin();
-			it != g_contigs.end(); ++it) {
-		const ContigCount& contig = it->second;
-		unsigned seqLength = it->second.counts.size();
+	for (ContigMap::const_iterator it = g_contigIDs.begin();
+			it != g_contigIDs.end(); ++it) {
+		const ContigCount& contig = g_contigs[it->second];
+		unsigned seqLength = contig.length;
 
 		Sequence outSeq(seqLength, 'N');
 		unsigned sumBest = 0;
 		unsigned sumSecond = 0;
 		for (unsigned x = 0; x < seqLength; x++) {
 			char c = selectBase(
-					it->second.counts[x], sumBest, sumSecond);
+					contig.counts(x), sumBest, sumSecond);
 			outSeq[x] = islower(contig.seq[x]) ? tolower(c) : c;
 		}
 
@@ -425,15 +468,15 @@ static void consensus(const string& outPath, const string& pileupPath)
 							<< '\t' << contig.seq[i]
 							<< '\t' << nucleotideToColourSpace(
 									outSeq[i], outSeq[i + 1])
-							<< '\t' << contig.counts[i].sum()
-							<< '\t' << contig.counts[i] << '\n';
+							<< '\t' << contig.counts(i).sum()
+							<< '\t' << contig.counts(i) << '\n';
 				else
 					for (unsigned i = 0; i < seqLength; i++)
 						cout << it->first << '\t' << 1+i
 							<< '\t' << contig.seq[i]
 							<< '\t' << outSeq[i]
-							<< '\t' << contig.counts[i].sum()
-							<< '\t' << contig.counts[i] << '\n';
+							<< '\t' << contig.counts(i).sum()
+							<< '\t' << contig.counts(i) << '\n';
 			}
 
 			if (!pileupPath.empty()) {
@@ -443,12 +486,12 @@ static void consensus(const string& outPath, const string& pileupPath)
 								contig.seq[i],
 								nucleotideToColourSpace(
 									outSeq[i], outSeq[i+1]),
-								contig.counts[i]);
+								contig.counts(i));
 				else
 					for (unsigned i = 0; i < seqLength; i++)
 						writePileup(pileupOut, it->first, i,
 								contig.seq[i], outSeq[i],
-								contig.counts[i]);
+								contig.counts(i));
 			}
 		} else if (opt::verbose > 0) {
 			cerr << "warning: Contig " << it->first
@@ -467,6 +510,7 @@ int main(int argc, char** argv)
 		switch (c) {
 			case '?': die = true; break;
 			case 'v': opt::verbose++; break;
+			case 'j': arg >> opt::threads; break;
 			case 'o': arg >> opt::outPath; break;
 			case 'p': arg >> opt::pileupPath; break;
 			case 'V': opt::onlyVariants = true; break;
@@ -502,6 +546,11 @@ int main(int argc, char** argv)
 		exit(EXIT_FAILURE);
 	}
 
+#if _OPENMP
+	if (opt::threads > 0)
+		omp_set_num_threads(opt::threads);
+#endif
+
 	readContigs(argv[optind++]);
 	buildBaseQuality();
 	consensus(opt::outPath, opt::pileupPath);
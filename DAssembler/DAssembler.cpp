@@ -2,6 +2,7 @@
 #include "Uncompress.h"
 #include "UnorderedMap.h"
 #include <algorithm>
+#include <cassert>
 #include <getopt.h>
 #include <iostream>
 #include <map>
@@ -84,21 +85,9 @@ static bool offset_sort(const Overlap& x, const Overlap& y)
 }
 
 /* Calculate the tier overlap between two rotated reads */
-static int tier_overlap(const string& seq1, const string& seq2,
+static int tier_overlap(const RotationView& seq1, const RotationView& seq2,
     bool allow_mismatch = false);
 
-/* From a rotated read, return the original sequence */
-static string original_read_from_rotated_read(
-        const string& rotated_read)
-{
-    size_t dollar_pos = rotated_read.find('$');
-    string orig_seq = rotated_read.substr(
-        dollar_pos+1,rotated_read.size()-dollar_pos) +
-        rotated_read.substr(0,dollar_pos);
-
-    return orig_seq;
-}
-
 /* Struct for holding base counts at a given position */
 struct BaseCount {
     unsigned x[4];
@@ -165,7 +154,16 @@ static float most_common_base_frequency(BaseCount counts)
     
 }
 
-typedef vector<Rotation> Rotations;
+/* Compare a rotation in the sorted list to a rotated read */
+struct RotationLess {
+    const vector<RotatedRead>& rl;
+    RotationLess(const vector<RotatedRead>& rl) : rl(rl) { }
+
+    bool operator()(const Rotation& a, const RotationView& b) const
+    {
+        return rl[a.read].rotation(a.offset) < b;
+    }
+};
 
 // Find all overlaps with the given focal read and call a consensus sequence
 static string find_complex_overlap(const RotatedRead& f,
@@ -177,11 +175,12 @@ static string find_complex_overlap(const RotatedRead& f,
     o.push_back(Overlap(f.seq, 0));
 
     // The pre-pended string to use to seed the search
-    const string& seq1 = '$' + f.seq;
+    RotationView seq1 = f.rotation(f.seq.size());
 
     //Find it in the sorted list - NOTE: if the flank read doesn't correspond
     // to a real read, this iterator will not be used
-    Rotations::const_iterator rt = lower_bound(r.begin(), r.end(), seq1);
+    Rotations::const_iterator rt = lower_bound(r.begin(), r.end(), seq1,
+            RotationLess(rl));
 
     /*
     Continue down the sorted list, checking for other matches
@@ -189,12 +188,14 @@ static string find_complex_overlap(const RotatedRead& f,
     of seq1 in the list
      - otherwise, just start at the beginning
      */
-    for(Rotations::const_iterator st = (seq1 == rt->seq) ? rt+1 : r.begin();
+    bool found = rt != r.end()
+        && seq1 == rl[rt->read].rotation(rt->offset);
+    for(Rotations::const_iterator st = found ? rt+1 : r.begin();
             st != r.end(); ++st)
     {
         // Check for an overlap between the two sequences,
         //  allowing for mismatches
-        const string& seq2 = st->seq;
+        RotationView seq2 = rl[st->read].rotation(st->offset);
         unsigned new_overlap = tier_overlap(seq1, seq2, true);
 
         // Continue if there's no match
@@ -203,8 +204,7 @@ static string find_complex_overlap(const RotatedRead& f,
             continue;
 
         // Add a new overlap object for each appropriate overlap found
-        o.push_back(Overlap(
-            original_read_from_rotated_read(seq2), new_overlap));
+        o.push_back(Overlap(seq2.read(), new_overlap));
     }
 
     // Counters for calculating coverage
@@ -301,14 +301,14 @@ static string find_complex_overlap(const RotatedRead& f,
 }
 
 // Calculate the tier overlap between two reads
-static int tier_overlap(const string& seq1, const string& seq2,
+static int tier_overlap(const RotationView& seq1, const RotationView& seq2,
         bool allow_mismatch)
 {
     assert(seq1 != seq2);
 
     //Find the position of the '$' character in both reads
-    unsigned first_dollar_pos = seq1.find('$');
-    unsigned second_dollar_pos = seq2.find('$');
+    unsigned first_dollar_pos = seq1.dollar_pos();
+    unsigned second_dollar_pos = seq2.dollar_pos();
     unsigned earliest_dollar_pos = first_dollar_pos <= second_dollar_pos ?
         first_dollar_pos : second_dollar_pos;
     unsigned latest_dollar_pos = first_dollar_pos > second_dollar_pos ?
@@ -316,14 +316,13 @@ static int tier_overlap(const string& seq1, const string& seq2,
 
     //If the two strings are equal outside the dollar signs,
     //  return the tier - this is a no-mismatch overlap
-    if( (seq1.substr(0, earliest_dollar_pos) ==
-         seq2.substr(0, earliest_dollar_pos)) &&
-        (seq1.substr(latest_dollar_pos+1,
-        (opt::read_length+1)-latest_dollar_pos+1) ==
-        seq2.substr(latest_dollar_pos+1,
-        (opt::read_length+1)-latest_dollar_pos+1)) ){
-           return latest_dollar_pos - earliest_dollar_pos;
-    }
+    bool equal = seq1.size() == seq2.size();
+    for (unsigned i = 0; equal && i < earliest_dollar_pos; ++i)
+        equal = seq1[i] == seq2[i];
+    for (unsigned i = latest_dollar_pos+1; equal && i < seq1.size(); ++i)
+        equal = seq1[i] == seq2[i];
+    if (equal)
+        return latest_dollar_pos - earliest_dollar_pos;
 
     //Otherwise, if mismatches are allowed, calculate that overlap
     if (allow_mismatch){
@@ -353,39 +352,6 @@ static int tier_overlap(const string& seq1, const string& seq2,
     return 0;
 }
 
-// From a sorted list of RotatedRead objects, generate a sorted
-//  vector of Rotation objects
-// This function generates the main vector we traverse when looking
-//  for simple extensions
-static Rotations generate_rotations_list(
-    const vector<RotatedRead>& read_list)
-{
-    // Each rotation has a sequence (string) and overlap (int)
-    // The overlap refers to the overlap between the current sequence
-    //  and the next sequence in the list
-    Rotations s;
-
-    // For each distinct read, add all the rotations to the overlap list
-    for (vector<RotatedRead>::const_iterator it = read_list.begin();
-            it != read_list.end(); ++it)
-        for(vector<string>::size_type i = 0; i != (*it).rotations.size(); ++i)
-            // Initialize object with sequence
-            s.push_back(Rotation((*it).rotations[i]));
-
-    // Sort the list of rotated reads
-    sort(s.begin(), s.end());
-
-    // Find the 0-mismatch tier overlap between each pair of reads
-    //  in the sorted list
-    for (Rotations::iterator rt = s.begin(); rt != s.end()-1; ++rt)
-        rt->overlap = tier_overlap(rt->seq, rt[1].seq);
-
-    // Define last entry in the list as 0
-    s[s.size()-1].overlap = 0;
-
-    return s;
-}
-
 // Main control flow function
 int main(int argc, char** argv)
 {
@@ -1,21 +1,160 @@
-#include <iostream>
 #include "RotatedRead.h"
-#include "Sequence.h"
+#include "sais.hxx"
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <stdint.h>
 
 using namespace std;
 
 //Constructor
 RotatedRead::RotatedRead(const string& orig_seq, unsigned count)
-	: seq(orig_seq), count(count)
+	: seq(orig_seq), count(count), used(false)
 {
-    // Add all rotations of the read to the object
-    string appended_seq = orig_seq + '$';
-    used = false;
-    for(unsigned int i = 0; i < appended_seq.size(); ++i)
+    // The rotations of the read are not stored: each rotation is
+    // identified by its offset in the read
+}
+
+/* Return the suffix array of the specified text. */
+template <typename index_type>
+static vector<index_type> suffix_array(const vector<unsigned char>& text)
+{
+    vector<index_type> sa(text.size());
+    int status = saisxx(text.begin(), sa.begin(),
+            (index_type)text.size(), (index_type)256);
+    assert(status == 0);
+    (void)status;
+    return sa;
+}
+
+/* Return the rotation that begins at the specified position of the
+ * text, whose reads begin at starts. */
+static Rotation rotation_at(const vector<size_t>& starts, size_t pos)
+{
+    size_t read = upper_bound(starts.begin(), starts.end(), pos)
+        - starts.begin() - 1;
+    return Rotation(read, pos - starts[read]);
+}
+
+/* Sort the rotations of reads of the same length using the suffix
+ * array of the specified text, which is the concatenation of
+ * seq + '$' + seq + '\0' for each read. The first read.size()+1
+ * characters of a suffix that begins in the first copy of a read are
+ * the rotation at that offset. The rotations differ within those
+ * characters, so the suffixes sort in the same order as the
+ * rotations.
+ */
+template <typename index_type>
+static void sort_rotations(const vector<unsigned char>& text,
+        const vector<size_t>& starts,
+        const vector<RotatedRead>& read_list, Rotations& s)
+{
+    vector<index_type> sa = suffix_array<index_type>(text);
+    for (typename vector<index_type>::const_iterator it = sa.begin();
+            it != sa.end(); ++it) {
+        Rotation r = rotation_at(starts, *it);
+        if (r.offset <= read_list[r.read].seq.size())
+            s.push_back(r);
+    }
+}
+
+/* Compare two rotations as strings */
+struct RotationCompare {
+    const vector<RotatedRead>& rl;
+    RotationCompare(const vector<RotatedRead>& rl) : rl(rl) { }
+
+    bool operator()(const Rotation& a, const Rotation& b) const
     {
-        string rotated_read = appended_seq.substr(i,(appended_seq.size()-i)) +
-         appended_seq.substr(0,i);
-        rotations.push_back(rotated_read);
+        return rl[a.read].rotation(a.offset)
+            < rl[b.read].rotation(b.offset);
     }
-    
+};
+
+/* Return whether two rotations begin with the same characters up to
+ * and including their '$'. */
+static bool same_prefix(const vector<RotatedRead>& rl,
+        const Rotation& a, const Rotation& b)
+{
+    const string& x = rl[a.read].seq;
+    const string& y = rl[b.read].seq;
+    return x.size() - a.offset == y.size() - b.offset
+        && equal(x.begin() + a.offset, x.end(), y.begin() + b.offset);
+}
+
+/* Sort the rotations of reads of different lengths using the suffix
+ * array of the specified text, which is the concatenation of
+ * seq + '$' for each read. Each position of the text is the rotation
+ * at that offset of its read. A suffix and its rotation agree up to
+ * and including the '$', which sorts before every base, so the
+ * rotations that differ before their '$' are in order. The runs of
+ * rotations that are equal up to their '$' are then sorted by
+ * comparing the rotations, which differ only after the '$'.
+ */
+template <typename index_type>
+static void sort_rotations_by_prefix(const vector<unsigned char>& text,
+        const vector<size_t>& starts,
+        const vector<RotatedRead>& read_list, Rotations& s)
+{
+    vector<index_type> sa = suffix_array<index_type>(text);
+    for (typename vector<index_type>::const_iterator it = sa.begin();
+            it != sa.end(); ++it)
+        s.push_back(rotation_at(starts, *it));
+
+    RotationCompare compare(read_list);
+    for (Rotations::iterator first = s.begin(); first != s.end();) {
+        Rotations::iterator last = first + 1;
+        while (last != s.end() && same_prefix(read_list, *first, *last))
+            ++last;
+        if (last - first > 1)
+            sort(first, last, compare);
+        first = last;
+    }
+}
+
+// From a sorted list of RotatedRead objects, generate a sorted
+//  vector of Rotation objects
+// This function generates the main vector we traverse when looking
+//  for simple extensions
+Rotations generate_rotations_list(const vector<RotatedRead>& read_list)
+{
+    // Each rotation is identified by its read and its offset in that
+    //  read, and the rotations are sorted by a suffix array of the
+    //  reads, without storing the rotated sequences
+    bool same_length = true;
+    size_t num_rotations = 0;
+    for (vector<RotatedRead>::const_iterator it = read_list.begin();
+            it != read_list.end(); ++it) {
+        num_rotations += it->seq.size() + 1;
+        same_length = same_length
+            && it->seq.size() == read_list.front().seq.size();
+    }
+
+    vector<unsigned char> text;
+    vector<size_t> starts;
+    text.reserve(same_length ? 2 * num_rotations : num_rotations);
+    starts.reserve(read_list.size());
+    for (vector<RotatedRead>::const_iterator it = read_list.begin();
+            it != read_list.end(); ++it) {
+        starts.push_back(text.size());
+        text.insert(text.end(), it->seq.begin(), it->seq.end());
+        text.push_back('$');
+        if (same_length) {
+            text.insert(text.end(), it->seq.begin(), it->seq.end());
+            text.push_back('\0');
+        }
+    }
+
+    Rotations s;
+    s.reserve(num_rotations);
+    bool small = text.size() < (size_t)numeric_limits<int32_t>::max();
+    if (same_length && small)
+        sort_rotations<int32_t>(text, starts, read_list, s);
+    else if (same_length)
+        sort_rotations<int64_t>(text, starts, read_list, s);
+    else if (small)
+        sort_rotations_by_prefix<int32_t>(text, starts, read_list, s);
+    else
+        sort_rotations_by_prefix<int64_t>(text, starts, read_list, s);
+    assert(s.size() == num_rotations);
+    return s;
 }
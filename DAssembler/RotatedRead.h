@@ -1,6 +1,7 @@
 #ifndef ROTATEDREAD_H
 #define ROTATEDREAD_H 1
 
+#include "Rotation.h"
 #include <string>
 #include <vector>
 
@@ -16,11 +17,20 @@ class RotatedRead{
       {
           return seq == x.seq;
       }
-      
+
+      /** Return the rotation of this read and a terminal '$' that
+       * begins at the specified offset. */
+      RotationView rotation(unsigned offset) const
+      {
+          return RotationView(seq, offset);
+      }
+
       std::string seq;
-      std::vector<std::string> rotations;
       unsigned count;
       bool used;
 };
 
+Rotations generate_rotations_list(
+        const std::vector<RotatedRead>& read_list);
+
 #endif //ROTATEDREAD_H
@@ -1,29 +1,77 @@
 #ifndef ROTATION_H
 #define ROTATION_H 1
 
+#include <algorithm>
+#include <cstddef>
+#include <stdint.h>
 #include <string>
 #include <vector>
 
-using namespace std;
+/** A rotation of a read terminated by '$'. The rotation is not
+ * stored. It is the index of the read and the offset at which the
+ * rotation begins.
+ */
+struct Rotation {
+    uint32_t read;
+    uint32_t offset;
 
-class Rotation {
-  
+    Rotation(uint32_t read, uint32_t offset)
+        : read(read), offset(offset) { }
+};
+
+typedef std::vector<Rotation> Rotations;
+
+/** A view of the rotation of seq + '$' that begins at offset. */
+class RotationView {
   public:
-      Rotation(const string& orig_seq)
-		  : seq(orig_seq), overlap(0) { }
-      
-      bool operator <(const Rotation& x) const
+      RotationView(const std::string& seq, unsigned offset)
+          : m_seq(seq), m_offset(offset) { }
+
+      /** Return the length of the rotation, including the '$'. */
+      size_t size() const { return m_seq.size() + 1; }
+
+      /** Return the position of the '$' in the rotation. */
+      size_t dollar_pos() const { return m_seq.size() - m_offset; }
+
+      /** Return the original read. */
+      const std::string& read() const { return m_seq; }
+
+      char operator[](size_t i) const
       {
-            return seq < x.seq;
+          size_t j = m_offset + i;
+          if (j > m_seq.size())
+              j -= m_seq.size() + 1;
+          return j == m_seq.size() ? '$' : m_seq[j];
       }
-      bool operator ==(const Rotation& x) const
+
+      /** Compare two rotations as strings. */
+      int compare(const RotationView& x) const
       {
-            return seq == x.seq;
+          size_t n = std::min(size(), x.size());
+          for (size_t i = 0; i < n; ++i) {
+              unsigned char a = (*this)[i], b = x[i];
+              if (a != b)
+                  return a < b ? -1 : 1;
+          }
+          return size() < x.size() ? -1 : size() > x.size() ? 1 : 0;
       }
-       
-      string seq;
-      unsigned overlap;  
-};
 
+      bool operator <(const RotationView& x) const
+      {
+          return compare(x) < 0;
+      }
+      bool operator ==(const RotationView& x) const
+      {
+          return compare(x) == 0;
+      }
+      bool operator !=(const RotationView& x) const
+      {
+          return compare(x) != 0;
+      }
+
+  private:
+      const std::string& m_seq;
+      unsigned m_offset;
+};
 
 #endif //ROTATION_H
@@ -58,8 +58,53 @@ FastaReader::FastaReader(const char* path, int flags, int len)
 			"file is empty\n";
 }
 
-/** Split the fasta file into nsections and seek to the start
- * of section. */
+/** Return the position of the first record that starts at or after
+ * pos, or the end of the file if there is none.
+ * @param format '>' for FASTA, '@' for FASTQ, and otherwise one record
+ * per line
+ */
+streampos FastaReader::nextRecord(streampos pos, int format)
+{
+	if (pos == streampos(0))
+		return pos;
+	m_in.clear();
+	m_in.seekg(pos - streamoff(1));
+	m_in.ignore(numeric_limits<streamsize>::max(), '\n');
+	for (string line;;) {
+		streampos p = m_in.tellg();
+		if (!std::getline(m_in, line))
+			break;
+		if (line.empty())
+			continue;
+		if (format == '>') {
+			if (line[0] == '>')
+				return p;
+		} else if (format == '@') {
+			// The header of a FASTQ record is followed by its sequence
+			// and then a line starting with '+', whereas a quality
+			// string starting with '@' is followed by a sequence.
+			if (line[0] != '@')
+				continue;
+			streampos next = m_in.tellg();
+			string seq, plus;
+			if (std::getline(m_in, seq) && std::getline(m_in, plus)
+					&& !plus.empty() && plus[0] == '+')
+				return p;
+			m_in.clear();
+			m_in.seekg(next);
+		} else if (line[0] != '@' && line[0] != '#')
+			return p;
+	}
+	m_in.clear();
+	m_in.seekg(0, ios::end);
+	return m_in.tellg();
+}
+
+/** Split the file into nsections of roughly equal size and seek to
+ * the start of section, numbered from 1. Each section contains the
+ * records that start within it. The file may be FASTA, FASTQ, or a
+ * format with one record per line, such as SAM.
+ */
 void FastaReader::split(unsigned section, unsigned nsections)
 {
 	assert(nsections >= section);
@@ -67,30 +112,28 @@ void FastaReader::split(unsigned section, unsigned nsections)
 	assert(strcmp(m_path, "-") != 0);
 	if (nsections == 1)
 		return;
-	// Move the get pointer to the first entry in this section and
-	// update the m_end if there is more than one section.
+
+	// Determine the format from the first record.
+	string line;
+	std::getline(m_in, line);
+	int format = line.empty() ? '>' : line[0];
+	if (format == '@' && line.size() > 3 && isalpha(line[1])
+			&& isalpha(line[2]) && line[3] == '\t')
+		format = '\t'; // SAM header
+	else if (format != '>' && format != '@')
+		format = '\n';
+
+	m_in.clear();
 	m_in.seekg(0, ios::end);
-	streampos length = m_in.tellg();
+	streamoff length = m_in.tellg();
 	assert(length > 0);
-	streampos start = length * (section - 1) / nsections;
-	streampos end = length * section / nsections;
-	assert(end > 0);
-	if (end < length) {
-		m_in.seekg(end);
-		if (m_in.peek() == '>')
-			end += 1;
-	}
-	m_end = end;
+	streamoff start = length * (section - 1) / nsections;
+	streamoff end = length * section / nsections;
+	if (end < length)
+		m_end = nextRecord(end, format);
+	start = nextRecord(start, format);
+	m_in.clear();
 	m_in.seekg(start);
-	if (start > 0) {
-		m_in.ignore(numeric_limits<streamsize>::max(), '\n');
-		m_in.ignore(numeric_limits<streamsize>::max(), '>');
-		if (m_in.peek() == EOF)
-			cerr << m_path << ':' << section << ": warning: "
-				"there are no contigs in this section\n";
-		m_in.putback('>');
-	}
-	assert(m_end > 0);
 	assert(m_in.good());
 }
 
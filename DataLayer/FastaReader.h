@@ -38,8 +38,8 @@ class FastaReader {
 		Sequence read(std::string& id, std::string& comment,
 				char& anchor, std::string& qual);
 
-		/** Split the fasta file into nsections and seek to the start
-		 * of section. */
+		/** Split the file into nsections and seek to the start of
+		 * section, numbered from 1. */
 		void split(unsigned section, unsigned nsections);
 
 		/** Return whether this stream is at end-of-file. */
@@ -95,6 +95,7 @@ class FastaReader {
 			return m_in;
 		}
 
+		std::streampos nextRecord(std::streampos pos, int format);
 		std::ostream& die();
 		bool isChaste(const std::string& s, const std::string& line);
 		void checkSeqQual(const std::string& s, const std::string& q);
@@ -0,0 +1,306 @@
+#include "DataLayer/FastaStore.h"
+#include "Common/Options.h"
+#include "DataLayer/FastaReader.h"
+#include "DataLayer/Options.h"
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+/** Return the complement of the specified base. */
+char FastaStore::View::complement(char c)
+{
+	return opt::colourSpace ? c : complementBaseChar(c);
+}
+
+/** Append at most n bases starting at pos to s. */
+void FastaStore::View::appendTo(Sequence& s, size_t pos, size_t n) const
+{
+	assert(pos <= m_size);
+	n = min(n, m_size - pos);
+	size_t first = s.size();
+	if (!m_rc) {
+		s.append(m_data + pos, n);
+	} else {
+		s.resize(first + n);
+		const char* p = m_data + m_size - pos;
+		for (size_t i = first; i < first + n; ++i)
+			s[i] = complement(*--p);
+	}
+	if (m_foldCase)
+		transform(s.begin() + first, s.end(), s.begin() + first,
+				::toupper);
+}
+
+ostream& operator<<(ostream& out, const FastaStore::View& o)
+{
+	if (!o.m_rc && !o.m_foldCase)
+		return out.write(o.m_data, o.m_size);
+	const size_t chunk = 65536;
+	Sequence s;
+	for (size_t pos = 0; pos < o.m_size; pos += chunk) {
+		s.clear();
+		o.appendTo(s, pos, chunk);
+		out << s;
+	}
+	return out;
+}
+
+FastaStore::FastaStore(const char* path, int flags)
+	: m_map(NULL), m_mapSize(0),
+	m_foldCase(~flags & NO_FOLD_CASE)
+{
+	if (map(path)) {
+		if (readIndex(string(path) + ".fai") || scan())
+			return;
+		unmap();
+	}
+	read(path);
+}
+
+FastaStore::~FastaStore()
+{
+	unmap();
+}
+
+/** Memory map the specified file if it is a regular file.
+ * @return whether the file was mapped
+ */
+bool FastaStore::map(const char* path)
+{
+	if (strcmp(path, "-") == 0)
+		return false;
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)
+			|| st.st_size == 0) {
+		close(fd);
+		return false;
+	}
+	void* p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED)
+		return false;
+	m_map = static_cast<const char*>(p);
+	m_mapSize = st.st_size;
+	return true;
+}
+
+void FastaStore::unmap()
+{
+	if (m_map != NULL)
+		munmap(const_cast<char*>(m_map), m_mapSize);
+	m_map = NULL;
+	m_mapSize = 0;
+	m_records.clear();
+}
+
+/** Skip white space, stopping at the end of the line. */
+static inline const char* skipSpace(const char* p, const char* end)
+{
+	while (p < end && *p != '\n' && isspace(*p))
+		++p;
+	return p;
+}
+
+/** Return the end of the line starting at p. */
+static inline const char* endOfLine(const char* p, const char* end)
+{
+	const char* eol = static_cast<const char*>(
+			memchr(p, '\n', end - p));
+	return eol == NULL ? end : eol;
+}
+
+/** Return whether the sequence s of length n is in colour space. */
+static bool isColourSpace(const char* s, size_t n)
+{
+	for (size_t i = 1; i < n; ++i) {
+		if (strchr("ACGTacgt", s[i]) != NULL)
+			return false;
+		if (strchr("0123", s[i]) != NULL)
+			return true;
+	}
+	return false;
+}
+
+/** Add a record located in the memory-mapped file.
+ * @return false if the record must be parsed by FastaReader
+ */
+bool FastaStore::addRecord(size_t header, size_t seq, size_t size)
+{
+	const char* end = m_map + m_mapSize;
+	const char* s = m_map + seq;
+	if (size == 0 || s[size - 1] == '\r' || s[-1] != '\n'
+			|| s[-2] == '\r')
+		return false;
+
+	// A Casava-style comment may affect the ID.
+	const char* p = skipSpace(m_map + header, end);
+	while (p < end && !isspace(*p))
+		++p;
+	p = skipSpace(p, end);
+	size_t commentLength = (s - 1) - p;
+	if (commentLength > 3 && p[1] == ':' && p[3] == ':')
+		return false;
+
+	bool colourSpace = isColourSpace(s, size);
+	if (colourSpace && !isdigit(s[0])) {
+		// A colour-space primer base is removed by FastaReader.
+		return false;
+	}
+
+	if (opt::trimMasked && !colourSpace) {
+		// Removed masked (lower case) sequence at the beginning and
+		// end of the sequence.
+		size_t trimFront = 0;
+		while (trimFront < size && islower(s[trimFront]))
+			trimFront++;
+		size_t trimBack = size;
+		while (trimBack > trimFront && islower(s[trimBack - 1]))
+			trimBack--;
+		seq += trimFront;
+		size = trimBack - trimFront;
+	}
+
+	Record r = { header, seq, size };
+	m_records.push_back(r);
+	return true;
+}
+
+/** Index the records of the memory-mapped file using its FASTA index
+ * (.fai) file, which was written by `abyss-fac' or `samtools faidx'.
+ * The index is used only if it describes every record of the file,
+ * each on a single line.
+ * @return whether the index was used
+ */
+bool FastaStore::readIndex(const string& faiPath)
+{
+	assert(m_map != NULL);
+	assert(m_records.empty());
+	ifstream in(faiPath.c_str());
+	if (!in)
+		return false;
+
+	const char* end = m_map + m_mapSize;
+	size_t pos = 0;
+	string line;
+	while (getline(in, line)) {
+		istringstream ss(line);
+		string id;
+		size_t size, offset, lineLen, lineBinLen;
+		if (!(ss >> id >> size >> offset >> lineLen >> lineBinLen)
+				|| lineLen != size || offset <= pos
+				|| offset + size > m_mapSize
+				|| m_map[pos] != '>'
+				|| (offset + size < m_mapSize
+					&& m_map[offset + size] != '\n')) {
+			m_records.clear();
+			return false;
+		}
+
+		// The header must immediately precede the sequence.
+		size_t header = pos + 1;
+		if (endOfLine(m_map + header, end) != m_map + offset - 1
+				|| !addRecord(header, offset, size)
+				|| this->id(m_records.size() - 1) != id) {
+			m_records.clear();
+			return false;
+		}
+		pos = offset + size + 1;
+	}
+	if (pos < m_mapSize) {
+		m_records.clear();
+		return false;
+	}
+	return true;
+}
+
+/** Index the records of the memory-mapped file by scanning it.
+ * @return false if the file must be parsed by FastaReader
+ */
+bool FastaStore::scan()
+{
+	assert(m_map != NULL);
+	assert(m_records.empty());
+	const char* end = m_map + m_mapSize;
+	for (const char* p = m_map; p < end;) {
+		if (*p != '>') {
+			m_records.clear();
+			return false;
+		}
+		const char* eol = endOfLine(p, end);
+		if (eol == end) {
+			m_records.clear();
+			return false;
+		}
+		const char* seq = eol + 1;
+		const char* seqEnd = endOfLine(seq, end);
+		if (!addRecord(p + 1 - m_map, seq - m_map, seqEnd - seq)) {
+			m_records.clear();
+			return false;
+		}
+		if (seqEnd == end)
+			break;
+		p = seqEnd + 1;
+	}
+	return true;
+}
+
+/** Read the records of the specified file into memory. */
+void FastaStore::read(const char* path)
+{
+	assert(m_map == NULL);
+	FastaReader in(path, m_foldCase ? FastaReader::FOLD_CASE
+			: FastaReader::NO_FOLD_CASE);
+	for (FastaRecord rec; in >> rec;) {
+		m_buffer += '>';
+		size_t header = m_buffer.size();
+		m_buffer += rec.id;
+		if (!rec.comment.empty()) {
+			m_buffer += ' ';
+			m_buffer += rec.comment;
+		}
+		m_buffer += '\n';
+		Record r = { header, m_buffer.size(), rec.seq.size() };
+		m_records.push_back(r);
+		m_buffer += rec.seq;
+		m_buffer += '\n';
+	}
+	assert(in.eof());
+}
+
+/** Return the identifier of record i. */
+string FastaStore::id(size_t i) const
+{
+	assert(i < m_records.size());
+	const Record& r = m_records[i];
+	const char* end = data() + r.seq;
+	const char* p = skipSpace(data() + r.header, end);
+	const char* q = p;
+	while (q < end && !isspace(*q))
+		++q;
+	return string(p, q);
+}
+
+/** Return the comment of record i. */
+string FastaStore::comment(size_t i) const
+{
+	assert(i < m_records.size());
+	const Record& r = m_records[i];
+	const char* end = endOfLine(data() + r.header, data() + r.seq);
+	const char* p = skipSpace(data() + r.header, end);
+	while (p < end && !isspace(*p))
+		++p;
+	p = skipSpace(p, end);
+	return string(p, end);
+}
@@ -0,0 +1,179 @@
+#ifndef FASTASTORE_H
+#define FASTASTORE_H 1
+
+#include "Common/Sequence.h"
+#include <cassert>
+#include <cctype>
+#include <cstddef>
+#include <iterator>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/** Random access to the sequences of a FASTA file.
+ * A regular file of single-line FASTA records, such as the contigs
+ * written by ABySS, is memory mapped and indexed in place, using its
+ * .fai index when one is present and up to date. A sequence is then
+ * read from the file only when it is used, and its reverse
+ * complement is computed as it is read rather than stored. Any other
+ * input, such as a pipe or a multi-line FASTA file, is read into
+ * memory using FastaReader.
+ */
+class FastaStore
+{
+  public:
+	enum {
+		/** Fold lower-case characters to upper-case. */
+		FOLD_CASE = 0, NO_FOLD_CASE = 1,
+	};
+
+	/** A read-only view of a sequence of this store, which is
+	 * optionally reverse complemented. */
+	class View
+	{
+	  public:
+		class const_iterator
+			: public std::iterator<std::forward_iterator_tag, char>
+		{
+		  public:
+			const_iterator(const View& view, size_t i)
+				: m_view(&view), m_i(i) { }
+			char operator*() const { return (*m_view)[m_i]; }
+			const_iterator& operator++() { ++m_i; return *this; }
+			const_iterator operator++(int)
+			{
+				const_iterator it = *this;
+				++m_i;
+				return it;
+			}
+			bool operator==(const const_iterator& it) const
+			{
+				return m_i == it.m_i;
+			}
+			bool operator!=(const const_iterator& it) const
+			{
+				return m_i != it.m_i;
+			}
+		  private:
+			const View* m_view;
+			size_t m_i;
+		};
+
+		View(const char* data, size_t size, bool rc, bool foldCase)
+			: m_data(data), m_size(size), m_rc(rc),
+			m_foldCase(foldCase) { }
+
+		size_t size() const { return m_size; }
+		size_t length() const { return m_size; }
+		bool empty() const { return m_size == 0; }
+
+		const_iterator begin() const { return const_iterator(*this, 0); }
+		const_iterator end() const
+		{
+			return const_iterator(*this, m_size);
+		}
+
+		/** Return the base at position i. */
+		char operator[](size_t i) const
+		{
+			assert(i < m_size);
+			char c = m_rc ? complement(m_data[m_size - 1 - i])
+				: m_data[i];
+			return m_foldCase ? toupper(c) : c;
+		}
+
+		/** Append at most n bases starting at pos to s. */
+		void appendTo(Sequence& s,
+				size_t pos = 0, size_t n = std::string::npos) const;
+
+		/** Return at most n bases starting at pos. */
+		Sequence substr(size_t pos = 0,
+				size_t n = std::string::npos) const
+		{
+			Sequence s;
+			appendTo(s, pos, n);
+			return s;
+		}
+
+		/** Return a copy of this sequence. */
+		Sequence str() const { return substr(); }
+		operator Sequence() const { return str(); }
+
+		friend std::ostream& operator<<(std::ostream& out,
+				const View& o);
+
+	  private:
+		static char complement(char c);
+
+		const char* m_data;
+		size_t m_size;
+		bool m_rc;
+		bool m_foldCase;
+	};
+
+	FastaStore(const char* path, int flags = FOLD_CASE);
+	~FastaStore();
+
+	/** Return the number of records. */
+	size_t size() const { return m_records.size(); }
+
+	/** Return whether the file is memory mapped. */
+	bool mapped() const { return m_map != NULL; }
+
+	/** Return the identifier of record i. */
+	std::string id(size_t i) const;
+
+	/** Return the comment of record i. */
+	std::string comment(size_t i) const;
+
+	/** Return the length of the sequence of record i. */
+	size_t length(size_t i) const
+	{
+		assert(i < m_records.size());
+		return m_records[i].size;
+	}
+
+	/** Return the sequence of record i, reverse complemented if rc
+	 * is true. */
+	View sequence(size_t i, bool rc = false) const
+	{
+		assert(i < m_records.size());
+		const Record& r = m_records[i];
+		return View(data() + r.seq, r.size, rc,
+				m_foldCase && m_map != NULL);
+	}
+
+  private:
+	FastaStore(const FastaStore&);
+	FastaStore& operator=(const FastaStore&);
+
+	/** The location of a record in the file. */
+	struct Record {
+		/** The offset of the header, excluding the '>'. */
+		size_t header;
+		/** The offset of the sequence. */
+		size_t seq;
+		/** The length of the sequence. */
+		size_t size;
+	};
+
+	const char* data() const
+	{
+		return m_map != NULL ? m_map : m_buffer.data();
+	}
+
+	bool map(const char* path);
+	void unmap();
+	bool readIndex(const std::string& path);
+	bool scan();
+	bool addRecord(size_t header, size_t seq, size_t size);
+	void read(const char* path);
+
+	const char* m_map;
+	size_t m_mapSize;
+	std::string m_buffer;
+	bool m_foldCase;
+	std::vector<Record> m_records;
+};
+
+#endif
@@ -9,9 +9,17 @@
 #include "DataLayer/FastaReader.h"
 #include "DataLayer/Options.h"
 #include <algorithm>
+#include <cstring>
+#include <fstream>
 #include <getopt.h>
 #include <iostream>
 #include <sstream>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+#if _OPENMP
+# include <omp.h>
+#endif
 
 using namespace std;
 
@@ -42,6 +50,7 @@ static const char USAGE_MESSAGE[] =
 "                          of sequences [default]\n"
 "      --count-ambig       count ambiguity codes in sequences\n"
 "      --no-count-ambig    do not count ambiguity codes in sequences [default]\n"
+"      --threads=N         read N files in parallel [1]\n"
 "  -v, --verbose           display verbose output\n"
 "      --help              display this help and exit\n"
 "      --version           output version information and exit\n"
@@ -55,12 +64,13 @@ namespace opt {
 	static int format;
 	static int verbose;
 	static int countAmbig;
+	static int threads = 1;
 }
 enum { TAB, JIRA, MMD };
 
 static const char shortopts[] = "d:e:G:jms:t:v";
 
-enum { OPT_HELP = 1, OPT_VERSION };
+enum { OPT_HELP = 1, OPT_VERSION, OPT_THREADS };
 
 static const struct option longopts[] = {
 	{ "genome-size", required_argument, NULL, 'G' },
@@ -74,6 +84,7 @@ static const struct option longopts[] = {
 	{ "no-trim-masked", no_argument, &opt::trimMasked, 0 },
 	{ "count-ambig", no_argument, &opt::countAmbig, 1 },
 	{ "no-count-ambig", no_argument, &opt::countAmbig, 0 },
+	{ "threads", required_argument, NULL, OPT_THREADS },
 	{ "help", no_argument, NULL, OPT_HELP },
 	{ "version", no_argument, NULL, OPT_VERSION },
 	{ NULL, 0, NULL, 0 }
@@ -82,8 +93,196 @@ static const struct option longopts[] = {
 /** FastaReader flags. */
 static const int FASTAREADER_FLAGS = FastaReader::NO_FOLD_CASE;
 
+/** The lengths of the sequences of a file. */
+typedef vector<unsigned> Lengths;
+
+/** Return the modification time of the specified file, or -1 if it
+ * does not exist. */
+static time_t modificationTime(const string& path)
+{
+	struct stat st;
+	return stat(path.c_str(), &st) == 0 ? st.st_mtime : -1;
+}
+
+/** Read the lengths of the sequences from the FASTA index PATH.fai,
+ * if it exists and is not older than PATH.
+ * @return whether the index was used, or false if it is malformed
+ */
+static bool readFastaIndex(const string& path, Lengths& lengths)
+{
+	// The index records the total length of each sequence, which is
+	// what is counted only with --count-ambig.
+	if (!opt::countAmbig || opt::trimMasked)
+		return false;
+	string faiPath = path + ".fai";
+	time_t faiTime = modificationTime(faiPath);
+	if (faiTime < 0 || faiTime < modificationTime(path))
+		return false;
+
+	ifstream in(faiPath.c_str());
+	if (!in || in.peek() == EOF)
+		return false;
+	if (opt::verbose > 0)
+#pragma omp critical(cerr)
+		cerr << "Reading `" << faiPath << "'...\n";
+	// Read only the name and length of each record. FastaIndex
+	// accepts only an index of single-line records.
+	for (string line; getline(in, line);) {
+		istringstream ss(line);
+		string id;
+		unsigned size;
+		if (!(ss >> id >> size))
+			return false;
+		lengths.push_back(size);
+	}
+	return in.eof();
+}
+
+/** Count the ACGT and the colour-space characters of a line. */
+static inline void countLine(const char* first, const char* last,
+		size_t& acgt, size_t& colour)
+{
+	size_t n = 0, m = 0;
+	for (const char* p = first; p != last; ++p) {
+		unsigned char c = *p | 0x20; // fold case
+		n += (c == 'a') | (c == 'c') | (c == 'g') | (c == 't');
+		m += (unsigned char)(*p - '0') < 4;
+	}
+	acgt += n;
+	colour += m;
+}
+
+/** Count the lengths of the sequences of a FASTA file by scanning
+ * large blocks of the file, without parsing records.
+ * @return false if the file has a feature that is handled only by
+ * FastaReader, such as a record that is not FASTA, a colour-space
+ * sequence, a Casava comment, a comment line, an empty sequence or
+ * an empty file
+ */
+static bool scanFasta(const string& path, Lengths& lengths)
+{
+	if (opt::trimMasked)
+		return false;
+	UncompressReader in(path.c_str());
+	if (!in.good())
+		return false;
+	if (opt::verbose > 0)
+#pragma omp critical(cerr)
+		cerr << "Reading `" << path << "'...\n";
+
+	enum { LINE_START, HEADER, SEQUENCE } state = LINE_START;
+	bool inRecord = false, good = true;
+	string header;
+	size_t length = 0, colour = 0, lineLength = 0;
+	char last = '\n';
+	const char* p;
+	for (size_t n; good && in.read(p, n);) {
+		const char* end = p + n;
+		while (p != end && good) {
+			if (state == LINE_START) {
+				if (*p == '>') {
+					if (inRecord) {
+						if (length == 0 && colour == 0
+								&& lineLength == 0) {
+							// An empty sequence.
+							good = false;
+							break;
+						}
+						lengths.push_back(length);
+					}
+					inRecord = true;
+					length = colour = lineLength = 0;
+					header.clear();
+					state = HEADER;
+					++p;
+					continue;
+				} else if (*p == '#' || !inRecord) {
+					good = false;
+					break;
+				}
+				state = SEQUENCE;
+			}
+
+			const char* eol = (const char*)memchr(p, '\n', end - p);
+			const char* q = eol == NULL ? end : eol;
+			if (state == HEADER) {
+				header.append(p, q);
+			} else if (q != p) {
+				size_t acgt = 0;
+				countLine(p, q, acgt, colour);
+				length += opt::countAmbig ? q - p : acgt;
+				lineLength += q - p;
+				last = q[-1];
+			}
+			if (eol == NULL) {
+				p = end;
+				continue;
+			}
+
+			if (state == HEADER) {
+				// Check for a Casava comment, 1:Y:0:AAAAAA.
+				size_t i = header.find_first_not_of(" \t");
+				if (i != string::npos)
+					i = header.find_first_of(" \t", i);
+				if (i != string::npos)
+					i = header.find_first_not_of(" \t\r", i);
+				if (i != string::npos && header.size() - i > 3
+						&& header[i + 1] == ':' && header[i + 3] == ':')
+					good = false;
+			} else if (last == '\r') {
+				// Discard the carriage return of a DOS line ending.
+				if (opt::countAmbig)
+					length--;
+				lineLength--;
+			}
+			last = '\n';
+			state = LINE_START;
+			p = eol + 1;
+		}
+	}
+	if (last == '\r') {
+		// Discard the carriage return of a last line that has no
+		// newline.
+		if (opt::countAmbig)
+			length--;
+		lineLength--;
+	}
+	// Let FastaReader warn about an empty file.
+	if (!good || colour > 0 || !inRecord)
+		return false;
+	if (length == 0 && lineLength == 0)
+		return false;
+	lengths.push_back(length);
+	return true;
+}
+
+/** Read the lengths of the sequences of a file using FastaReader. */
+static void readSequences(const char* path, Lengths& lengths)
+{
+	FastaReader in(path, FASTAREADER_FLAGS);
+	for (string s; in >> s;)
+		lengths.push_back(opt::countAmbig ? s.length() :
+				count_if(s.begin(), s.end(), isACGT));
+	assert(in.eof());
+}
+
+/** Return the histogram of the specified lengths. */
+static Histogram toHistogram(Lengths& lengths)
+{
+	sort(lengths.begin(), lengths.end());
+	Histogram h;
+	for (size_t i = 0, j; i < lengths.size(); i = j) {
+		for (j = i + 1; j < lengths.size()
+				&& lengths[j] == lengths[i]; ++j)
+			;
+		h.insert(lengths[i], j - i);
+	}
+	return h;
+}
+
 /** Print contiguity statistics. */
-static void printContiguityStatistics(const char* path)
+static void printContiguityStatistics(const char* path,
+		Lengths& lengths)
 {
 	static bool printHeader = true;
 	if (string(path) == "---") {
@@ -92,14 +291,8 @@ static void printContiguityStatistics(const char* path)
 		printHeader = true;
 		return;
 	}
-
-	// Read the sequences and count the lengths.
-	Histogram h;
-	FastaReader in(path, FASTAREADER_FLAGS);
-	for (string s; in >> s;)
-		h.insert(opt::countAmbig ? s.length() :
-				count_if(s.begin(), s.end(), isACGT));
-	assert(in.eof());
+	Histogram h = toHistogram(lengths);
+	Lengths().swap(lengths);
 
 	// Print the table header.
 	if (opt::format == JIRA && printHeader) {
@@ -203,6 +396,9 @@ int main(int argc, char** argv)
 		  case 'v':
 			opt::verbose++;
 			break;
+		  case OPT_THREADS:
+			arg >> opt::threads;
+			break;
 		  case OPT_HELP:
 			cout << USAGE_MESSAGE;
 			exit(EXIT_SUCCESS);
@@ -222,11 +418,39 @@ int main(int argc, char** argv)
 		exit(EXIT_FAILURE);
 	}
 
-	if (optind == argc)
-		printContiguityStatistics("-");
-	else
-		for_each(argv + optind, argv + argc,
-				printContiguityStatistics);
+#if _OPENMP
+	if (opt::threads > 0)
+		omp_set_num_threads(opt::threads);
+#endif
+
+	vector<const char*> paths(argv + optind, argv + argc);
+	if (paths.empty())
+		paths.push_back("-");
+
+	// Count the lengths of the sequences of the files in parallel,
+	// using a FASTA index if one exists.
+	vector<Lengths> lengths(paths.size());
+	vector<char> done(paths.size());
+#pragma omp parallel for schedule(dynamic, 1)
+	for (long i = 0; i < (long)paths.size(); ++i) {
+		string path(paths[i]);
+		if (path == "-" || path == "---")
+			continue;
+		done[i] = readFastaIndex(path, lengths[i]);
+		if (!done[i]) {
+			lengths[i].clear();
+			done[i] = scanFasta(path, lengths[i]);
+		}
+		if (!done[i])
+			lengths[i].clear();
+	}
+
+	// Fall back to FastaReader for any other input.
+	for (size_t i = 0; i < paths.size(); ++i) {
+		if (!done[i] && string(paths[i]) != "---")
+			readSequences(paths[i], lengths[i]);
+		printContiguityStatistics(paths[i], lengths[i]);
+	}
 
 	cout.flush();
 	assert_good(cout, "stdout");
@@ -2,10 +2,16 @@
 #include "Histogram.h"
 #include "IOUtil.h"
 #include "MLE.h"
+#include "OrderedPipeline.h"
 #include "PMF.h"
 #include "SAM.h"
+#include "Sequence.h"
 #include "Uncompress.h"
+#include "UnorderedMap.h"
+#include "DataLayer/FastaInterleave.h"
+#include "DataLayer/Options.h"
 #include "Graph/Options.h" // for opt::k
+#include "Map/Mapper.h"
 #include <algorithm>
 #include <cassert>
 #include <climits>
@@ -37,12 +43,18 @@ PROGRAM " (" PACKAGE_NAME ") " VERSION "\n"
 
 static const char USAGE_MESSAGE[] =
 "Usage: " PROGRAM " -k<kmer> -s<seed-length> -n<npairs> [OPTION]... HIST [PAIR]\n"
+"  or:  " PROGRAM " -k<kmer> -s<seed-length> -n<npairs> [OPTION]... --map HIST QUERY... TARGET\n"
 "Estimate distances between contigs using paired-end alignments.\n"
+"With --map, map the read pairs of QUERY to TARGET, write the\n"
+"distribution of fragment sizes to HIST and estimate distances\n"
+"without writing the alignments.\n"
 "\n"
 " Arguments:\n"
 "\n"
-"  HIST  distribution of fragments size\n"
-"  PAIR  alignments between contigs\n"
+"  HIST    distribution of fragments size\n"
+"  PAIR    alignments between contigs\n"
+"  QUERY   the paired reads to map\n"
+"  TARGET  the contigs to which to map the reads\n"
 "\n"
 " Options:\n"
 "\n"
@@ -57,6 +69,8 @@ static const char USAGE_MESSAGE[] =
 "  -q, --min-mapq=N      ignore alignments with mapping quality\n"
 "                        less than this threshold [10]\n"
 "  -o, --out=FILE        write result to FILE\n"
+"      --map             map the reads of QUERY to TARGET, rather\n"
+"                        than reading alignments from PAIR\n"
 "      --mle             use the MLE [default]\n"
 "                        (maximum likelihood estimator)\n"
 "      --median          use the difference of the population median\n"
@@ -109,6 +123,9 @@ namespace opt {
 	static int verbose;
 	static string out;
 	static int threads = 1;
+
+	/** Map the reads to the contigs. */
+	static int mapReads;
 }
 
 static const char shortopts[] = "j:k:l:n:o:q:s:v";
@@ -132,6 +149,7 @@ static const struct option longopts[] = {
 	{ "min-align",   required_argument, NULL, 'l' },
 	{ "mind",        required_argument, NULL, OPT_MIND },
 	{ "maxd",        required_argument, NULL, OPT_MAXD },
+	{ "map",         no_argument,       &opt::mapReads, 1 },
 	{ "mle",         no_argument,       &opt::method, MLE },
 	{ "median",      no_argument,       &opt::method, MEDIAN },
 	{ "mean",        no_argument,       &opt::method, MEAN },
@@ -245,7 +263,9 @@ static int estimateDistance(unsigned len0, unsigned len1,
 			fragments.end());
 	numPairs = fragments.size();
 	assert((int)orig - (int)numPairs >= 0);
+#pragma omp atomic
 	stats.total_frags += orig;
+#pragma omp atomic
 	stats.dup_frags += orig - numPairs;
 
 	if (numPairs < opt::npairs)
@@ -310,12 +330,10 @@ static void writeEstimate(ostream& out,
 	std::pair<ContigNode, ContigNode> e(id0, id1 ^ id0.sense());
 	if (est.numPairs >= opt::npairs) {
 		if (opt::format == DOT) {
-#pragma omp critical(out)
 			out << get(g_contigNames, e) << " [" << est << "]\n";
 		} else if (opt::format == GFA2) {
 			// Output only one of the two complementary edges.
 			if (len1 < opt::seedLen || e.first < e.second || e.first == e.second)
-#pragma omp critical(out)
 				out << "G\t*"
 					<< '\t' << get(g_contigNames, e.first)
 					<< '\t' << get(g_contigNames, e.second)
@@ -371,9 +389,7 @@ static void writeEstimates(ostream& out,
 					it->second, pmf);
 	}
 	if (opt::format == DIST)
-#pragma omp critical(out)
 		out << ss.str() << '\n';
-	assert(out.good());
 }
 
 /** Load a histogram from the specified file. */
@@ -393,41 +409,388 @@ static Histogram loadHist(const string& path)
 	return hist;
 }
 
-/** Copy records from [it, last) to out and stop before alignments to
- * the next target sequence.
- * @param[in,out] it an input iterator
- */
-template<typename It>
-static void readPairs(It& it, const It& last, vector<SAMRecord>& out)
-{
-	assert(out.empty());
-	for (; it != last; ++it) {
-		if (it->isUnmapped() || it->isMateUnmapped()
-				|| !it->isPaired() || it->rname == it->mrnm
-				|| it->mapq < opt::minMapQ)
-			continue;
-		if (!out.empty() && out.back().rname != it->rname)
-			break;
-
-		out.push_back(*it);
-		SAMRecord& sam = out.back();
-		// Clear unused fields.
-		sam.qname.clear();
+/** Read the alignments to one contig from a sorted SAM stream. */
+struct SAMPairsReader {
+	typedef Pairs value_type;
+	istream& in;
+
+	/** The line buffer of the next alignment */
+	string line;
+
+	/** The next alignment */
+	SAMRecordView rec;
+
+	/** Whether rec holds an alignment */
+	bool good;
+
+	SAMPairsReader(istream& in)
+		: in(in), good(readSAMRecord(in, line, rec)) { }
+
+	bool operator()(Pairs& out)
+	{
+		readPairs(out);
+		return !out.empty();
+	}
+
+	/** Copy records to out and stop before alignments to the next
+	 * target sequence. Only the alignments that are kept are copied.
+	 */
+	void readPairs(vector<SAMRecord>& out)
+	{
+		assert(out.empty());
+		for (; good; good = readSAMRecord(in, line, rec)) {
+			if (rec.isUnmapped() || rec.isMateUnmapped()
+					|| !rec.isPaired() || rec.rname() == rec.mrnm()
+					|| rec.mapq() < opt::minMapQ)
+				continue;
+			if (!out.empty() && out.back().rname != rec.rname().c_str())
+				break;
+
+			out.push_back(SAMRecord());
+			SAMRecord& sam = out.back();
+			sam.assign(rec);
+			// Clear unused fields.
+			sam.qname.clear();
 #if SAM_SEQ_QUAL
-		sam.seq.clear();
-		sam.qual.clear();
+			sam.seq.clear();
+			sam.qual.clear();
 #endif
+		}
+
+		// Check that the input is sorted.
+		if (good && !out.empty()
+				&& get(g_contigNames, rec.rname().c_str())
+					< get(g_contigNames, out.front().rname)) {
+			cerr << "error: input must be sorted: saw `"
+				<< out.front().rname << "' before `"
+				<< rec.rname() << "'\n";
+			exit(EXIT_FAILURE);
+		}
+	}
+};
+
+/** Read the alignments to one contig from the alignments grouped
+ * by contig.
+ */
+struct ContigPairsReader {
+	typedef Pairs value_type;
+	vector<Pairs>& pairs;
+	size_t i;
+	ContigPairsReader(vector<Pairs>& pairs) : pairs(pairs), i(0) { }
+	bool operator()(Pairs& out)
+	{
+		while (i < pairs.size() && pairs[i].empty())
+			++i;
+		if (i == pairs.size())
+			return false;
+		out.swap(pairs[i++]);
+		return true;
+	}
+};
+
+/** Estimate the distances from one contig to its neighbours. */
+struct Estimator {
+	typedef string result_type;
+	const vector<unsigned>& lengths;
+	const PMF& pmf;
+	Estimator(const vector<unsigned>& lengths, const PMF& pmf)
+		: lengths(lengths), pmf(pmf) { }
+	void operator()(const Pairs& pairs, string& out) const
+	{
+		ostringstream ss;
+		writeEstimates(ss, pairs, lengths, pmf);
+		out = ss.str();
+	}
+};
+
+/** Write the distance estimates in the order of the contigs. */
+struct EstimateWriter {
+	ostream& out;
+	EstimateWriter(ostream& out) : out(out) { }
+	void operator()(const string& s)
+	{
+		out << s;
+		assert(out.good());
+	}
+};
+
+/** Statistics of the read pairs mapped by --map */
+static struct {
+	size_t reads;
+	size_t mateless;
+	size_t bothUnaligned;
+	size_t oneUnaligned;
+	size_t numDifferent;
+	size_t numFF;
+	size_t numSame;
+} g_mapStats;
+
+/** Map the specified read to the target, as abyss-map does, and
+ * return its alignment, as DistanceEst would read it from abyss-map.
+ */
+static SAMRecord mapRead(const FastaIndex& faIndex,
+		const FMIndex& fmIndex, const FastqRecord& rec)
+{
+	if (rec.seq.empty()) {
+		cerr << PROGRAM ": error: "
+			"the sequence `" << rec.id << "' is empty\n";
+		exit(EXIT_FAILURE);
+	}
+
+	Match m = fmIndex.find(rec.seq, opt::minAlign);
+	Match rcm = fmIndex.find(reverseComplement(rec.seq), m.qspan());
+	bool rc = rcm.qspan() > m.qspan();
+	// If both matches are the same length, sum up the number of times
+	// each were seen.
+	if (rcm.qspan() == m.qspan())
+		rc ? rcm.num += m.num : m.num += rcm.num;
+
+	SAMRecord a = toSAM(faIndex, fmIndex, rc ? rcm : m, rc,
+			rec.seq.size());
+	a.qname = rec.id;
+
+	// Set the paired flags if qname ends in /1 or /2.
+	unsigned l = a.qname.length();
+	if (l >= 2 && a.qname[l-2] == '/') {
+		switch (a.qname[l-1]) {
+			case '1':
+				a.flag |= SAMAlignment::FPAIRED | SAMAlignment::FREAD1;
+				a.qname.resize(l - 2);
+				break;
+			case '2': case '3':
+				a.flag |= SAMAlignment::FPAIRED | SAMAlignment::FREAD2;
+				a.qname.resize(l - 2);
+				break;
+		}
+	}
+	return a;
+}
+
+/** Add the alignment of a read whose mate aligns to a different
+ * contig to the spanning alignments of this thread.
+ */
+static void addSpanningAlignment(SAMRecord& a, Pairs& spanning)
+{
+	if (a.mapq < opt::minMapQ)
+		return;
+	a.qname.clear();
+	spanning.push_back(a);
+}
+
+/** Classify a pair of alignments as abyss-fixmate does. Add the
+ * fragment size of a pair aligned to the same contig to hist, and
+ * add the alignments of a pair aligned to different contigs to
+ * spanning.
+ */
+static void handlePair(SAMRecord& a0, SAMRecord& a1,
+		Histogram& hist, Pairs& spanning)
+{
+	if ((a0.isRead1() && a1.isRead1())
+			|| (a0.isRead2() && a1.isRead2())) {
+		cerr << "error: duplicate read ID `" << a0.qname
+			<< (a0.isRead1() ? "/1" : "")
+			<< (a0.isRead2() ? "/2" : "") << "'\n";
+		exit(EXIT_FAILURE);
+	}
+
+	fixMate(a0, a1);
+	if (a0.isUnmapped() && a1.isUnmapped()) {
+#pragma omp atomic
+		g_mapStats.bothUnaligned++;
+	} else if (a0.isUnmapped() || a1.isUnmapped()) {
+#pragma omp atomic
+		g_mapStats.oneUnaligned++;
+	} else if (a0.rname != a1.rname) {
+		// Set the mapping quality of both reads to their minimum.
+		a0.mapq = a1.mapq = min(a0.mapq, a1.mapq);
+#pragma omp atomic
+		g_mapStats.numDifferent++;
+		addSpanningAlignment(a0, spanning);
+		addSpanningAlignment(a1, spanning);
+	} else if (a0.isReverse() == a1.isReverse()) {
+#pragma omp atomic
+		g_mapStats.numFF++;
+	} else {
+#pragma omp atomic
+		g_mapStats.numSame++;
+		hist.insert(a0.isReverse() ? a1.isize : a0.isize);
+	}
+}
+
+/** Alignments whose mate has not yet been seen */
+typedef unordered_map<string, SAMRecord> Unpaired;
+
+/** Pair the specified alignment with its mate if it has been seen,
+ * and otherwise store it until its mate is seen.
+ */
+static void handleUnpaired(SAMRecord& a, Unpaired& unpaired,
+		Histogram& hist, Pairs& spanning)
+{
+	SAMRecord mate;
+	bool found;
+#pragma omp critical(unpaired)
+	{
+		Unpaired::iterator it = unpaired.find(a.qname);
+		found = it != unpaired.end();
+		if (found) {
+			mate = it->second;
+			unpaired.erase(it);
+		} else
+			unpaired.insert(make_pair(a.qname, a));
+	}
+	if (found)
+		handlePair(mate, a, hist, spanning);
+}
+
+/** Return the specified number formatted as a percent. */
+static string percent(size_t x, size_t n)
+{
+	ostringstream ss;
+	ss << setw((int)log10(n) + 1) << x;
+	if (x > 0)
+		ss << "  " << setprecision(3) << (float)100 * x / n << '%';
+	return ss.str();
+}
+
+/** Map the read pairs of the query files to the target, and return
+ * the fragment size histogram of the pairs that align to the same
+ * contig. The alignments of the pairs that align to different contigs
+ * are stored in pairs, grouped by contig.
+ */
+static Histogram mapPairs(char** first, char** last,
+		const char* targetFile,
+		vector<unsigned>& contigLens, vector<Pairs>& pairs)
+{
+	FastaIndex faIndex;
+	FMIndex fmIndex;
+	readIndexes(targetFile, faIndex, fmIndex,
+			"-ACGT", 1, opt::verbose);
+
+	assert(contigLens.empty());
+	assert(g_contigNames.empty());
+	loadContigNames(targetFile);
+	for (FastaIndex::const_iterator it = faIndex.begin();
+			it != faIndex.end(); ++it) {
+		put(g_contigNames, contigLens.size(), it->id);
+		contigLens.push_back(it->size);
+	}
+	saveContigNames(targetFile);
+	g_contigNames.lock();
+	pairs.resize(contigLens.size());
+
+	opt::chastityFilter = false;
+	opt::trimMasked = false;
+	FastaInterleave in(first, last, FastaReader::FOLD_CASE);
+
+	// The mates of a pair are usually consecutive. Pair those that
+	// are not by their query name.
+	Unpaired unpaired;
+	Histogram hist;
+#pragma omp parallel
+	{
+		// Count the fragment sizes and keep the spanning alignments
+		// of each thread separately.
+		Histogram threadHist;
+		Pairs threadPairs;
+		for (FastqRecord rec0, rec1;;) {
+			bool good0, good1;
+#pragma omp critical(in)
+			{
+				good0 = in >> rec0;
+				good1 = good0 && in >> rec1;
+			}
+			if (!good0)
+				break;
+
+			SAMRecord a0 = mapRead(faIndex, fmIndex, rec0);
+			if (good1) {
+				SAMRecord a1 = mapRead(faIndex, fmIndex, rec1);
+				if (a0.qname == a1.qname) {
+					handlePair(a0, a1, threadHist, threadPairs);
+				} else {
+					handleUnpaired(a0, unpaired,
+							threadHist, threadPairs);
+					handleUnpaired(a1, unpaired,
+							threadHist, threadPairs);
+				}
+			} else
+				handleUnpaired(a0, unpaired, threadHist, threadPairs);
+#pragma omp atomic
+			g_mapStats.reads += good1 ? 2 : 1;
+		}
+#pragma omp critical(hist)
+		hist += threadHist;
+
+		// Group the spanning alignments by contig.
+#pragma omp critical(pairs)
+		for (Pairs::const_iterator it = threadPairs.begin();
+				it != threadPairs.end(); ++it)
+			pairs[get(g_contigNames, it->rname)].push_back(*it);
+	}
+	assert(in.eof());
+	g_mapStats.mateless = unpaired.size();
+
+	size_t sum = g_mapStats.mateless + g_mapStats.bothUnaligned
+		+ g_mapStats.oneUnaligned + g_mapStats.numDifferent
+		+ g_mapStats.numFF + g_mapStats.numSame;
+	unsigned numRF = hist.count(INT_MIN, 0);
+	unsigned numFR = hist.count(1, INT_MAX);
+	cerr << "Mateless   " << percent(g_mapStats.mateless, sum)
+		<< "\nUnaligned  " << percent(g_mapStats.bothUnaligned, sum)
+		<< "\nSingleton  " << percent(g_mapStats.oneUnaligned, sum)
+		<< "\nFR         " << percent(numFR, sum)
+		<< "\nRF         " << percent(numRF, sum)
+		<< "\nFF         " << percent(g_mapStats.numFF, sum)
+		<< "\nDifferent  " << percent(g_mapStats.numDifferent, sum)
+		<< "\nTotal      " << sum << endl;
+	if (opt::verbose > 0)
+		cerr << "Mapped " << g_mapStats.reads << " reads.\n";
+
+	if (!opt::db.empty()) {
+		vector<int> vals = make_vector<int>()
+			<< g_mapStats.mateless
+			<< g_mapStats.bothUnaligned
+			<< g_mapStats.oneUnaligned
+			<< numFR
+			<< numRF
+			<< g_mapStats.numFF
+			<< g_mapStats.numDifferent
+			<< sum;
+		vector<string> keys = make_vector<string>()
+			<< "Mateless"
+			<< "Unaligned"
+			<< "Singleton"
+			<< "FR"
+			<< "RF"
+			<< "FF"
+			<< "Different"
+			<< "Total";
+		for (unsigned i = 0; i < vals.size(); i++)
+			addToDb(db, keys[i], vals[i]);
 	}
 
-	// Check that the input is sorted.
-	if (it != last && !out.empty()
-			&& get(g_contigNames, it->rname)
-				< get(g_contigNames, out.front().rname)) {
-		cerr << "error: input must be sorted: saw `"
-			<< out.front().rname << "' before `"
-			<< it->rname << "'\n";
+	if (g_mapStats.mateless == sum) {
+		cerr << PROGRAM ": error: All reads are mateless. This "
+			"can happen when first and second read IDs do not match."
+			<< endl;
+		exit(EXIT_FAILURE);
+	}
+	if (g_mapStats.numFF > numFR && g_mapStats.numFF > numRF) {
+		cerr << PROGRAM ": error: The mate pairs of this library are "
+			"oriented forward-forward (FF), which is not supported "
+			"by ABySS." << endl;
 		exit(EXIT_FAILURE);
 	}
+	return hist;
+}
+
+/** Write the specified histogram to the specified file. */
+static void writeHist(const string& path, const Histogram& hist)
+{
+	ofstream out(path.c_str());
+	assert_good(out, path);
+	out << hist;
+	assert_good(out, path);
 }
 
 int main(int argc, char** argv)
@@ -494,10 +857,10 @@ int main(int argc, char** argv)
 		die = true;
 	}
 
-	if (argc - optind < 1) {
+	if (argc - optind < (opt::mapReads ? 3 : 1)) {
 		cerr << PROGRAM ": missing arguments\n";
 		die = true;
-	} else if (argc - optind > 2) {
+	} else if (!opt::mapReads && argc - optind > 2) {
 		cerr << PROGRAM ": too many arguments\n";
 		die = true;
 	}
@@ -530,13 +893,15 @@ int main(int argc, char** argv)
 	}
 
 	string distanceCountFile(argv[optind++]);
-	string alignFile(argv[optind] == NULL ? "-" : argv[optind++]);
-
-	ifstream inFile(alignFile.c_str());
-	istream& in(strcmp(alignFile.c_str(), "-") == 0 ? cin : inFile);
+	string alignFile(opt::mapReads || argv[optind] == NULL
+			? "-" : argv[optind++]);
 
-	if (strcmp(alignFile.c_str(), "-") != 0)
+	ifstream inFile;
+	if (!opt::mapReads && alignFile != "-") {
+		inFile.open(alignFile.c_str());
 		assert_good(inFile, alignFile);
+	}
+	istream& in(alignFile == "-" ? cin : inFile);
 
 	ofstream outFile;
 	if (!opt::out.empty()) {
@@ -563,12 +928,27 @@ int main(int argc, char** argv)
 		<< "SeedLen"
 		<< "NumPairs";
 
-	// The fragment size histogram may not be written out until after
-	// the alignments complete. Wait for the alignments to complete.
-	in.peek();
-
-	// Read the fragment size distribution.
-	Histogram distanceHist = loadHist(distanceCountFile);
+	// Read the fragment size distribution, or map the reads to the
+	// contigs and write it.
+	Histogram distanceHist;
+	vector<unsigned> contigLens;
+	vector<Pairs> contigPairs;
+	if (opt::mapReads) {
+		distanceHist = mapPairs(argv + optind, argv + argc - 1,
+				argv[argc - 1], contigLens, contigPairs);
+		writeHist(distanceCountFile, distanceHist);
+		if (distanceHist.empty()) {
+			cerr << "error: the histogram `" << distanceCountFile
+				<< "' is empty\n";
+			exit(EXIT_FAILURE);
+		}
+	} else {
+		// The fragment size histogram may not be written out until
+		// after the alignments complete. Wait for the alignments to
+		// complete.
+		in.peek();
+		distanceHist = loadHist(distanceCountFile);
+	}
 	unsigned numRF = distanceHist.count(INT_MIN, 0);
 	unsigned numFR = distanceHist.count(1, INT_MAX);
 	unsigned numTotal = distanceHist.size();
@@ -646,10 +1026,9 @@ int main(int argc, char** argv)
 		<< "max";
 
 	// Read the contig lengths.
-	vector<unsigned> contigLens;
-
 	vals += make_vector<int>()
-		<< readContigLengths(in, contigLens);
+		<< (opt::mapReads ? contigLens.size()
+				: readContigLengths(in, contigLens));
 
 	keys += make_vector<string>()
 		<< "CntgCounted";
@@ -659,24 +1038,24 @@ int main(int argc, char** argv)
 	g_contigNames.lock();
 
 	// Estimate the distances between contigs.
-	istream_iterator<SAMRecord> it(in), last;
-	if (contigLens.size() == 1) {
-		// When mapping to a single contig, no alignments spanning
-		// contigs are expected.
-		assert(in.eof());
-		exit(EXIT_SUCCESS);
-	}
-	assert(in);
-
 	g_recMA = opt::minAlign;
-#pragma omp parallel
-	for (vector<SAMRecord> records;;) {
-		records.clear();
-#pragma omp critical(in)
-		readPairs(it, last, records);
-		if (records.empty())
-			break;
-		writeEstimates(out, records, contigLens, pmf);
+	Estimator estimator(contigLens, pmf);
+	EstimateWriter writer(out);
+	if (opt::mapReads) {
+		ContigPairsReader reader(contigPairs);
+		orderedPipeline(reader, estimator, writer);
+	} else {
+		SAMPairsReader reader(in);
+		if (contigLens.size() == 1) {
+			// When mapping to a single contig, no alignments spanning
+			// contigs are expected.
+			assert(in.eof());
+			exit(EXIT_SUCCESS);
+		}
+		assert(in);
+
+		orderedPipeline(reader, estimator, writer);
+		assert(in.eof());
 	}
 
 	if (opt::verbose > 0) {
@@ -707,8 +1086,6 @@ int main(int argc, char** argv)
 		cerr << PROGRAM << ": warning: MLE will be more accurate if "
 			"l is decreased to " << g_recMA << ".\n";
 
-	assert(in.eof());
-
 	if (opt::format == DOT)
 		out << "}\n";
 	return 0;
@@ -17,8 +17,6 @@
 #include "IOUtil.h"
 #include "Uncompress.h"
 #include <algorithm>
-#include <boost/lambda/bind.hpp>
-#include <boost/lambda/lambda.hpp>
 #include <fstream>
 #include <functional>
 #include <getopt.h>
@@ -28,10 +26,12 @@
 #include <string>
 #include <utility>
 #include <vector>
+#if _OPENMP
+#include <omp.h>
+#endif
 
 using namespace std;
 using namespace rel_ops;
-using namespace boost::lambda;
 using boost::tie;
 
 #define PROGRAM "abyss-filtergraph"
@@ -82,6 +82,7 @@ static const char USAGE_MESSAGE[] =
     "      --gfa2              output the graph in GFA2 format\n"
     "      --gv                output the graph in GraphViz format\n"
     "      --sam               output the graph in SAM format\n"
+    "  -j, --threads=N         use N parallel threads [1]\n"
     "  -v, --verbose           display verbose output\n"
     "      --help              display this help and exit\n"
     "      --version           output version information and exit\n"
@@ -134,11 +135,14 @@ static string removePath;
 /** The minimum overlap allowed between two contigs. */
 static int minOverlap = 10;
 
+/** The number of threads. */
+static int threads = 1;
+
 /** Output graph format. */
 int format = ADJ; // used by ContigProperties
 }
 
-static const char shortopts[] = "c:C:g:i:r:k:l:L:m:t:T:v";
+static const char shortopts[] = "c:C:g:i:j:r:k:l:L:m:t:T:v";
 
 enum
 {
@@ -174,6 +178,7 @@ static const struct option longopts[] = {
 	{ "assemble", no_argument, &opt::assemble, 1 },
 	{ "no-assemble", no_argument, &opt::assemble, 0 },
 	{ "min-overlap", required_argument, NULL, 'm' },
+	{ "threads", required_argument, NULL, 'j' },
 	{ "verbose", no_argument, NULL, 'v' },
 	{ "help", no_argument, NULL, OPT_HELP },
 	{ "version", no_argument, NULL, OPT_VERSION },
@@ -199,36 +204,41 @@ static struct
 	unsigned parallel_edge;
 } g_count;
 
-/** Returns if the contig can be removed from the graph. */
-static bool
-removable(const Graph* pg, vertex_descriptor v)
+/** Whether a contig can be removed from the graph, or why not. */
+enum Removability
+{
+	REMOVABLE,
+	REMOVED,
+	TAIL,
+	TOO_COMPLEX,
+	SELF_ADJ,
+	TOO_LONG
+};
+
+/** Return whether the contig can be removed from the graph, or why
+ * not. Does not modify any state, so that it may be called in
+ * parallel. */
+static Removability
+checkRemovable(const Graph& g, vertex_descriptor v)
 {
 	typedef graph_traits<Graph> GTraits;
 	typedef GTraits::out_edge_iterator OEit;
 	typedef GTraits::in_edge_iterator IEit;
 	typedef GTraits::vertex_descriptor V;
 
-	const Graph& g = *pg;
-
 	// Check if previously removed
-	if (get(vertex_removed, g, v)) {
-		g_count.removed++;
-		return false;
-	}
+	if (get(vertex_removed, g, v))
+		return REMOVED;
 
 	unsigned min_degree = min(out_degree(v, g), in_degree(v, g));
 
 	// Check for tails
-	if (min_degree == 0) {
-		g_count.tails++;
-		return false;
-	}
+	if (min_degree == 0)
+		return TAIL;
 
 	// Check that the result will be less complex that the original
-	if (min_degree > opt::shimMaxDegree) {
-		g_count.too_complex++;
-		return false;
-	}
+	if (min_degree > opt::shimMaxDegree)
+		return TOO_COMPLEX;
 
 	// Check if self adjacent
 	OEit oei0, oei1;
@@ -236,10 +246,8 @@ removable(const Graph* pg, vertex_descriptor v)
 	for (OEit vw = oei0; vw != oei1; ++vw) {
 		V w = target(*vw, g);
 		V vc = get(vertex_complement, g, v);
-		if (v == w || vc == w) {
-			g_count.self_adj++;
-			return false;
-		}
+		if (v == w || vc == w)
+			return SELF_ADJ;
 	}
 
 	// Check that removing the contig will result in adjacent contigs
@@ -255,11 +263,69 @@ removable(const Graph* pg, vertex_descriptor v)
 		if (g[*maxvw].distance < g[*vw].distance)
 			maxvw = vw;
 
-	if (g[*maxuv].distance + (int)g[v].length + g[*maxvw].distance > -opt::minOverlap) {
+	if (g[*maxuv].distance + (int)g[v].length + g[*maxvw].distance > -opt::minOverlap)
+		return TOO_LONG;
+	return REMOVABLE;
+}
+
+/** Count the reason that a contig cannot be removed.
+ * @return whether the contig can be removed
+ */
+static bool
+countRemovable(Removability r)
+{
+	switch (r) {
+	case REMOVABLE:
+		return true;
+	case REMOVED:
+		g_count.removed++;
+		break;
+	case TAIL:
+		g_count.tails++;
+		break;
+	case TOO_COMPLEX:
+		g_count.too_complex++;
+		break;
+	case SELF_ADJ:
+		g_count.self_adj++;
+		break;
+	case TOO_LONG:
 		g_count.too_long++;
-		return false;
+		break;
 	}
-	return true;
+	return false;
+}
+
+/** Check whether each of the specified contigs can be removed from
+ * the graph, in parallel. */
+static void
+checkRemovable(
+    const Graph& g,
+    const vector<vertex_descriptor>& vs,
+    vector<unsigned char>& out)
+{
+	out.resize(vs.size());
+#pragma omp parallel for schedule(dynamic, 1024)
+	for (ptrdiff_t i = 0; i < (ptrdiff_t)vs.size(); ++i)
+		out[i] = checkRemovable(g, vs[i]);
+}
+
+/** Copy the elements of [first, last) that satisfy the predicate p
+ * to out, in order. The predicate is evaluated in parallel. */
+template<typename It, typename T, typename Pred>
+static void
+parallelCopyIf(It first, It last, vector<T>& out, Pred p)
+{
+	vector<T> all;
+	for (; first != last; ++first)
+		all.push_back(*first);
+	vector<unsigned char> keep(all.size());
+#pragma omp parallel for schedule(dynamic, 1024)
+	for (ptrdiff_t i = 0; i < (ptrdiff_t)all.size(); ++i)
+		keep[i] = p(all[i]);
+	for (size_t i = 0; i < all.size(); ++i)
+		if (keep[i])
+			out.push_back(all[i]);
 }
 
 /** Data to store information of an edge. */
@@ -345,17 +411,42 @@ removeContig(vertex_descriptor v, Graph& g)
 	g_count.removed++;
 }
 
-/** Remove the specified contig from the adjacency graph. */
+/** Record that the edges of the neighbours of the removed contig v
+ * have changed. */
+static void
+markChanged(const Graph& g, vertex_descriptor v, const vector<EdgeInfo>& eds, vector<bool>& changed)
+{
+	changed[get(vertex_index, g, v)] = true;
+	changed[get(vertex_index, g, get(vertex_complement, g, v))] = true;
+	for (vector<EdgeInfo>::const_iterator it = eds.begin(); it != eds.end(); ++it) {
+		changed[get(vertex_index, g, it->u)] = true;
+		changed[get(vertex_index, g, get(vertex_complement, g, it->u))] = true;
+		changed[get(vertex_index, g, it->w)] = true;
+		changed[get(vertex_index, g, get(vertex_complement, g, it->w))] = true;
+	}
+}
+
+/** Remove the specified contig from the adjacency graph.
+ * Whether each contig can be removed is checked in parallel against
+ * the graph as it is before this pass. The contigs are then removed
+ * in order, and a contig is checked again only if removing an earlier
+ * contig changed its edges, so that the result does not depend on the
+ * number of threads.
+ */
 static void
 removeContigs(Graph& g, vector<vertex_descriptor>& sc)
 {
 	typedef graph_traits<Graph> GTraits;
 	typedef GTraits::vertex_descriptor V;
 
+	vector<unsigned char> snapshot;
+	checkRemovable(g, sc, snapshot);
+
 	vector<vertex_descriptor> out;
 	out.reserve(sc.size());
 
 	vector<bool> markedContigs(g.num_vertices());
+	vector<bool> changed(g.num_vertices());
 	for (vector<vertex_descriptor>::iterator it = sc.begin(); it != sc.end(); ++it) {
 		V v = *it;
 		if (opt::verbose > 0 && ++g_count.checked % 10000000 == 0)
@@ -367,7 +458,10 @@ removeContigs(Graph& g, vector<vertex_descriptor>& sc)
 			continue;
 		}
 
-		if (!removable(&g, v))
+		Removability r = changed[get(vertex_index, g, v)]
+		                     ? checkRemovable(g, v)
+		                     : Removability(snapshot[it - sc.begin()]);
+		if (!countRemovable(r))
 			continue;
 
 		vector<EdgeInfo> eds;
@@ -376,29 +470,12 @@ removeContigs(Graph& g, vector<vertex_descriptor>& sc)
 		else
 			continue;
 
+		markChanged(g, v, eds, changed);
 		removeContig(v, g);
 	}
 	sc.swap(out);
 }
 
-/** Return the value of the bit at the specified index. */
-struct Marked
-{
-	typedef vector<bool> Data;
-	Marked(const Graph& g, const Data& data)
-	  : m_g(g)
-	  , m_data(data)
-	{}
-	bool operator()(vertex_descriptor u) const { return m_data[get(vertex_contig_index, m_g, u)]; }
-
-	typedef vertex_descriptor argument_type;
-	typedef bool result_type;
-
-  private:
-	const Graph& m_g;
-	const Data& m_data;
-};
-
 /** Finds all potentially removable contigs in the graph. */
 static void
 findShortContigs(const Graph& g, const vector<bool>& seen, vector<vertex_descriptor>& sc)
@@ -407,11 +484,16 @@ findShortContigs(const Graph& g, const vector<bool>& seen, vector<vertex_descrip
 	typedef GTraits::vertex_iterator Vit;
 	Vit first, second;
 	tie(first, second) = vertices(g);
-	::copy_if(
-	    first,
-	    second,
-	    back_inserter(sc),
-	    !boost::lambda::bind(Marked(g, seen), _1) && boost::lambda::bind(removable, &g, _1));
+	vector<vertex_descriptor> vs;
+	for (Vit it = first; it != second; ++it)
+		if (!seen[get(vertex_contig_index, g, *it)])
+			vs.push_back(*it);
+
+	vector<unsigned char> r;
+	checkRemovable(g, vs, r);
+	for (size_t i = 0; i < vs.size(); ++i)
+		if (countRemovable(Removability(r[i])))
+			sc.push_back(vs[i]);
 }
 
 /** Functor used for sorting contigs based on degree, then size,
@@ -537,7 +619,7 @@ removeContigs_if(Graph& g, pred p)
 	Vit first, second;
 	tie(first, second) = vertices(g);
 	vector<V> sc;
-	::copy_if(first, second, back_inserter(sc), p);
+	parallelCopyIf(first, second, sc, p);
 	remove_vertex_if(g, sc.begin(), sc.end(), True<V>());
 	transform(sc.begin(), sc.end(), back_inserter(g_removed), [](const ContigNode& c) {
 		return c.contigIndex();
@@ -550,14 +632,28 @@ removeContigs_if(Graph& g, pred p)
 typedef vector<const_string> Contigs;
 static Contigs g_contigs;
 
-/** Return the sequence of vertex u. */
+/** Return the length of the sequence of vertex u. */
+static size_t
+getSequenceLength(const Graph& g, vertex_descriptor u)
+{
+	size_t i = get(vertex_contig_index, g, u);
+	assert(i < g_contigs.size());
+	return g_contigs[i].size();
+}
+
+/** Return n bases of the sequence of vertex u starting at pos,
+ * without copying the rest of the sequence. */
 static string
-getSequence(const Graph& g, vertex_descriptor u)
+getSequence(const Graph& g, vertex_descriptor u, size_t pos, size_t n)
 {
 	size_t i = get(vertex_contig_index, g, u);
 	assert(i < g_contigs.size());
-	string seq(g_contigs[i]);
-	return get(vertex_sense, g, u) ? reverseComplement(seq) : seq;
+	const char* seq = g_contigs[i].c_str();
+	size_t len = g_contigs[i].size();
+	assert(pos + n <= len);
+	if (!get(vertex_sense, g, u))
+		return string(seq + pos, n);
+	return reverseComplement(string(seq + len - pos - n, n));
 }
 
 /** Return whether the specified edge is inconsistent. */
@@ -577,12 +673,13 @@ struct is_edge_inconsistent
 		int overlap = g[e].distance;
 		assert(overlap < 0);
 
-		string su = getSequence(g, u);
-		string sv = getSequence(g, v);
-		const unsigned u_start = su.length() + overlap;
+		// Compare only the overlapping sequence.
+		unsigned n = -overlap;
+		string su = getSequence(g, u, getSequenceLength(g, u) - n, n);
+		string sv = getSequence(g, v, 0, n);
 
-		for (unsigned i = 0; i < (unsigned)-overlap; i++)
-			if (!(ambiguityToBitmask(su[u_start + i]) & ambiguityToBitmask(sv[i])))
+		for (unsigned i = 0; i < n; i++)
+			if (!(ambiguityToBitmask(su[i]) & ambiguityToBitmask(sv[i])))
 				return true;
 		return false;
 	}
@@ -609,7 +706,7 @@ removeEdges_if(Graph& g, pred p)
 	Eit first, second;
 	tie(first, second) = edges(g);
 	vector<E> sc;
-	::copy_if(first, second, back_inserter(sc), p);
+	parallelCopyIf(first, second, sc, p);
 	remove_edge(g, sc.begin(), sc.end());
 	if (opt::verbose > 0) {
 		cerr << "Edge removal stats:\n";
@@ -657,6 +754,9 @@ main(int argc, char** argv)
 		case 'i':
 			arg >> opt::ignorePath;
 			break;
+		case 'j':
+			arg >> opt::threads;
+			break;
 		case 'r':
 			arg >> opt::removePath;
 			break;
@@ -715,6 +815,11 @@ main(int argc, char** argv)
 		exit(EXIT_FAILURE);
 	}
 
+#if _OPENMP
+	if (opt::threads > 0)
+		omp_set_num_threads(opt::threads);
+#endif
+
 	Graph g;
 	// Read the contig adjacency graph.
 	{
@@ -723,8 +828,10 @@ main(int argc, char** argv)
 			cerr << "Loading graph from file: " << adjPath << '\n';
 		ifstream fin(adjPath.c_str());
 		assert_good(fin, adjPath);
+		loadContigNames(adjPath);
 		fin >> g;
 		assert(fin.eof());
+		saveContigNames(adjPath);
 	}
 
 	// Read the set of contigs to ignore.
@@ -8,7 +8,6 @@
 #include "Graph/HashGraph.h"
 #include "Graph/BidirectionalBFSVisitor.h"
 #include "Graph/AllPathsSearch.h"
-#include "Common/MemUtils.h"
 #include <boost/graph/graph_traits.hpp>
 #include <iostream>
 #include <sstream>
@@ -25,7 +24,93 @@ protected:
 	typedef typename boost::graph_traits<G>::edge_descriptor E;
 	typedef unsigned short depth_t;
 	typedef std::vector< Path<V> > PathList;
-	typedef unordered_map<V, depth_t, hash<V> > DepthMap;
+
+	/**
+	 * Records the depth of each visited vertex.
+	 *
+	 * The table uses open addressing with linear probing, storing
+	 * vertices and depths inline in a single array. Compared to a
+	 * node-based unordered_map, this avoids one allocation per
+	 * visited vertex and several pointers of overhead per entry,
+	 * so that more vertices fit within the search memory limit.
+	 */
+	class DepthMap
+	{
+	  public:
+
+		DepthMap() : m_size(0) { }
+
+		/** Return the depth of v, or 0 if v has not been visited. */
+		depth_t get(const V& v) const
+		{
+			if (m_slots.empty())
+				return 0;
+			size_t i = find(m_slots, v);
+			return m_slots[i].used ? m_slots[i].depth : 0;
+		}
+
+		/** Set the depth of v. */
+		void set(const V& v, depth_t depth)
+		{
+			// keep the load factor at or below 1/2
+			if (2 * (m_size + 1) > m_slots.size())
+				grow();
+			size_t i = find(m_slots, v);
+			if (!m_slots[i].used) {
+				m_slots[i].key = v;
+				m_slots[i].used = true;
+				m_size++;
+			}
+			m_slots[i].depth = depth;
+		}
+
+		size_t size() const { return m_size; }
+
+		/** Return the approximate memory usage in bytes. */
+		size_t approxMemSize() const
+		{
+			return m_slots.capacity() * sizeof(Slot);
+		}
+
+	  private:
+
+		struct Slot {
+			V key;
+			depth_t depth;
+			bool used;
+			Slot() : key(), depth(0), used(false) { }
+		};
+
+		typedef std::vector<Slot> Slots;
+
+		/** Return the slot of v, or the empty slot where v belongs. */
+		static size_t find(const Slots& slots, const V& v)
+		{
+			// mix the bits, since hash<V> may be the identity
+			size_t mask = slots.size() - 1;
+			size_t i = ((hash<V>()(v) * 0x9e3779b97f4a7c15ULL) >> 16) & mask;
+			while (slots[i].used && !(slots[i].key == v))
+				i = (i + 1) & mask;
+			return i;
+		}
+
+		/** Double the capacity of the table and rehash. */
+		void grow()
+		{
+			const size_t INITIAL_CAPACITY = 64;
+			Slots slots(m_slots.empty()
+				? INITIAL_CAPACITY : 2 * m_slots.size());
+			for (typename Slots::const_iterator it = m_slots.begin();
+					it != m_slots.end(); ++it) {
+				if (it->used)
+					slots[find(slots, it->key)] = *it;
+			}
+			m_slots.swap(slots);
+		}
+
+		Slots m_slots;
+		size_t m_size;
+	};
 
 	struct EdgeHash {
 		const G& m_g;
@@ -214,7 +299,7 @@ public:
 
 		const V& parent = (dir == FORWARD) ? u : v;
 
-		if (m_depthMap[dir][parent] >= m_maxDepth[dir])
+		if (m_depthMap[dir].get(parent) >= m_maxDepth[dir])
 			return SKIP_ELEMENT;
 
 		return recordCommonEdge(e);
@@ -277,8 +362,8 @@ public:
 		return
 			m_traversalGraph[FORWARD].approxMemSize() +
 			m_traversalGraph[REVERSE].approxMemSize() +
-			approxMemSize(m_depthMap[FORWARD]) +
-			approxMemSize(m_depthMap[REVERSE]);
+			m_depthMap[FORWARD].approxMemSize() +
+			m_depthMap[REVERSE].approxMemSize();
 	}
 
 	void getTraversalGraph(HashGraph<V>& traversalGraph)
@@ -384,12 +469,12 @@ protected:
 		const V& parent = (dir == FORWARD) ? source(e, g) : target(e, g);
 		const V& child = (dir == FORWARD) ? target(e, g) : source(e, g);
 
-		depth_t parentDepth = m_depthMap[dir][parent];
+		depth_t parentDepth = m_depthMap[dir].get(parent);
 		if (parentDepth == m_maxDepth[dir])
 			return false;
 
 		depth_t childDepth = parentDepth + 1;
-		m_depthMap[dir][child] = childDepth;
+		m_depthMap[dir].set(child, childDepth);
 
 		if (childDepth > m_maxDepthVisited[dir])
 			m_maxDepthVisited[dir] = childDepth;
@@ -1,10 +1,12 @@
 #include "Aligner.h"
+#include "IOUtil.h"
 #include "Iterator.h"
 #include "SAM.h"
 #include "Sequence.h"
 #include <algorithm>
 #include <cassert>
 #include <cstdlib>
+#include <cstring>
 #include <iterator>
 #include <utility>
 
@@ -19,59 +21,123 @@ namespace opt {
 	int multimap;
 }
 
-template <>
-void Aligner<SeqPosHashMultiMap>::addReferenceSequence(
-		const Kmer& kmer, Position pos)
+/** Add a target sequence to be indexed by buildIndex. */
+void Aligner::addReferenceSequence(
+		const StringID& idString, const Sequence& seq)
 {
-	assert(opt::multimap == opt::MULTIMAP);
-	m_target.insert(make_pair(kmer, pos));
+	unsigned id = contigIDToIndex(idString);
+	assert(id == m_pending.size());
+	(void)id;
+	m_pending.push_back(seq);
 }
 
-template <class SeqPosHashMap>
-void Aligner<SeqPosHashMap>::addReferenceSequence(
-		const Kmer& kmer, Position pos)
+/** Return whether the specified character is an unambiguous base. */
+static bool isUnambiguous(char c)
 {
-	assert(opt::multimap != opt::MULTIMAP);
-	Kmer rc_kmer = reverseComplement(kmer);
-	map_iterator findIt = m_target.find(rc_kmer);
-
-	if (findIt != m_target.end()) {
-		if (!findIt->second.isDuplicate())
-			findIt->second.setDuplicate(
-					contigIndexToID(findIt->second.contig),
-					contigIndexToID(pos.contig), kmer.str());
-		return;
+	switch (c) {
+	  case 'A': case 'C': case 'G': case 'T':
+	  case '0': case '1': case '2': case '3':
+		return true;
+	  default:
+		return false;
+	}
+}
+
+/** Return the number of k-mer of seq that contain only unambiguous
+ * bases, and store them in keys and positions if they are not null.
+ */
+static size_t indexSequence(const Sequence& seq, unsigned id,
+		unsigned k, char* keys, Position* positions)
+{
+	const unsigned bytes = Kmer::bytes();
+	size_t n = 0;
+	// The number of consecutive unambiguous bases ending at i
+	unsigned run = 0;
+	for (size_t i = 0; i < seq.size(); ++i) {
+		run = isUnambiguous(seq[i]) ? run + 1 : 0;
+		if (run < k)
+			continue;
+		size_t pos = i + 1 - k;
+		if (keys != NULL) {
+			char key[Kmer::NUM_BYTES];
+			Kmer(Sequence(seq, pos, k)).serialize(key);
+			memcpy(keys + n * bytes, key, bytes);
+			positions[n] = Position(id, pos);
+		}
+		n++;
 	}
+	return n;
+}
+
+/** Index the k-mer of the target sequences in parallel. */
+void Aligner::buildIndex()
+{
+	assert(m_pending.size() == m_dict.size());
+	const long n = m_pending.size();
+	std::vector<size_t> offsets(n + 1);
+#pragma omp parallel for schedule(dynamic)
+	for (long i = 0; i < n; ++i)
+		offsets[i + 1] = indexSequence(m_pending[i], i, m_hashSize,
+				NULL, NULL);
+	for (long i = 0; i < n; ++i)
+		offsets[i + 1] += offsets[i];
+
+	const unsigned bytes = Kmer::bytes();
+	std::vector<char> keys(offsets[n] * bytes);
+	std::vector<Position> positions(offsets[n]);
+#pragma omp parallel for schedule(dynamic)
+	for (long i = 0; i < n; ++i)
+		indexSequence(m_pending[i], i, m_hashSize,
+				&keys[offsets[i] * bytes], &positions[offsets[i]]);
+	std::vector<Sequence>().swap(m_pending);
+
+	m_target.assign(keys, positions);
+	if (opt::multimap == opt::MULTIMAP)
+		return;
 
-	pair<map_iterator, bool> inserted
-		= m_target.insert(make_pair(kmer, pos));
+	KmerIndex::Duplicate dup;
+	if (m_target.removeDuplicates(dup) && opt::multimap == opt::ERROR) {
+		std::cerr << "error: duplicate k-mer in "
+			<< contigIndexToID(dup.first.contig)
+			<< " also in " << contigIndexToID(dup.second.contig)
+			<< ": " << dup.kmer.str() << '\n';
+		exit(EXIT_FAILURE);
+	}
+}
 
-	if (!inserted.second)
-		if (!inserted.first->second.isDuplicate())
-			inserted.first->second.setDuplicate(
-					contigIndexToID(inserted.first->second.contig),
-					contigIndexToID(pos.contig), kmer.str());
+/** Store the dictionary of contig IDs and the index. */
+ostream& operator<<(ostream& out, const Aligner& o)
+{
+	out << o.m_hashSize << ' ' << o.m_dict.size() << '\n';
+	for (vector<const_string>::const_iterator it = o.m_dict.begin();
+			it != o.m_dict.end(); ++it)
+		out << *it << '\n';
+	return out << o.m_target;
 }
 
-/** Create an index of the target sequence. */
-template <class SeqPosHashMap>
-void Aligner<SeqPosHashMap>::addReferenceSequence(
-		const StringID& idString, const Sequence& seq)
+/** Load the dictionary of contig IDs and the index. Set the fail bit
+ * of the stream if the index is truncated or does not match the k-mer
+ * size. */
+istream& operator>>(istream& in, Aligner& o)
 {
-	unsigned id = contigIDToIndex(idString);
-	int size = seq.length();
-	for(int i = 0; i < (size - m_hashSize + 1); ++i)
-	{
-		Sequence subseq(seq, i, m_hashSize);
-		if (subseq.find_first_not_of("ACGT0123") != string::npos)
-			continue;
-		addReferenceSequence(Kmer(subseq), Position(id, i));
+	int k;
+	size_t n;
+	in >> k >> n >> expect("\n");
+	if (!in || k != o.m_hashSize) {
+		in.setstate(ios::failbit);
+		return in;
 	}
+	o.m_dict.clear();
+	o.m_dict.reserve(n);
+	for (string id; o.m_dict.size() < n && getline(in, id);)
+		o.m_dict.push_back(id);
+	if (!in)
+		return in;
+	return in >> o.m_target;
 }
 
-template <class SeqPosHashMap>
 template <class oiterator>
-void Aligner<SeqPosHashMap>::alignRead(
+void Aligner::alignRead(
 		const string& qid, const Sequence& seq,
 		oiterator dest)
 {
@@ -85,8 +151,7 @@ void Aligner<SeqPosHashMap>::alignRead(
 /** Store all alignments for a given Kmer in the parameter aligns.
  *  @param[out] aligns Map of contig IDs to alignment vectors.
  */
-template <class SeqPosHashMap>
-void Aligner<SeqPosHashMap>::alignKmer(
+void Aligner::alignKmer(
 		AlignmentSet& aligns, const Sequence& seq,
 		bool isRC, bool good, int read_ind, int seqLen)
 {
@@ -95,33 +160,31 @@ void Aligner<SeqPosHashMap>::alignKmer(
 	if (!good && kmer.find_first_not_of("ACGT0123") != string::npos)
 		return;
 
-	pair<map_const_iterator, map_const_iterator> range
-		= m_target.equal_range(Kmer(kmer));
+	KmerIndex::Range range = m_target.equal_range(Kmer(kmer));
 
 	if (range.first != range.second
 				&& opt::multimap == opt::IGNORE
-				&& range.first->second.isDuplicate())
+				&& range.first->isDuplicate())
 		return;
 
-	for (map_const_iterator resultIter = range.first;
+	for (const Position* resultIter = range.first;
 			resultIter != range.second; ++resultIter) {
 		assert(opt::multimap != opt::IGNORE
-				|| !resultIter->second.isDuplicate());
+				|| !resultIter->isDuplicate());
 
 		int read_pos = !isRC ? read_ind
 			: Alignment::calculateReverseReadStart(
 					read_ind, seqLen, m_hashSize);
-		unsigned ctgIndex = resultIter->second.contig;
+		unsigned ctgIndex = resultIter->contig;
 		Alignment align(string(),
-				resultIter->second.pos, read_pos, m_hashSize,
+				resultIter->pos, read_pos, m_hashSize,
 				seqLen, isRC);
 		aligns[ctgIndex].push_back(align);
 	}
 }
 
-template <class SeqPosHashMap>
-typename Aligner<SeqPosHashMap>::AlignmentSet
-Aligner<SeqPosHashMap>::getAlignmentsInternal(
+Aligner::AlignmentSet
+Aligner::getAlignmentsInternal(
 		const Sequence& seq, bool isRC)
 {
 	// The results
@@ -176,9 +239,8 @@ static int compareQueryPos(const Alignment& a1, const Alignment& a2)
 }
 
 /** Coalesce the k-mer alignments into a read alignment. */
-template <class SeqPosHashMap>
 template <class oiterator>
-void Aligner<SeqPosHashMap>::coalesceAlignments(
+void Aligner::coalesceAlignments(
 		const string& qid, const string& seq,
 		const AlignmentSet& alignSet,
 		oiterator& dest)
@@ -222,28 +284,10 @@ void Aligner<SeqPosHashMap>::coalesceAlignments(
 }
 
 // Explicit instantiation.
-template void Aligner<SeqPosHashMultiMap>::addReferenceSequence(
-		const StringID& id, const Sequence& seq);
-
-template void Aligner<SeqPosHashUniqueMap>::addReferenceSequence(
-		const StringID& id, const Sequence& seq);
-
-template void Aligner<SeqPosHashMultiMap>::
-alignRead<affix_ostream_iterator<Alignment> >(
-		const string& qid, const Sequence& seq,
-		affix_ostream_iterator<Alignment> dest);
-
-template void Aligner<SeqPosHashUniqueMap>::
-alignRead<affix_ostream_iterator<Alignment> >(
+template void Aligner::alignRead<affix_ostream_iterator<Alignment> >(
 		const string& qid, const Sequence& seq,
 		affix_ostream_iterator<Alignment> dest);
 
-template void Aligner<SeqPosHashMultiMap>::
-alignRead<ostream_iterator<SAMRecord> >(
-		const string& qid, const Sequence& seq,
-		ostream_iterator<SAMRecord> dest);
-
-template void Aligner<SeqPosHashUniqueMap>::
-alignRead<ostream_iterator<SAMRecord> >(
+template void Aligner::alignRead<ostream_iterator<SAMRecord> >(
 		const string& qid, const Sequence& seq,
 		ostream_iterator<SAMRecord> dest);
@@ -5,8 +5,8 @@
 #include "ConstString.h"
 #include "Functional.h"
 #include "KAligner/Options.h"
+#include "KmerIndex.h"
 #include "Kmer.h"
-#include "UnorderedMap.h"
 #include "config.h"
 #include <cassert>
 #include <cstdlib>
@@ -22,87 +22,37 @@
 
 typedef std::string StringID;
 
-/** A tuple of a target ID and position. */
-struct Position
-{
-	uint32_t contig;
-	uint32_t pos; // 0 indexed
-	Position(
-	    uint32_t contig = std::numeric_limits<uint32_t>::max(),
-	    uint32_t pos = std::numeric_limits<uint32_t>::max())
-	  : contig(contig)
-	  , pos(pos)
-	{}
-
-	/** Mark this seed as a duplicate. */
-	void setDuplicate(const char* thisContig, const char* otherContig, const Sequence& kmer)
-	{
-		if (opt::multimap == opt::IGNORE)
-			contig = std::numeric_limits<uint32_t>::max();
-		else {
-			std::cerr << "error: duplicate k-mer in " << thisContig << " also in " << otherContig
-			          << ": " << kmer << '\n';
-			exit(EXIT_FAILURE);
-		}
-	}
-
-	/** Return whether this seed is a duplciate. */
-	bool isDuplicate() const { return contig == std::numeric_limits<uint32_t>::max(); }
-};
-
-typedef unordered_multimap<Kmer, Position, hash<Kmer>> SeqPosHashMultiMap;
-
-#if HAVE_GOOGLE_SPARSE_HASH_MAP
-#include <google/sparse_hash_map>
-typedef google::sparse_hash_map<Kmer, Position, hash<Kmer>> SeqPosHashUniqueMap;
-#else
-typedef unordered_map<Kmer, Position, hash<Kmer>> SeqPosHashUniqueMap;
-#endif
-
 typedef std::vector<Alignment> AlignmentVector;
 
 /**
  * Index a target sequence and align query sequences to that indexed
  * target.
  */
-template<class SeqPosHashMap>
 class Aligner
 {
   public:
-	typedef typename SeqPosHashMap::iterator map_iterator;
-	typedef typename SeqPosHashMap::const_iterator map_const_iterator;
-
-	Aligner(int hashSize, size_t buckets)
+	Aligner(int hashSize)
 	  : m_hashSize(hashSize)
-	  , m_target(buckets)
 	{}
 
-	Aligner(int hashSize, size_t buckets, float factor)
-	  : m_hashSize(hashSize)
-	{
-		m_target.max_load_factor(factor);
-		m_target.rehash(buckets);
-	}
-
 	void addReferenceSequence(const StringID& id, const Sequence& seq);
-	void addReferenceSequence(const Kmer& kmer, Position pos);
+	void buildIndex();
 
 	template<class oiterator>
 	void alignRead(const std::string& qid, const Sequence& seq, oiterator dest);
 
 	size_t size() const { return m_target.size(); }
-	size_t bucket_count() const { return m_target.bucket_count(); }
 
 	/** Return the number of duplicate k-mer in the target. */
 	size_t countDuplicates() const
 	{
 		assert(opt::multimap == opt::IGNORE);
-		return count_if(
-		    m_target.begin(), m_target.end(), [](const std::pair<const Kmer, Position>& s) {
-			    return s.second.isDuplicate();
-		    });
+		return m_target.countDuplicates();
 	}
 
+	friend std::ostream& operator<<(std::ostream& out, const Aligner& o);
+	friend std::istream& operator>>(std::istream& in, Aligner& o);
+
   private:
 	explicit Aligner(const Aligner&);
 
@@ -128,8 +78,11 @@ class Aligner
 	// The number of bases to hash on
 	int m_hashSize;
 
-	/** A map of k-mer to contig coordinates. */
-	SeqPosHashMap m_target;
+	/** An index of k-mer to contig coordinates. */
+	KmerIndex m_target;
+
+	/** The target sequences that are not yet indexed. */
+	std::vector<Sequence> m_pending;
 
 	/** A dictionary of contig IDs. */
 	std::vector<const_string> m_dict;
@@ -6,25 +6,28 @@
 #include "Iterator.h"
 #include "IOUtil.h"
 #include "MemoryUtil.h"
+#include "OrderedPipeline.h"
 #include "SAM.h"
 #include "StringUtil.h" // for toSI
 #include "Uncompress.h"
-#include "Pipe.h"
-#include "PipeMux.h"
 #include <algorithm>
 #include <cassert>
 #include <cctype>
 #include <cerrno>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <fstream>
 #include <getopt.h>
 #include <iostream>
-#include <pthread.h>
 #include <sstream>
 #include <string>
 #include <sys/stat.h>
 #include <sys/time.h>
+#include <unistd.h>
+#if _OPENMP
+# include <omp.h>
+#endif
 
 using namespace std;
 
@@ -50,17 +53,27 @@ static const char USAGE_MESSAGE[] =
 "                        [default]\n"
 "  -m, --multimap        allow duplicate k-mer in the target\n"
 "      --no-multimap     disallow duplicate k-mer in the target\n"
-"  -j, --threads=N       use N threads [2] up to one per query file\n"
+"  -j, --threads=N       use N threads [2]\n"
 "                        or if N is 0 use one thread per query file\n"
 "  -v, --verbose         display verbose output\n"
 "      --no-sam          output the results in KAligner format\n"
 "      --sam             output the results in SAM format\n"
 "      --seq             print the sequence with the alignments\n"
+"      --index=FILE      read the index of TARGET from FILE, or build\n"
+"                        the index and write it to FILE\n"
 "      --help            display this help and exit\n"
 "      --version         output version information and exit\n"
 "\n"
 "Report bugs to <" PACKAGE_BUGREPORT ">.\n";
 
+/** The number of queries aligned by a thread at a time */
+static const unsigned BATCH_SIZE = 4096;
+
+/** The maximum number of batches per thread read but not yet
+ * written, which bounds the memory used by alignments waiting to be
+ * output when one batch is slow to align. */
+static const unsigned MAX_PENDING_PER_THREAD = 2;
+
 /** Enumeration of output formats */
 enum format { KALIGNER, SAM };
 
@@ -71,6 +84,9 @@ namespace opt {
 	static unsigned section = 1;
 	static unsigned nsections = 1;
 
+	/** The file of the index of the target */
+	static string indexPath;
+
 	/** Output formats */
 	static int format;
 }
@@ -78,7 +94,7 @@ namespace opt {
 static const char shortopts[] = "ij:k:l:mo:s:v";
 
 
-enum { OPT_HELP = 1, OPT_VERSION, OPT_SYNC };
+enum { OPT_HELP = 1, OPT_VERSION, OPT_SYNC, OPT_INDEX };
 
 static const struct option longopts[] = {
 	{ "kmer",        required_argument, NULL, 'k' },
@@ -92,97 +108,20 @@ static const struct option longopts[] = {
 	{ "sam",         no_argument,       &opt::format, SAM },
 	{ "no-seq",		 no_argument,		&opt::printSeq, 0 },
 	{ "seq",		 no_argument,		&opt::printSeq, 1 },
+	{ "index",       required_argument, NULL, OPT_INDEX },
 	{ "help",        no_argument,       NULL, OPT_HELP },
 	{ "version",     no_argument,       NULL, OPT_VERSION },
 	{ NULL, 0, NULL, 0 }
 };
 
-/** Return the number of k-mer in the specified file. */
-static size_t countKmer(const string& path)
-{
-	struct stat st;
-	if (stat(path.c_str(), &st) == -1) {
-		perror(path.c_str());
-		exit(EXIT_FAILURE);
-	}
+static void readContigsIntoDB(string refFastaFile, Aligner& aligner);
+static bool readIndex(const string& path, const string& refFastaFile,
+		Aligner& aligner);
+static void writeIndex(const string& path, const string& refFastaFile,
+		const Aligner& aligner);
 
-	if (!S_ISREG(st.st_mode)) {
-		cerr << "Not calculating k-mer in `" << path
-			<< "', because it is not a regular file.\n";
-		return 500000000;
-	}
-
-	if (opt::verbose > 0)
-		cerr << "Reading target `" << path << "'..." << endl;
-
-	ifstream in(path.c_str());
-	assert(in.is_open());
-	size_t scaffolds = 0, contigs = 0, bases = 0;
-	enum { ID, SEQUENCE, GAP } state = SEQUENCE;
-	for (char c; in.get(c);) {
-		c = toupper(c);
-		switch (state) {
-		  case ID:
-			if (c == '\n')
-				state = SEQUENCE;
-			break;
-		  case SEQUENCE:
-		  case GAP:
-			switch (c) {
-			  case '>':
-				scaffolds++;
-				contigs++;
-				state = ID;
-				break;
-			  case 'N':
-			  case 'B': case 'D': case 'H': case 'K': case 'M':
-			  case 'R': case 'S': case 'V': case 'W': case 'Y':
-				if (state != GAP)
-					contigs++;
-				state = GAP;
-				break;
-			  case 'A': case 'C': case 'G': case 'T':
-			  case '0': case '1': case '2': case '3':
-				bases++;
-				state = SEQUENCE;
-				break;
-			  case '\n':
-				break;
-			  default:
-				cerr << "error: unexpected character: "
-					"`" << c << "'\n";
-				exit(EXIT_FAILURE);
-			}
-			break;
-		}
-	}
-
-	size_t overlaps = contigs * (opt::k-1);
-	size_t kmer = bases - overlaps;
-	if (opt::verbose > 0) {
-		cerr << "Read " << bases << " bases, "
-			<< contigs << " contigs, " << scaffolds << " scaffolds"
-			" from `" << path << "'. "
-			"Expecting " << kmer << " k-mer.\n";
-		cerr << "Index will use at least "
-			<< toSI(kmer * sizeof(pair<Kmer, Position>))
-			<< "B.\n";
-	}
-	assert(bases > overlaps);
-	return kmer;
-}
-
-template <class SeqPosHashMap>
-static void readContigsIntoDB(string refFastaFile,
-		Aligner<SeqPosHashMap>& aligner);
-static void *alignReadsToDB(void *arg);
-static void *readFile(void *arg);
-
-/** Unique aligner using map */
-static Aligner<SeqPosHashUniqueMap> *g_aligner_u;
-
-/** Multimap aligner using multimap */
-static Aligner<SeqPosHashMultiMap> *g_aligner_m;
+/** The aligner */
+static Aligner *g_aligner;
 
 /** Number of reads. */
 static unsigned g_readCount;
@@ -190,104 +129,138 @@ static unsigned g_readCount;
 /** Number of reads that aligned. */
 static unsigned g_alignedCount;
 
-/** Guard cerr. */
-static pthread_mutex_t g_mutexCerr = PTHREAD_MUTEX_INITIALIZER;
-
-/** Stores the output string and the read index number for an
- * alignment. */
-struct OutData
+/** Read the query files in turn, one record from each, so that the
+ * mates of paired files are adjacent. */
+struct QueryReader
 {
-	string s;
-	size_t index;
+	typedef FastaRecord value_type;
+
+	vector<FastaReader*> files;
+	size_t i;
+
+	QueryReader() : i(0) { }
 
-	OutData(string s = string(), size_t index = 0)
-		: s(s), index(index) { }
+	~QueryReader()
+	{
+		for (size_t j = 0; j < files.size(); ++j)
+			delete files[j];
+	}
+
+	/** Open the specified query file. */
+	void open(const char* path)
+	{
+		if (opt::verbose > 0)
+			cerr << "Reading `" << path << "'...\n";
+		files.push_back(new FastaReader(path, FastaReader::FOLD_CASE));
+	}
 
-	/** Operator needed for sorting priority queue. */
-	bool operator<(const OutData& a) const
+	bool operator()(FastaRecord& rec)
 	{
-		// Smaller index number has higher priority.
-		return index > a.index;
+		while (!files.empty()) {
+			if (i >= files.size())
+				i = 0;
+			if (*files[i] >> rec) {
+				i++;
+				return true;
+			}
+			assert(files[i]->eof());
+			delete files[i];
+			files.erase(files.begin() + i);
+		}
+		return false;
 	}
 };
 
-/** Shares data between workers and the output thread. */
-static Pipe<OutData> g_pipeOut(1<<7);
+/** The alignments of a query. */
+struct OutData
+{
+	string s;
+	bool aligned;
+};
 
-/** Shares data between producer and worker threads. */
-static PipeMux<FastaRecord> g_pipeMux(1);
+/** Align a query to the target. */
+struct QueryAligner
+{
+	typedef OutData result_type;
 
-/** Notification of the current size of the g_pqueue. */
-static size_t g_pqSize;
-static const size_t MAX_PQ_SIZE = 1000;
+	void operator()(const FastaRecord& rec, OutData& result) const
+	{
+		const Sequence& seq = rec.seq;
+		ostringstream output;
+		if (seq.find_first_not_of("ACGT0123") == string::npos) {
+			if (opt::colourSpace)
+				assert(isdigit(seq[0]));
+			else
+				assert(isalpha(seq[0]));
+		}
 
-/** Conditional variable used to block workers until the g_pqueue has
- * become small enough. */
-static pthread_cond_t g_pqSize_cv = PTHREAD_COND_INITIALIZER;
-static pthread_mutex_t g_mutexPqSize = PTHREAD_MUTEX_INITIALIZER;
+		switch (opt::format) {
+		  case KALIGNER:
+			g_aligner->alignRead(rec.id, seq,
+					affix_ostream_iterator<Alignment>(output, "\t"));
+			break;
+		  case SAM:
+			g_aligner->alignRead(rec.id, seq,
+					ostream_iterator<SAMRecord>(output, "\n"));
+			break;
+		}
 
-static void* printAlignments(void*)
-{
-	priority_queue<OutData> pqueue;
-	size_t index = 1;
-	for (pair<OutData, size_t> p = g_pipeOut.pop();
-			p.second > 0; p = g_pipeOut.pop()) {
-		pqueue.push(p.first);
-		while (!pqueue.empty()) {
-			const OutData& rec = pqueue.top();
-			if (index == rec.index) {
-				// Print the record at the current index.
-				index++;
-				assert(rec.index > 0);
-				cout << rec.s;
-				assert_good(cout, "stdout");
-				pqueue.pop();
-			} else if (g_pipeMux.invalidEntry(index)) {
-				// Skip this index since it is invalid.
-				index++;
-			} else {
-				// The record for this index has not been added, get
-				// another record from the pipe.
-				break;
+		ostringstream out;
+		string s = output.str();
+		switch (opt::format) {
+		  case KALIGNER:
+			out << rec.id;
+			if (opt::printSeq) {
+				out << ' ';
+				if (opt::colourSpace)
+					out << rec.anchor;
+				out << seq;
 			}
+			out << s << '\n';
+			break;
+		  case SAM:
+			out << s;
+			break;
 		}
-
-		// Let waiting workers continue if the pqueue is small enough.
-		pthread_mutex_lock(&g_mutexPqSize);
-		g_pqSize = pqueue.size();
-		if (g_pqSize < MAX_PQ_SIZE)
-			pthread_cond_broadcast(&g_pqSize_cv);
-		pthread_mutex_unlock(&g_mutexPqSize);
+		result.s = out.str();
+		result.aligned = !s.empty();
 	}
-	return NULL;
-}
-
-/** Store a FastaReader and Pipe. */
-struct WorkerArg {
-	FastaReader& in;
-	Pipe<FastaRecord>& out;
-	WorkerArg(FastaReader& in, Pipe<FastaRecord>& out)
-		: in(in), out(out) { }
-	~WorkerArg() { delete &in; }
 };
 
-static pthread_t getReadFiles(const char *readsFile)
+/** @Returns the time in seconds between [start, end]. */
+static double timeDiff(const timeval& start, const timeval& end)
 {
-	if (opt::verbose > 0) {
-		pthread_mutex_lock(&g_mutexCerr);
-		cerr << "Reading `" << readsFile << "'...\n";
-		pthread_mutex_unlock(&g_mutexCerr);
-	}
+	double result = (double)end.tv_sec +
+		(double)end.tv_usec/1000000.0;
+	result -= (double)start.tv_sec +
+		(double)start.tv_usec/1000000.0;
+	return result;
+}
 
-	FastaReader* in = new FastaReader(
-			readsFile, FastaReader::FOLD_CASE);
-	WorkerArg* arg = new WorkerArg(*in, *g_pipeMux.addPipe());
+/** Write the alignments in the order in which the queries were read,
+ * and report progress. */
+struct AlignmentWriter
+{
+	timeval start;
 
-	pthread_t thread;
-	pthread_create(&thread, NULL, readFile, static_cast<void*>(arg));
+	AlignmentWriter() { gettimeofday(&start, NULL); }
 
-	return thread;
-}
+	void operator()(const OutData& o)
+	{
+		cout << o.s;
+		assert_good(cout, "stdout");
+		if (o.aligned)
+			g_alignedCount++;
+		if (++g_readCount % 1000000 == 0 && opt::verbose > 0) {
+			timeval end;
+			gettimeofday(&end, NULL);
+			double result = timeDiff(start, end);
+			cerr << "Aligned " << g_readCount << " reads at "
+				<< (int)(1000000 / result) << " reads/sec.\n";
+			start = end;
+		}
+	}
+};
 
 int main(int argc, char** argv)
 {
@@ -316,6 +289,7 @@ int main(int argc, char** argv)
 			case 'v': opt::verbose++; break;
 			case 's': arg >> opt::section >> delim >>
 					  opt::nsections; break;
+			case OPT_INDEX: arg >> opt::indexPath; break;
 			case OPT_HELP:
 				cout << USAGE_MESSAGE;
 				exit(EXIT_SUCCESS);
@@ -364,80 +338,57 @@ int main(int argc, char** argv)
 		"@PG\tID:" PROGRAM "\tVN:" VERSION "\t"
 		"CL:" << commandLine << '\n';
 
-	size_t numKmer = countKmer(refFastaFile);
-	if (opt::multimap == opt::MULTIMAP) {
-		g_aligner_m = new Aligner<SeqPosHashMultiMap>(opt::k,
-				numKmer);
-		readContigsIntoDB(refFastaFile, *g_aligner_m);
-	} else {
-#if HAVE_GOOGLE_SPARSE_HASH_MAP
-		g_aligner_u = new Aligner<SeqPosHashUniqueMap>(opt::k,
-				numKmer, 0.3);
-#else
-		g_aligner_u = new Aligner<SeqPosHashUniqueMap>(opt::k,
-				numKmer);
+#if _OPENMP
+	omp_set_num_threads(opt::threads);
 #endif
-		readContigsIntoDB(refFastaFile, *g_aligner_u);
-	}
-
-	g_readCount = 0;
-
-	vector<pthread_t> producer_threads;
-	transform(argv + optind, argv + argc,
-			back_inserter(producer_threads), getReadFiles);
 
-	vector<pthread_t> threads;
-	for (int i = 0; i < opt::threads; i++) {
-		pthread_t thread;
-		pthread_create(&thread, NULL, alignReadsToDB, NULL);
-		threads.push_back(thread);
+	g_aligner = new Aligner(opt::k);
+	if (opt::indexPath.empty()
+			|| !readIndex(opt::indexPath, refFastaFile, *g_aligner)) {
+		readContigsIntoDB(refFastaFile, *g_aligner);
+		if (!opt::indexPath.empty())
+			writeIndex(opt::indexPath, refFastaFile, *g_aligner);
 	}
 
-	pthread_t out_thread;
-	pthread_create(&out_thread, NULL, printAlignments, NULL);
-
-	void *status;
-	// Wait for all threads to finish.
-	for (size_t i = 0; i < producer_threads.size(); i++)
-		pthread_join(producer_threads[i], &status);
-	for (size_t i = 0; i < threads.size(); i++)
-		pthread_join(threads[i], &status);
-	g_pipeOut.close();
-	pthread_join(out_thread, &status);
+	opt::chastityFilter = false;
+	opt::trimMasked = false;
+	QueryReader reader;
+	for (int i = optind; i < argc; ++i)
+		reader.open(argv[i]);
+	QueryAligner aligner;
+	AlignmentWriter writer;
+	orderedPipeline(reader, aligner, writer, BATCH_SIZE,
+			MAX_PENDING_PER_THREAD * opt::threads);
 
 	if (opt::verbose > 0)
 		cerr << "Aligned " << g_alignedCount
 			<< " of " << g_readCount << " reads ("
 			<< (float)100 * g_alignedCount / g_readCount << "%)\n";
 
-	if (opt::multimap == opt::MULTIMAP)
-		delete g_aligner_m;
-	else
-		delete g_aligner_u;
+	delete g_aligner;
 
 	return 0;
 }
 
-template <class SeqPosHashMap>
-static void printProgress(const Aligner<SeqPosHashMap>& align,
-		unsigned count)
+/** The @SQ headers of the target */
+static string g_headers;
+
+/** Print the memory used to index the target. */
+static void printProgress(const Aligner& align, unsigned count)
 {
-	size_t size = align.size();
-	size_t buckets = align.bucket_count();
-	cerr << "Read " << count << " contigs. "
-		"Hash load: " << size << " / " << buckets
-		<< " = " << (float)size / buckets
-		<< " using " << toSI(getMemoryUsage()) << "B." << endl;
+	cerr << "Read " << count << " contigs";
+	if (align.size() > 0)
+		cerr << " and indexed " << align.size() << " k-mer";
+	cerr << " using " << toSI(getMemoryUsage()) << "B." << endl;
 }
 
-template <class SeqPosHashMap>
-static void readContigsIntoDB(string refFastaFile,
-		Aligner<SeqPosHashMap>& aligner)
+static void readContigsIntoDB(string refFastaFile, Aligner& aligner)
 {
 	if (opt::verbose > 0)
 		cerr << "Reading target `" << refFastaFile << "'..." << endl;
 
 	unsigned count = 0;
+	ostringstream headers;
 	FastaReader in(refFastaFile.c_str(), FastaReader::FOLD_CASE);
 	if (opt::nsections > 1)
 		in.split(opt::section, opt::nsections);
@@ -452,7 +403,7 @@ static void readContigsIntoDB(string refFastaFile,
 				assert(isalpha(rec.seq[0]));
 		}
 
-		cout << "@SQ\tSN:" << rec.id
+		headers << "@SQ\tSN:" << rec.id
 			<< "\tLN:" << rec.seq.length() << '\n';
 		aligner.addReferenceSequence(rec.id, rec.seq);
 
@@ -461,6 +412,10 @@ static void readContigsIntoDB(string refFastaFile,
 			printProgress(aligner, count);
 	}
 	assert(in.eof());
+	g_headers = headers.str();
+	cout << g_headers;
+
+	aligner.buildIndex();
 	if (opt::verbose > 0)
 		printProgress(aligner, count);
 
@@ -474,116 +429,89 @@ static void readContigsIntoDB(string refFastaFile,
 	}
 }
 
-/** Read each fasta record from 'in', and add it to 'pipe'. */
-static void readFile(FastaReader& in, Pipe<FastaRecord>& pipe)
-{
-	for (FastaRecord rec; in >> rec;)
-		pipe.push(rec);
-	assert(in.eof());
-	pipe.close();
-}
+/** The version of the index file format */
+static const char INDEX_VERSION[] = "KAligner-index-1";
 
-/** Producer thread. */
-static void* readFile(void* arg)
-{
-	WorkerArg* p = static_cast<WorkerArg*>(arg);
-	readFile(p->in, p->out);
-	delete p;
-	return NULL;
-}
-
-/** @Returns the time in seconds between [start, end]. */
-static double timeDiff(const timeval& start, const timeval& end)
+/** Return the parameters that determine the index of the target. */
+static string indexParameters(const string& refFastaFile)
 {
-	double result = (double)end.tv_sec +
-		(double)end.tv_usec/1000000.0;
-	result -= (double)start.tv_sec +
-		(double)start.tv_usec/1000000.0;
-	return result;
+	struct stat st;
+	if (stat(refFastaFile.c_str(), &st) == -1) {
+		perror(refFastaFile.c_str());
+		exit(EXIT_FAILURE);
+	}
+	ostringstream ss;
+	ss << opt::k << ' ' << opt::multimap << ' '
+		<< opt::section << '/' << opt::nsections << ' '
+		<< st.st_size << ' ' << st.st_mtime;
+	return ss.str();
 }
 
-static void* alignReadsToDB(void*)
+/** Read the index of the target from the specified file.
+ * @return false if the file does not exist or does not match the
+ * target and options
+ */
+static bool readIndex(const string& path, const string& refFastaFile,
+		Aligner& aligner)
 {
-	opt::chastityFilter = false;
-	opt::trimMasked = false;
-	static timeval start, end;
-
-	pthread_mutex_lock(&g_mutexCerr);
-	gettimeofday(&start, NULL);
-	pthread_mutex_unlock(&g_mutexCerr);
+	ifstream in(path.c_str(), ios::binary);
+	if (!in)
+		return false;
+
+	string version, params;
+	getline(in, version);
+	getline(in, params);
+	if (version != INDEX_VERSION
+			|| params != indexParameters(refFastaFile)) {
+		if (opt::verbose > 0)
+			cerr << "The index `" << path << "' does not match the "
+				"target `" << refFastaFile << "'. Rebuilding it.\n";
+		return false;
+	}
 
-	for (pair<FastaRecord, size_t> recPair = g_pipeMux.nextValue();
-			recPair.second > 0; recPair = g_pipeMux.nextValue()) {
-		const FastaRecord& rec = recPair.first;
-		const Sequence& seq = rec.seq;
-		ostringstream output;
-		if (seq.find_first_not_of("ACGT0123") == string::npos) {
-			if (opt::colourSpace)
-				assert(isdigit(seq[0]));
-			else
-				assert(isalpha(seq[0]));
-		}
+	if (opt::verbose > 0)
+		cerr << "Reading index `" << path << "'..." << endl;
+	size_t n;
+	in >> opt::colourSpace >> n >> expect("\n");
+	g_headers.resize(n);
+	in.read(&g_headers[0], n);
+	in >> aligner;
+	if (!in || in.peek() != EOF) {
+		cerr << "error: `" << path << "': the index is truncated or "
+			"corrupt. Remove it to rebuild it.\n";
+		exit(EXIT_FAILURE);
+	}
+	cout << g_headers;
 
-		switch (opt::format) {
-		  case KALIGNER:
-			if (opt::multimap == opt::MULTIMAP)
-				g_aligner_m->alignRead(rec.id, seq,
-						affix_ostream_iterator<Alignment>(
-							output, "\t"));
-			else
-				g_aligner_u->alignRead(rec.id, seq,
-						affix_ostream_iterator<Alignment>(
-							output, "\t"));
-			break;
-		  case SAM:
-			if (opt::multimap == opt::MULTIMAP)
-				g_aligner_m->alignRead(rec.id, seq,
-						ostream_iterator<SAMRecord>(output, "\n"));
-			else
-				g_aligner_u->alignRead(rec.id, seq,
-						ostream_iterator<SAMRecord>(output, "\n"));
-			break;
-		}
+	if (opt::verbose > 0)
+		printProgress(aligner, 0);
+	return true;
+}
 
-		ostringstream out;
-		string s = output.str();
-		switch (opt::format) {
-		  case KALIGNER:
-			out << rec.id;
-			if (opt::printSeq) {
-				out << ' ';
-				if (opt::colourSpace)
-					out << rec.anchor;
-				out << seq;
-			}
-			out << s << '\n';
-			break;
-		  case SAM:
-			out << s;
-			break;
-		}
-		g_pipeOut.push(OutData(out.str(), recPair.second));
-
-		// Prevent the priority_queue from growing too large by
-		// waiting for threads going far too slow.
-		pthread_mutex_lock(&g_mutexPqSize);
-		if (g_pqSize >= MAX_PQ_SIZE)
-			pthread_cond_wait(&g_pqSize_cv, &g_mutexPqSize);
-		pthread_mutex_unlock(&g_mutexPqSize);
-
-		if (opt::verbose > 0) {
-			pthread_mutex_lock(&g_mutexCerr);
-			if (!s.empty())
-				g_alignedCount++;
-			if (++g_readCount % 1000000 == 0) {
-				gettimeofday(&end, NULL);
-				double result = timeDiff(start, end);
-				cerr << "Aligned " << g_readCount << " reads at "
-					<< (int)(1000000 / result) << " reads/sec.\n";
-				start = end;
-			}
-			pthread_mutex_unlock(&g_mutexCerr);
-		}
+/** Write the index of the target to the specified file. The index
+ * is written to a temporary file, which is renamed when complete, so
+ * that an interrupted run does not leave a partial index.
+ */
+static void writeIndex(const string& path, const string& refFastaFile,
+		const Aligner& aligner)
+{
+	if (opt::verbose > 0)
+		cerr << "Writing index `" << path << "'..." << endl;
+	ostringstream ss;
+	ss << path << '.' << getpid() << ".tmp";
+	string tmpPath = ss.str();
+	ofstream out(tmpPath.c_str(), ios::binary);
+	assert_good(out, tmpPath);
+	out << INDEX_VERSION << '\n'
+		<< indexParameters(refFastaFile) << '\n'
+		<< opt::colourSpace << ' ' << g_headers.size() << '\n'
+		<< g_headers << aligner;
+	out.close();
+	assert_good(out, tmpPath);
+	if (rename(tmpPath.c_str(), path.c_str()) == -1) {
+		cerr << "error: renaming `" << tmpPath << "' to `" << path
+			<< "': " << strerror(errno) << '\n';
+		unlink(tmpPath.c_str());
+		exit(EXIT_FAILURE);
 	}
-	return NULL;
 }
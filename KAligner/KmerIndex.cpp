@@ -0,0 +1,286 @@
+#include "KmerIndex.h"
+#include "IOUtil.h"
+#include <algorithm>
+#include <cstdlib>
+#if _OPENMP
+# include <omp.h>
+#endif
+
+using namespace std;
+
+static const char KMERINDEX_VERSION[] = "KmerIndex-1";
+
+/** Return the number of chunks into which to divide the input for
+ * parallel processing. */
+static unsigned numChunks()
+{
+#if _OPENMP
+	return omp_get_max_threads();
+#else
+	return 1;
+#endif
+}
+
+/** Order the k-mer by their packed sequence and then by decreasing
+ * position, which is the order in which the hash multimap that
+ * preceded this index reported them. */
+struct KeyLess
+{
+	const char* keys;
+	const Position* positions;
+	unsigned bytes;
+
+	KeyLess(const char* keys, const Position* positions, unsigned bytes)
+		: keys(keys), positions(positions), bytes(bytes) { }
+
+	bool operator()(size_t a, size_t b) const
+	{
+		int c = memcmp(keys + a * bytes, keys + b * bytes, bytes);
+		return c != 0 ? c < 0 : positions[b] < positions[a];
+	}
+};
+
+void KmerIndex::assign(vector<char>& keys, vector<Position>& positions)
+{
+	size_t n = positions.size();
+	assert(keys.size() == n * m_bytes);
+
+	// Count the k-mer of each bucket in each chunk of the input.
+	const long chunks = numChunks();
+	vector< vector<size_t> > offsets(chunks,
+			vector<size_t>(NUM_BUCKETS));
+#pragma omp parallel for
+	for (long t = 0; t < chunks; ++t) {
+		vector<size_t>& counts = offsets[t];
+		for (size_t i = n * t / chunks; i < n * (t + 1) / chunks; ++i)
+			counts[bucket(&keys[i * m_bytes])]++;
+	}
+
+	// Assign each chunk its range of each bucket.
+	m_buckets.assign(NUM_BUCKETS + 1, 0);
+	size_t sum = 0;
+	for (unsigned b = 0; b < NUM_BUCKETS; ++b) {
+		m_buckets[b] = sum;
+		for (long t = 0; t < chunks; ++t) {
+			size_t count = offsets[t][b];
+			offsets[t][b] = sum;
+			sum += count;
+		}
+	}
+	m_buckets[NUM_BUCKETS] = sum;
+	assert(sum == n);
+
+	// Distribute the k-mer to their buckets.
+	vector<size_t> order(n);
+#pragma omp parallel for
+	for (long t = 0; t < chunks; ++t) {
+		vector<size_t>& next = offsets[t];
+		for (size_t i = n * t / chunks; i < n * (t + 1) / chunks; ++i)
+			order[next[bucket(&keys[i * m_bytes])]++] = i;
+	}
+	offsets.clear();
+
+	// Sort each bucket.
+	KeyLess less(keys.data(), positions.data(), m_bytes);
+#pragma omp parallel for schedule(dynamic, 64)
+	for (long b = 0; b < (long)NUM_BUCKETS; ++b)
+		sort(order.begin() + m_buckets[b],
+				order.begin() + m_buckets[b + 1], less);
+
+	m_keys.resize(n * m_bytes);
+	m_positions.resize(n);
+#pragma omp parallel for
+	for (long i = 0; i < (long)n; ++i) {
+		memcpy(&m_keys[i * m_bytes], &keys[order[i] * m_bytes], m_bytes);
+		m_positions[i] = positions[order[i]];
+	}
+
+	vector<char>().swap(keys);
+	vector<Position>().swap(positions);
+}
+
+/** Return the range of indices of the specified packed k-mer. */
+pair<size_t, size_t> KmerIndex::find(const char* k) const
+{
+	if (m_buckets.empty())
+		return make_pair(0, 0);
+	unsigned b = bucket(k);
+	size_t lo = m_buckets[b], hi = m_buckets[b + 1];
+
+	// Find the first k-mer not less than k.
+	for (size_t n = hi - lo; n > 0;) {
+		size_t half = n / 2;
+		if (memcmp(key(lo + half), k, m_bytes) < 0) {
+			lo += half + 1;
+			n -= half + 1;
+		} else
+			n = half;
+	}
+
+	// Find the first k-mer greater than k.
+	size_t end = lo;
+	for (size_t n = hi - lo; n > 0;) {
+		size_t half = n / 2;
+		if (memcmp(key(end + half), k, m_bytes) <= 0) {
+			end += half + 1;
+			n -= half + 1;
+		} else
+			n = half;
+	}
+	return make_pair(lo, end);
+}
+
+bool KmerIndex::removeDuplicates(Duplicate& dup)
+{
+	size_t n = m_positions.size();
+	if (n == 0)
+		return false;
+
+	// Decide which k-mer to keep. The first occurrence of a k-mer and
+	// its reverse complement is kept. The positions of a k-mer are
+	// sorted in decreasing order, so that occurrence is the last of
+	// its run or the last of the run of its reverse complement.
+	enum { DROP, KEEP, KEEP_DUPLICATE };
+	vector<uint8_t> keep(n, DROP);
+	vector<size_t> counts(NUM_BUCKETS);
+	bool found = false;
+	size_t dupFirst = 0, dupSecond = 0;
+#pragma omp parallel
+	{
+		bool myFound = false;
+		size_t myFirst = 0, mySecond = 0;
+		char rcKey[Kmer::NUM_BYTES];
+#pragma omp for schedule(dynamic, 64)
+		for (long b = 0; b < (long)NUM_BUCKETS; ++b) {
+			for (size_t i = m_buckets[b], j; i < m_buckets[b + 1]; i = j) {
+				for (j = i + 1; j < m_buckets[b + 1]
+						&& memcmp(key(j), key(i), m_bytes) == 0; ++j)
+					;
+
+				char k[Kmer::NUM_BYTES] = {};
+				memcpy(k, key(i), m_bytes);
+				Kmer kmer;
+				kmer.unserialize(k);
+				reverseComplement(kmer).serialize(rcKey);
+				pair<size_t, size_t> rc
+					= memcmp(rcKey, k, m_bytes) == 0 ? make_pair(j, j)
+					: find(rcKey);
+				size_t first = j - 1, rcFirst = rc.second - 1;
+				if (rc.first != rc.second
+						&& m_positions[rcFirst] < m_positions[first])
+					continue;
+
+				size_t total = (j - i) + (rc.second - rc.first);
+				keep[first] = total > 1 ? KEEP_DUPLICATE : KEEP;
+				counts[b]++;
+				if (total > 1) {
+					size_t second = j - i > 1
+						&& (rc.first == rc.second
+							|| m_positions[first - 1] < m_positions[rcFirst])
+						? first - 1 : rcFirst;
+					if (!myFound
+							|| m_positions[second] < m_positions[mySecond]) {
+						myFound = true;
+						myFirst = first;
+						mySecond = second;
+					}
+				}
+			}
+		}
+#pragma omp critical(removeDuplicates)
+		if (myFound && (!found
+					|| m_positions[mySecond] < m_positions[dupSecond])) {
+			found = true;
+			dupFirst = myFirst;
+			dupSecond = mySecond;
+		}
+	}
+
+	if (found) {
+		dup.first = m_positions[dupFirst];
+		dup.second = m_positions[dupSecond];
+		char k[Kmer::NUM_BYTES] = {};
+		memcpy(k, key(dupSecond), m_bytes);
+		dup.kmer.unserialize(k);
+	}
+
+	// Copy the k-mer that are kept.
+	vector<size_t> buckets(NUM_BUCKETS + 1);
+	for (unsigned b = 0; b < NUM_BUCKETS; ++b)
+		buckets[b + 1] = buckets[b] + counts[b];
+	vector<char> keys(buckets[NUM_BUCKETS] * m_bytes);
+	vector<Position> positions(buckets[NUM_BUCKETS]);
+#pragma omp parallel for schedule(dynamic, 64)
+	for (long b = 0; b < (long)NUM_BUCKETS; ++b) {
+		size_t out = buckets[b];
+		for (size_t i = m_buckets[b]; i < m_buckets[b + 1]; ++i) {
+			if (keep[i] == DROP)
+				continue;
+			memcpy(&keys[out * m_bytes], key(i), m_bytes);
+			positions[out] = m_positions[i];
+			if (keep[i] == KEEP_DUPLICATE)
+				positions[out].setDuplicate();
+			out++;
+		}
+		assert(out == buckets[b + 1]);
+	}
+	m_keys.swap(keys);
+	m_positions.swap(positions);
+	m_buckets.swap(buckets);
+	return found;
+}
+
+size_t KmerIndex::countDuplicates() const
+{
+	size_t n = 0;
+#pragma omp parallel for reduction(+:n)
+	for (long i = 0; i < (long)m_positions.size(); ++i)
+		if (m_positions[i].isDuplicate())
+			n++;
+	return n;
+}
+
+/** Store an index. */
+std::ostream& operator<<(std::ostream& out, const KmerIndex& o)
+{
+	out << KMERINDEX_VERSION << '\n'
+		<< o.m_bytes << ' ' << o.m_positions.size() << '\n';
+	out.write(o.m_keys.data(), o.m_keys.size());
+	out.write(reinterpret_cast<const char*>(o.m_positions.data()),
+			o.m_positions.size() * sizeof o.m_positions[0]);
+	out.write(reinterpret_cast<const char*>(o.m_buckets.data()),
+			o.m_buckets.size() * sizeof o.m_buckets[0]);
+	return out;
+}
+
+/** Load an index. Set the fail bit of the stream if the index is
+ * truncated or does not match the k-mer size. */
+std::istream& operator>>(std::istream& in, KmerIndex& o)
+{
+	std::string version;
+	std::getline(in, version);
+	if (version != KMERINDEX_VERSION) {
+		std::cerr << "error: the version of this k-mer index, `"
+			<< version << "', does not match the version required "
+			"by this program, `" << KMERINDEX_VERSION << "'.\n";
+		exit(EXIT_FAILURE);
+	}
+
+	size_t n;
+	in >> o.m_bytes >> n >> expect("\n");
+	if (!in || o.m_bytes != Kmer::bytes()) {
+		in.setstate(std::ios::failbit);
+		return in;
+	}
+	o.m_keys.resize(n * o.m_bytes);
+	o.m_positions.resize(n);
+	o.m_buckets.resize(KmerIndex::NUM_BUCKETS + 1);
+	in.read(o.m_keys.data(), o.m_keys.size());
+	in.read(reinterpret_cast<char*>(o.m_positions.data()),
+			n * sizeof o.m_positions[0]);
+	in.read(reinterpret_cast<char*>(o.m_buckets.data()),
+			o.m_buckets.size() * sizeof o.m_buckets[0]);
+	if (o.m_buckets.front() != 0 || o.m_buckets.back() != n)
+		in.setstate(std::ios::failbit);
+	return in;
+}
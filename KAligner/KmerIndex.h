@@ -0,0 +1,126 @@
+#ifndef KMERINDEX_H
+#define KMERINDEX_H 1
+
+#include "Kmer.h"
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+/** A tuple of a target ID and position. */
+struct Position
+{
+	uint32_t contig;
+	uint32_t pos; // 0 indexed
+	Position(
+	    uint32_t contig = std::numeric_limits<uint32_t>::max(),
+	    uint32_t pos = std::numeric_limits<uint32_t>::max())
+	  : contig(contig)
+	  , pos(pos)
+	{}
+
+	/** Mark this seed as a duplicate. */
+	void setDuplicate() { contig = std::numeric_limits<uint32_t>::max(); }
+
+	/** Return whether this seed is a duplciate. */
+	bool isDuplicate() const { return contig == std::numeric_limits<uint32_t>::max(); }
+
+	bool operator<(const Position& o) const
+	{
+		return contig != o.contig ? contig < o.contig : pos < o.pos;
+	}
+};
+
+/** An index of the k-mer of a target. The k-mer are packed to
+ * Kmer::bytes() bytes and stored in a sorted array. A directory of
+ * the first two bytes of each k-mer, its first eight bases, locates
+ * the bucket of a k-mer in constant time, and the k-mer is found in
+ * its bucket by binary search.
+ */
+class KmerIndex
+{
+  public:
+	/** The positions of a k-mer */
+	typedef std::pair<const Position*, const Position*> Range;
+
+	/** A k-mer seen more than once in the target. */
+	struct Duplicate
+	{
+		/** The first occurrence of the k-mer */
+		Position first;
+		/** The second occurrence of the k-mer */
+		Position second;
+		/** The k-mer in the orientation of its second occurrence */
+		Kmer kmer;
+	};
+
+	KmerIndex() : m_bytes(Kmer::bytes()) { }
+
+	/** Index the specified k-mer, which are packed to Kmer::bytes()
+	 * bytes each, and their positions. The k-mer are sorted in
+	 * parallel, first by bucket and then within each bucket. The
+	 * positions of a k-mer are sorted in decreasing order. The
+	 * arguments are cleared.
+	 */
+	void assign(std::vector<char>& keys, std::vector<Position>& positions);
+
+	/** Keep only the first occurrence of each k-mer, counting a
+	 * k-mer and its reverse complement as the same k-mer, and mark
+	 * it as a duplicate if it occurs more than once.
+	 * @param [out] dup the duplicate k-mer whose second occurrence
+	 * is seen first
+	 * @return whether any k-mer is a duplicate
+	 */
+	bool removeDuplicates(Duplicate& dup);
+
+	/** Return the positions of the specified k-mer. */
+	Range equal_range(const Kmer& kmer) const
+	{
+		char key[Kmer::NUM_BYTES];
+		kmer.serialize(key);
+		std::pair<size_t, size_t> range = find(key);
+		const Position* p = m_positions.data();
+		return Range(p + range.first, p + range.second);
+	}
+
+	/** Return the number of k-mer in this index. */
+	size_t size() const { return m_positions.size(); }
+
+	/** Return the number of duplicate k-mer. */
+	size_t countDuplicates() const;
+
+	friend std::ostream& operator<<(std::ostream& out, const KmerIndex& o);
+	friend std::istream& operator>>(std::istream& in, KmerIndex& o);
+
+  private:
+	/** The number of buckets */
+	static const unsigned NUM_BUCKETS = 1 << 16;
+
+	/** Return the packed k-mer at the specified index. */
+	const char* key(size_t i) const { return &m_keys[i * m_bytes]; }
+
+	/** Return the bucket of the specified packed k-mer. */
+	unsigned bucket(const char* key) const
+	{
+		return (uint8_t)key[0] << 8 | (m_bytes > 1 ? (uint8_t)key[1] : 0);
+	}
+
+	std::pair<size_t, size_t> find(const char* key) const;
+
+	/** The number of bytes of a packed k-mer */
+	unsigned m_bytes;
+
+	/** The packed k-mer, sorted */
+	std::vector<char> m_keys;
+
+	/** The position of each k-mer */
+	std::vector<Position> m_positions;
+
+	/** The index of the first k-mer of each bucket */
+	std::vector<size_t> m_buckets;
+};
+
+#endif
@@ -0,0 +1,184 @@
+#ifndef MAP_MAPPER_H
+#define MAP_MAPPER_H 1
+
+#include "FMIndex.h"
+#include "FastaIndex.h"
+#include "IOUtil.h"
+#include "MemoryUtil.h"
+#include "SAM.h"
+#include "StringUtil.h"
+#include <algorithm>
+#include <cassert>
+#include <cctype> // for toupper
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+typedef FMIndex::Match Match;
+
+/** Return a SAM record of the specified match. */
+static inline SAMRecord toSAM(const FastaIndex& faIndex,
+		const FMIndex& fmIndex, const Match& m, bool rc,
+		unsigned qlength)
+{
+	SAMRecord a;
+	if (m.size() == 0) {
+		// No hit.
+		a.rname = "*";
+		a.pos = -1;
+		a.flag = SAMAlignment::FUNMAP;
+		a.mapq = 0;
+		a.cigar = "*";
+	} else {
+		FastaIndex::SeqPos seqPos = faIndex[fmIndex[m.l]];
+		a.rname = seqPos.get<0>().id;
+		a.pos = seqPos.get<1>();
+		a.flag = rc ? SAMAlignment::FREVERSE : 0;
+
+		// Set the mapq to the alignment score.
+		assert(m.qstart < m.qend);
+		unsigned matches = m.qend - m.qstart;
+		assert (m.num != 0);
+		a.mapq = m.size() > 1 || m.num > 1 ? 0 : std::min(matches, 254U);
+
+		std::ostringstream ss;
+		if (m.qstart > 0)
+			ss << m.qstart << 'S';
+		ss << matches << 'M';
+		if (m.qend < qlength)
+			ss << qlength - m.qend << 'S';
+		a.cigar = ss.str();
+	}
+	a.mrnm = "*";
+	a.mpos = -1;
+	a.isize = 0;
+	return a;
+}
+
+/** Build an FM index of the specified file. */
+static inline void buildFMIndex(FMIndex& fm, const char* path,
+		const std::string& alphabet, int verbose)
+{
+	if (verbose > 0)
+		std::cerr << "Reading `" << path << "'...\n";
+	std::vector<FMIndex::value_type> s;
+	readFile(path, s);
+
+	uint64_t MAX_SIZE
+		= std::numeric_limits<FMIndex::sais_size_type>::max();
+	if (s.size() > MAX_SIZE) {
+		std::cerr << "error: `" << path << "', "
+			<< toSI(s.size())
+			<< "B, must be smaller than "
+			<< toSI(MAX_SIZE) << "B\n";
+		exit(EXIT_FAILURE);
+	}
+
+	std::transform(s.begin(), s.end(), s.begin(), ::toupper);
+	fm.setAlphabet(alphabet);
+	fm.assign(s.begin(), s.end());
+}
+
+/** Return the size of the specified file. */
+static inline std::streampos fileSize(const std::string& path)
+{
+	std::ifstream in(path.c_str());
+	assert_good(in, path);
+	in.seekg(0, std::ios::end);
+	assert_good(in, path);
+	return in.tellg();
+}
+
+/** Check that the indexes are up to date. */
+static inline void checkIndexes(const std::string& path,
+		const FMIndex& fmIndex, const FastaIndex& faIndex)
+{
+	size_t fastaFileSize = fileSize(path);
+	if (fmIndex.size() != fastaFileSize) {
+		std::cerr << "error: `" << path << "': "
+			"The size of the FM-index, "
+			<< fmIndex.size()
+			<< " B, does not match the size of the FASTA file, "
+			<< fastaFileSize << " B. The index is likely stale.\n";
+		exit(EXIT_FAILURE);
+	}
+	if (faIndex.fileSize() != fastaFileSize) {
+		std::cerr << "error: `" << path << "': "
+			"The size of the FASTA index, "
+			<< faIndex.fileSize()
+			<< " B, does not match the size of the FASTA file, "
+			<< fastaFileSize << " B. The index is likely stale.\n";
+		exit(EXIT_FAILURE);
+	}
+}
+
+/** Read the FASTA index and the FM index of the specified file,
+ * TARGET.fai and TARGET.fm, or build them if they are not present.
+ */
+static inline void readIndexes(const char* targetFile,
+		FastaIndex& faIndex, FMIndex& fmIndex,
+		const std::string& alphabet, unsigned sampleSA, int verbose)
+{
+	std::string faiPath = std::string(targetFile) + ".fai";
+	std::string fmPath = std::string(targetFile) + ".fm";
+	std::ifstream in;
+
+	// Read the FASTA index.
+	in.open(faiPath.c_str());
+	if (in) {
+		if (verbose > 0)
+			std::cerr << "Reading `" << faiPath << "'...\n";
+		in >> faIndex;
+		assert(in.eof());
+		in.close();
+	} else {
+		if (verbose > 0)
+			std::cerr << "Reading `" << targetFile << "'...\n";
+		faIndex.index(targetFile);
+	}
+	if (verbose > 0) {
+		ssize_t bytes = getMemoryUsage();
+		if (bytes > 0)
+			std::cerr << "Using " << toSI(bytes) << "B of memory and "
+				<< std::setprecision(3)
+				<< (float)bytes / faIndex.size()
+				<< " B/sequence.\n";
+	}
+
+	// Read the FM index.
+	in.clear();
+	in.open(fmPath.c_str());
+	if (in) {
+		if (verbose > 0)
+			std::cerr << "Reading `" << fmPath << "'...\n";
+		assert_good(in, fmPath);
+		in >> fmIndex;
+		assert_good(in, fmPath);
+		in.close();
+	} else
+		buildFMIndex(fmIndex, targetFile, alphabet, verbose);
+	if (sampleSA > 1)
+		fmIndex.sampleSA(sampleSA);
+
+	if (verbose > 0) {
+		size_t bp = fmIndex.size();
+		std::cerr << "Read " << toSI(bp) << "B in "
+			<< faIndex.size() << " contigs.\n";
+		ssize_t bytes = getMemoryUsage();
+		if (bytes > 0)
+			std::cerr << "Using " << toSI(bytes) << "B of memory and "
+				<< std::setprecision(3) << (float)bytes / bp
+				<< " B/bp.\n";
+	}
+
+	// Check that the indexes are up to date.
+	checkIndexes(targetFile, fmIndex, faIndex);
+}
+
+#endif
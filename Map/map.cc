@@ -5,6 +5,7 @@
 #include "FastaInterleave.h"
 #include "FastaReader.h"
 #include "IOUtil.h"
+#include "Mapper.h"
 #include "MemoryUtil.h"
 #include "SAM.h"
 #include "StringUtil.h"
@@ -166,8 +167,6 @@ static struct {
 	unsigned subunmapped;
 } g_count;
 
-typedef FMIndex::Match Match;
-
 #if SAM_SEQ_QUAL
 static string toXA(const FastaIndex& faIndex,
 		const FMIndex& fmIndex, const Match& m, bool rc,
@@ -202,45 +201,6 @@ static string toXA(const FastaIndex& faIndex,
 }
 #endif
 
-/** Return a SAM record of the specified match. */
-static SAMRecord toSAM(const FastaIndex& faIndex,
-		const FMIndex& fmIndex, const Match& m, bool rc,
-		unsigned qlength)
-{
-	SAMRecord a;
-	if (m.size() == 0) {
-		// No hit.
-		a.rname = "*";
-		a.pos = -1;
-		a.flag = SAMAlignment::FUNMAP;
-		a.mapq = 0;
-		a.cigar = "*";
-	} else {
-		FastaIndex::SeqPos seqPos = faIndex[fmIndex[m.l]];
-		a.rname = seqPos.get<0>().id;
-		a.pos = seqPos.get<1>();
-		a.flag = rc ? SAMAlignment::FREVERSE : 0;
-
-		// Set the mapq to the alignment score.
-		assert(m.qstart < m.qend);
-		unsigned matches = m.qend - m.qstart;
-		assert (m.num != 0);
-		a.mapq = m.size() > 1 || m.num > 1 ? 0 : min(matches, 254U);
-
-		ostringstream ss;
-		if (m.qstart > 0)
-			ss << m.qstart << 'S';
-		ss << matches << 'M';
-		if (m.qend < qlength)
-			ss << qlength - m.qend << 'S';
-		a.cigar = ss.str();
-	}
-	a.mrnm = "*";
-	a.mpos = -1;
-	a.isize = 0;
-	return a;
-}
-
 /** Return the position of the current contig. */
 static size_t getMyPos(const Match& m, const FastaIndex& faIndex,
 		const FMIndex& fmIndex, const string& id)
@@ -497,61 +457,6 @@ static void find(const FastaIndex& faIndex, const FMIndex& fmIndex,
 	assert(in.eof());
 }
 
-/** Build an FM index of the specified file. */
-static void buildFMIndex(FMIndex& fm, const char* path)
-{
-	if (opt::verbose > 0)
-		std::cerr << "Reading `" << path << "'...\n";
-	std::vector<FMIndex::value_type> s;
-	readFile(path, s);
-
-	uint64_t MAX_SIZE = numeric_limits<FMIndex::sais_size_type>::max();
-	if (s.size() > MAX_SIZE) {
-		std::cerr << PROGRAM << ": `" << path << "', "
-			<< toSI(s.size())
-			<< "B, must be smaller than "
-			<< toSI(MAX_SIZE) << "B\n";
-		exit(EXIT_FAILURE);
-	}
-
-	transform(s.begin(), s.end(), s.begin(), ::toupper);
-	fm.setAlphabet(opt::alphabet);
-	fm.assign(s.begin(), s.end());
-}
-
-/** Return the size of the specified file. */
-static streampos fileSize(const string& path)
-{
-	std::ifstream in(path.c_str());
-	assert_good(in, path);
-	in.seekg(0, std::ios::end);
-	assert_good(in, path);
-	return in.tellg();
-}
-
-/** Check that the indexes are up to date. */
-static void checkIndexes(const string& path,
-		const FMIndex& fmIndex, const FastaIndex& faIndex)
-{
-	size_t fastaFileSize = fileSize(path);
-	if (fmIndex.size() != fastaFileSize) {
-		cerr << PROGRAM ": `" << path << "': "
-			"The size of the FM-index, "
-			<< fmIndex.size()
-			<< " B, does not match the size of the FASTA file, "
-			<< fastaFileSize << " B. The index is likely stale.\n";
-		exit(EXIT_FAILURE);
-	}
-	if (faIndex.fileSize() != fastaFileSize) {
-		cerr << PROGRAM ": `" << path << "': "
-			"The size of the FASTA index, "
-			<< faIndex.fileSize()
-			<< " B, does not match the size of the FASTA file, "
-			<< fastaFileSize << " B. The index is likely stale.\n";
-		exit(EXIT_FAILURE);
-	}
-}
-
 int main(int argc, char** argv)
 {
 	string commandLine;
@@ -665,68 +570,14 @@ int main(int argc, char** argv)
 	}
 
 	const char* targetFile(argv[--argc]);
-	ostringstream ss;
-	ss << targetFile << ".fm";
-	string fmPath(ss.str());
-	ss.str("");
-	ss << targetFile << ".fai";
-	string faiPath(ss.str());
-
-	ifstream in;
-
-	// Read the FASTA index.
 	FastaIndex faIndex;
-	in.open(faiPath.c_str());
-	if (in) {
-		if (opt::verbose > 0)
-			cerr << "Reading `" << faiPath << "'...\n";
-		in >> faIndex;
-		assert(in.eof());
-		in.close();
-	} else {
-		if (opt::verbose > 0)
-			cerr << "Reading `" << targetFile << "'...\n";
-		faIndex.index(targetFile);
-	}
-	if (opt::verbose > 0) {
-		ssize_t bytes = getMemoryUsage();
-		if (bytes > 0)
-			cerr << "Using " << toSI(bytes) << "B of memory and "
-				<< setprecision(3) << (float)bytes / faIndex.size()
-				<< " B/sequence.\n";
-	}
-
-	// Read the FM index.
 	FMIndex fmIndex;
-	in.open(fmPath.c_str());
-	if (in) {
-		if (opt::verbose > 0)
-			cerr << "Reading `" << fmPath << "'...\n";
-		assert_good(in, fmPath);
-		in >> fmIndex;
-		assert_good(in, fmPath);
-		in.close();
-	} else
-		buildFMIndex(fmIndex, targetFile);
-	if (opt::sampleSA > 1)
-		fmIndex.sampleSA(opt::sampleSA);
-
-	if (opt::verbose > 0) {
-		size_t bp = fmIndex.size();
-		cerr << "Read " << toSI(bp) << "B in "
-			<< faIndex.size() << " contigs.\n";
-		ssize_t bytes = getMemoryUsage();
-		if (bytes > 0)
-			cerr << "Using " << toSI(bytes) << "B of memory and "
-				<< setprecision(3) << (float)bytes / bp << " B/bp.\n";
-	}
+	readIndexes(targetFile, faIndex, fmIndex,
+			opt::alphabet, opt::sampleSA, opt::verbose);
 
 	if (!opt::db.empty())
 		addToDb(db, "readContigs", faIndex.size());
 
-	// Check that the indexes are up to date.
-	checkIndexes(targetFile, fmIndex, faIndex);
-
 	if (!opt::dup) {
 		// Write the SAM header.
 		cout << "@HD\tVN:1.4\n"
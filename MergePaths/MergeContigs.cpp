@@ -7,6 +7,7 @@
 #include "DataLayer/Options.h"
 #include "Dictionary.h"
 #include "FastaReader.h"
+#include "FastaStore.h"
 #include "Graph/ContigGraph.h"
 #include "Graph/ContigGraphAlgorithms.h"
 #include "Graph/DirectedGraph.h"
@@ -142,16 +143,48 @@ struct Contig
 	  : comment(comment)
 	  , seq(seq)
 	{}
-	Contig(const FastaRecord& o)
-	  : comment(o.comment)
-	  , seq(o.seq)
-	{}
 	string comment;
 	string seq;
 };
 
-/** The contig sequences. */
-typedef vector<Contig> Contigs;
+/** The contig sequences, which are read from the FASTA file only
+ * as they are used.
+ */
+class Contigs
+{
+  public:
+	Contigs(const char* path)
+	  : m_store(path, FastaStore::NO_FOLD_CASE)
+	{}
+
+	/** Return the records of the FASTA file. */
+	const FastaStore& store() const { return m_store; }
+
+	/** Add the specified record as the next contig. */
+	void push_back(size_t record) { m_index.push_back(record); }
+
+	size_t size() const { return m_index.size(); }
+	bool empty() const { return m_index.empty(); }
+
+	/** Return the comment of the specified contig. */
+	string comment(unsigned id) const
+	{
+		return m_store.comment(m_index[id]);
+	}
+
+	/** Return the sequence of the specified contig, reverse
+	 * complemented if rc is true. */
+	FastaStore::View seq(unsigned id, bool rc = false) const
+	{
+		return m_store.sequence(m_index[id], rc);
+	}
+
+  private:
+	FastaStore m_store;
+
+	/** The index of the record of each contig. */
+	vector<size_t> m_index;
+};
 
 /** Return the sequence of the specified contig node. The sequence
  * may be ambiguous or reverse complemented.
@@ -165,8 +198,7 @@ sequence(const Contigs& contigs, const ContigNode& id)
 			transform(s.begin(), s.end(), s.begin(), ::tolower);
 		return string(opt::k - 1, 'N') + s;
 	} else {
-		const Sequence& seq = contigs[id.id()].seq;
-		return id.sense() ? reverseComplement(seq) : seq;
+		return contigs.seq(id.id(), id.sense());
 	}
 }
 
@@ -534,8 +566,10 @@ main(int argc, char** argv)
 			cerr << "Reading `" << adjPath << "'..." << endl;
 		ifstream fin(adjPath.c_str());
 		assert_good(fin, adjPath);
+		loadContigNames(adjPath);
 		fin >> g;
 		assert(fin.eof());
+		saveContigNames(adjPath);
 		if (opt::verbose > 0)
 			cerr << "Read " << num_vertices(g)
 			     << " vertices. "
@@ -549,22 +583,23 @@ main(int argc, char** argv)
 	mergedPathFile = string(argv[optind++]);
 
 	// Read the contig sequence.
-	Contigs contigs;
+	if (opt::verbose > 0)
+		cerr << "Reading `" << contigFile << "'..." << endl;
+	Contigs contigs(contigFile);
 	{
-		if (opt::verbose > 0)
-			cerr << "Reading `" << contigFile << "'..." << endl;
 		unsigned count = 0;
-		FastaReader in(contigFile, FastaReader::NO_FOLD_CASE);
-		for (FastaRecord rec; in >> rec;) {
-			if (!adjPath.empty() && g_contigNames.count(rec.id) == 0)
+		const FastaStore& store = contigs.store();
+		for (size_t i = 0; i < store.size(); ++i) {
+			string id = store.id(i);
+			if (!adjPath.empty() && g_contigNames.count(id) == 0)
 				continue;
 			if (adjPath.empty()) {
 				graph_traits<Graph>::vertex_descriptor u =
-				    add_vertex(ContigProperties(rec.seq.length(), 0), g);
-				put(vertex_name, g, u, rec.id);
+				    add_vertex(ContigProperties(store.length(i), 0), g);
+				put(vertex_name, g, u, id);
 			}
-			assert(get(g_contigNames, rec.id) == contigs.size());
-			contigs.push_back(rec);
+			assert(get(g_contigNames, id) == contigs.size());
+			contigs.push_back(i);
 
 			++count;
 			if (opt::verbose > 1 && count % 1000000 == 0)
@@ -580,9 +615,8 @@ main(int argc, char** argv)
 			     << toSI(getMemoryUsage()) << "B of memory.\n";
 		if (!opt::db.empty())
 			addToDb(db, "Init_seq", count);
-		assert(in.eof());
 		assert(!contigs.empty());
-		opt::colourSpace = isdigit(contigs[0].seq[0]);
+		opt::colourSpace = isdigit(contigs.seq(0)[0]);
 		g_contigNames.lock();
 	}
 
@@ -600,16 +634,17 @@ main(int argc, char** argv)
 	ostream& out = opt::out == "-" ? cout : (fout.open(opt::out.c_str()), fout);
 	assert_good(out, opt::out);
 	if (!opt::onlyMerged) {
-		for (Contigs::const_iterator it = contigs.begin(); it != contigs.end(); ++it) {
-			ContigID id(it - contigs.begin());
+		for (unsigned i = 0; i < contigs.size(); ++i) {
+			ContigID id(i);
 			if (!seen[id]) {
-				const Contig& contig = *it;
 				out << '>' << get(g_contigNames, id);
-				if (!contig.comment.empty())
-					out << ' ' << contig.comment;
-				out << '\n' << contig.seq << '\n';
+				string comment = contigs.comment(id);
+				if (!comment.empty())
+					out << ' ' << comment;
+				FastaStore::View seq = contigs.seq(id);
+				out << '\n' << seq << '\n';
 				if (opt::verbose > 0)
-					lengthHistogram.insert(count_if(contig.seq.begin(), contig.seq.end(), isACGT));
+					lengthHistogram.insert(count_if(seq.begin(), seq.end(), isACGT));
 			}
 		}
 	}
@@ -9,6 +9,8 @@
 #include "Graph/GraphAlgorithms.h"
 #include "Graph/GraphUtil.h"
 #include "IOUtil.h"
+#include "OrderedPipeline.h"
+#include "PathIndex.h"
 #include "Uncompress.h"
 #include "config.h"
 #include <algorithm>
@@ -265,19 +267,26 @@ appendToMergeQ(deque<ContigNode>& mergeQ, set<ContigNode>& seen, const ContigPat
 /** A path overlap graph. */
 typedef ContigGraph<DirectedGraph<>> PathGraph;
 
-/** Add an edge if the two paths overlap.
+/** An edge of the path overlap graph. */
+typedef pair<ContigNode, ContigNode> PathEdge;
+
+/** A collection of edges of the path overlap graph. */
+typedef vector<PathEdge> PathEdges;
+
+/** Find the edge between two paths if they overlap.
  * @param pivot the pivot at which to seed the alignment
+ * @param e [out] the overlap edge
  * @return whether an overlap was found
  */
 static bool
-addOverlapEdge(
+findOverlapEdge(
     const Lengths& lengths,
-    PathGraph& gout,
     ContigNode pivot,
     ContigNode seed1,
     const ContigPath& path1,
     ContigNode seed2,
-    const ContigPath& path2)
+    const ContigPath& path2,
+    PathEdge& e)
 {
 	assert(seed1 != seed2);
 
@@ -297,16 +306,53 @@ addOverlapEdge(
 	}
 	assert(orientation == DIR_F || orientation == DIR_R);
 
-	// Add the edge.
-	ContigNode u = orientation == DIR_F ? seed1 : seed2;
-	ContigNode v = orientation == DIR_F ? seed2 : seed1;
-	bool added = false;
-#pragma omp critical(gout)
-	if (!edge(u, v, gout).second) {
-		add_edge(u, v, gout);
-		added = true;
-	}
-	return added;
+	e.first = orientation == DIR_F ? seed1 : seed2;
+	e.second = orientation == DIR_F ? seed2 : seed1;
+	return true;
+}
+
+/** Add an edge if the two paths overlap.
+ * @param pivot the pivot at which to seed the alignment
+ * @return whether an edge was added
+ */
+static bool
+addOverlapEdge(
+    const Lengths& lengths,
+    PathGraph& gout,
+    ContigNode pivot,
+    ContigNode seed1,
+    const ContigPath& path1,
+    ContigNode seed2,
+    const ContigPath& path2)
+{
+	PathEdge e;
+	if (!findOverlapEdge(lengths, pivot, seed1, path1, seed2, path2, e)
+	    || edge(e.first, e.second, gout).second)
+		return false;
+	add_edge(e.first, e.second, gout);
+	return true;
+}
+
+/** Return the path of the specified contig. */
+static const ContigPath&
+findPath(const ContigPathMap& paths, ContigNode u)
+{
+	ContigPathMap::const_iterator it = paths.find(u.contigIndex());
+	assert(it != paths.end());
+	return it->second;
+}
+
+/** Return the specified path, or its reverse complement if sense is
+ * true. The path is copied only to reverse complement it.
+ * @param rc [out] storage for the reverse complement
+ */
+static const ContigPath&
+orientPath(const ContigPath& path, bool sense, ContigPath& rc)
+{
+	if (!sense)
+		return path;
+	rc = reverseComplement(path);
+	return rc;
 }
 
 /** Return the specified path. */
@@ -321,14 +367,16 @@ getPath(const ContigPathMap& paths, ContigNode u)
 	return path;
 }
 
-/** Find the overlaps between paths and add edges to the graph. */
+/** Find the overlaps between paths.
+ * @param out [out] the overlap edges
+ */
 static void
 findPathOverlaps(
     const Lengths& lengths,
     const ContigPathMap& paths,
     const ContigNode& seed1,
     const ContigPath& path1,
-    PathGraph& gout)
+    PathEdges& out)
 {
 	for (ContigPath::const_iterator it = path1.begin(); it != path1.end(); ++it) {
 		ContigNode seed2 = *it;
@@ -340,14 +388,16 @@ findPathOverlaps(
 		if (path2It == paths.end())
 			continue;
 
-		ContigPath path2 = path2It->second;
-		if (seed2.sense())
-			reverseComplement(path2.begin(), path2.end());
-		addOverlapEdge(lengths, gout, seed2, seed1, path1, seed2, path2);
+		ContigPath rc2;
+		const ContigPath& path2 = orientPath(path2It->second, seed2.sense(), rc2);
+		PathEdge e;
+		if (findOverlapEdge(lengths, seed2, seed1, path1, seed2, path2, e))
+			out.push_back(e);
 	}
 }
 
 /** Attempt to merge the paths specified in mergeQ with path.
+ * @param vout [out] the debugging output
  * @return the number of paths merged
  */
 static unsigned
@@ -356,7 +406,8 @@ mergePaths(
     ContigPath& path,
     deque<ContigNode>& mergeQ,
     set<ContigNode>& seen,
-    const ContigPathMap& paths)
+    const ContigPathMap& paths,
+    ostream& vout)
 {
 	unsigned merged = 0;
 	deque<ContigNode> invalid;
@@ -366,9 +417,8 @@ mergePaths(
 		if (path2It == paths.end())
 			continue;
 
-		ContigPath path2 = path2It->second;
-		if (pivot.sense())
-			reverseComplement(path2.begin(), path2.end());
+		ContigPath rc2;
+		const ContigPath& path2 = orientPath(path2It->second, pivot.sense(), rc2);
 		ContigPath consensus = align(lengths, path, path2, pivot);
 		if (consensus.empty()) {
 			invalid.push_back(pivot);
@@ -378,8 +428,7 @@ mergePaths(
 		appendToMergeQ(mergeQ, seen, path2);
 		path.swap(consensus);
 		if (gDebugPrint)
-#pragma omp critical(cout)
-			cout << get(g_contigNames, pivot) << '\t' << path2 << '\n' << '\t' << path << '\n';
+			vout << get(g_contigNames, pivot) << '\t' << path2 << '\n' << '\t' << path << '\n';
 		merged++;
 	}
 	mergeQ.swap(invalid);
@@ -407,9 +456,8 @@ mergePath(const Lengths& lengths, const ContigPathMap& paths, const ContigPath&
 		ContigNode seed2 = *it;
 		ContigPathMap::const_iterator path2It = paths.find(seed2.contigIndex());
 		assert(path2It != paths.end());
-		ContigPath path2 = path2It->second;
-		if (seed2.sense())
-			reverseComplement(path2.begin(), path2.end());
+		ContigPath rc2;
+		const ContigPath& path2 = orientPath(path2It->second, seed2.sense(), rc2);
 
 		ContigNode pivot = find(path.begin(), path.end(), seed2) != path.end() ? seed2 : seed1;
 		ContigPath consensus = align(lengths, path, path2, pivot);
@@ -448,43 +496,53 @@ mergeSeedPaths(const Lengths& lengths, const ContigPathMap& paths, const ContigP
 	return out;
 }
 
-/** Extend the specified path as long as is unambiguously possible and
- * add the result to the specified container.
+/** Extend the specified path as long as is unambiguously possible.
+ * @param path [out] the extended path
+ * @param vout [out] the debugging output
  */
 static void
-extendPaths(const Lengths& lengths, ContigID id, const ContigPathMap& paths, ContigPathMap& out)
+extendPath(
+    const Lengths& lengths,
+    ContigID id,
+    const ContigPathMap& paths,
+    ContigPath& path,
+    ostream& vout)
 {
 	ContigPathMap::const_iterator pathIt = paths.find(id);
 	assert(pathIt != paths.end());
-
-	pair<ContigPathMap::iterator, bool> inserted;
-#pragma omp critical(out)
-	inserted = out.insert(*pathIt);
-	assert(inserted.second);
-	ContigPath& path = inserted.first->second;
+	path = pathIt->second;
 
 	if (gDebugPrint)
-#pragma omp critical(cout)
-		cout << "\n* " << get(g_contigNames, id) << "+\n" << '\t' << path << '\n';
+		vout << "\n* " << get(g_contigNames, id) << "+\n" << '\t' << path << '\n';
 
 	set<ContigNode> seen;
 	seen.insert(ContigNode(id, false));
 	deque<ContigNode> mergeQ;
 	appendToMergeQ(mergeQ, seen, path);
-	while (mergePaths(lengths, path, mergeQ, seen, paths) > 0)
+	while (mergePaths(lengths, path, mergeQ, seen, paths, vout) > 0)
 		;
 
 	if (!mergeQ.empty() && gDebugPrint) {
-#pragma omp critical(cout)
-		{
-			cout << "invalid\n";
-			for (deque<ContigNode>::const_iterator it = mergeQ.begin(); it != mergeQ.end(); ++it)
-				cout << get(g_contigNames, *it) << '\t' << paths.find(it->contigIndex())->second
-				     << '\n';
-		}
+		vout << "invalid\n";
+		for (deque<ContigNode>::const_iterator it = mergeQ.begin(); it != mergeQ.end(); ++it)
+			vout << get(g_contigNames, *it) << '\t' << paths.find(it->contigIndex())->second
+			     << '\n';
 	}
 }
 
+/** Extend the specified path as long as is unambiguously possible and
+ * add the result to the specified container.
+ */
+static void
+extendPaths(const Lengths& lengths, ContigID id, const ContigPathMap& paths, ContigPathMap& out)
+{
+	ContigPath path;
+	extendPath(lengths, id, paths, path, cout);
+	bool inserted = out.insert(make_pair(id, path)).second;
+	assert(inserted);
+	(void)inserted;
+}
+
 /** Return true if the contigs are equal or both are ambiguous. */
 static bool
 equalOrBothAmbiguos(const ContigNode& a, const ContigNode& b)
@@ -532,9 +590,8 @@ identifySubsumedPaths(
 		ContigPathMap::iterator path2It = paths.find(pivot.contigIndex());
 		if (path2It == paths.end())
 			continue;
-		ContigPath path2 = path2It->second;
-		if (pivot.sense())
-			reverseComplement(path2.begin(), path2.end());
+		ContigPath rc2;
+		const ContigPath& path2 = orientPath(path2It->second, pivot.sense(), rc2);
 		ContigPath consensus = align(lengths, path, path2, pivot);
 		if (consensus.empty())
 			continue;
@@ -629,36 +686,45 @@ removeSubsumedPaths(const Lengths& lengths, ContigPathMap& paths)
  * and add the edge (v2,v1) if v2 < v1.
  */
 static void
-addMissingEdges(const Lengths& lengths, PathGraph& g, const ContigPathMap& paths)
+addMissingEdges(
+    const Lengths& lengths,
+    PathGraph& g,
+    const ContigPathMap& paths,
+    const PathIndex& index)
 {
 	typedef graph_traits<PathGraph>::adjacency_iterator Vit;
 	typedef graph_traits<PathGraph>::vertex_iterator Uit;
 	typedef graph_traits<PathGraph>::vertex_descriptor V;
 
 	unsigned numAdded = 0;
+	vector<V> vs;
+	vector<ContigPath> vpaths;
 	pair<Uit, Uit> urange = vertices(g);
 	for (Uit uit = urange.first; uit != urange.second; ++uit) {
 		V u = *uit;
 		if (out_degree(u, g) < 2)
 			continue;
+
+		// Copy the paths of the successors of u that contain u.
+		vs.clear();
+		vpaths.clear();
 		pair<Vit, Vit> vrange = adjacent_vertices(u, g);
-		for (Vit vit1 = vrange.first; vit1 != vrange.second;) {
-			V v1 = *vit1;
-			++vit1;
-			assert(v1 != u);
-			ContigPath path1 = getPath(paths, v1);
-			if (find(path1.begin(), path1.end(), ContigPath::value_type(u)) == path1.end())
-				continue;
-			for (Vit vit2 = vit1; vit2 != vrange.second; ++vit2) {
-				V v2 = *vit2;
-				assert(v2 != u);
+		for (Vit vit = vrange.first; vit != vrange.second; ++vit) {
+			V v = *vit;
+			assert(v != u);
+			if (index.contains(v.contigIndex(), v.sense(), u)) {
+				vs.push_back(v);
+				vpaths.push_back(getPath(paths, v));
+			}
+		}
+
+		for (unsigned i = 0; i < vs.size(); ++i) {
+			for (unsigned j = i + 1; j < vs.size(); ++j) {
+				V v1 = vs[i], v2 = vs[j];
 				assert(v1 != v2);
 				if (edge(v1, v2, g).second || edge(v2, v1, g).second)
 					continue;
-				ContigPath path2 = getPath(paths, v2);
-				if (find(path2.begin(), path2.end(), ContigPath::value_type(u)) == path2.end())
-					continue;
-				numAdded += addOverlapEdge(lengths, g, u, v1, path1, v2, path2);
+				numAdded += addOverlapEdge(lengths, g, u, v1, vpaths[i], v2, vpaths[j]);
 			}
 		}
 	}
@@ -703,7 +769,7 @@ removeSmallOverlaps(PathGraph& g, const ContigPathMap& paths)
 		V u = *uit;
 		if (out_degree(u, g) < 2)
 			continue;
-		ContigPath pathu = getPath(paths, u);
+		ContigNode backu = orientedBack(findPath(paths, u), u.sense());
 		pair<Eit, Eit> uvits = out_edges(u, g);
 		for (Eit uvit = uvits.first; uvit != uvits.second; ++uvit) {
 			E uv = *uvit;
@@ -711,8 +777,8 @@ removeSmallOverlaps(PathGraph& g, const ContigPathMap& paths)
 			assert(v != u);
 			if (in_degree(v, g) < 2)
 				continue;
-			ContigPath pathv = getPath(paths, v);
-			if (pathu.back() == pathv.front() && paths.count(pathu.back().contigIndex()) > 0)
+			if (backu == orientedFront(findPath(paths, v), v.sense())
+			    && paths.count(backu.contigIndex()) > 0)
 				edges.push_back(uv);
 		}
 	}
@@ -829,17 +895,97 @@ readPaths(const Lengths& lengths, const string& filePath)
 	return paths;
 }
 
-/** Store it in out and increment it.
- * @return true if out != last
- */
-template<class T1, class T2, class T3>
-bool
-atomicInc(T1& it, T2 last, T3& out)
+/** Read the paths of a ContigPathMap in order. */
+struct PathMapReader
 {
-#pragma omp critical(atomicInc)
-	out = it == last ? it : it++;
-	return out != last;
-}
+	typedef ContigPathMap::const_iterator value_type;
+	ContigPathMap::const_iterator it, last;
+	PathMapReader(const ContigPathMap& paths)
+	  : it(paths.begin())
+	  , last(paths.end())
+	{}
+	bool operator()(value_type& out)
+	{
+		if (it == last)
+			return false;
+		out = it++;
+		return true;
+	}
+};
+
+/** Find the overlaps of one path. */
+struct PathOverlapFinder
+{
+	typedef PathEdges result_type;
+	const Lengths& lengths;
+	const ContigPathMap& paths;
+	PathOverlapFinder(const Lengths& lengths, const ContigPathMap& paths)
+	  : lengths(lengths)
+	  , paths(paths)
+	{}
+	void operator()(ContigPathMap::const_iterator it, PathEdges& out) const
+	{
+		findPathOverlaps(lengths, paths, ContigNode(it->first, false), it->second, out);
+	}
+};
+
+/** Add the overlap edges to the path overlap graph in order. */
+struct PathOverlapWriter
+{
+	PathGraph& g;
+	PathOverlapWriter(PathGraph& g)
+	  : g(g)
+	{}
+	void operator()(const PathEdges& edges)
+	{
+		for (PathEdges::const_iterator it = edges.begin(); it != edges.end(); ++it)
+			if (!edge(it->first, it->second, g).second)
+				add_edge(it->first, it->second, g);
+	}
+};
+
+/** The extended path and debugging output of one path. */
+struct ExtendedPath
+{
+	ContigID id;
+	ContigPath path;
+	string log;
+};
+
+/** Extend one path. */
+struct PathExtender
+{
+	typedef ExtendedPath result_type;
+	const Lengths& lengths;
+	const ContigPathMap& paths;
+	PathExtender(const Lengths& lengths, const ContigPathMap& paths)
+	  : lengths(lengths)
+	  , paths(paths)
+	{}
+	void operator()(ContigPathMap::const_iterator it, ExtendedPath& out) const
+	{
+		ostringstream vout;
+		out.id = it->first;
+		extendPath(lengths, it->first, paths, out.path, vout);
+		out.log = vout.str();
+	}
+};
+
+/** Add the extended paths to a ContigPathMap in order. */
+struct ExtendedPathWriter
+{
+	ContigPathMap& out;
+	ExtendedPathWriter(ContigPathMap& out)
+	  : out(out)
+	{}
+	void operator()(const ExtendedPath& o)
+	{
+		cout << o.log;
+		bool inserted = out.insert(make_pair(o.id, o.path)).second;
+		assert(inserted);
+		(void)inserted;
+	}
+};
 
 /** Build the path overlap graph. */
 static void
@@ -856,14 +1002,17 @@ buildPathGraph(const Lengths& lengths, PathGraph& g, const ContigPathMap& paths)
 			remove_vertex(*u, g);
 
 	// Find the overlapping paths.
-	ContigPathMap::const_iterator sharedIt = paths.begin();
-#pragma omp parallel
-	for (ContigPathMap::const_iterator it; atomicInc(sharedIt, paths.end(), it);)
-		findPathOverlaps(lengths, paths, ContigNode(it->first, false), it->second, g);
+	PathMapReader reader(paths);
+	PathOverlapFinder finder(lengths, paths);
+	PathOverlapWriter writer(g);
+	orderedPipeline(reader, finder, writer);
 	if (gDebugPrint)
 		cout << '\n';
 
-	addMissingEdges(lengths, g, paths);
+	PathIndex index;
+	for (ContigPathMap::const_iterator it = paths.begin(); it != paths.end(); ++it)
+		index.insert(it->first, it->second);
+	addMissingEdges(lengths, g, paths, index);
 	removeTransitiveEdges(g);
 	removeSmallOverlaps(g, paths);
 	if (opt::verbose > 0)
@@ -1031,16 +1180,10 @@ main(int argc, char** argv)
 	}
 
 	ContigPathMap resultsPathMap;
-#if _OPENMP
-	ContigPathMap::iterator sharedIt = originalPathMap.begin();
-#pragma omp parallel
-	for (ContigPathMap::iterator it; atomicInc(sharedIt, originalPathMap.end(), it);)
-		extendPaths(lengths, it->first, originalPathMap, resultsPathMap);
-#else
-	for (ContigPathMap::const_iterator it = originalPathMap.begin(); it != originalPathMap.end();
-	     ++it)
-		extendPaths(lengths, it->first, originalPathMap, resultsPathMap);
-#endif
+	PathMapReader reader(originalPathMap);
+	PathExtender extender(lengths, originalPathMap);
+	ExtendedPathWriter writer(resultsPathMap);
+	orderedPipeline(reader, extender, writer);
 	if (gDebugPrint)
 		cout << '\n';
 
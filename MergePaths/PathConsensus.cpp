@@ -1,11 +1,11 @@
 #include "dialign.h"
 #include "config.h"
 #include "Common/Options.h"
-#include "ConstString.h"
 #include "ContigNode.h"
 #include "ContigPath.h"
 #include "Dictionary.h"
 #include "FastaReader.h"
+#include "FastaStore.h"
 #include "IOUtil.h"
 #include "StringUtil.h"
 #include "Uncompress.h"
@@ -23,8 +23,12 @@
 #include <iostream>
 #include <map>
 #include <set>
+#include <sstream>
 #include <vector>
 #include "VectorUtil.h"
+#if _OPENMP
+# include <omp.h>
+#endif
 #include "DataBase/Options.h"
 #include "DataBase/DB.h"
 
@@ -71,6 +75,7 @@ static const char USAGE_MESSAGE[] =
 "  -a, --branches=N      maximum number of sequences to align\n"
 "                        default: 4\n"
 "  -p, --identity=REAL   minimum identity, default: 0.9\n"
+"  -j, --threads=N       use N parallel threads [1]\n"
 "  -v, --verbose         display verbose output\n"
 "      --help            display this help and exit\n"
 "      --version         output version information and exit\n"
@@ -96,6 +101,7 @@ namespace opt {
 	static string graphPath;
 	static float identity = 0.9;
 	static unsigned numBranches = 4;
+	static int threads = 1;
 	static int dialign_debug;
 	static string dialign_score;
 	static string dialign_prob;
@@ -109,7 +115,7 @@ namespace opt {
 	unsigned distanceError = 6;
 }
 
-static const char shortopts[] = "d:k:o:s:g:a:p:vD:M:P:";
+static const char shortopts[] = "d:k:o:s:g:a:p:j:vD:M:P:";
 
 enum { OPT_HELP = 1, OPT_VERSION, OPT_DB, OPT_LIBRARY, OPT_STRAIN, OPT_SPECIES };
 //enum { OPT_HELP = 1, OPT_VERSION };
@@ -130,6 +136,7 @@ static const struct option longopts[] = {
 	{ "sam",         no_argument,       &opt::format, SAM },
 	{ "branches",    required_argument, NULL, 'a' },
 	{ "identity",    required_argument, NULL, 'p' },
+	{ "threads",     required_argument, NULL, 'j' },
 	{ "verbose",     no_argument,       NULL, 'v' },
 	{ "help",        no_argument,       NULL, OPT_HELP },
 	{ "version",     no_argument,       NULL, OPT_VERSION },
@@ -181,8 +188,8 @@ typedef ContigPath Path;
 typedef vector<Path> ContigPaths;
 typedef map<AmbPathConstraint, ContigPath> AmbPath2Contig;
 
-typedef vector<const_string> Contigs;
-static Contigs g_contigs;
+/** The contig sequences. */
+static const FastaStore* g_contigs;
 AmbPath2Contig g_ambpath_contig;
 
 /** Return the sequence of the specified contig node. The sequence
@@ -196,8 +203,7 @@ static const Sequence getSequence(ContigNode id)
 			transform(s.begin(), s.end(), s.begin(), ::tolower);
 		return string(opt::k - 1, 'N') + s;
 	} else {
-		string seq(g_contigs[id.id()]);
-		return id.sense() ? reverseComplement(seq) : seq;
+		return g_contigs->sequence(id.id(), id.sense());
 	}
 }
 
@@ -294,6 +300,26 @@ typedef vector<NewVertex> NewVertices;
 /** The new vertices that will be added to the graph. */
 static NewVertices g_newVertices;
 
+/** A consensus sequence of an ambiguous region, which will be output
+ * as a new contig.
+ */
+struct NewContig
+{
+	size_t longestPrefix;
+	size_t longestSuffix;
+	Sequence seq;
+	unsigned coverage;
+
+	NewContig() : longestPrefix(0), longestSuffix(0), coverage(0) { }
+
+	NewContig(size_t longestPrefix, size_t longestSuffix,
+			const Sequence& seq, unsigned coverage)
+		: longestPrefix(longestPrefix), longestSuffix(longestSuffix),
+		seq(seq), coverage(coverage) { }
+
+	bool empty() const { return seq.empty(); }
+};
+
 /** Output a new contig. */
 static ContigNode outputNewContig(const Graph& g,
 	const vector<Path>& solutions,
@@ -377,7 +403,8 @@ static string createConsensus(const Sequence& a, const Sequence& b)
  */
 static void mergeContigs(const Graph& g,
 		unsigned overlap, Sequence& seq,
-		const Sequence& s, const ContigNode& node, const Path& path)
+		const Sequence& s, const ContigNode& node, const Path& path,
+		ostream& log)
 {
 	assert(s.length() >= overlap);
 	Sequence ao;
@@ -389,7 +416,7 @@ static void mergeContigs(const Graph& g,
 		o = createConsensus(ao, bo);
 	} while (o.empty() && chomp(seq, 'n'));
 	if (o.empty()) {
-		cerr << "warning: the head of "
+		log << "warning: the head of "
 			<< get(vertex_name, g, node)
 			<< " does not match the tail of the previous contig\n"
 			<< ao << '\n' << bo << '\n' << path << endl;
@@ -402,7 +429,8 @@ static void mergeContigs(const Graph& g,
 	}
 }
 
-static Sequence mergePath(const Graph&g, const Path& path)
+static Sequence mergePath(const Graph&g, const Path& path,
+		ostream& log)
 {
 	Sequence seq;
 	Path::const_iterator prev_it;
@@ -415,7 +443,7 @@ static Sequence mergePath(const Graph&g, const Path& path)
 			assert(d < 0);
 			unsigned overlap = -d;
 			mergeContigs(g, overlap, seq,
-					getSequence(*it), *it, path);
+					getSequence(*it), *it, path, log);
 		}
 		prev_it = it;
 	}
@@ -432,9 +460,13 @@ static ContigProperties calculatePathProperties(const Graph& g,
 /* Resolve ambiguous region using pairwise alignment
  * (Needleman-Wunsch) ('solutions' contain exactly two paths, from a
  * source contig to a dest contig)
+ * @param[out] newContig the consensus sequence, which is represented
+ * in the returned path by a placeholder after the common prefix
+ * @param[out] log verbose output and warnings
  */
 static ContigPath alignPair(const Graph& g,
-		const ContigPaths& solutions, ofstream& out)
+		const ContigPaths& solutions, NewContig& newContig,
+		ostream& log)
 {
 	assert(solutions.size() == 2);
 	assert(solutions[0].size() > 1);
@@ -448,7 +480,7 @@ static ContigPath alignPair(const Graph& g,
 		// This entire sequence may be deleted.
 		const ContigPath& sol(fstSol.empty() ? sndSol : fstSol);
 		assert(!sol.empty());
-		Sequence consensus(mergePath(g, sol));
+		Sequence consensus(mergePath(g, sol, log));
 		assert(consensus.size() > opt::k - 1);
 		string::iterator first = consensus.begin() + opt::k - 1;
 		transform(first, consensus.end(), first, ::tolower);
@@ -456,25 +488,24 @@ static ContigPath alignPair(const Graph& g,
 		unsigned match = opt::k - 1;
 		float identity = (float)match / consensus.size();
 		if (opt::verbose > 2)
-			cerr << consensus << '\n';
+			log << consensus << '\n';
 		if (opt::verbose > 1)
-			cerr << identity
+			log << identity
 				<< (identity < opt::identity ? " (too low)\n" : "\n");
 		if (identity < opt::identity)
 			return ContigPath();
 
 		unsigned coverage = calculatePathProperties(g, sol).coverage;
-		ContigNode u = outputNewContig(g,
-				solutions, 1, 1, consensus, coverage, out);
+		newContig = NewContig(1, 1, consensus, coverage);
 		ContigPath path;
 		path.push_back(solutions.front().front());
-		path.push_back(u);
+		path.push_back(ContigNode());
 		path.push_back(solutions.front().back());
 		return path;
 	}
 
-	Sequence fstPathContig(mergePath(g, fstSol));
-	Sequence sndPathContig(mergePath(g, sndSol));
+	Sequence fstPathContig(mergePath(g, fstSol, log));
+	Sequence sndPathContig(mergePath(g, sndSol, log));
 	if (fstPathContig == sndPathContig) {
 		// These two paths have identical sequence.
 		if (fstSol.size() == sndSol.size()) {
@@ -488,12 +519,12 @@ static ContigPath alignPair(const Graph& g,
 					== get(vertex_complement, g, *it.second));
 			assert(equal(it.first+1, It(fstSol.end()), it.second+1));
 			if (opt::verbose > 1)
-				cerr << "Palindrome: "
+				log << "Palindrome: "
 					<< get(vertex_contig_name, g, *it.first) << '\n';
 			return solutions[0];
 		} else {
 			// The paths are different lengths.
-			cerr << PROGRAM ": warning: "
+			log << PROGRAM ": warning: "
 				"Two paths have identical sequence, which may be "
 				"caused by a transitive edge in the overlap graph.\n"
 				<< '\t' << fstSol << '\n'
@@ -509,30 +540,31 @@ static ContigPath alignPair(const Graph& g,
 	float lengthRatio = (float)minLength / maxLength;
 	if (lengthRatio < opt::identity) {
 		if (opt::verbose > 1)
-			cerr << minLength << '\t' << maxLength
+			log << minLength << '\t' << maxLength
 				<< '\t' << lengthRatio << "\t(different length)\n";
 		return ContigPath();
 	}
 
+	// Both paths satisfy the same distance estimate, so the
+	// alignment is expected to stay close to the diagonal.
 	NWAlignment align;
 	unsigned match = alignGlobal(fstPathContig, sndPathContig,
-		   	align);
+		   	align, opt::distanceError);
 	float identity = (float)match / align.size();
 	if (opt::verbose > 2)
-		cerr << align;
+		log << align;
 	if (opt::verbose > 1)
-		cerr << identity
+		log << identity
 			<< (identity < opt::identity ? " (too low)\n" : "\n");
 	if (identity < opt::identity)
 		return ContigPath();
 
 	unsigned coverage = calculatePathProperties(g, fstSol).coverage
 		+ calculatePathProperties(g, sndSol).coverage;
-	ContigNode u = outputNewContig(g, solutions, 1, 1,
-			align.consensus(), coverage, out);
+	newContig = NewContig(1, 1, align.consensus(), coverage);
 	ContigPath path;
 	path.push_back(solutions.front().front());
-	path.push_back(u);
+	path.push_back(ContigNode());
 	path.push_back(solutions.front().back());
 	return path;
 }
@@ -546,9 +578,13 @@ struct GetLength {
 
 /* Resolve ambiguous region using multiple alignment of all paths in
  * `solutions'.
+ * @param[out] newContig the consensus sequence, which is represented
+ * in the returned path by a placeholder after the common prefix
+ * @param[out] log verbose output and warnings
  */
 static ContigPath alignMulti(const Graph& g,
-		const vector<Path>& solutions, ofstream& out)
+		const vector<Path>& solutions, NewContig& newContig,
+		ostream& log)
 {
 	// Find the size of the smallest path.
 	const Path& firstSol = solutions.front();
@@ -603,7 +639,7 @@ static ContigPath alignMulti(const Graph& g,
 	reverse(vspath.begin(), vspath.end());
 
 	if (opt::verbose > 1 && vppath.size() + vspath.size() > 2)
-		cerr << vppath << " * " << vspath << '\n';
+		log << vppath << " * " << vspath << '\n';
 
 	// Get sequence of ambiguous region in paths
 	assert(longestPrefix > 0 && longestSuffix > 0);
@@ -615,7 +651,7 @@ static ContigPath alignMulti(const Graph& g,
 		Path path(solIter->begin() + longestPrefix,
 				solIter->end() - longestSuffix);
 		if (!path.empty()) {
-			amb_seqs.push_back(mergePath(g, path));
+			amb_seqs.push_back(mergePath(g, path, log));
 			coverage += calculatePathProperties(g, path).coverage;
 		} else {
 			// The prefix and suffix paths overlap by k-1 bp.
@@ -632,7 +668,7 @@ static ContigPath alignMulti(const Graph& g,
 	float lengthRatio = (float)minLength / maxLength;
 	if (lengthRatio < opt::identity) {
 		if (opt::verbose > 1)
-			cerr << minLength << '\t' << maxLength
+			log << minLength << '\t' << maxLength
 				<< '\t' << lengthRatio << "\t(different length)\n";
 		return ContigPath();
 	}
@@ -643,10 +679,10 @@ static ContigPath alignMulti(const Graph& g,
 	string consensus = alignment.consensus();
 
 	if (opt::verbose > 2)
-	   	cerr << alignment << consensus << '\n';
+	   	log << alignment << consensus << '\n';
 	float identity = (float)matches / consensus.size();
 	if (opt::verbose > 1)
-		cerr << identity
+		log << identity
 			<< (identity < opt::identity ? " (too low)\n" : "\n");
 	if (identity < opt::identity)
 		return ContigPath();
@@ -658,7 +694,7 @@ static ContigPath alignMulti(const Graph& g,
 		ContigID palindrome1
 			= solutions[0].rbegin()[longestSuffix].contigIndex();
 		if (opt::verbose > 1)
-			cerr << "Palindrome: "
+			log << "Palindrome: "
 				<< get(g_contigNames, palindrome0) << '\n'
 				<< "Palindrome: "
 				<< get(g_contigNames, palindrome1) << '\n';
@@ -679,10 +715,10 @@ static ContigPath alignMulti(const Graph& g,
 		return solutions[0];
 	}
 
-	ContigNode u = outputNewContig(g, solutions,
-		longestPrefix, longestSuffix, consensus, coverage, out);
+	newContig = NewContig(longestPrefix, longestSuffix,
+			consensus, coverage);
 	ContigPath path(vppath);
-	path.push_back(u);
+	path.push_back(ContigNode());
 	path.insert(path.end(), vspath.begin(), vspath.end());
 	return path;
 }
@@ -691,22 +727,48 @@ static ContigPath alignMulti(const Graph& g,
  * @return the consensus sequence
  */
 static ContigPath align(const Graph& g, const vector<Path>& sequences,
-		ofstream& out)
+		NewContig& newContig, ostream& log)
 {
 	assert(sequences.size() > 1);
 	return sequences.size() == 2
-		? alignPair(g, sequences, out)
-		: alignMulti(g, sequences, out);
+		? alignPair(g, sequences, newContig, log)
+		: alignMulti(g, sequences, newContig, log);
 }
 
-/** Return the consensus sequence of the specified gap. */
-static ContigPath fillGap(const Graph& g,
+/** The resolution of an ambiguous region of a path. */
+struct GapResolution
+{
+	enum Outcome {
+		MERGED, NOT_MERGED, NO_PATHS, TOO_MANY_PATHS, TOO_COMPLEX
+	};
+
+	Outcome outcome;
+
+	/** The paths through the ambiguous region. */
+	ContigPaths solutions;
+
+	/** The consensus path, or empty if the region is not resolved. */
+	ContigPath consensus;
+
+	/** The consensus sequence, if a new contig is needed. */
+	NewContig newContig;
+
+	/** Verbose output and warnings. */
+	string log;
+
+	GapResolution() : outcome(NO_PATHS) { }
+};
+
+/** Find the consensus of the specified gap. This function does not
+ * modify any global state, so that gaps may be resolved in parallel.
+ */
+static void fillGap(const Graph& g,
 		const AmbPathConstraint& apConstraint,
-		vector<bool>& seen,
-		ofstream& outFasta)
+		GapResolution& resolution)
 {
+	ostringstream log;
 	if (opt::verbose > 1)
-		cerr << "\n* "
+		log << "\n* "
 			<< get(vertex_name, g, apConstraint.source) << ' '
 			<< apConstraint.dist << "N "
 			<< get(vertex_name, g, apConstraint.dest) << '\n';
@@ -715,7 +777,7 @@ static ContigPath fillGap(const Graph& g,
 	constraints.push_back(Constraint(apConstraint.dest,
 				apConstraint.dist + opt::distanceError));
 
-	ContigPaths solutions;
+	ContigPaths& solutions = resolution.solutions;
 	unsigned numVisited = 0;
 	constrainedSearch(g, apConstraint.source,
 			constraints, solutions, numVisited);
@@ -725,41 +787,80 @@ static ContigPath fillGap(const Graph& g,
 			solIt != solutions.end(); solIt++)
 		solIt->insert(solIt->begin(), apConstraint.source);
 
-	ContigPath consensus;
+	ContigPath& consensus = resolution.consensus;
 	bool tooManySolutions = solutions.size() > opt::numBranches;
 	if (tooComplex) {
-		stats.tooComplex++;
+		resolution.outcome = GapResolution::TOO_COMPLEX;
 		if (opt::verbose > 1)
-			cerr << solutions.size() << " paths (too complex)\n";
+			log << solutions.size() << " paths (too complex)\n";
 	} else if (tooManySolutions) {
-		stats.numTooManySolutions++;
+		resolution.outcome = GapResolution::TOO_MANY_PATHS;
 		if (opt::verbose > 1)
-			cerr << solutions.size() << " paths (too many)\n";
+			log << solutions.size() << " paths (too many)\n";
 	} else if (solutions.empty()) {
-		stats.numNoSolutions++;
+		resolution.outcome = GapResolution::NO_PATHS;
 		if (opt::verbose > 1)
-			cerr << "no paths\n";
+			log << "no paths\n";
 	} else if (solutions.size() == 1) {
 		if (opt::verbose > 1)
-			cerr << "1 path\n" << solutions.front() << '\n';
+			log << "1 path\n" << solutions.front() << '\n';
 		consensus = solutions.front();
-		stats.numMerged++;
+		resolution.outcome = GapResolution::MERGED;
 	} else {
 		assert(solutions.size() > 1);
 		if (opt::verbose > 2)
 			copy(solutions.begin(), solutions.end(),
-					ostream_iterator<ContigPath>(cerr, "\n"));
+					ostream_iterator<ContigPath>(log, "\n"));
 		else if (opt::verbose > 1)
-			cerr << solutions.size() << " paths\n";
-		consensus = align(g, solutions, outFasta);
-		if (!consensus.empty()) {
-			stats.numMerged++;
+			log << solutions.size() << " paths\n";
+		consensus = align(g, solutions, resolution.newContig, log);
+		resolution.outcome = consensus.empty()
+			? GapResolution::NOT_MERGED : GapResolution::MERGED;
+	}
+	resolution.log = log.str();
+}
+
+/** Output the new contig of the specified resolution, mark the
+ * contigs that are used in a consensus and record statistics.
+ * @return the consensus path
+ */
+static ContigPath commitGap(const Graph& g,
+		const GapResolution& resolution,
+		vector<bool>& seen, ofstream& outFasta)
+{
+	cerr << resolution.log;
+	ContigPath consensus = resolution.consensus;
+	const NewContig& newContig = resolution.newContig;
+	if (!newContig.empty()) {
+		assert(consensus.size() > newContig.longestPrefix);
+		consensus[newContig.longestPrefix] = outputNewContig(g,
+				resolution.solutions,
+				newContig.longestPrefix, newContig.longestSuffix,
+				newContig.seq, newContig.coverage, outFasta);
+	}
+
+	switch (resolution.outcome) {
+	  case GapResolution::TOO_COMPLEX:
+		stats.tooComplex++;
+		break;
+	  case GapResolution::TOO_MANY_PATHS:
+		stats.numTooManySolutions++;
+		break;
+	  case GapResolution::NO_PATHS:
+		stats.numNoSolutions++;
+		break;
+	  case GapResolution::NOT_MERGED:
+		stats.notMerged++;
+		break;
+	  case GapResolution::MERGED:
+		stats.numMerged++;
+		if (resolution.solutions.size() > 1) {
 			// Mark contigs that are used in a consensus.
-			markSeen(seen, solutions, true);
+			markSeen(seen, resolution.solutions, true);
 			if (opt::verbose > 1)
 				cerr << consensus << '\n';
-		} else
-			stats.notMerged++;
+		}
+		break;
 	}
 	return consensus;
 }
@@ -790,6 +891,7 @@ int main(int argc, char** argv)
 		case 'o': arg >> opt::out; break;
 		case 'p': arg >> opt::identity; break;
 		case 'a': arg >> opt::numBranches; break;
+		case 'j': arg >> opt::threads; break;
 		case 's': arg >> opt::consensusPath; break;
 		case 'g': arg >> opt::graphPath; break;
 		case 'D': arg >> opt::dialign_debug; break;
@@ -844,6 +946,11 @@ int main(int argc, char** argv)
 		exit(EXIT_FAILURE);
 	}
 
+#if _OPENMP
+	if (opt::threads > 0)
+		omp_set_num_threads(opt::threads);
+#endif
+
 	const char *contigFile = argv[optind++];
 	string adjFile(argv[optind++]);
 	string allPaths(argv[optind++]);
@@ -854,24 +961,21 @@ int main(int argc, char** argv)
 	ifstream fin(adjFile.c_str());
 	assert_good(fin, adjFile);
 	Graph g;
+	loadContigNames(adjFile);
 	fin >> g;
 	assert(fin.eof());
+	saveContigNames(adjFile);
 	g_contigNames.lock();
 
 	// Read contigs
-	Contigs& contigs = g_contigs;
-	{
-		if (opt::verbose > 0)
-			cerr << "Reading `" << contigFile << "'..." << endl;
-		FastaReader in(contigFile, FastaReader::NO_FOLD_CASE);
-		for (FastaRecord rec; in >> rec;) {
-			assert(contigs.size() == get(g_contigNames, rec.id));
-			contigs.push_back(rec.seq);
-		}
-		assert(in.eof());
-		assert(!contigs.empty());
-		opt::colourSpace = isdigit(contigs[0][0]);
-	}
+	if (opt::verbose > 0)
+		cerr << "Reading `" << contigFile << "'..." << endl;
+	FastaStore contigs(contigFile, FastaStore::NO_FOLD_CASE);
+	for (size_t i = 0; i < contigs.size(); ++i)
+		assert(i == get(g_contigNames, contigs.id(i)));
+	assert(contigs.size() > 0);
+	opt::colourSpace = isdigit(contigs.sequence(0)[0]);
+	g_contigs = &contigs;
 
 	vector<string> pathIDs;
 	vector<bool> isAmbPath;
@@ -910,12 +1014,33 @@ int main(int argc, char** argv)
 	// Contigs that were seen in a consensus.
 	vector<bool> seen(contigs.size());
 
-	// resolve ambiguous paths recorded in g_ambpath_contig
-	g_contigNames.unlock();
+	// Resolve the ambiguous paths recorded in g_ambpath_contig.
+	// Each batch of gaps is resolved in parallel, and then the
+	// results are output in order, so that the output does not
+	// depend on the number of threads.
+	vector<AmbPath2Contig::iterator> ambPaths;
+	ambPaths.reserve(g_ambpath_contig.size());
 	for (AmbPath2Contig::iterator ambIt = g_ambpath_contig.begin();
 			ambIt != g_ambpath_contig.end(); ambIt++)
-		ambIt->second = fillGap(g, ambIt->first, seen, fa);
-	g_contigNames.lock();
+		ambPaths.push_back(ambIt);
+
+	const size_t BATCH_SIZE = 4096;
+	vector<GapResolution> resolutions;
+	for (size_t first = 0; first < ambPaths.size();
+			first += BATCH_SIZE) {
+		size_t last = min(first + BATCH_SIZE, ambPaths.size());
+		resolutions.clear();
+		resolutions.resize(last - first);
+#pragma omp parallel for schedule(dynamic)
+		for (int i = 0; i < (int)resolutions.size(); i++)
+			fillGap(g, ambPaths[first + i]->first, resolutions[i]);
+
+		g_contigNames.unlock();
+		for (size_t i = 0; i < resolutions.size(); i++)
+			ambPaths[first + i]->second
+				= commitGap(g, resolutions[i], seen, fa);
+		g_contigNames.lock();
+	}
 	assert_good(fa, opt::consensusPath);
 	fa.close();
 	if (opt::verbose > 1)
@@ -8,6 +8,7 @@
 #include "ContigProperties.h"
 #include "Estimate.h"
 #include "FastaReader.h"
+#include "FastaStore.h"
 #include "IOUtil.h"
 #include "Uncompress.h"
 #include "Graph/ContigGraph.h"
@@ -126,7 +127,7 @@ static const struct option longopts[] = {
 };
 
 /** Contig sequences. */
-static vector<string> g_contigs;
+static const FastaStore* g_contigs;
 
 /** Contig adjacency graph. */
 typedef ContigGraph<DirectedGraph<ContigProperties, Distance> > Graph;
@@ -142,10 +143,9 @@ static struct {
 } stats;
 
 /** Return the sequence of the specified contig. */
-static string sequence(const ContigNode& id)
+static FastaStore::View sequence(const ContigNode& id)
 {
-	const string& seq = g_contigs[id.id()];
-	return id.sense() ? reverseComplement(seq) : seq;
+	return g_contigs->sequence(id.id(), id.sense());
 }
 
 static unsigned findOverlap(const Graph& g,
@@ -154,14 +154,15 @@ static unsigned findOverlap(const Graph& g,
 		bool& mask)
 {
 	mask = false;
-	string t = sequence(t_id);
-	string h = sequence(h_id);
+	FastaStore::View t = sequence(t_id);
+	FastaStore::View h = sequence(h_id);
 	unsigned len = min(t.length(), h.length());
+	string tail = t.substr(t.length() - len);
+	string head = h.substr(0, len);
 	vector<unsigned> overlaps;
 	overlaps.reserve(len);
 	for (unsigned overlap = len; overlap >= 1; overlap--) {
-		if (t.substr(t.length()-overlap, overlap)
-				== h.substr(0, overlap))
+		if (tail.compare(len - overlap, overlap, head, 0, overlap) == 0)
 			overlaps.push_back(overlap);
 	}
 
@@ -252,8 +253,8 @@ static FastaRecord createGapContig(const Graph& g,
 	assert(distance < 100000);
 	string gap = distance <= 0 ? string("n")
 		: string(distance, 'N');
-	const string& useq = sequence(u);
-	const string& vseq = sequence(v);
+	FastaStore::View useq = sequence(u);
+	FastaStore::View vseq = sequence(v);
 	unsigned overlap = opt::k - 1; // by convention
 	return newContig(g, u, v, distance,
 			useq.substr(useq.length() - overlap) + gap
@@ -352,16 +353,6 @@ static void findOverlap(const Graph& g,
 		add_edge(t, h, Overlap(est, overlap, mask), out);
 }
 
-static void readContigs(const char *contigPath)
-{
-	FastaReader in(contigPath, FastaReader::FOLD_CASE);
-	for (FastaRecord rec; in >> rec;)
-		g_contigs.push_back(rec.seq);
-	assert(in.eof());
-	assert(!g_contigs.empty());
-	opt::colourSpace = isdigit(g_contigs[0][0]);
-}
-
 int main(int argc, char** argv)
 {
 	string commandLine;
@@ -428,7 +419,10 @@ int main(int argc, char** argv)
 	string adjPath(argv[optind++]);
 	string estPath(argv[optind++]);
 
-	readContigs(contigPath);
+	FastaStore contigs(contigPath, FastaStore::FOLD_CASE);
+	assert(contigs.size() > 0);
+	opt::colourSpace = isdigit(contigs.sequence(0)[0]);
+	g_contigs = &contigs;
 
 	// Read the contig adjacency graph.
 	ifstream fin(adjPath.c_str());
@@ -2,6 +2,19 @@
 #define PAIREDDBG_BRANCHRECORD_H 1
 
 #include "Common/Options.h" // for opt::verbose
+#include "PairedDBG/Dinuc.h"
+
+/** The bases that extend a branch of k-mer pairs by one k-mer pair. */
+struct BranchStep
+{
+	typedef Dinuc value_type;
+
+	/** The number of bits of a packed step */
+	static const unsigned BITS = 4;
+
+	static unsigned pack(value_type x) { return x.toInt(); }
+	static value_type unpack(unsigned x) { return Dinuc((Dinuc::Bits)x); }
+};
 
 /** Generate the sequence of this contig. */
 template <typename It, typename OutIt>
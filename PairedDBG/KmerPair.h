@@ -197,6 +197,12 @@ unsigned getCode() const
 	return m_a.getCode() ^ m_b.getCode();
 }
 
+/** Return a hash of the canonical minimizers of the two k-mers. */
+unsigned getMinimizerCode(unsigned m) const
+{
+	return m_a.getMinimizerCode(m) ^ m_b.getMinimizerCode(m);
+}
+
 private:
 
 	/** The length of a k-mer pair, including the gap. */
@@ -5,11 +5,13 @@
 #include "Common/Log.h"
 #include "Common/Options.h"
 #include "Common/StringUtil.h"
+#include "Common/Uncompress.h"
 #include "DataLayer/FastaWriter.h"
 #include <climits> // for UINT_MAX
 #include <cstdlib>
 #include <fstream>
 #include <iostream>
+#include <sys/stat.h>
 #include <utility>
 
 using namespace std;
@@ -30,12 +32,32 @@ namespace NSC
 // control node uses a lot of memory at large NP.
 const int DEDICATE_CONTROL_AT = 1000;
 
+/** Return whether the specified input file may be split into
+ * sections that are loaded by different processes. A regular,
+ * uncompressed file of reads may be split. A compressed file, a pipe
+ * or a k-mer file is loaded whole by one process.
+ */
+static bool isSplittable(const string& path)
+{
+	struct stat st;
+	return path != "-" && path.find(".kmer") == string::npos
+		&& !uncompress_isPipe(path.c_str())
+		&& stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode)
+		&& st.st_size > 0;
+}
+
 void NetworkSequenceCollection::loadSequences()
 {
 	Timer timer("LoadSequences");
-	for (unsigned i = opt::rank; i < opt::inFiles.size();
-			i += opt::numProc)
-		AssemblyAlgorithms::loadSequences(this, opt::inFiles[i]);
+	unsigned whole = 0;
+	for (unsigned i = 0; i < opt::inFiles.size(); ++i) {
+		const string& path = opt::inFiles[i];
+		if (isSplittable(path))
+			AssemblyAlgorithms::loadSequences(this, path,
+					opt::rank + 1, opt::numProc);
+		else if (whole++ % opt::numProc == (unsigned)opt::rank)
+			AssemblyAlgorithms::loadSequences(this, path);
+	}
 }
 
 /** Receive, process, send, and synchronize.
@@ -1499,9 +1521,11 @@ bool NetworkSequenceCollection::isLocal(const V& seq) const
 /** Return the process ID to which the specified kmer belongs. */
 int NetworkSequenceCollection::computeNodeID(const V& seq) const
 {
+	unsigned code = opt::minimizer > 0
+		? seq.getMinimizerCode(opt::minimizer) : seq.getCode();
 	if (opt::numProc < DEDICATE_CONTROL_AT) {
-		return seq.getCode() % (unsigned)opt::numProc;
+		return code % (unsigned)opt::numProc;
 	} else {
-		return seq.getCode() % (unsigned)(opt::numProc - 1) + 1;
+		return code % (unsigned)(opt::numProc - 1) + 1;
 	}
 }
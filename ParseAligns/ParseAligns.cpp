@@ -410,16 +410,16 @@ handleAlignment(const ReadAlignMap::value_type& alignments, ReadAlignMap& out)
 }
 
 static void
-readAlignment(const string& line, ReadAlignMap& out)
+readAlignment(string& line, ReadAlignMap& out)
 {
-	istringstream s(line);
 	pair<string, AlignmentVector> v;
 	switch (opt::inputFormat) {
 	case opt::SAM: {
-		SAMRecord sam;
-		s >> sam;
-		assert(s);
-		v.first = sam.qname;
+		SAMRecordView sam;
+		bool good = sam.parse(line);
+		assert(good);
+		(void)good;
+		v.first = sam.qname().c_str();
 		if (sam.isRead1())
 			v.first += "/1";
 		else if (sam.isRead2())
@@ -429,6 +429,7 @@ readAlignment(const string& line, ReadAlignMap& out)
 		break;
 	}
 	case opt::KALIGNER: {
+		istringstream s(line);
 		s >> v.first;
 		assert(s);
 		v.second.reserve(count(line.begin(), line.end(), '\t'));
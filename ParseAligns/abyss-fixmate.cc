@@ -287,20 +287,23 @@ parseTag(string line)
 static void
 readAlignments(istream& in, Alignments* pMap)
 {
-	for (SAMRecord sam; in >> ws;) {
-		if (in.peek() == '@') {
-			string line;
-			getline(in, line);
-			assert(in);
-
+	SAMRecord sam;
+	SAMRecordView view;
+	for (string line; getline(in >> ws, line);) {
+		if (line[0] == '@') {
 			if (!opt::covPath.empty())
 				parseTag(line);
 
 			cout << line << '\n';
 			if (!opt::fragPath.empty())
 				g_fragFile << line << '\n';
-		} else if (in >> sam)
+		} else if (view.parse(line)) {
+			sam.assign(view);
 			handleAlignment(sam, *pMap);
+		} else {
+			in.setstate(ios::failbit);
+			break;
+		}
 	}
 	if (!opt::covPath.empty())
 		printCov(opt::covPath);
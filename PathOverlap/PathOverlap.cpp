@@ -9,6 +9,7 @@
 #include "Graph/DirectedGraph.h"
 #include "Graph/GraphIO.h"
 #include "IOUtil.h"
+#include "PathIndex.h"
 #include "Uncompress.h"
 #include "config.h"
 #include <algorithm>
@@ -250,102 +251,80 @@ readPaths(Graph& g, const string& inPath, vector<string>& pathIDs)
 	return paths;
 }
 
-typedef multimap<ContigNode, Vertex> SeedMap;
-
-/** Index the first and last contig of each path to facilitate finding
- * overlaps between paths. */
-static SeedMap
-makeSeedMap(const Paths& paths)
-{
-	SeedMap seedMap;
-	for (Paths::const_iterator it = paths.begin(); it != paths.end(); ++it) {
-		if (it->empty())
-			continue;
-		assert(!it->front().ambiguous());
-		seedMap.insert(make_pair(it->front(), Vertex(it - paths.begin(), false)));
-		assert(!it->back().ambiguous());
-		seedMap.insert(make_pair(it->back() ^ 1, Vertex(it - paths.begin(), true)));
-	}
-	return seedMap;
-}
-
-/** Check whether path starts with the sequence [first, last). */
-static bool
-startsWith(
-    ContigPath path,
-    bool rc,
-    ContigPath::const_iterator first,
-    ContigPath::const_iterator last)
+/** Index the contigs of the paths to facilitate finding overlaps
+ * between paths. */
+static PathIndex
+makePathIndex(const Paths& paths)
 {
-	if (rc)
-		reverseComplement(path.begin(), path.end());
-	assert(*first == path.front());
-	assert(first < last);
-	return unsigned(last - first) > path.size() ? false : equal(first, last, path.begin());
-}
-
-/** Check whether path starts with the sequence [first, last). */
-static unsigned
-findOverlap(
-    const Graph& g,
-    const Paths& paths,
-    ContigPath::const_iterator first,
-    ContigPath::const_iterator last,
-    const Vertex& v,
-    int& distance)
-{
-	if (!startsWith(paths[v.id], v.sense, first, last))
-		return 0;
-	distance = -addProp(g, first, last).length;
-	return last - first;
+	PathIndex index;
+	for (Paths::const_iterator it = paths.begin(); it != paths.end(); ++it)
+		index.insert(it - paths.begin(), *it);
+	return index;
 }
 
 typedef vector<Overlap> Overlaps;
 
-/** Find every path that overlaps with the specified path. */
+/** Find every path whose suffix overlaps a prefix of the specified
+ * path. */
 static void
 findOverlaps(
     const Graph& g,
     const Paths& paths,
-    const SeedMap& seedMap,
+    const PathIndex& index,
     const Vertex& v,
     Overlaps& overlaps)
 {
-	ContigPath rc;
-	if (v.sense) {
-		rc = paths[v.id];
-		reverseComplement(rc.begin(), rc.end());
-	}
-	const ContigPath& path = v.sense ? rc : paths[v.id];
-
-	for (ContigPath::const_iterator it = path.begin(); it != path.end(); ++it) {
-		if (it->ambiguous())
+	const ContigPath& path = paths[v.id];
+	if (path.empty())
+		return;
+	ContigNode head = orientedFront(path, v.sense);
+	assert(!head.ambiguous());
+
+	const PathIndex::Postings& postings = index.postings(head);
+	for (PathIndex::Postings::const_iterator it = postings.begin(); it != postings.end();
+	     ++it) {
+		const ContigPath& path2 = paths[it->path];
+		pair<bool, unsigned> orient = it->orient(head, path2.size());
+		Vertex u(it->path, orient.first);
+		if (u == v || !suffixIsPrefix(path2, u.sense, orient.second, path, v.sense))
 			continue;
-
-		pair<SeedMap::const_iterator, SeedMap::const_iterator> range = seedMap.equal_range(*it);
-		for (SeedMap::const_iterator seed = range.first; seed != range.second; ++seed) {
-			if (v == seed->second)
-				continue;
-			int distance = 0;
-			unsigned overlap = findOverlap(g, paths, it, path.end(), seed->second, distance);
-			if (overlap > 0)
-				overlaps.push_back(Overlap(v, seed->second, overlap, distance));
-		}
+		unsigned overlap = path2.size() - orient.second;
+		// The length of the overlap is the same in either orientation.
+		int distance = v.sense ? -addProp(g, path.end() - overlap, path.end()).length
+		                       : -addProp(g, path.begin(), path.begin() + overlap).length;
+		overlaps.push_back(Overlap(u, v, overlap, distance));
 	}
 }
 
+/** Order the overlaps by source, by the start of the overlap in the
+ * source and by target. */
+static bool
+compareOverlaps(const Overlap& a, const Overlap& b)
+{
+	if (a.source.id != b.source.id)
+		return a.source.id < b.source.id;
+	if (a.source.sense != b.source.sense)
+		return a.source.sense < b.source.sense;
+	if (a.overlap != b.overlap)
+		return a.overlap > b.overlap;
+	if (a.target.id != b.target.id)
+		return a.target.id < b.target.id;
+	return a.target.sense < b.target.sense;
+}
+
 /** Find every pair of overlapping paths. */
 static Overlaps
 findOverlaps(const Graph& g, const Paths& paths)
 {
-	SeedMap seedMap = makeSeedMap(paths);
+	PathIndex index = makePathIndex(paths);
 
 	Overlaps overlaps;
 	for (Paths::const_iterator it = paths.begin(); it != paths.end(); ++it) {
 		unsigned i = it - paths.begin();
-		findOverlaps(g, paths, seedMap, Vertex(i, false), overlaps);
-		findOverlaps(g, paths, seedMap, Vertex(i, true), overlaps);
+		findOverlaps(g, paths, index, Vertex(i, false), overlaps);
+		findOverlaps(g, paths, index, Vertex(i, true), overlaps);
 	}
+	sort(overlaps.begin(), overlaps.end(), compareOverlaps);
 	return overlaps;
 }
 
@@ -626,8 +626,10 @@ main(int argc, char** argv)
 	ifstream fin(adjPath.c_str());
 	assert_good(fin, adjPath);
 	Graph g;
+	loadContigNames(adjPath);
 	fin >> g;
 	assert(fin.eof());
+	saveContigNames(adjPath);
 	g_contigNames.lock();
 	if (opt::verbose > 0)
 		printGraphStats(cerr, g);
@@ -8,6 +8,75 @@
 Graph g_contigGraph;
 std::vector<std::string> g_contigComments;
 ContigSequences g_contigSequences;
+std::vector<ContigSequenceRef> g_contigSequenceRefs;
+
+/** Return the two-bit code of an upper-case base, or -1. */
+static inline int
+packedBaseCode(char c)
+{
+	switch (c) {
+	case 'A':
+		return 0;
+	case 'C':
+		return 1;
+	case 'G':
+		return 2;
+	case 'T':
+		return 3;
+	default:
+		return -1;
+	}
+}
+
+PackedSequence::PackedSequence(const std::string& s)
+  : m_size(s.size())
+  , m_bits((s.size() + 31) / 32)
+{
+	for (size_t i = 0; i < s.size(); i++) {
+		int code = opt::colourSpace ? -1 : packedBaseCode(s[i]);
+		if (code >= 0) {
+			m_bits[i / 32] |= uint64_t(code) << (2 * (i % 32));
+		} else if (
+		    !m_exceptions.empty() && m_exceptions.back().c == s[i] &&
+		    m_exceptions.back().pos + m_exceptions.back().length == i) {
+			m_exceptions.back().length++;
+		} else {
+			Exception e = { uint32_t(i), 1, s[i] };
+			m_exceptions.push_back(e);
+		}
+	}
+}
+
+void
+PackedSequence::appendTo(Sequence& s, size_t pos, size_t n, bool rc) const
+{
+	assert(pos + n <= m_size);
+	const size_t start = rc ? m_size - pos - n : pos;
+	const size_t first = s.size();
+	s.resize(first + n);
+	char* p = &s[first];
+	for (size_t i = 0; i < n; i++) {
+		const size_t j = start + i;
+		p[i] = "ACGT"[(m_bits[j / 32] >> (2 * (j % 32))) & 3];
+	}
+
+	auto it = std::upper_bound(
+	    m_exceptions.begin(), m_exceptions.end(), start, [](size_t x, const Exception& e) {
+		    return x < e.pos + e.length;
+	    });
+	for (; it != m_exceptions.end() && it->pos < start + n; ++it) {
+		const size_t from = std::max<size_t>(it->pos, start);
+		const size_t to = std::min<size_t>(it->pos + it->length, start + n);
+		std::fill(p + from - start, p + to - start, it->c);
+	}
+
+	if (rc) {
+		std::reverse(p, p + n);
+		if (!opt::colourSpace) {
+			std::transform(p, p + n, p, complementBaseChar);
+		}
+	}
+}
 
 int
 distanceBetween(const ContigNode& node1, const ContigNode& node2)
@@ -15,12 +84,31 @@ distanceBetween(const ContigNode& node1, const ContigNode& node2)
 	return get(edge_bundle, g_contigGraph, node1, node2).distance;
 }
 
-const ContigSequence&
+ContigSequence
 getContigSequence(const ContigNode& node)
 {
-	const unsigned int idx = node.index();
-	assert(idx < g_contigSequences.size());
-	return g_contigSequences[idx];
+	const unsigned int id = node.id();
+	assert(id < g_contigSequenceRefs.size());
+	const ContigSequenceRef& ref = g_contigSequenceRefs[id];
+	return ContigSequence(g_contigSequences[ref.seq], ref.rc != node.sense());
+}
+
+/** Add the sequence of the next contig. */
+void
+addContigSequence(const Sequence& seq)
+{
+	ContigSequenceRef ref = { unsigned(g_contigSequences.size()), false };
+	g_contigSequences.push_back(PackedSequence(seq));
+	g_contigSequenceRefs.push_back(ref);
+}
+
+/** Add the next contig, which is a copy of the specified contig. */
+void
+addContigSequence(const ContigNode& original)
+{
+	ContigSequenceRef ref = g_contigSequenceRefs[original.id()];
+	ref.rc = ref.rc != original.sense();
+	g_contigSequenceRefs.push_back(ref);
 }
 
 int
@@ -37,21 +125,27 @@ getContigComment(const ContigNode& node)
 	return g_contigComments[id];
 }
 
+/** Append the sequence of node to sequence, which ends with the
+ * specified overlap with node. */
+static void
+appendContigSequence(Sequence& sequence, const ContigNode& node, const int overlap)
+{
+	assert(overlap >= 0);
+	const ContigSequence newSequence = getContigSequence(node);
+	assert(int(sequence.size()) >= overlap);
+	assert(int(newSequence.size()) >= overlap);
+	assert(sequence.substr(sequence.size() - overlap) == newSequence.substr(0, overlap));
+	newSequence.appendTo(sequence, overlap);
+}
+
 Sequence
 getPathSequence(const ContigPath& path)
 {
 	assert(path.size() >= 1);
-	Sequence sequence = Sequence(getContigSequence(path[0]));
+	Sequence sequence = getContigSequence(path[0]);
 	for (size_t i = 1; i < path.size(); i++) {
-		const auto& node = path[i];
 		const auto distance = distanceBetween(path[i - 1], path[i]);
-		const auto overlap = -distance;
-		assert(overlap >= 0);
-		Sequence newSequence = Sequence(getContigSequence(node));
-		assert(int(sequence.size()) >= overlap);
-		assert(int(newSequence.size()) >= overlap);
-		assert(sequence.substr(sequence.size() - overlap) == newSequence.substr(0, overlap));
-		sequence += newSequence.substr(overlap);
+		appendContigSequence(sequence, path[i], -distance);
 	}
 	return sequence;
 }
@@ -60,17 +154,9 @@ Sequence
 getPathSequence(const ImaginaryContigPath& path)
 {
 	assert(path.size() >= 1);
-	Sequence sequence = Sequence(getContigSequence(path[0].first));
+	Sequence sequence = getContigSequence(path[0].first);
 	for (size_t i = 1; i < path.size(); i++) {
-		const auto& node = path[i].first;
-		const auto& distance = path[i].second;
-		const auto overlap = -distance;
-		assert(overlap >= 0);
-		Sequence newSequence = Sequence(getContigSequence(node));
-		assert(int(sequence.size()) >= overlap);
-		assert(int(newSequence.size()) >= overlap);
-		assert(sequence.substr(sequence.size() - overlap) == newSequence.substr(0, overlap));
-		sequence += newSequence.substr(overlap);
+		appendContigSequence(sequence, path[i].first, -path[i].second);
 	}
 	return sequence;
 }
@@ -113,14 +199,15 @@ loadContigs(const std::string& contigsPath)
 	for (FastaRecord rec; in >> rec;) {
 		if (g_contigNames.count(rec.id) == 0)
 			continue;
-		assert(g_contigSequences.size() / 2 == get(g_contigNames, rec.id));
+		assert(g_contigSequenceRefs.size() == get(g_contigNames, rec.id));
+		if (g_contigSequences.empty()) {
+			opt::colourSpace = isdigit(rec.seq[0]);
+		}
 		g_contigComments.push_back(rec.comment);
-		g_contigSequences.push_back(rec.seq);
-		g_contigSequences.push_back(reverseComplement(rec.seq));
+		addContigSequence(rec.seq);
 	}
 	assert(in.eof());
 	assert(!g_contigSequences.empty());
-	opt::colourSpace = isdigit(g_contigSequences.front()[0]);
 	if (opt::verbose) {
 		std::cerr << "Contigs loaded.\n";
 	}
@@ -166,7 +253,7 @@ storeContigs(const std::string& contigsPath)
 
 			rec.id = name.substr(0, name.size() - 1);
 			rec.comment = getContigComment(node);
-			rec.seq = getContigSequence(node);
+			rec.seq = getContigSequence(node).str();
 
 			fout << rec;
 		}
@@ -245,8 +332,7 @@ assembleContigs()
 			ss << ",...";
 		ss << ',' << get(vertex_name, g_contigGraph, path.back());
 
-		g_contigSequences.push_back(sequence);
-		g_contigSequences.push_back(reverseComplement(sequence));
+		addContigSequence(sequence);
 		g_contigComments.push_back(ss.str());
 	}
 
@@ -1,7 +1,6 @@
 #ifndef RRESOLVER_CONTIGS_H
 #define RRESOLVER_CONTIGS_H 1
 
-#include "Common/ConstString.h"
 #include "Common/ContigNode.h"
 #include "Common/ContigPath.h"
 #include "Common/ContigProperties.h"
@@ -17,7 +16,10 @@
 #include "Graph/GraphIO.h"
 #include "Graph/GraphUtil.h"
 
+#include <algorithm>
+#include <cassert>
 #include <set>
+#include <stdint.h>
 #include <string>
 #include <vector>
 
@@ -28,23 +30,79 @@ typedef Graph::adjacency_iterator adjacency_iterator;
 typedef Graph::in_edge_iterator in_edge_iterator;
 typedef Graph::out_edge_iterator out_edge_iterator;
 
-class ContigSequence : public const_string
+/** A contig sequence packed in two bits per base. Characters other
+ * than upper-case ACGT, such as N and masked bases, are stored as
+ * runs of exceptions. */
+class PackedSequence
 {
 public:
-	ContigSequence(const std::string& s)
-	  : const_string(s)
+	PackedSequence(const std::string& s);
+
+	size_t size() const { return m_size; }
+
+	/** Append n bases starting at pos to s, reading the reverse
+	 * complement of this sequence if rc is true. */
+	void appendTo(Sequence& s, size_t pos, size_t n, bool rc) const;
+
+private:
+	/** A run of a character that is not upper-case ACGT. */
+	struct Exception
+	{
+		uint32_t pos;
+		uint32_t length;
+		char c;
+	};
+
+	size_t m_size;
+	std::vector<uint64_t> m_bits;
+	std::vector<Exception> m_exceptions;
+};
+
+/** A read-only view of a contig sequence in either orientation. */
+class ContigSequence
+{
+public:
+	ContigSequence(const PackedSequence& seq, bool rc)
+	  : m_seq(&seq)
+	  , m_rc(rc)
+	{}
+
+	size_t size() const { return m_seq->size(); }
+
+	/** Append n bases starting at pos to s. */
+	void appendTo(Sequence& s, size_t pos = 0, size_t n = std::string::npos) const
+	{
+		assert(pos <= size());
+		m_seq->appendTo(s, pos, std::min(n, size() - pos), m_rc);
+	}
+
+	/** Return n bases starting at pos. */
+	Sequence substr(size_t pos = 0, size_t n = std::string::npos) const
 	{
-		strSize = const_string::size();
+		Sequence s;
+		appendTo(s, pos, n);
+		return s;
 	}
 
-	size_t size() const { return strSize; }
+	/** Return a copy of this sequence. */
+	Sequence str() const { return substr(); }
+	operator Sequence() const { return str(); }
 
 private:
-	size_t strSize;
+	const PackedSequence* m_seq;
+	bool m_rc;
+};
+
+/** The packed sequence of a contig and its orientation. Copies of a
+ * contig share one packed sequence. */
+struct ContigSequenceRef
+{
+	unsigned seq;
+	bool rc;
 };
 
 typedef std::vector<std::pair<std::string, std::string>> ContigSequencesInfo;
-typedef std::vector<ContigSequence> ContigSequences;
+typedef std::vector<PackedSequence> ContigSequences;
 typedef std::vector<ContigNode> ContigPath;
 typedef std::vector<ContigPath> ContigPaths;
 typedef std::vector<std::pair<ContigNode, int>>
@@ -54,11 +112,16 @@ typedef std::set<ImaginaryContigPath> ImaginaryContigPaths;
 extern Graph g_contigGraph;
 extern std::vector<std::string> g_contigComments;
 extern ContigSequences g_contigSequences;
+extern std::vector<ContigSequenceRef> g_contigSequenceRefs;
 
 int
 distanceBetween(const ContigNode& node1, const ContigNode& node2);
-const ContigSequence&
+ContigSequence
 getContigSequence(const ContigNode& node);
+void
+addContigSequence(const Sequence& seq);
+void
+addContigSequence(const ContigNode& original);
 int
 getContigSize(const ContigNode& node);
 const std::string&
@@ -10,6 +10,7 @@
 #endif
 
 #include <algorithm>
+#include <atomic>
 #include <fstream>
 #include <iostream>
 #include <map>
@@ -43,7 +44,7 @@ class FractionHistogram : public Histogram
 	friend std::ostream& operator<<(std::ostream& o, const FractionHistogram& h)
 	{
 		o << (Histogram&)h;
-		if (h.size() == 0 || (--h.end())->first != 100) {
+		if (h.empty() || h.maximum() != 100) {
 			o << 100 << "\t0\n";
 		}
 		return o;
@@ -399,12 +400,19 @@ testCombination(
 		return Support(Support::UnknownReason::TAIL_SHORTER_THAN_MARGIN);
 	}
 
-	Sequence sequence;
+	// Reuse the buffer of this thread rather than allocating a
+	// sequence for every test.
+	static thread_local Sequence sequence;
+	sequence.clear();
 	if (possibleTests > plannedTests + 1) {
 		assert(long(head.size()) > margin || long(tail.size()) > margin);
-		sequence = head.substr(head.size() - margin) + repeat + tail.substr(0, margin);
+		sequence.append(head, head.size() - margin, margin);
+		sequence += repeat;
+		sequence.append(tail, 0, margin);
 	} else {
-		sequence = head + repeat + tail;
+		sequence += head;
+		sequence += repeat;
+		sequence += tail;
 	}
 	possibleTests = sequence.size() - windowSize + 1;
 
@@ -445,6 +453,24 @@ expectedSpacingBetweenReads(const ContigPath& path)
 	return expectedSpacing;
 }
 
+/** Update maxSupport with the support of another combination.
+ * @return false if the support is unknown, in which case maxSupport
+ * becomes that support
+ */
+static bool
+updateMaxSupport(Support& maxSupport, Support support)
+{
+	if (support.unknown()) {
+		maxSupport = support;
+		return false;
+	} else if (support > maxSupport) {
+		maxSupport = support;
+	} else if (maxSupport.found == 0 && support.tests > maxSupport.tests) {
+		maxSupport.tests = support.tests;
+	}
+	return true;
+}
+
 static Support
 determinePathSupport(const ContigPath& path)
 {
@@ -516,56 +542,46 @@ determinePathSupport(const ContigPath& path)
 	}
 
 	Support maxSupport(calculatedTests, Support::UnknownReason::UNDETERMINED);
-	bool unknown = false;
+	std::atomic<bool> unknown(false);
 
 	if (combinations >= PATH_COMBINATIONS_MULTITHREAD_THRESHOLD) {
-		bool end = false;
 #if _OPENMP
 		for (const auto& h : heads) {
 			const auto head = h;
 #else
 		for (const auto& head : heads) {
 #endif
-#pragma omp critical(maxSupport)
-			{
-				if (unknown) {
-					end = true;
-				}
-			}
-			if (end) {
+			if (unknown) {
 				break;
 			}
 
+			// Each head is tested against every tail in its own task,
+			// which merges its best support once when it is done.
 #pragma omp task firstprivate(head) shared(maxSupport, unknown)
 			{
-				bool end = false;
+				Support headSupport(calculatedTests, Support::UnknownReason::UNDETERMINED);
+				bool tested = false, headUnknown = false;
 				for (const auto& tail : tails) {
-#pragma omp critical(maxSupport)
-					{
-						if (unknown) {
-							end = true;
-						}
-					}
-					if (end) {
+					if (unknown) {
 						break;
 					}
 
 					auto support = testCombination(head, repeat, tail, requiredTests);
+					tested = true;
+					if (!updateMaxSupport(headSupport, support)) {
+						headUnknown = true;
+						unknown = true;
+						break;
+					}
+				}
 
+				if (headUnknown) {
 #pragma omp critical(maxSupport)
-					{
-						if (support.unknown()) {
-							unknown = true;
-							end = true;
-							maxSupport = support;
-						} else if (support > maxSupport) {
-							maxSupport = support;
-						} else if (maxSupport.found == 0 && support.tests > maxSupport.tests) {
-							maxSupport.tests = support.tests;
-						}
-					}
-					if (end) {
-						break;
+					maxSupport = headSupport;
+				} else if (tested && !unknown) {
+#pragma omp critical(maxSupport)
+					if (!unknown) {
+						updateMaxSupport(maxSupport, headSupport);
 					}
 				}
 			}
@@ -577,20 +593,10 @@ determinePathSupport(const ContigPath& path)
 			}
 
 			for (const auto& tail : tails) {
-				if (unknown) {
-					break;
-				}
-
 				auto support = testCombination(head, repeat, tail, requiredTests);
-
-				if (support.unknown()) {
+				if (!updateMaxSupport(maxSupport, support)) {
 					unknown = true;
-					maxSupport = support;
 					break;
-				} else if (support > maxSupport) {
-					maxSupport = support;
-				} else if (maxSupport.found == 0 && support.tests > maxSupport.tests) {
-					maxSupport.tests = support.tests;
 				}
 			}
 		}
@@ -940,12 +946,22 @@ processGraph(
 	const auto start = resolution.repeatSupportMap.begin();
 	const auto end = resolution.repeatSupportMap.end();
 
-#ifdef _OPENMP
-	int threads = omp_get_num_threads();
+#if _OPENMP
+	const int threads = omp_get_max_threads();
 #else
-	int threads = 1;
+	const int threads = 1;
 #endif
 
+	// Each thread collects its results in its own buffers, which are
+	// merged once every repeat has been processed.
+	std::vector<std::vector<ImaginaryContigPath>> threadSupported(threads), threadUnsupported(threads);
+
+	for (auto it = start; it != end; it++) {
+		const auto repeat = ContigNode(it->first);
+		repeatInstancesMap.emplace(repeat.index(), std::vector<RepeatInstance>());
+		repeatInstancesMap.emplace((repeat ^ true).index(), std::vector<RepeatInstance>());
+	}
+
 	// 1
 	iteratorMultithreading(
 	    start,
@@ -957,12 +973,7 @@ processGraph(
 	    [&](const std::pair<int, SupportMap>& repeatSupport) {
 		    const auto repeat = ContigNode(repeatSupport.first);
 		    const auto& supportMap = repeatSupport.second;
-
-#pragma omp critical(repeatInstancesMap)
-		    {
-			    repeatInstancesMap.emplace(repeat.index(), std::vector<RepeatInstance>());
-			    repeatInstancesMap.emplace((repeat ^ true).index(), std::vector<RepeatInstance>());
-		    }
+		    const int tid = threadNum();
 
 		    for (const auto& intigIdxAndOutigsSupp : supportMap) {
 			    const auto intig = ContigNode(intigIdxAndOutigsSupp.first);
@@ -977,26 +988,28 @@ processGraph(
 					                             { outig, dist2 } };
 
 				    if (support.good()) {
-#pragma omp critical(supportedPaths)
-					    supportedPaths.insert(path);
+					    threadSupported[tid].push_back(path);
 				    } else {
-#pragma omp critical(unsupportedPaths)
-					    unsupportedPaths.insert(path);
-
-#pragma omp critical(supportedPaths)
-					    {
-						    if (supportedPaths.find(path) != supportedPaths.end()) {
-							    supportedPaths.erase(path);
-						    }
-					    }
+					    threadUnsupported[tid].push_back(path);
 				    }
 			    }
 		    }
 
 #pragma omp critical(cerr)
 		    progressUpdate();
-	    },
-	    std::min(4, threads));
+	    });
+
+	// Each path includes its repeat, so no path is both supported and
+	// unsupported in this subiteration.
+	for (const auto& paths : threadSupported) {
+		supportedPaths.insert(paths.begin(), paths.end());
+	}
+	for (const auto& paths : threadUnsupported) {
+		for (const auto& path : paths) {
+			unsupportedPaths.insert(path);
+			supportedPaths.erase(path);
+		}
+	}
 
 	// 2
 	for (auto it = start; it != end; it++) {
@@ -1086,6 +1099,9 @@ processGraph(
 	}
 
 	// 3
+	std::vector<std::vector<OldEdge>> threadEdges2remove(threads);
+	std::vector<std::vector<NewVertex>> threadVertices2add(threads);
+	std::vector<std::vector<NewEdge>> threadEdges2add(threads);
 	iteratorMultithreading(
 	    start,
 	    end,
@@ -1097,6 +1113,7 @@ processGraph(
 		    const auto repeat = ContigNode(repeatSupport.first);
 
 		    auto& repeatInstances = repeatInstancesMap.at(repeat.index());
+		    const int tid = threadNum();
 
 		    std::list<RepeatInstance> tempInstances;
 
@@ -1134,8 +1151,7 @@ processGraph(
 				    for (std::tie(inIt, inLast) = in_edges(instance.original, g_contigGraph);
 				         inIt != inLast;
 				         ++inIt) {
-#pragma omp critical(edges2remove)
-					    edges2remove.push_back(
+					    threadEdges2remove[tid].push_back(
 					        OldEdge(source(*inIt, g_contigGraph), instance.original));
 				    }
 
@@ -1143,18 +1159,15 @@ processGraph(
 				    for (std::tie(outIt, outLast) = out_edges(instance.original, g_contigGraph);
 				         outIt != outLast;
 				         ++outIt) {
-#pragma omp critical(edges2remove)
-					    edges2remove.push_back(
+					    threadEdges2remove[tid].push_back(
 					        OldEdge(instance.original, target(*outIt, g_contigGraph)));
 				    }
 			    } else {
-#pragma omp critical(vertices2add)
-				    vertices2add.push_back(NewVertex(instance.original, instance.instance));
+				    threadVertices2add[tid].push_back(NewVertex(instance.original, instance.instance));
 			    }
 
 			    for (const RepeatInstance& intigInstance : instance.intigsInstances) {
-#pragma omp critical(edges2add)
-				    edges2add.push_back(NewEdge(
+				    threadEdges2add[tid].push_back(NewEdge(
 				        intigInstance.instance,
 				        instance.instance,
 				        get(edge_bundle,
@@ -1163,8 +1176,7 @@ processGraph(
 			    }
 
 			    for (const RepeatInstance& outigInstance : instance.outigsInstances) {
-#pragma omp critical(edges2add)
-				    edges2add.push_back(NewEdge(
+				    threadEdges2add[tid].push_back(NewEdge(
 				        instance.instance,
 				        outigInstance.instance,
 				        get(edge_bundle,
@@ -1177,6 +1189,14 @@ processGraph(
 		    progressUpdate();
 	    });
 
+	for (int i = 0; i < threads; i++) {
+		edges2remove.insert(
+		    edges2remove.end(), threadEdges2remove[i].begin(), threadEdges2remove[i].end());
+		vertices2add.insert(
+		    vertices2add.end(), threadVertices2add[i].begin(), threadVertices2add[i].end());
+		edges2add.insert(edges2add.end(), threadEdges2add[i].begin(), threadEdges2add[i].end());
+	}
+
 	std::sort(
 	    vertices2add.begin(), vertices2add.end(), [](const NewVertex& v1, const NewVertex& v2) {
 		    return v1.node.index() < v2.node.index();
@@ -1201,11 +1221,10 @@ processGraph(
 		assert(in_degree(newVertex.original, g_contigGraph) == 0);
 		assert(out_degree(newVertex.original, g_contigGraph) == 0);
 
-		assert(g_contigSequences.size() == newVertex.node.index());
+		assert(g_contigSequenceRefs.size() == newVertex.node.id());
 		assert(g_contigComments.size() == newVertex.node.id());
 
-		g_contigSequences.push_back(getContigSequence(newVertex.original));
-		g_contigSequences.push_back(getContigSequence(newVertex.original ^ true));
+		addContigSequence(newVertex.original);
 
 		std::string name = createContigName();
 		put(vertex_name, g_contigGraph, newVertex.node, name);
@@ -1271,7 +1290,7 @@ resolveShort(
 	}
 
 	assert(g_contigSequences.size() > 0);
-	assert(g_contigSequences.size() / 2 == g_contigComments.size());
+	assert(g_contigSequenceRefs.size() == g_contigComments.size());
 	assert(ReadSize::readSizes.size() > 0);
 
 	std::vector<std::pair<int, Histogram>> histograms;
@@ -12,6 +12,18 @@ const unsigned MAX_SIMULTANEOUS_TASKS = 60000;
 
 const double PROGRESS_PRINT_FRACTION = 0.01;
 
+/** Return the number of the calling thread, for indexing per-thread
+ * buffers. */
+inline int
+threadNum()
+{
+#if _OPENMP
+	return omp_get_thread_num();
+#else
+	return 0;
+#endif
+}
+
 template<typename IteratorT, typename FilterT, typename ActionT>
 void
 iteratorMultithreading(
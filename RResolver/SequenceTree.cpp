@@ -20,7 +20,7 @@ class SequenceTreeNode : public ContigNode
 
 	std::vector<SequenceTreeNode> getChildren(
 	    const int maxChildren = std::numeric_limits<int>::max()) const;
-	const Sequence treeSequence() const;
+	void appendTreeSequence(Sequence& sequence) const;
 
 	int treeSequenceStart;
 	int treeSequenceLength;
@@ -42,8 +42,7 @@ SequenceTreeNode::SequenceTreeNode(
 	assert(overlap >= 0);
 	assert(maxLength > 0);
 	treeSequenceStart = overlap;
-	const auto& sequence = getContigSequence(*this);
-	const int size = sequence.size();
+	const int size = getContigSequence(*this).size();
 	int treeSequenceEnd = std::min(overlap + maxLength, size);
 	assert(treeSequenceStart >= 0);
 	assert(treeSequenceEnd > 0);
@@ -104,12 +103,12 @@ SequenceTreeNode::getChildren(const int maxChildren) const
 	return children;
 }
 
-const Sequence
-SequenceTreeNode::treeSequence() const
+void
+SequenceTreeNode::appendTreeSequence(Sequence& sequence) const
 {
 	assert(treeSequenceStart >= 0);
 	assert(treeSequenceLength > 0);
-	return Sequence(getContigSequence(*this).c_str(), treeSequenceStart, treeSequenceLength);
+	getContigSequence(*this).appendTo(sequence, treeSequenceStart, treeSequenceLength);
 }
 
 typedef std::list<SequenceTreeNode> Trace;
@@ -191,11 +190,11 @@ getTreeSequences(
 		sequence.reserve(trace.size() * EXPECTED_BASES_PER_NODE);
 		if (forward) {
 			for (Trace::const_iterator it = trace.begin(); !(it == trace.end()); it++) {
-				sequence += it->treeSequence();
+				it->appendTreeSequence(sequence);
 			}
 		} else {
 			for (Trace::const_reverse_iterator it = trace.rbegin(); !(it == trace.rend()); it++) {
-				sequence += it->treeSequence();
+				it->appendTreeSequence(sequence);
 			}
 		}
 		sequences.push_back(sequence);
@@ -117,23 +117,26 @@ static void processQuery(vector<Alignment>& recs, Graph& g)
 
 static void readAlignments(istream& in, Graph& g)
 {
-	SAMRecord rec, prev;
+	string line, qname;
+	SAMRecordView rec;
 	vector<Alignment> recs;
 	int i = 0;
-	while (in >> prev && (prev.isUnmapped() || prev.mapq == 0));
-	recs.push_back(prev);
-	while (in >> rec) {
-		if (rec.isUnmapped() || rec.mapq == 0)
+	while (readSAMRecord(in, line, rec)) {
+		if (rec.isUnmapped() || rec.mapq() == 0)
 			continue;
+		if (recs.empty()) {
+			qname = rec.qname().c_str();
+			recs.push_back(rec);
+			continue;
+		}
 		if (opt::verbose > 0 && ++i % 100000 == 0)
 			cerr << "Processed " << i << " good alignments...\n";
-		if (rec.qname != prev.qname) {
+		if (qname != rec.qname().c_str()) {
 			processQuery(recs, g);
 			recs.clear();
-			prev = rec;
-			recs.push_back(prev);
-		} else
-			recs.push_back(rec);
+			qname = rec.qname().c_str();
+		}
+		recs.push_back(rec);
 	}
 	if (opt::verbose > 0)
 		cerr << "Processed " << i << " good alignments.\n";
@@ -584,8 +584,10 @@ readGraph(const string& path, Graph& g)
 	ifstream fin(path.c_str());
 	istream& in = path == "-" ? cin : fin;
 	assert_good(in, path);
+	loadContigNames(path);
 	read_graph(in, g, BetterDistanceEst());
 	assert(in.eof());
+	saveContigNames(path);
 	if (opt::verbose > 0)
 		printGraphStats(cerr, g);
 
@@ -2,6 +2,7 @@
 #include "ContigPath.h"
 #include "Estimate.h"
 #include "IOUtil.h"
+#include "OrderedPipeline.h"
 #include "Uncompress.h"
 #include "Graph/ConstrainedSearch.h"
 #include "Graph/ContigGraph.h"
@@ -14,9 +15,11 @@
 #include <fstream>
 #include <getopt.h>
 #include <iostream>
-#include <pthread.h>
 #include <set>
 #include <vector>
+#if _OPENMP
+#include <omp.h>
+#endif
 #include "DataBase/Options.h"
 #include "DataBase/DB.h"
 
@@ -196,6 +199,11 @@ int main(int argc, char** argv)
 				opt::getCommand(argc, argv),
 				opt::metaVars);
 
+#if _OPENMP
+	if (opt::threads > 0)
+		omp_set_num_threads(opt::threads);
+#endif
+
 	string adjFile(argv[optind++]);
 	string estFile(argv[optind++]);
 
@@ -457,18 +465,16 @@ typedef std::vector<std::pair<ContigNode, DistanceEst> > Estimates;
 
 /** Find a path for the specified distance estimates.
  * @param out [out] the solution path
+ * @param vout [out] the verbose output
  */
 static void handleEstimate(const Graph& g,
 		const EstimateRecord& er, bool dirIdx,
-		ContigPath& out)
+		ContigPath& out, ostream& vout)
 {
 	if (er.estimates[dirIdx].empty())
 		return;
 
 	ContigNode origin(er.refID, dirIdx);
-	ostringstream vout_ss;
-	ostream bitBucket(NULL);
-	ostream& vout = opt::verbose > 0 ? vout_ss : bitBucket;
 	vout << "\n* " << get(vertex_name, g, origin) << '\n';
 
 	unsigned minNumPairs = UINT_MAX;
@@ -600,22 +606,28 @@ static void handleEstimate(const Graph& g,
 			<< " sumdiff: " << sumDiff << '\n';
 	}
 
-	/** Lock the debugging stream. */
-	static pthread_mutex_t coutMutex = PTHREAD_MUTEX_INITIALIZER;
-	pthread_mutex_lock(&coutMutex);
-	stats.totalAttempted++;
-	g_minNumPairs = min(g_minNumPairs, minNumPairs);
+#pragma omp critical(stats)
+	{
+		stats.totalAttempted++;
+		g_minNumPairs = min(g_minNumPairs, minNumPairs);
+	}
 
+	bool used = false;
 	if (tooComplex) {
+#pragma omp atomic
 		stats.tooComplex++;
 	} else if (tooManySolutions) {
+#pragma omp atomic
 		stats.tooManySolutions++;
 	} else if (numPossiblePaths == 0) {
+#pragma omp atomic
 		stats.noPossiblePaths++;
 	} else if (solutions.empty()) {
+#pragma omp atomic
 		stats.noValidPaths++;
 	} else if (repeats.count(er.refID) > 0) {
 		vout << "Repeat: " << get(vertex_name, g, origin) << '\n';
+#pragma omp atomic
 		stats.repeat++;
 	} else if (solutions.size() > 1) {
 		ContigPath path
@@ -626,10 +638,10 @@ static void handleEstimate(const Graph& g,
 			vout << path << '\n';
 			if (opt::scaffold) {
 				out.insert(out.end(), path.begin(), path.end());
-				g_minNumPairsUsed
-					= min(g_minNumPairsUsed, minNumPairs);
+				used = true;
 			}
 		}
+#pragma omp atomic
 		stats.multiEnd++;
 	} else {
 		assert(solutions.size() == 1);
@@ -640,13 +652,15 @@ static void handleEstimate(const Graph& g,
 		if (opt::extend)
 			extend(g, path.back(), back_inserter(path));
 		out.insert(out.end(), path.begin(), path.end());
+#pragma omp atomic
 		stats.uniqueEnd++;
-		g_minNumPairsUsed = min(g_minNumPairsUsed, minNumPairs);
+		used = true;
 	}
-	cout << vout_ss.str();
+	if (used)
+#pragma omp critical(stats)
+		g_minNumPairsUsed = min(g_minNumPairsUsed, minNumPairs);
 	if (!out.empty())
 		assert(!out.back().ambiguous());
-	pthread_mutex_unlock(&coutMutex);
 }
 
 /** Return whether the specified edge has sufficient support. */
@@ -659,35 +673,65 @@ struct PoorSupport {
 	const unsigned m_minEdgeWeight;
 };
 
-struct WorkerArg {
-	istream* in;
-	ostream* out;
-	const Graph* graph;
-	WorkerArg(istream* in, ostream* out, const Graph* g)
-		: in(in), out(out), graph(g) { }
+/** Read the distance estimates of one contig as a line of text,
+ * which is parsed by the worker.
+ */
+struct EstimateReader {
+	typedef string value_type;
+	istream& in;
+	EstimateReader(istream& in) : in(in) { }
+	bool operator()(string& line)
+	{
+		while (getline(in, line)) {
+			if (line.find_first_not_of(" \t") != string::npos) {
+				// Restore the terminator, which the parser expects.
+				line += '\n';
+				return true;
+			}
+		}
+		return false;
+	}
 };
 
-static void* worker(void* pArg)
-{
-	WorkerArg& arg = *static_cast<WorkerArg*>(pArg);
-	unsigned countSeedTooShort = 0;
-	unsigned countNoEdges = 0;
-	unsigned countEdgesRemoved = 0;
-	for (;;) {
-		/** Lock the input stream. */
-		static pthread_mutex_t inMutex = PTHREAD_MUTEX_INITIALIZER;
-		pthread_mutex_lock(&inMutex);
+/** The path found for one contig. */
+struct PathRecord {
+	ContigID id;
+	ContigPath path;
+	/** The verbose output */
+	string log;
+};
+
+/** Find a path through the distance estimates of one contig. */
+struct EstimateWorker {
+	typedef PathRecord result_type;
+	const Graph& g;
+	/** The path of the distance estimates */
+	const string& path;
+	EstimateWorker(const Graph& g, const string& path)
+		: g(g), path(path) { }
+
+	void operator()(const string& line, PathRecord& out) const
+	{
+		istringstream in(line);
 		EstimateRecord er;
-		bool good = bool((*arg.in) >> er);
-		pthread_mutex_unlock(&inMutex);
-		if (!good)
-			break;
-		if ((*arg.graph)[ContigNode(er.refID, false)].length < opt::minSeedLength) {
-			++countSeedTooShort;
-			continue;
+		if (!(in >> er)
+				|| er.refID >= num_vertices(g) / 2) {
+			cerr << "error: `" << path << "': "
+				"invalid distance estimates: `"
+				<< line.substr(0, line.size() - 1) << "'\n";
+			exit(EXIT_FAILURE);
+		}
+		out.id = er.refID;
+		if (g[ContigNode(er.refID, false)].length
+				< opt::minSeedLength) {
+#pragma omp atomic
+			++stats.seedTooShort;
+			return;
 		}
 
 		// Remove edges with insufficient support.
+		unsigned countNoEdges = 0;
+		unsigned countEdgesRemoved = 0;
 		for (unsigned i = 0; i < 2; ++i) {
 			Estimates& estimates = er.estimates[i];
 			if (estimates.empty())
@@ -702,38 +746,42 @@ static void* worker(void* pArg)
 			if (sizeAfter == 0)
 				++countNoEdges;
 		}
+#pragma omp atomic
+		stats.noEdges += countNoEdges;
+#pragma omp atomic
+		stats.edgesRemoved += countEdgesRemoved;
 
 		// Flip the anterior distance estimates.
 		for (Estimates::iterator it = er.estimates[1].begin();
 				it != er.estimates[1].end(); ++it)
 			it->first ^= 1;
 
-		ContigPath path;
-		handleEstimate(*arg.graph, er, true, path);
+		ostringstream vout_ss;
+		ostream bitBucket(NULL);
+		ostream& vout = opt::verbose > 0 ? vout_ss : bitBucket;
+		ContigPath& path = out.path;
+		handleEstimate(g, er, true, path, vout);
 		reverseComplement(path.begin(), path.end());
 		path.push_back(ContigNode(er.refID, false));
-		handleEstimate(*arg.graph, er, false, path);
-		if (path.size() > 1) {
-			/** Lock the output stream. */
-			static pthread_mutex_t outMutex
-				= PTHREAD_MUTEX_INITIALIZER;
-			pthread_mutex_lock(&outMutex);
-			*arg.out << get(g_contigNames, er.refID)
-				<< '\t' << path << '\n';
-			assert(arg.out->good());
-			pthread_mutex_unlock(&outMutex);
-		}
+		handleEstimate(g, er, false, path, vout);
+		out.log = vout_ss.str();
 	}
+};
 
-	static pthread_mutex_t statsMutex = PTHREAD_MUTEX_INITIALIZER;
-	pthread_mutex_lock(&statsMutex);
-	stats.seedTooShort += countSeedTooShort;
-	stats.noEdges += countNoEdges;
-	stats.edgesRemoved += countEdgesRemoved;
-	pthread_mutex_unlock(&statsMutex);
-
-	return NULL;
-}
+/** Write the paths in the order of the distance estimates. */
+struct PathWriter {
+	ostream& out;
+	PathWriter(ostream& out) : out(out) { }
+	void operator()(const PathRecord& o)
+	{
+		cout << o.log;
+		if (o.path.size() > 1) {
+			out << get(g_contigNames, o.id)
+				<< '\t' << o.path << '\n';
+			assert(out.good());
+		}
+	}
+};
 
 static void generatePathsThroughEstimates(const Graph& g,
 		const string& estPath)
@@ -746,22 +794,11 @@ static void generatePathsThroughEstimates(const Graph& g,
 	ofstream outStream(opt::out.c_str());
 	assert(outStream.is_open());
 
-	// Create the worker threads.
-	vector<pthread_t> threads;
-	threads.reserve(opt::threads);
-	WorkerArg arg(&inStream, &outStream, &g);
-	for (unsigned i = 0; i < opt::threads; i++) {
-		pthread_t thread;
-		pthread_create(&thread, NULL, worker, &arg);
-		threads.push_back(thread);
-	}
-
-	// Wait for the worker threads to finish.
-	for (vector<pthread_t>::const_iterator it = threads.begin();
-			it != threads.end(); ++it) {
-		void* status;
-		pthread_join(*it, &status);
-	}
+	EstimateReader reader(inStream);
+	EstimateWorker worker(g, estPath);
+	PathWriter writer(outStream);
+	orderedPipeline(reader, worker, writer);
+	assert(inStream.eof());
 	if (opt::verbose > 0)
 		cout << '\n';
 
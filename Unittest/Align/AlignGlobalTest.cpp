@@ -0,0 +1,152 @@
+#include "Align/alignGlobal.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+using namespace std;
+
+/** Return a random sequence of the specified length. */
+static string randomSequence(unsigned n, const char* alphabet)
+{
+	string s(n, 'A');
+	size_t k = strlen(alphabet);
+	for (unsigned i = 0; i < n; ++i)
+		s[i] = alphabet[rand() % k];
+	return s;
+}
+
+/** Return a copy of s with random substitutions and indels. */
+static string mutate(const string& s, unsigned edits)
+{
+	string t = s;
+	for (unsigned e = 0; e < edits && !t.empty(); ++e) {
+		size_t pos = rand() % t.size();
+		switch (rand() % 3) {
+		  case 0:
+			t[pos] = "ACGT"[rand() % 4];
+			break;
+		  case 1:
+			t.erase(pos, 1 + rand() % 5);
+			break;
+		  default:
+			t.insert(pos, randomSequence(1 + rand() % 5, "ACGT"));
+			break;
+		}
+	}
+	return t;
+}
+
+/** Check the alignment of a and b with the specified band. */
+static void expectBandedAlignment(const string& a, const string& b,
+		unsigned band, unsigned matches, const string& queryAlign,
+		const string& targetAlign, const string& matchAlign)
+{
+	NWAlignment align;
+	EXPECT_EQ(matches, alignGlobal(a, b, align, band));
+	EXPECT_EQ(queryAlign, align.query_align);
+	EXPECT_EQ(targetAlign, align.target_align);
+	EXPECT_EQ(matchAlign, align.match_align);
+}
+
+/** Check the alignment of a and b with narrow and wide bands. */
+static void expectAlignment(const string& a, const string& b,
+		unsigned matches, const string& queryAlign,
+		const string& targetAlign, const string& matchAlign)
+{
+	const unsigned bands[] = { 1, 2, 1000 };
+	for (unsigned i = 0; i < sizeof bands / sizeof *bands; ++i)
+		expectBandedAlignment(a, b, bands[i], matches,
+				queryAlign, targetAlign, matchAlign);
+}
+
+TEST(alignGlobal, identical)
+{
+	string a = "ACGTACGTTTGACCA";
+	expectAlignment(a, a, a.size(), a, a, a);
+	NWAlignment align;
+	EXPECT_EQ(a.size(), alignGlobal(a, a, align));
+	EXPECT_EQ(a, align.consensus());
+}
+
+TEST(alignGlobal, empty)
+{
+	expectAlignment("", "", 0, "", "", "");
+	expectAlignment("ACGT", "", 0, "ACGT", "****", "acgt");
+	expectAlignment("", "ACGT", 0, "****", "ACGT", "acgt");
+}
+
+TEST(alignGlobal, substitution)
+{
+	// The consensus of a mismatch is its ambiguity code, W = A|T.
+	expectAlignment("ACGTACGT", "ACGAACGT", 7,
+			"ACGTACGT", "ACGAACGT", "ACGWACGT");
+	// An ambiguity code matches the bases that it includes.
+	expectAlignment("ACNGT", "ACAGT", 5, "ACNGT", "ACAGT", "ACNGT");
+}
+
+TEST(alignGlobal, indel)
+{
+	// One gap of two, -12 - 4, scores better than any alignment with
+	// two gaps or with mismatches.
+	expectAlignment("AACCGGTT", "AACCTT", 6,
+			"AACCGGTT", "AACC**TT", "AACCggTT");
+	expectAlignment("ACGCA", "ACGTTCA", 5,
+			"ACG**CA", "ACGTTCA", "ACGttCA");
+}
+
+/** Assert that the banded alignment matches the alignment with a
+ * band that includes every cell of the score matrices.
+ */
+static void expectSameAsWideBand(const string& a, const string& b,
+		unsigned band)
+{
+	NWAlignment expected, actual;
+	unsigned wide = a.size() + b.size();
+	EXPECT_EQ(alignGlobal(a, b, expected, wide),
+			alignGlobal(a, b, actual, band));
+	EXPECT_EQ(expected.query_align, actual.query_align);
+	EXPECT_EQ(expected.target_align, actual.target_align);
+	EXPECT_EQ(expected.match_align, actual.match_align);
+}
+
+/** Check that the gapped alignment spells the two sequences. */
+static void expectSpells(const string& a, const string& b,
+		const NWAlignment& align)
+{
+	string qa = align.query_align, ta = align.target_align;
+	EXPECT_EQ(qa.size(), ta.size());
+	EXPECT_EQ(qa.size(), align.match_align.size());
+	qa.erase(remove(qa.begin(), qa.end(), '*'), qa.end());
+	ta.erase(remove(ta.begin(), ta.end(), '*'), ta.end());
+	EXPECT_EQ(a, qa);
+	EXPECT_EQ(b, ta);
+}
+
+TEST(alignGlobal, bandedMatchesWide)
+{
+	srand(1);
+	const unsigned bands[] = { 1, 2, 4, 8 };
+	for (unsigned trial = 0; trial < 200; ++trial) {
+		string a = randomSequence(1 + rand() % 120,
+				trial % 4 == 0 ? "ACGTNRY" : "ACGT");
+		string b = trial % 5 == 0
+			? randomSequence(1 + rand() % 120, "ACGT")
+			: mutate(a, rand() % 12);
+		for (unsigned i = 0; i < sizeof bands / sizeof *bands; ++i)
+			expectSameAsWideBand(a, b, bands[i]);
+	}
+}
+
+TEST(alignGlobal, defaultSpells)
+{
+	srand(2);
+	for (unsigned trial = 0; trial < 50; ++trial) {
+		string a = randomSequence(1 + rand() % 200, "ACGT");
+		string b = mutate(a, rand() % 20);
+		NWAlignment align;
+		alignGlobal(a, b, align);
+		expectSpells(a, b, align);
+	}
+}
@@ -0,0 +1,160 @@
+#include "Common/Dictionary.h"
+#include "gtest/gtest.h"
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <unistd.h>
+
+using namespace std;
+
+/** Return the path of a temporary file. */
+static string tempPath()
+{
+	ostringstream ss;
+	ss << "DictionaryTest." << getpid() << ".names";
+	return ss.str();
+}
+
+TEST(Dictionary, insert)
+{
+	Dictionary d;
+	EXPECT_TRUE(d.empty());
+	EXPECT_EQ(0u, d.insert("a"));
+	EXPECT_EQ(1u, d.insert("b"));
+	EXPECT_EQ(2u, d.size());
+	EXPECT_EQ(1u, d.getIndex("b"));
+	EXPECT_EQ(string("a"), string(d.getName(0)));
+	EXPECT_EQ(1u, d.count("a"));
+	EXPECT_EQ(0u, d.count("c"));
+	EXPECT_FALSE(d.mapped());
+}
+
+TEST(Dictionary, saveLoad)
+{
+	Dictionary d;
+	for (unsigned i = 0; i < 1000; ++i) {
+		ostringstream ss;
+		ss << i * 7;
+		d.insert(ss.str());
+	}
+	string path = tempPath();
+	ASSERT_TRUE(d.save(path, 42));
+
+	Dictionary wrongKey;
+	EXPECT_FALSE(wrongKey.load(path, 43));
+	EXPECT_TRUE(wrongKey.empty());
+
+	Dictionary m;
+	ASSERT_TRUE(m.load(path, 42));
+	unlink(path.c_str());
+	EXPECT_TRUE(m.mapped());
+	ASSERT_EQ(d.size(), m.size());
+	for (unsigned i = 0; i < d.size(); ++i) {
+		EXPECT_EQ(string(d.getName(i)), string(m.getName(i)));
+		EXPECT_EQ(i, m.getIndex(string(d.getName(i))));
+	}
+	EXPECT_EQ(1u, m.count("7"));
+	EXPECT_EQ(0u, m.count("8"));
+	EXPECT_EQ(string("6993"), string(m.back()));
+
+	// Names inserted after loading follow the mapped names.
+	m.put(5, "35");
+	EXPECT_EQ(1000u, m.insert("x"));
+	EXPECT_EQ(1000u, m.getIndex("x"));
+	EXPECT_EQ(string("x"), string(m.getName(1000)));
+	EXPECT_EQ(string("x"), string(m.back()));
+	EXPECT_EQ(1001u, m.size());
+	EXPECT_EQ(1u, m.count("x"));
+}
+
+TEST(Dictionary, saveLoadEmpty)
+{
+	Dictionary d;
+	string path = tempPath();
+	ASSERT_TRUE(d.save(path, 1));
+	Dictionary m;
+	ASSERT_TRUE(m.load(path, 1));
+	unlink(path.c_str());
+	EXPECT_TRUE(m.empty());
+	EXPECT_EQ(0u, m.count("a"));
+	EXPECT_EQ(0u, m.insert("a"));
+}
+
+/** Overwrite the bytes of a file at the specified offset. */
+static void patchFile(const string& path, long offset,
+		const void* p, size_t n)
+{
+	FILE* f = fopen(path.c_str(), "r+b");
+	ASSERT_TRUE(f != NULL);
+	ASSERT_EQ(0, fseek(f, offset, SEEK_SET));
+	ASSERT_EQ(n, fwrite(p, 1, n, f));
+	fclose(f);
+}
+
+/** The size of the header of a dictionary file. */
+static const long HEADER_SIZE = 32;
+
+TEST(Dictionary, loadBadOffset)
+{
+	Dictionary d;
+	d.insert("a");
+	d.insert("b");
+	string path = tempPath();
+	ASSERT_TRUE(d.save(path, 1));
+	uint64_t offset = 1 << 30;
+	patchFile(path, HEADER_SIZE + sizeof offset, &offset, sizeof offset);
+	Dictionary m;
+	EXPECT_FALSE(m.load(path, 1));
+	unlink(path.c_str());
+	EXPECT_TRUE(m.empty());
+}
+
+TEST(Dictionary, loadBadSlot)
+{
+	Dictionary d;
+	d.insert("a");
+	string path = tempPath();
+	ASSERT_TRUE(d.save(path, 1));
+	// One name, a table of two slots.
+	uint32_t slots[2] = { 3, 3 };
+	patchFile(path, HEADER_SIZE + sizeof (uint64_t), slots, sizeof slots);
+	Dictionary m;
+	EXPECT_FALSE(m.load(path, 1));
+	unlink(path.c_str());
+}
+
+TEST(Dictionary, loadFullTable)
+{
+	Dictionary d;
+	d.insert("a");
+	string path = tempPath();
+	ASSERT_TRUE(d.save(path, 1));
+	// A table with no empty slot must not loop forever.
+	uint32_t slots[2] = { 1, 1 };
+	patchFile(path, HEADER_SIZE + sizeof (uint64_t), slots, sizeof slots);
+	Dictionary m;
+	ASSERT_TRUE(m.load(path, 1));
+	unlink(path.c_str());
+	EXPECT_EQ(1u, m.count("a"));
+	EXPECT_EQ(0u, m.count("b"));
+}
+
+TEST(Dictionary, staleMapping)
+{
+	Dictionary d;
+	d.insert("a");
+	d.insert("b");
+	string path = tempPath();
+	ASSERT_TRUE(d.save(path, 1));
+	Dictionary m;
+	ASSERT_TRUE(m.load(path, 1));
+	m.put(0, "a");
+	// The SIGCHLD handler of libcommon would exit the test itself.
+	signal(SIGCHLD, SIG_DFL);
+	EXPECT_EXIT(m.put(1, "c"), ::testing::ExitedWithCode(EXIT_FAILURE),
+			"does not match the graph");
+	// The death test runs in a child, which removed the stale file.
+	EXPECT_NE(0, access(path.c_str(), F_OK));
+	unlink(path.c_str());
+}
@@ -1,5 +1,6 @@
 #include "Common/Histogram.h"
 #include "gtest/gtest.h"
+#include <ctime>
 
 
 // test Histogram.empty()
@@ -51,3 +52,115 @@ TEST(removeNoise, one_entry)
 	hi.removeNoise();
 	EXPECT_EQ(hi.size(), 10u);
 }
+
+// test the order of samples stored densely and sparsely
+TEST(iteratorTest, dense_and_sparse)
+{
+	Histogram hi;
+	hi.insert(100000, 2);
+	hi.insert(5);
+	hi.insert(-3, 4);
+	hi.insert(0);
+	hi.insert(5);
+	EXPECT_EQ(hi.minimum(), -3);
+	EXPECT_EQ(hi.maximum(), 100000);
+	EXPECT_EQ(hi.count(5), 2u);
+	EXPECT_EQ(hi.count(0, 5), 3u);
+
+	Histogram::const_iterator it = hi.begin();
+	EXPECT_EQ(it->first, -3);
+	EXPECT_EQ(it->second, 4u);
+	++it;
+	EXPECT_EQ(it->first, 0);
+	++it;
+	EXPECT_EQ(it->first, 5);
+	EXPECT_EQ(it->second, 2u);
+	++it;
+	EXPECT_EQ(it->first, 100000);
+	++it;
+	EXPECT_TRUE(it == hi.end());
+
+	hi.eraseNegative();
+	EXPECT_EQ(hi.minimum(), 0);
+	EXPECT_EQ(hi.trimLow(1).size(), 4u);
+}
+
+// test Histogram::operator+=
+TEST(mergeTest, base_cases)
+{
+	Histogram a, b;
+	a.insert(2);
+	a.insert(-1);
+	b.insert(2, 3);
+	b.insert(70000);
+	a += b;
+	EXPECT_EQ(a.size(), 6u);
+	EXPECT_EQ(a.count(2), 4u);
+	EXPECT_EQ(a.count(-1), 1u);
+	EXPECT_EQ(a.count(70000), 1u);
+	EXPECT_EQ(a.sum(), 70000u + 8 - 1);
+}
+
+// test merging sparse and dense histograms
+TEST(mergeTest, sparse_and_dense)
+{
+	// Many distinct samples make a dense histogram.
+	Histogram dense;
+	for (int i = 0; i < 200; ++i)
+		dense.insert(i, 2);
+	// A few samples spread widely stay sparse.
+	Histogram sparse;
+	for (int i = -1; i < 10; ++i)
+		sparse.insert(1000 * i + 500);
+
+	Histogram merged[2] = { sparse, dense };
+	merged[0] += dense;
+	merged[1] += sparse;
+	for (Histogram* h = merged; h != merged + 2; ++h) {
+		EXPECT_EQ(411u, h->size());
+		EXPECT_EQ(4u, h->count(100, 101));
+		EXPECT_EQ(1u, h->count(9500));
+		EXPECT_EQ(-500, h->minimum());
+		EXPECT_EQ(9500, h->maximum());
+		Histogram::const_iterator it = h->begin();
+		EXPECT_EQ(-500, it->first);
+		++it;
+		EXPECT_EQ(0, it->first);
+		EXPECT_EQ(2u, it->second);
+		it = h->begin();
+		for (int i = 0; i < 200; ++i)
+			++it;
+		EXPECT_EQ(199, it->first);
+		++it;
+		EXPECT_EQ(500, it->first);
+		EXPECT_EQ(1u, it->second);
+	}
+}
+
+/** Return the time in seconds to iterate over h n times. */
+static double timeIteration(const Histogram& h, unsigned n)
+{
+	clock_t start = clock();
+	size_t total = 0;
+	for (unsigned i = 0; i < n; ++i)
+		for (Histogram::const_iterator it = h.begin();
+				it != h.end(); ++it)
+			total += it->second;
+	EXPECT_EQ(n * h.size(), total);
+	return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+// Iterating over a few samples, such as the distances between two
+// contigs, does not walk a dense array up to the largest sample.
+TEST(iteratorTest, sparse_cost)
+{
+	Histogram small, large;
+	for (int i = 0; i < 40; ++i) {
+		small.insert(10 * i, 3);
+		large.insert(60000 + 10 * i, 3);
+	}
+	const unsigned n = 20000;
+	double smallTime = timeIteration(small, n);
+	double largeTime = timeIteration(large, n);
+	EXPECT_LT(largeTime, 10 * smallTime + 0.05);
+}
@@ -1,5 +1,7 @@
 #include "Common/Kmer.h"
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <climits>
 #include <iostream>
 
 TEST(Kmer, canonicalize)
@@ -30,3 +32,27 @@ TEST(Kmer, canonicalize)
 	EXPECT_EQ(oddLengthCanonical, kmer);
 }
 
+
+TEST(Kmer, getMinimizerCode)
+{
+	const std::string seq = "ACGTTGCATTGACCA";
+	const unsigned m = 5;
+
+	// The minimizer of a k-mer is its m-mer of least hash value.
+	Kmer::setLength(m);
+	unsigned expected = UINT_MAX;
+	for (unsigned i = 0; i + m <= seq.size(); i++)
+		expected = std::min(expected,
+				Kmer(seq.substr(i, m)).getMinimizerCode(m));
+
+	Kmer::setLength(seq.size());
+	Kmer kmer(seq);
+	EXPECT_EQ(expected, kmer.getMinimizerCode(m));
+	EXPECT_EQ(expected, reverseComplement(kmer).getMinimizerCode(m));
+
+	// A k-mer and its reverse complement share their minimizer.
+	Kmer::setLength(m);
+	Kmer mmer("ACGTT");
+	EXPECT_EQ(mmer.getMinimizerCode(m),
+			reverseComplement(mmer).getMinimizerCode(m));
+}
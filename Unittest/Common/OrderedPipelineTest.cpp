@@ -0,0 +1,162 @@
+#include "Common/OrderedPipeline.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <vector>
+#if _OPENMP
+#include <omp.h>
+#endif
+
+using namespace std;
+
+/** Read the integers [0, n). */
+struct CountReader {
+	typedef unsigned value_type;
+	unsigned i, n;
+	CountReader(unsigned n) : i(0), n(n) { }
+	bool operator()(unsigned& x)
+	{
+		if (i == n)
+			return false;
+		x = i++;
+		return true;
+	}
+};
+
+/** Square an integer, taking longer for some items than others. */
+struct Squarer {
+	typedef unsigned long long result_type;
+	void operator()(unsigned x, unsigned long long& out) const
+	{
+		volatile unsigned long long y = 0;
+		for (unsigned i = 0; i < (x % 13) * 1000; ++i)
+			y += i;
+		out = (unsigned long long)x * x;
+	}
+};
+
+/** Store the results. */
+struct VectorWriter {
+	vector<unsigned long long>& out;
+	VectorWriter(vector<unsigned long long>& out) : out(out) { }
+	void operator()(unsigned long long x) { out.push_back(x); }
+};
+
+TEST(orderedPipelineTest, order)
+{
+#if _OPENMP
+	omp_set_num_threads(4);
+#endif
+	const unsigned sizes[] = { 0, 1, 63, 64, 65, 1000 };
+	const unsigned batchSizes[] = { 1, 7, 64 };
+	for (unsigned i = 0; i < sizeof sizes / sizeof *sizes; ++i) {
+		for (unsigned j = 0;
+				j < sizeof batchSizes / sizeof *batchSizes; ++j) {
+			CountReader reader(sizes[i]);
+			Squarer squarer;
+			vector<unsigned long long> out;
+			VectorWriter writer(out);
+			orderedPipeline(reader, squarer, writer, batchSizes[j]);
+			ASSERT_EQ(sizes[i], out.size());
+			for (unsigned x = 0; x < out.size(); ++x)
+				EXPECT_EQ((unsigned long long)x * x, out[x]);
+		}
+	}
+}
+
+/** Count the items that are read and not yet written. */
+struct PendingCount {
+	size_t read, written, maxPending;
+	PendingCount() : read(0), written(0), maxPending(0) { }
+};
+
+/** Read the integers [0, n) and record the number pending. */
+struct PendingReader {
+	typedef unsigned value_type;
+	PendingCount& count;
+	unsigned n;
+	PendingReader(PendingCount& count, unsigned n)
+		: count(count), n(n) { }
+	bool operator()(unsigned& x)
+	{
+		if (count.read == n)
+			return false;
+		x = count.read++;
+		size_t written;
+#pragma omp atomic read
+		written = count.written;
+		count.maxPending = std::max(count.maxPending,
+				count.read - written);
+		return true;
+	}
+};
+
+/** Process the first item slowly. */
+struct SlowFirst {
+	typedef unsigned result_type;
+	void operator()(unsigned x, unsigned& out) const
+	{
+		if (x == 0)
+			usleep(200000);
+		out = x;
+	}
+};
+
+/** Count the written items. */
+struct PendingWriter {
+	PendingCount& count;
+	PendingWriter(PendingCount& count) : count(count) { }
+	void operator()(unsigned x)
+	{
+		EXPECT_EQ(count.written, x);
+#pragma omp atomic
+		count.written++;
+	}
+};
+
+TEST(orderedPipelineTest, maxPending)
+{
+#if _OPENMP
+	omp_set_num_threads(4);
+#endif
+	const unsigned n = 10000, batchSize = 10, maxPending = 6;
+	PendingCount count;
+	PendingReader reader(count, n);
+	SlowFirst slow;
+	PendingWriter writer(count);
+	orderedPipeline(reader, slow, writer, batchSize, maxPending);
+	EXPECT_EQ(n, count.written);
+	// The batch being written may not yet be counted as written.
+	EXPECT_LE(count.maxPending, (maxPending + 1) * batchSize);
+}
+
+/** Return the CPU time used by this process in seconds. */
+static double cpuTime()
+{
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+		+ (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+/** The threads that cannot read while the first batch is slow wait
+ * without spinning.
+ */
+TEST(orderedPipelineTest, waitWhenFull)
+{
+#if _OPENMP
+	omp_set_num_threads(4);
+#endif
+	const unsigned n = 1000, batchSize = 10, maxPending = 6;
+	PendingCount count;
+	PendingReader reader(count, n);
+	SlowFirst slow;
+	PendingWriter writer(count);
+	double start = cpuTime();
+	orderedPipeline(reader, slow, writer, batchSize, maxPending);
+	EXPECT_EQ(n, count.written);
+	// Threads spinning for the 200 ms of the first batch would use
+	// at least 200 ms of CPU time, even on one core.
+	EXPECT_LT(cpuTime() - start, 0.05);
+}
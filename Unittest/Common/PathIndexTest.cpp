@@ -0,0 +1,81 @@
+#include "Common/PathIndex.h"
+#include "gtest/gtest.h"
+
+using namespace std;
+
+static ContigNode fwd(unsigned id) { return ContigNode(id, false); }
+static ContigNode rev(unsigned id) { return ContigNode(id, true); }
+
+TEST(PathIndex, orientedNode)
+{
+	// 1+ 5N 2-
+	ContigPath path;
+	path.push_back(fwd(1));
+	path.push_back(ContigNode(5, 'N'));
+	path.push_back(rev(2));
+
+	EXPECT_EQ(fwd(1), orientedFront(path, false));
+	EXPECT_EQ(rev(2), orientedBack(path, false));
+
+	ContigPath rc = reverseComplement(path);
+	for (unsigned i = 0; i < path.size(); ++i)
+		EXPECT_EQ(rc[i], orientedNode(path, true, i));
+}
+
+TEST(PathIndex, suffixIsPrefix)
+{
+	// a: 1+ 2+ 3+, b: 2+ 3+ 4+
+	ContigPath a, b;
+	a.push_back(fwd(1));
+	a.push_back(fwd(2));
+	a.push_back(fwd(3));
+	b.push_back(fwd(2));
+	b.push_back(fwd(3));
+	b.push_back(fwd(4));
+
+	EXPECT_TRUE(suffixIsPrefix(a, false, 1, b, false));
+	EXPECT_FALSE(suffixIsPrefix(a, false, 0, b, false));
+	EXPECT_FALSE(suffixIsPrefix(a, false, 2, b, true));
+
+	// The reverse complement of b, 4- 3- 2-, overlaps the reverse
+	// complement of a, 3- 2- 1-.
+	EXPECT_TRUE(suffixIsPrefix(b, true, 1, a, true));
+	EXPECT_FALSE(suffixIsPrefix(b, true, 0, a, true));
+}
+
+TEST(PathIndex, postings)
+{
+	// 0: 1+ 2- 3+, 1: 2+ 4+
+	ContigPath p0, p1;
+	p0.push_back(fwd(1));
+	p0.push_back(rev(2));
+	p0.push_back(fwd(3));
+	p1.push_back(fwd(2));
+	p1.push_back(fwd(4));
+
+	PathIndex index;
+	index.insert(0, p0);
+	index.insert(1, p1);
+
+	const PathIndex::Postings& postings = index.postings(fwd(2));
+	ASSERT_EQ(2u, postings.size());
+	EXPECT_EQ(0u, postings[0].path);
+	EXPECT_EQ(1u, postings[0].offset);
+	EXPECT_TRUE(postings[0].sense);
+	EXPECT_EQ(1u, postings[1].path);
+	EXPECT_EQ(0u, postings[1].offset);
+	EXPECT_FALSE(postings[1].sense);
+	EXPECT_TRUE(index.postings(fwd(9)).empty());
+
+	// 2+ is at offset 1 of the reverse complement of path 0.
+	pair<bool, unsigned> orient = postings[0].orient(fwd(2), p0.size());
+	EXPECT_TRUE(orient.first);
+	EXPECT_EQ(1u, orient.second);
+	EXPECT_EQ(fwd(2), orientedNode(p0, orient.first, orient.second));
+
+	EXPECT_TRUE(index.contains(0, false, rev(2)));
+	EXPECT_FALSE(index.contains(0, false, fwd(2)));
+	EXPECT_TRUE(index.contains(0, true, fwd(2)));
+	EXPECT_TRUE(index.contains(1, false, fwd(4)));
+	EXPECT_FALSE(index.contains(1, false, fwd(1)));
+}
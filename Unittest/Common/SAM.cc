@@ -111,3 +111,35 @@ TEST(parseSAMInput, check_values)
 #endif
 	
 }
+
+// Test SAMRecordView::parse()
+TEST(parseSAMView, check_values)
+{
+	std::string line("read/2\t0\tctg1\t11\t60\t5S30M\t=\t101\t120\tACGT\t####");
+	SAMRecordView view;
+	ASSERT_TRUE(view.parse(line));
+	EXPECT_STREQ("read", view.qname());
+	EXPECT_TRUE(view.isPaired());
+	EXPECT_TRUE(view.isRead2());
+	EXPECT_FALSE(view.isUnmapped());
+	EXPECT_STREQ("ctg1", view.rname());
+	EXPECT_EQ(10, view.pos());
+	EXPECT_EQ(60, view.mapq());
+	EXPECT_STREQ("ctg1", view.mrnm());
+	EXPECT_EQ(100, view.mpos());
+	EXPECT_EQ(120, view.isize());
+	EXPECT_STREQ("ACGT", view.seq());
+	EXPECT_STREQ("", view.tags());
+	EXPECT_EQ(5u, view.cigarCoord().qstart);
+	EXPECT_EQ(35u, view.cigarCoord().qlen);
+
+	SAMRecord sam;
+	sam.assign(view);
+	EXPECT_EQ("read", sam.qname);
+	EXPECT_EQ(10, sam.pos);
+	EXPECT_EQ("ctg1", sam.mrnm);
+	EXPECT_EQ(sam.targetAtQueryStart(), 5);
+
+	std::string shortLine("read\t0\tctg1\t11");
+	EXPECT_FALSE(view.parse(shortLine));
+}
@@ -0,0 +1,127 @@
+#include "Common/Timer.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <csignal>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+/** The trace file, which must be named before the first timer. */
+static string tracePath()
+{
+	static string path;
+	if (path.empty()) {
+		ostringstream ss;
+		ss << "TimerTest." << getpid() << ".tsv";
+		path = ss.str();
+		setenv("ABYSS_TRACE", path.c_str(), 1);
+	}
+	return path;
+}
+
+/** Return the fields of a tab-separated line. */
+static vector<string> split(const string& line)
+{
+	vector<string> fields;
+	istringstream ss(line);
+	for (string field; getline(ss, field, '\t');)
+		fields.push_back(field);
+	return fields;
+}
+
+/** Return the lines of the trace file, and remove it. */
+static vector<string> readTrace()
+{
+	vector<string> lines;
+	ifstream in(tracePath().c_str());
+	for (string line; getline(in, line);)
+		lines.push_back(line);
+	unlink(tracePath().c_str());
+	return lines;
+}
+
+static const char* HEADER = "program\tpid\trank\tphase\tdepth"
+	"\tstart\twall\tuser\tsys\tmaxrss\trchar\twchar"
+	"\tthreads\tbusy\tidle";
+
+TEST(Timer, record)
+{
+	unlink(tracePath().c_str());
+	{
+		Timer outer("Total");
+		Timer inner("Load");
+	}
+	{
+		Timer again("Total");
+	}
+
+	vector<string> lines = readTrace();
+	ASSERT_EQ(4u, lines.size());
+	EXPECT_EQ(HEADER, lines[0]);
+
+	const char* phases[] = { "Total/Load", "Total", "Total" };
+	const char* depths[] = { "1", "0", "0" };
+	for (unsigned i = 0; i < 3; ++i) {
+		vector<string> fields = split(lines[i + 1]);
+		ASSERT_EQ(15u, fields.size()) << lines[i + 1];
+		EXPECT_FALSE(fields[0].empty());
+		EXPECT_EQ(getpid(), atoi(fields[1].c_str()));
+		EXPECT_EQ("-1", fields[2]);
+		EXPECT_EQ(phases[i], fields[3]);
+		EXPECT_EQ(depths[i], fields[4]);
+		EXPECT_GT(atof(fields[5].c_str()), 0);
+		EXPECT_GE(atof(fields[6].c_str()), 0);
+		EXPECT_GT(atoll(fields[9].c_str()), 0);
+
+		// A busy and an idle time for each thread
+		unsigned threads = atoi(fields[12].c_str());
+		EXPECT_GE(threads, 1u);
+		EXPECT_EQ(threads - 1, (unsigned)count(fields[13].begin(),
+					fields[13].end(), ','));
+		EXPECT_EQ(threads - 1, (unsigned)count(fields[14].begin(),
+					fields[14].end(), ','));
+	}
+}
+
+/** Processes that share a trace file write exactly one header, which
+ * precedes every record.
+ */
+TEST(Timer, sharedHeader)
+{
+	// Wait for the children rather than the SIGCHLD handler of
+	// libcommon.
+	signal(SIGCHLD, SIG_DFL);
+	const unsigned n = 8;
+	for (unsigned trial = 0; trial < 5; ++trial) {
+		unlink(tracePath().c_str());
+		vector<pid_t> pids;
+		for (unsigned i = 0; i < n; ++i) {
+			pid_t pid = fork();
+			ASSERT_NE(-1, pid);
+			if (pid == 0) {
+				{
+					Timer timer("Child");
+				}
+				_exit(EXIT_SUCCESS);
+			}
+			pids.push_back(pid);
+		}
+		for (unsigned i = 0; i < n; ++i) {
+			int status;
+			ASSERT_EQ(pids[i], waitpid(pids[i], &status, 0));
+			EXPECT_EQ(0, status);
+		}
+
+		vector<string> lines = readTrace();
+		ASSERT_EQ(n + 1, lines.size());
+		EXPECT_EQ(HEADER, lines[0]);
+		for (unsigned i = 1; i < lines.size(); ++i)
+			EXPECT_EQ("Child", split(lines[i])[3]);
+	}
+}
@@ -0,0 +1,243 @@
+#include "config.h"
+#include "Common/Uncompress.h"
+#include "gtest/gtest.h"
+#include <cassert>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdint.h>
+#include <string>
+#include <unistd.h>
+#if HAVE_ZLIB_H && HAVE_LIBZ
+# include <zlib.h>
+#endif
+
+using namespace std;
+
+#if HAVE_ZLIB_H && HAVE_LIBZ
+
+/** Return the path of a temporary gzip file. */
+static string tempPath()
+{
+	ostringstream ss;
+	ss << "UncompressTest." << getpid() << ".gz";
+	return ss.str();
+}
+
+/** Write the specified data to a file. */
+static void writeFile(const string& path, const string& data)
+{
+	ofstream out(path.c_str(), ios::binary);
+	out << data;
+	ASSERT_TRUE(out.good());
+}
+
+/** Compress data with the specified zlib window bits, which select
+ * a gzip member or raw deflate data.
+ */
+static string deflateData(const string& data, int windowBits)
+{
+	z_stream z;
+	memset(&z, 0, sizeof z);
+	int err = deflateInit2(&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+			windowBits, 8, Z_DEFAULT_STRATEGY);
+	assert(err == Z_OK);
+	string out(deflateBound(&z, data.size()), '\0');
+	z.next_in = (Bytef*)data.data();
+	z.avail_in = data.size();
+	z.next_out = (Bytef*)&out[0];
+	z.avail_out = out.size();
+	err = deflate(&z, Z_FINISH);
+	assert(err == Z_STREAM_END);
+	(void)err;
+	out.resize(z.total_out);
+	deflateEnd(&z);
+	return out;
+}
+
+/** Return a gzip member of the specified data. */
+static string gzip(const string& data)
+{
+	return deflateData(data, 15 + 16);
+}
+
+/** Append a little-endian integer of n bytes to s. */
+static void putLE(string& s, uint32_t x, unsigned n)
+{
+	for (unsigned i = 0; i < n; ++i)
+		s += (char)(x >> 8 * i);
+}
+
+/** Return a BGZF block of the specified data. */
+static string bgzfBlock(const string& data)
+{
+	string raw = deflateData(data, -15);
+	static const unsigned char header[] = {
+		31, 139, 8, 4, 0, 0, 0, 0, 0, 255, 6, 0, 'B', 'C', 2, 0 };
+	string block((const char*)header, sizeof header);
+	putLE(block, sizeof header + 2 + raw.size() + 8 - 1, 2);
+	block += raw;
+	putLE(block, crc32(crc32(0, NULL, 0),
+				(const Bytef*)data.data(), data.size()), 4);
+	putLE(block, data.size(), 4);
+	return block;
+}
+
+/** The empty block that marks the end of a BGZF file */
+static const string BGZF_EOF("\x1f\x8b\x08\x04\0\0\0\0\0\xff\x06\0BC"
+		"\x02\0\x1b\0\x03\0\0\0\0\0\0\0\0\0", 28);
+
+/** Return some text that does not compress too well. */
+static string someText(unsigned n)
+{
+	string s;
+	srand(n);
+	while (s.size() < n)
+		s += "ACGT"[rand() % 4];
+	s += '\n';
+	return s;
+}
+
+/** Read the specified file using UncompressReader. */
+static string readUncompress(const string& path)
+{
+	UncompressReader in(path.c_str());
+	assert(in.good());
+	string s;
+	const char* p;
+	size_t n;
+	while (in.read(p, n))
+		s.append(p, n);
+	return s;
+}
+
+/** Read the specified file using fopen, which is hooked to uncompress
+ * the file.
+ */
+static string readFopen(const string& path)
+{
+	FILE* f = fopen(path.c_str(), "r");
+	assert(f != NULL);
+	string s;
+	char buf[4096];
+	size_t n;
+	while ((n = fread(buf, 1, sizeof buf, f)) > 0)
+		s.append(buf, n);
+	fclose(f);
+	return s;
+}
+
+TEST(Uncompress, concatenatedGzip)
+{
+	string path = tempPath();
+	writeFile(path, gzip("hello ") + gzip("world\n") + gzip(""));
+	EXPECT_EQ("hello world\n", readUncompress(path));
+	EXPECT_EQ("hello world\n", readFopen(path));
+	unlink(path.c_str());
+}
+
+TEST(Uncompress, bgzf)
+{
+	string expected, data;
+	for (unsigned i = 0; i < 100; ++i) {
+		string text = someText(1000 + 600 * i);
+		expected += text;
+		data += bgzfBlock(text);
+	}
+	data += BGZF_EOF;
+	string path = tempPath();
+	writeFile(path, data);
+	EXPECT_EQ(expected, readUncompress(path));
+	EXPECT_EQ(expected, readFopen(path));
+	unlink(path.c_str());
+}
+
+TEST(Uncompress, bgzfThenGzip)
+{
+	// A gzip file appended to a BGZF file, as by cat a.bgz b.gz
+	string path = tempPath();
+	writeFile(path, bgzfBlock("hello ") + bgzfBlock("BGZF\n") + BGZF_EOF
+			+ gzip("hello ") + gzip("gzip\n"));
+	EXPECT_EQ("hello BGZF\nhello gzip\n", readUncompress(path));
+	EXPECT_EQ("hello BGZF\nhello gzip\n", readFopen(path));
+	unlink(path.c_str());
+}
+
+TEST(Uncompress, bgzfTrailingGarbage)
+{
+	string path = tempPath();
+	writeFile(path, bgzfBlock("hello\n") + BGZF_EOF + "garbage\n");
+	EXPECT_EQ("hello\n", readUncompress(path));
+	EXPECT_EQ("hello\n", readFopen(path));
+	unlink(path.c_str());
+}
+
+TEST(Uncompress, trailingGarbage)
+{
+	string path = tempPath();
+	writeFile(path, gzip("hello\n") + "garbage\n");
+	EXPECT_EQ("hello\n", readUncompress(path));
+	EXPECT_EQ("hello\n", readFopen(path));
+	unlink(path.c_str());
+}
+
+/** Prepare for a death test. The SIGCHLD handler installed by
+ * uncompress_init would reap the child process of the death test.
+ */
+static void useDefaultSigchld()
+{
+	testing::FLAGS_gtest_death_test_style = "threadsafe";
+	signal(SIGCHLD, SIG_DFL);
+}
+
+TEST(UncompressDeathTest, truncatedGzip)
+{
+	useDefaultSigchld();
+	string data = gzip(someText(100000));
+	string path = tempPath();
+	writeFile(path, data.substr(0, data.size() - 100));
+	EXPECT_EXIT(readUncompress(path),
+			testing::ExitedWithCode(EXIT_FAILURE),
+			"unexpected end of file");
+	EXPECT_EXIT(readFopen(path),
+			testing::ExitedWithCode(EXIT_FAILURE),
+			"unexpected end of file");
+	unlink(path.c_str());
+}
+
+TEST(UncompressDeathTest, truncatedBgzf)
+{
+	useDefaultSigchld();
+	string data = bgzfBlock(someText(1000)) + bgzfBlock(someText(2000));
+	string path = tempPath();
+	writeFile(path, data.substr(0, data.size() - 10));
+	EXPECT_EXIT(readUncompress(path),
+			testing::ExitedWithCode(EXIT_FAILURE),
+			"unexpected end of file");
+	EXPECT_EXIT(readFopen(path),
+			testing::ExitedWithCode(EXIT_FAILURE),
+			"unexpected end of file");
+	unlink(path.c_str());
+}
+
+TEST(UncompressDeathTest, bgzfChecksum)
+{
+	useDefaultSigchld();
+	string data = bgzfBlock(someText(1000));
+	// Corrupt the CRC32 of the block.
+	data[data.size() - 8] ^= 1;
+	string path = tempPath();
+	writeFile(path, data + BGZF_EOF);
+	EXPECT_EXIT(readUncompress(path),
+			testing::ExitedWithCode(EXIT_FAILURE),
+			"BGZF block CRC mismatch");
+	EXPECT_EXIT(readFopen(path),
+			testing::ExitedWithCode(EXIT_FAILURE),
+			"BGZF block CRC mismatch");
+	unlink(path.c_str());
+}
+
+#endif // HAVE_ZLIB_H && HAVE_LIBZ
@@ -0,0 +1,55 @@
+#include "Consensus/BaseCount.h"
+#include "gtest/gtest.h"
+#include <limits>
+#include <sstream>
+
+using namespace std;
+
+static const unsigned MAX_COUNT = numeric_limits<uint16_t>::max();
+
+TEST(BaseCount, increment)
+{
+	BaseCount c;
+	EXPECT_EQ(0u, c.sum());
+	c.increment(0);
+	c.increment(2);
+	c.increment(2);
+	EXPECT_EQ(1u, c.count[0]);
+	EXPECT_EQ(0u, c.count[1]);
+	EXPECT_EQ(2u, c.count[2]);
+	EXPECT_EQ(3u, c.sum());
+	ostringstream ss;
+	ss << c;
+	EXPECT_EQ("1\t0\t2\t0", ss.str());
+}
+
+TEST(BaseCount, saturate)
+{
+	BaseCount c;
+	for (unsigned i = 0; i < MAX_COUNT - 1; ++i)
+		c.increment(1);
+	EXPECT_EQ(MAX_COUNT - 1, c.count[1]);
+	c.increment(1);
+	EXPECT_EQ(MAX_COUNT, c.count[1]);
+	for (unsigned i = 0; i < 10; ++i)
+		c.increment(1);
+	EXPECT_EQ(MAX_COUNT, c.count[1]);
+	EXPECT_EQ(0u, c.count[0]);
+	EXPECT_EQ(MAX_COUNT, c.sum());
+}
+
+TEST(BaseCount, saturateParallel)
+{
+	BaseCount c;
+	const int n = 3 * MAX_COUNT;
+#pragma omp parallel for num_threads(4)
+	for (int i = 0; i < n; ++i) {
+		c.increment(3);
+		if (i % 3 == 0)
+			c.increment(0);
+	}
+	EXPECT_EQ(MAX_COUNT, c.count[3]);
+	EXPECT_EQ(MAX_COUNT, c.count[0]);
+	EXPECT_EQ(0u, c.count[1]);
+	EXPECT_EQ(0u, c.count[2]);
+}
@@ -0,0 +1,121 @@
+#include "gtest/gtest.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+
+using namespace std;
+
+/** Compare the consensus called by one thread and by several threads
+ * from the same alignments.
+ */
+
+/** The directory of the programs being tested */
+static const string BUILDDIR = ABYSS_BUILDDIR;
+
+/** Return a random sequence of the specified length. */
+static string randomSequence(unsigned n)
+{
+	string s(n, 'A');
+	for (unsigned i = 0; i < n; ++i)
+		s[i] = "ACGT"[rand() % 4];
+	return s;
+}
+
+/** Substitute a different base at one in n positions of s. */
+static string mutate(string s, unsigned n)
+{
+	static const char bases[] = "ACGT";
+	for (unsigned i = 0; i < s.size(); ++i) {
+		if (rand() % n != 0)
+			continue;
+		unsigned x = strchr(bases, s[i]) - bases;
+		s[i] = bases[(x + 1 + rand() % 3) % 4];
+	}
+	return s;
+}
+
+/** Return the contents of the specified file. */
+static string readFile(const string& path)
+{
+	ifstream in(path.c_str());
+	ostringstream ss;
+	ss << in.rdbuf();
+	return ss.str();
+}
+
+class ConsensusTest : public testing::Test {
+  protected:
+	string dir;
+
+	/** The genome from which the contigs and reads are drawn */
+	string genome;
+
+	/** Write contigs of a random genome with some substitutions,
+	 * and reads of the genome with some sequencing errors.
+	 */
+	virtual void SetUp()
+	{
+		char templ[] = "ConsensusTest.XXXXXX";
+		ASSERT_TRUE(mkdtemp(templ) != NULL);
+		dir = templ;
+
+		srand(1);
+		genome = randomSequence(20000);
+
+		ofstream contigs((dir + "/contigs.fa").c_str());
+		for (unsigned id = 0; id < 10; ++id) {
+			string seq = genome.substr(2000 * id, 2000);
+			contigs << '>' << id << ' ' << seq.size() << " 10\n"
+				<< mutate(seq, 200) << '\n';
+		}
+		ASSERT_TRUE(contigs.good());
+
+		const unsigned readLen = 100;
+		ofstream reads((dir + "/reads.fa").c_str());
+		for (unsigned i = 0; i < 20000; ++i) {
+			unsigned pos = rand() % (genome.size() - readLen);
+			reads << ">r" << i << '\n'
+				<< mutate(genome.substr(pos, readLen), 100) << '\n';
+		}
+		ASSERT_TRUE(reads.good());
+	}
+
+	virtual void TearDown()
+	{
+		string cmd = "rm -rf '" + dir + "'";
+		EXPECT_EQ(0, system(cmd.c_str()));
+	}
+
+	/** Run the specified shell command in the test directory. */
+	void run(const string& cmd)
+	{
+		string s = "cd '" + dir + "' && (" + cmd + ") 2>/dev/null";
+		ASSERT_EQ(0, system(s.c_str())) << cmd;
+	}
+};
+
+TEST_F(ConsensusTest, sameThreads)
+{
+	ASSERT_NO_FATAL_FAILURE(run(
+		BUILDDIR + "/KAligner/KAligner --seq -m -j1 -k25"
+		" reads.fa contigs.fa >aligns"));
+	ASSERT_NO_FATAL_FAILURE(run(
+		BUILDDIR + "/Consensus/Consensus -j1"
+		" -o single.fa -p single.pileup contigs.fa <aligns"));
+	ASSERT_NO_FATAL_FAILURE(run(
+		BUILDDIR + "/Consensus/Consensus -j4"
+		" -o multi.fa -p multi.pileup contigs.fa <aligns"));
+
+	string fa = readFile(dir + "/single.fa");
+	string pileup = readFile(dir + "/single.pileup");
+	EXPECT_FALSE(pileup.empty());
+	EXPECT_EQ(fa, readFile(dir + "/multi.fa"));
+	EXPECT_EQ(pileup, readFile(dir + "/multi.pileup"));
+
+	// The consensus corrects the substitutions of the contigs.
+	EXPECT_NE(string::npos, fa.find(genome.substr(500, 1000)));
+}
@@ -0,0 +1,123 @@
+#include "DAssembler/RotatedRead.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/** Return the rotated strings of the specified rotations. */
+static vector<string> rotationStrings(const vector<RotatedRead>& reads,
+		const Rotations& rotations)
+{
+	vector<string> s;
+	for (Rotations::const_iterator it = rotations.begin();
+			it != rotations.end(); ++it) {
+		RotationView view = reads[it->read].rotation(it->offset);
+		string rotation;
+		for (size_t i = 0; i < view.size(); ++i)
+			rotation += view[i];
+		s.push_back(rotation);
+	}
+	return s;
+}
+
+/** Return distinct sorted reads of random lengths in [minLen, maxLen]. */
+static vector<RotatedRead> randomReads(unsigned n,
+		unsigned minLen, unsigned maxLen, const char* alphabet)
+{
+	size_t k = string(alphabet).size();
+	vector<string> seqs;
+	for (unsigned i = 0; i < n; ++i) {
+		unsigned len = minLen + rand() % (maxLen - minLen + 1);
+		string seq(len, 'A');
+		for (unsigned j = 0; j < len; ++j)
+			seq[j] = alphabet[rand() % k];
+		seqs.push_back(seq);
+	}
+	sort(seqs.begin(), seqs.end());
+	seqs.erase(unique(seqs.begin(), seqs.end()), seqs.end());
+	return vector<RotatedRead>(seqs.begin(), seqs.end());
+}
+
+/** Check that the rotations of the reads are sorted to the
+ * specified rotated strings.
+ */
+static void expectOrder(const vector<RotatedRead>& reads,
+		const char* const* expected, size_t n)
+{
+	Rotations rotations = generate_rotations_list(reads);
+	EXPECT_EQ(vector<string>(expected, expected + n),
+			rotationStrings(reads, rotations));
+}
+
+/** Check that every rotation of the reads is listed once and that
+ * the rotated strings are in order.
+ */
+static void expectSorted(const vector<RotatedRead>& reads)
+{
+	Rotations rotations = generate_rotations_list(reads);
+	size_t n = 0;
+	vector<vector<bool> > seen(reads.size());
+	for (size_t i = 0; i < reads.size(); ++i) {
+		n += reads[i].seq.size() + 1;
+		seen[i].resize(reads[i].seq.size() + 1);
+	}
+	ASSERT_EQ(n, rotations.size());
+	for (Rotations::const_iterator it = rotations.begin();
+			it != rotations.end(); ++it) {
+		ASSERT_LT(it->offset, seen[it->read].size());
+		EXPECT_FALSE(seen[it->read][it->offset]);
+		seen[it->read][it->offset] = true;
+	}
+	vector<string> s = rotationStrings(reads, rotations);
+	for (size_t i = 1; i < s.size(); ++i)
+		EXPECT_LE(s[i - 1], s[i]);
+}
+
+TEST(generate_rotations_list, sameLength)
+{
+	vector<RotatedRead> reads;
+	reads.push_back(RotatedRead("ACG"));
+	reads.push_back(RotatedRead("CAT"));
+	const char* expected[] = { "$ACG", "$CAT", "ACG$", "AT$C",
+		"CAT$", "CG$A", "G$AC", "T$CA" };
+	expectOrder(reads, expected, sizeof expected / sizeof *expected);
+
+	srand(1);
+	for (unsigned trial = 0; trial < 20; ++trial)
+		expectSorted(randomReads(200, 30, 30,
+					trial % 2 ? "AC" : "ACGT"));
+}
+
+TEST(generate_rotations_list, differentLength)
+{
+	// A shorter rotation that is a prefix of a longer one sorts first,
+	// although the suffix that follows it may not.
+	vector<RotatedRead> reads;
+	reads.push_back(RotatedRead("AAC"));
+	reads.push_back(RotatedRead("AC"));
+	const char* expected[] = { "$AAC", "$AC", "AAC$", "AC$", "AC$A",
+		"C$A", "C$AA" };
+	expectOrder(reads, expected, sizeof expected / sizeof *expected);
+
+	srand(2);
+	for (unsigned trial = 0; trial < 20; ++trial)
+		expectSorted(randomReads(200, 1, 30,
+					trial % 2 ? "AC" : "ACGT"));
+}
+
+TEST(generate_rotations_list, periodic)
+{
+	vector<RotatedRead> reads;
+	reads.push_back(RotatedRead("ACAC"));
+	reads.push_back(RotatedRead("CACA"));
+	const char* expected[] = { "$ACAC", "$CACA", "A$CAC", "AC$AC",
+		"ACA$C", "ACAC$", "C$ACA", "CA$CA", "CAC$A", "CACA$" };
+	expectOrder(reads, expected, sizeof expected / sizeof *expected);
+
+	reads.push_back(RotatedRead("AAAAAA"));
+	reads.push_back(RotatedRead("CCCCCC"));
+	expectSorted(reads);
+}
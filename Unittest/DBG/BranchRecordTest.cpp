@@ -0,0 +1,109 @@
+#include "Assembly/Options.h"
+#include "Assembly/SequenceCollection.h"
+#include "Common/Options.h"
+
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/** Return the k-mer of s in order. */
+static vector<Kmer> kmers(const string& s)
+{
+	vector<Kmer> v;
+	for (unsigned i = 0; i + Kmer::length() <= s.size(); ++i)
+		v.push_back(Kmer(Sequence(s.substr(i, Kmer::length()))));
+	return v;
+}
+
+TEST(BranchRecordTest, Sequence)
+{
+	Kmer::setLength(3);
+
+	// sequence for branch: TAGGATT
+	// k-mer:               TAG
+	//                       AGG
+	//                        GGA
+	//                         GAT
+	//                          ATT
+	vector<Kmer> v = kmers("TAGGATT");
+	ASSERT_EQ(5U, v.size());
+
+	// test sequence reconstruction in forward dir
+	BranchRecord forwardBranch(SENSE);
+	for (unsigned i = 0; i < v.size(); ++i)
+		forwardBranch.push_back(make_pair(v[i], KmerData()));
+	EXPECT_EQ("TAGGATT", (Sequence)forwardBranch);
+
+	// test sequence reconstruction in reverse dir
+	BranchRecord reverseBranch(ANTISENSE);
+	for (unsigned i = v.size(); i-- > 0;)
+		reverseBranch.push_back(make_pair(v[i], KmerData()));
+	EXPECT_EQ("TAGGATT", (Sequence)reverseBranch);
+
+	// a branch of a single k-mer
+	BranchRecord single(SENSE);
+	single.push_back(make_pair(v[2], KmerData()));
+	EXPECT_EQ("GGA", (Sequence)single);
+}
+
+TEST(BranchRecordTest, Roll)
+{
+	// Cross the boundaries of the bytes of the packed steps.
+	Kmer::setLength(5);
+	const string s = "TAGGATTCCAGTACGGT";
+	vector<Kmer> v = kmers(s);
+	ASSERT_EQ(13U, v.size());
+
+	for (extDirection dir = SENSE; dir <= ANTISENSE; ++dir) {
+		BranchRecord branch(dir);
+		for (unsigned i = 0; i < v.size(); ++i) {
+			unsigned j = dir == SENSE ? i : v.size() - 1 - i;
+			branch.push_back(make_pair(v[j], KmerData(SENSE, i + 1)));
+		}
+		ASSERT_EQ(v.size(), branch.size());
+		EXPECT_EQ(91, branch.calculateBranchMultiplicity());
+		EXPECT_EQ(s, (string)(Sequence)branch);
+
+		// Every vertex is reconstructed by at and by the iterators.
+		unsigned i = 0;
+		for (BranchRecord::const_iterator it = branch.begin();
+				it != branch.end(); ++it, ++i) {
+			unsigned j = dir == SENSE ? i : v.size() - 1 - i;
+			EXPECT_EQ(v[j], branch.at(i).first);
+			EXPECT_EQ(v[j], it->first);
+			EXPECT_TRUE(branch.exists(i, it->first));
+			EXPECT_EQ(i + 1, it->second.getMultiplicity());
+		}
+		EXPECT_EQ(branch.size(), i);
+		for (BranchRecord::const_iterator it = branch.rbegin();
+				it != branch.rend(); ++it) {
+			--i;
+			EXPECT_EQ(branch.at(i).first, it->first);
+			EXPECT_EQ(i + 1, it->second.getMultiplicity());
+		}
+		EXPECT_EQ(0U, i);
+
+		// Remove every vertex and check the remaining branch.
+		while (branch.size() > 1) {
+			branch.pop_back();
+			unsigned n = branch.size();
+			EXPECT_EQ(dir == SENSE ? v[n - 1] : v[v.size() - n],
+					branch.back().first);
+			EXPECT_EQ(n, branch.back().second.getMultiplicity());
+			EXPECT_EQ(dir == SENSE ? v[0] : v.back(),
+					branch.front().first);
+			EXPECT_EQ(dir == SENSE ? s.substr(0, n + 4)
+					: s.substr(s.size() - n - 4),
+					(string)(Sequence)branch);
+		}
+		branch.pop_back();
+		EXPECT_TRUE(branch.empty());
+
+		// The branch may be extended again once emptied.
+		branch.push_back(make_pair(v[6], KmerData(SENSE, 7)));
+		EXPECT_EQ(v[6], branch.at(0).first);
+		EXPECT_EQ(v[6].str(), (string)(Sequence)branch);
+	}
+}
@@ -2,7 +2,9 @@
 #include "Assembly/SequenceCollection.h"
 #include "Assembly/DBG.h"
 #include "Assembly/AssemblyAlgorithms.h"
+#include "Assembly/KmerBuckets.h"
 #include "Assembly/Options.h"
+#include "Common/Histogram.h"
 #include "Common/UnorderedSet.h"
 
 #include <gtest/gtest.h>
@@ -42,3 +44,58 @@ cerr << "visiting Kmer: " << kmer << "\n";
 
 	ASSERT_TRUE(expectedKmers.empty());
 }
+
+TEST(SequenceCollectionHashTest, compact)
+{
+	typedef SequenceCollectionHash Graph;
+	Graph g;
+
+	opt::kmerSize = 5;
+	Kmer::setLength(5);
+
+	Sequence seq("TAATGCCA");
+	AssemblyAlgorithms::loadSequence(&g, seq);
+	ASSERT_EQ(4u, g.size());
+
+	EXPECT_EQ(0u, g.compact());
+	g.remove(Kmer("AATGC"));
+	g.remove(Kmer("GGCAT")); // the reverse complement of ATGCC
+	g.remove(Kmer("AATGC"));
+	EXPECT_EQ(4u, g.size());
+
+	EXPECT_EQ(2u, g.compact());
+	EXPECT_EQ(2u, g.size());
+	for (Graph::const_iterator it = g.begin(); it != g.end(); ++it)
+		EXPECT_FALSE(it->second.deleted());
+	EXPECT_EQ(0u, g.cleanup());
+}
+
+TEST(KmerBucketsTest, count)
+{
+	typedef SequenceCollectionHash Graph;
+	typedef graph_traits<Graph>::vertex_descriptor V;
+	Graph g;
+
+	opt::kmerSize = 5;
+	Kmer::setLength(5);
+
+	KmerBuckets<V> buckets(3);
+	Sequence seq("TAATGCCA");
+	AssemblyAlgorithms::loadSequence(&buckets, seq);
+	AssemblyAlgorithms::loadSequence(&buckets, seq);
+	// The reverse complement of TAATG and AATGC
+	Sequence seqRC("GCATTA");
+	AssemblyAlgorithms::loadSequence(&buckets, seqRC);
+	EXPECT_FALSE(buckets.empty());
+
+	Histogram h;
+	EXPECT_EQ(4u, buckets.count(g, 3, h));
+	EXPECT_EQ(2u, g.size());
+	EXPECT_EQ(2u, h.count(2));
+	EXPECT_EQ(2u, h.count(3));
+
+	// The orientation of the first occurrence is the sense strand.
+	EXPECT_EQ(2u, g[V("TAATG")].getMultiplicity(SENSE));
+	EXPECT_EQ(1u, g[V("TAATG")].getMultiplicity(ANTISENSE));
+	EXPECT_EQ(2u, g[V("GCATT")].getMultiplicity(ANTISENSE));
+}
@@ -0,0 +1,114 @@
+#include "config.h"
+#include "Assembly/SequenceCollection.h"
+#include "Assembly/DBG.h"
+#include "Assembly/AssemblyAlgorithms.h"
+#include "Assembly/Options.h"
+
+#include <gtest/gtest.h>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/** Add the k-mer of the specified sequence to the graph. */
+static void load(SequenceCollectionHash& g, const string& s)
+{
+	Sequence seq(s);
+	AssemblyAlgorithms::loadSequence(&g, seq);
+}
+
+/** Load the specified sequences and add the edges of the graph. */
+static void loadGraph(SequenceCollectionHash& g,
+		const vector<string>& seqs)
+{
+	for (vector<string>::const_iterator it = seqs.begin();
+			it != seqs.end(); ++it)
+		load(g, *it);
+	g.setColourSpace(false);
+	AssemblyAlgorithms::generateAdjacency(&g);
+}
+
+/** Return the k-mer of the graph that are not deleted. */
+static set<string> kmers(const SequenceCollectionHash& g)
+{
+	set<string> s;
+	for (SequenceCollectionHash::const_iterator it = g.begin();
+			it != g.end(); ++it)
+		if (!it->second.deleted())
+			s.insert(it->first.str());
+	return s;
+}
+
+/** Trim a graph of the specified sequences, and check that the k-mer
+ * of the expected sequences remain.
+ * @return the number of trimmed branches
+ */
+static size_t expectTrimmed(const vector<string>& seqs,
+		const vector<string>& expectedSeqs)
+{
+	SequenceCollectionHash g, expected;
+	loadGraph(g, seqs);
+	loadGraph(expected, expectedSeqs);
+	size_t before = AssemblyAlgorithms::tempCounter[1];
+	AssemblyAlgorithms::performTrim(&g);
+	EXPECT_EQ(kmers(expected), kmers(g));
+	return AssemblyAlgorithms::tempCounter[1] - before;
+}
+
+/** A genome of 34 7-mer, which are distinct */
+static const char* GENOME = "GGGTAGGATACGGCGGAGGGCACGTCAATACGGTTCAATG";
+
+class TrimAlgorithmTest : public testing::Test {
+  protected:
+	virtual void SetUp()
+	{
+		opt::kmerSize = 7;
+		Kmer::setLength(7);
+		opt::trimLen = 4;
+	}
+};
+
+TEST_F(TrimAlgorithmTest, tips)
+{
+	vector<string> seqs, expected;
+	seqs.push_back(GENOME);
+	// A tip of 3 k-mer after the 11th k-mer of the genome
+	seqs.push_back("CGGCGGACCC");
+	// A tip of 6 k-mer after the 23rd k-mer, in reverse complement
+	seqs.push_back("GCAGTAATTGACG");
+	// Islands of 2 and 10 k-mer
+	seqs.push_back("CTTGTGGT");
+	seqs.push_back("TCATCTGCATGGAGAG");
+
+	// Trim the tips and islands of at most 4 k-mer. The island of 2
+	// k-mer is trimmed from both of its ends.
+	expected.push_back(GENOME);
+	expected.push_back("GCAGTAATTGACG");
+	expected.push_back("TCATCTGCATGGAGAG");
+	EXPECT_EQ(3U, expectTrimmed(seqs, expected));
+}
+
+TEST_F(TrimAlgorithmTest, tipOfTip)
+{
+	vector<string> seqs, expected;
+	seqs.push_back(GENOME);
+	// A tip of 3 k-mer, and a tip of 2 k-mer that branches from its
+	// second k-mer, which together are no longer than 4 k-mer
+	seqs.push_back("CGGCGGAATG");
+	seqs.push_back("GCGGAATCT");
+	// A tip of 6 k-mer
+	seqs.push_back("GCAGTAATTGACG");
+
+	// The first round trims the last k-mer of the longer tip, which
+	// ends at the junction. The remaining 4 k-mer form one tip.
+	expected.push_back(GENOME);
+	expected.push_back("GCAGTAATTGACG");
+	EXPECT_EQ(2U, expectTrimmed(seqs, expected));
+}
+
+TEST_F(TrimAlgorithmTest, noTips)
+{
+	vector<string> seqs(1, GENOME);
+	EXPECT_EQ(0U, expectTrimmed(seqs, seqs));
+}
@@ -0,0 +1,75 @@
+#include "DataLayer/FastaReader.h"
+#include "gtest/gtest.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+class FastaReaderSplitTest : public testing::Test
+{
+  protected:
+	string path;
+
+	FastaReaderSplitTest()
+	{
+		char name[] = "FastaReaderTest.XXXXXX";
+		int fd = mkstemp(name);
+		assert(fd >= 0);
+		close(fd);
+		path = name;
+	}
+
+	~FastaReaderSplitTest()
+	{
+		remove(path.c_str());
+	}
+
+	void write(const string& s)
+	{
+		ofstream out(path.c_str());
+		out << s;
+	}
+
+	/** Read the IDs of every section of the file in turn. */
+	vector<string> readSections(unsigned nsections)
+	{
+		vector<string> ids;
+		for (unsigned i = 1; i <= nsections; ++i) {
+			FastaReader in(path.c_str(), FastaReader::FOLD_CASE);
+			in.split(i, nsections);
+			for (FastaRecord rec; in >> rec;)
+				ids.push_back(rec.id);
+		}
+		return ids;
+	}
+};
+
+TEST_F(FastaReaderSplitTest, FASTA)
+{
+	write(">1\nACGT\n>2\nAC\nGT\n>3\nGGCC\n>4\nTTTTAAAA\n");
+	vector<string> expected;
+	expected.push_back("1");
+	expected.push_back("2");
+	expected.push_back("3");
+	expected.push_back("4");
+	for (unsigned n = 1; n <= 12; ++n)
+		EXPECT_EQ(expected, readSections(n)) << n << " sections";
+}
+
+TEST_F(FastaReaderSplitTest, FASTQ)
+{
+	// The quality strings start with '@' to resemble a header.
+	write("@1\nACGT\n+\n@@@@\n@2\nACGTA\n+2\n@III@\n"
+			"@3\nGG\n+\n@@\n@4\nTTTT\n+\nIIII\n");
+	vector<string> expected;
+	expected.push_back("1");
+	expected.push_back("2");
+	expected.push_back("3");
+	expected.push_back("4");
+	for (unsigned n = 1; n <= 12; ++n)
+		EXPECT_EQ(expected, readSections(n)) << n << " sections";
+}
@@ -0,0 +1,97 @@
+#include "DataLayer/FastaStore.h"
+#include "gtest/gtest.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+
+using namespace std;
+
+class FastaStoreTest : public testing::Test
+{
+  protected:
+	string path;
+
+	FastaStoreTest()
+	{
+		char name[] = "FastaStoreTest.XXXXXX";
+		int fd = mkstemp(name);
+		assert(fd >= 0);
+		close(fd);
+		path = name;
+	}
+
+	~FastaStoreTest()
+	{
+		remove(path.c_str());
+		remove((path + ".fai").c_str());
+	}
+
+	void write(const string& s, const string& fai = "")
+	{
+		ofstream out(path.c_str());
+		out << s;
+		if (!fai.empty()) {
+			ofstream faiOut((path + ".fai").c_str());
+			faiOut << fai;
+		}
+	}
+};
+
+TEST_F(FastaStoreTest, SingleLine)
+{
+	write(">1 10 5\nACGTTggaac\n>2\nttCCGG\n");
+	FastaStore store(path.c_str());
+	EXPECT_TRUE(store.mapped());
+	ASSERT_EQ(2u, store.size());
+	EXPECT_EQ("1", store.id(0));
+	EXPECT_EQ("10 5", store.comment(0));
+	EXPECT_EQ("2", store.id(1));
+	EXPECT_EQ("", store.comment(1));
+	EXPECT_EQ(5u, store.length(0));
+	EXPECT_EQ("ACGTT", store.sequence(0).str());
+	EXPECT_EQ("AACGT", store.sequence(0, true).str());
+	EXPECT_EQ("CCGG", store.sequence(1).str());
+	EXPECT_EQ("CG", store.sequence(0).substr(1, 2));
+	EXPECT_EQ('A', store.sequence(0, true)[0]);
+}
+
+TEST_F(FastaStoreTest, NoFoldCase)
+{
+	write(">1\nACgtT\n");
+	FastaStore store(path.c_str(), FastaStore::NO_FOLD_CASE);
+	EXPECT_EQ("ACgtT", store.sequence(0).str());
+	EXPECT_EQ("AacGT", store.sequence(0, true).str());
+}
+
+TEST_F(FastaStoreTest, Index)
+{
+	write(">1\nACGT\n>2 x\nGGC\n", "1\t4\t3\t4\t5\n2\t3\t14\t3\t4\n");
+	FastaStore store(path.c_str());
+	EXPECT_TRUE(store.mapped());
+	ASSERT_EQ(2u, store.size());
+	EXPECT_EQ("2", store.id(1));
+	EXPECT_EQ("x", store.comment(1));
+	EXPECT_EQ("GCC", store.sequence(1, true).str());
+}
+
+TEST_F(FastaStoreTest, StaleIndex)
+{
+	write(">1\nACGT\n>2\nGGC\n", "1\t4\t3\t4\t5\n");
+	FastaStore store(path.c_str());
+	ASSERT_EQ(2u, store.size());
+	EXPECT_EQ("GGC", store.sequence(1).str());
+}
+
+TEST_F(FastaStoreTest, MultiLine)
+{
+	write(">1\nACGT\nAC\n>2\nGGC\n");
+	FastaStore store(path.c_str());
+	EXPECT_FALSE(store.mapped());
+	ASSERT_EQ(2u, store.size());
+	EXPECT_EQ("1", store.id(0));
+	EXPECT_EQ("ACGTAC", store.sequence(0).str());
+	EXPECT_EQ("GTACGT", store.sequence(0, true).str());
+	EXPECT_EQ("GGC", store.sequence(1).str());
+}
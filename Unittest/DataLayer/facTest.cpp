@@ -0,0 +1,150 @@
+#include "gtest/gtest.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <sys/time.h>
+#include <unistd.h>
+
+using namespace std;
+
+/** Compare the statistics of abyss-fac when it scans a file in
+ * blocks or reads its FASTA index with those when it reads the same
+ * sequences with FastaReader, which it uses for standard input.
+ */
+
+/** The directory of the programs being tested */
+static const string BUILDDIR = ABYSS_BUILDDIR;
+
+class FacTest : public testing::Test {
+  protected:
+	string dir;
+
+	/** The exit status of the last run of abyss-fac */
+	int status;
+
+	virtual void SetUp()
+	{
+		char templ[] = "facTest.XXXXXX";
+		ASSERT_TRUE(mkdtemp(templ) != NULL);
+		dir = templ;
+	}
+
+	virtual void TearDown()
+	{
+		string cmd = "rm -rf '" + dir + "'";
+		EXPECT_EQ(0, system(cmd.c_str()));
+	}
+
+	/** Write the specified file in the test directory. */
+	void write(const string& name, const string& s)
+	{
+		ofstream out((dir + '/' + name).c_str(), ios::binary);
+		out << s;
+		ASSERT_TRUE(out.good());
+	}
+
+	/** Run abyss-fac in the test directory and return its output
+	 * without the name of the file, which is the last column. Set
+	 * status to its exit status.
+	 */
+	string fac(const string& args)
+	{
+		string path = dir + "/fac.out";
+		string cmd = "cd '" + dir + "' && "
+			+ BUILDDIR + "/DataLayer/abyss-fac -s1 " + args
+			+ " >fac.out 2>/dev/null";
+		status = system(cmd.c_str());
+		ifstream in(path.c_str());
+		ostringstream ss;
+		for (string line; getline(in, line);)
+			ss << line.substr(0, line.rfind('\t')) << '\n';
+		return ss.str();
+	}
+
+	/** Check that the block scanner and FastaReader agree on the
+	 * specified FASTA file, with and without --count-ambig.
+	 * @return the exit status of abyss-fac
+	 */
+	int expectSame(const string& fasta)
+	{
+		write("in.fa", fasta);
+		const char* options[] = { "", "--count-ambig " };
+		for (unsigned i = 0; i < 2; ++i) {
+			string opts = options[i];
+			string expected = fac(opts + "- <in.fa");
+			int expectedStatus = status;
+			EXPECT_EQ(expected, fac(opts + "in.fa"))
+				<< opts << fasta;
+			EXPECT_EQ(expectedStatus, status) << opts << fasta;
+		}
+		return status;
+	}
+};
+
+TEST_F(FacTest, plain)
+{
+	EXPECT_EQ(0, expectSame(
+				">1\nACGT\nACG\n>2\nACNNGT\n>3 comment\nA\n"));
+}
+
+TEST_F(FacTest, crlf)
+{
+	EXPECT_EQ(0, expectSame(
+				">1\r\nACGT\r\nACG\r\n>2\r\nACNNGT\r\n"));
+	EXPECT_EQ(0, expectSame(">1\r\nACGT\nACG\r\n>2\nACNNGT\r\n"));
+}
+
+TEST_F(FacTest, noFinalNewline)
+{
+	EXPECT_EQ(0, expectSame(">1\nACGT\n>2\nACGTAC"));
+	EXPECT_EQ(0, expectSame(">1\r\nACGT\r\n>2\r\nACGTAC\r"));
+}
+
+TEST_F(FacTest, emptyRecord)
+{
+	// FastaReader rejects an empty sequence, and so must the scanner.
+	EXPECT_NE(0, expectSame(">1\n>2\nACGT\n"));
+	EXPECT_NE(0, expectSame(">1\nACGT\n>2\n>3\nAC\n"));
+	EXPECT_NE(0, expectSame(">1\nACGT\n>2\n"));
+	EXPECT_NE(0, expectSame(">1\nACGT\n>2\n\r\n"));
+}
+
+TEST_F(FacTest, colourSpace)
+{
+	EXPECT_EQ(0, expectSame(">1\nA0123012\n>2\nT3210\n"));
+}
+
+/** Set the modification time of the specified file to t seconds
+ * before now. */
+static void age(const string& path, time_t t)
+{
+	struct timeval times[2];
+	gettimeofday(&times[0], NULL);
+	times[0].tv_sec -= t;
+	times[1] = times[0];
+	ASSERT_EQ(0, utimes(path.c_str(), times));
+}
+
+TEST_F(FacTest, fastaIndex)
+{
+	write("in.fa", ">1\nACGT\nACG\n>2\nACNNGT\n");
+	string expected = fac("--count-ambig - <in.fa");
+
+	// The index of samtools faidx, which has a record of two lines.
+	write("in.fa.fai", "1\t7\t3\t4\t5\n2\t6\t15\t6\t7\n");
+	age(dir + "/in.fa", 10);
+	EXPECT_EQ(expected, fac("--count-ambig in.fa"));
+	EXPECT_EQ(0, status);
+
+	// An index older than its FASTA file is ignored.
+	write("in.fa.fai", "1\t70\t3\t70\t71\n2\t60\t16\t60\t61\n");
+	age(dir + "/in.fa.fai", 20);
+	EXPECT_EQ(expected, fac("--count-ambig in.fa"));
+
+	// A malformed index is ignored.
+	write("in.fa.fai", "1\t7\t3\t4\t5\n2\n");
+	EXPECT_EQ(expected, fac("--count-ambig in.fa"));
+	EXPECT_EQ(0, status);
+}
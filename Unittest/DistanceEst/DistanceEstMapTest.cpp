@@ -0,0 +1,137 @@
+#include "gtest/gtest.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+
+using namespace std;
+
+/** Compare DistanceEst --map with its equivalent pipeline,
+ * abyss-map | abyss-fixmate | sort | DistanceEst
+ */
+
+/** The directory of the programs being tested */
+static const string BUILDDIR = ABYSS_BUILDDIR;
+
+/** The k-mer size of the contigs */
+static const unsigned k = 31;
+
+/** Return a random sequence of the specified length. */
+static string randomSequence(unsigned n)
+{
+	string s(n, 'A');
+	for (unsigned i = 0; i < n; ++i)
+		s[i] = "ACGT"[rand() % 4];
+	return s;
+}
+
+/** Return the reverse complement of s. */
+static string reverseComplement(const string& s)
+{
+	string rc(s.rbegin(), s.rend());
+	for (string::iterator it = rc.begin(); it != rc.end(); ++it)
+		*it = *it == 'A' ? 'T' : *it == 'C' ? 'G'
+			: *it == 'G' ? 'C' : 'A';
+	return rc;
+}
+
+/** Return the contents of the specified file. */
+static string readFile(const string& path)
+{
+	ifstream in(path.c_str());
+	ostringstream ss;
+	ss << in.rdbuf();
+	return ss.str();
+}
+
+class DistanceEstMapTest : public testing::Test {
+  protected:
+	string dir;
+
+	/** Write contigs that overlap by k-1 bases and read pairs of a
+	 * random genome.
+	 */
+	virtual void SetUp()
+	{
+		char templ[] = "DistanceEstMapTest.XXXXXX";
+		ASSERT_TRUE(mkdtemp(templ) != NULL);
+		dir = templ;
+
+		srand(1);
+		string genome = randomSequence(30000);
+
+		ofstream contigs((dir + "/contigs.fa").c_str());
+		unsigned id = 0;
+		for (unsigned pos = 0; pos + k < genome.size(); ++id) {
+			unsigned len = 500 + rand() % 2500;
+			if (pos + len > genome.size())
+				len = genome.size() - pos;
+			string seq = genome.substr(pos, len);
+			contigs << '>' << id << '\n'
+				<< (id % 3 == 0 ? reverseComplement(seq) : seq)
+				<< '\n';
+			pos += len - (k - 1);
+		}
+		ASSERT_TRUE(contigs.good());
+
+		const unsigned readLen = 100;
+		ofstream reads1((dir + "/reads_1.fa").c_str());
+		ofstream reads2((dir + "/reads_2.fa").c_str());
+		for (unsigned i = 0; i < 20000; ++i) {
+			// A fragment size of roughly 400 +/- 30
+			unsigned frag = 350;
+			for (unsigned j = 0; j < 10; ++j)
+				frag += rand() % 11;
+			unsigned pos = rand() % (genome.size() - frag);
+			string seq = genome.substr(pos, frag);
+			if (rand() % 2)
+				seq = reverseComplement(seq);
+			reads1 << ">r" << i << "/1\n"
+				<< seq.substr(0, readLen) << '\n';
+			reads2 << ">r" << i << "/2\n"
+				<< reverseComplement(seq.substr(frag - readLen))
+				<< '\n';
+		}
+		ASSERT_TRUE(reads1.good());
+		ASSERT_TRUE(reads2.good());
+	}
+
+	virtual void TearDown()
+	{
+		string cmd = "rm -rf '" + dir + "'";
+		EXPECT_EQ(0, system(cmd.c_str()));
+	}
+
+	/** Run the specified shell command in the test directory. */
+	void run(const string& cmd)
+	{
+		string s = "cd '" + dir + "' && (" + cmd + ") 2>/dev/null";
+		ASSERT_EQ(0, system(s.c_str())) << cmd;
+	}
+};
+
+TEST_F(DistanceEstMapTest, samePipeline)
+{
+	const string options = " -k31 -l40 -s200 -n1";
+	ASSERT_NO_FATAL_FAILURE(run(
+		BUILDDIR + "/Map/abyss-map -l40 -j2"
+		" reads_1.fa reads_2.fa contigs.fa >pipe.sam"
+		" && " + BUILDDIR + "/ParseAligns/abyss-fixmate -l40"
+		" -h pipe.hist <pipe.sam >pipe.fixmate.sam"
+		" && sort -snk3 -k4 pipe.fixmate.sam >pipe.sort.sam"
+		" && " + BUILDDIR + "/DistanceEst/DistanceEst" + options
+		+ " -o pipe.dist pipe.hist <pipe.sort.sam"));
+	ASSERT_NO_FATAL_FAILURE(run(
+		BUILDDIR + "/DistanceEst/DistanceEst -j2" + options
+		+ " --map -o map.dist map.hist"
+		" reads_1.fa reads_2.fa contigs.fa"));
+
+	string hist = readFile(dir + "/pipe.hist");
+	string dist = readFile(dir + "/pipe.dist");
+	EXPECT_FALSE(hist.empty());
+	EXPECT_NE(string::npos, dist.find(';'));
+	EXPECT_EQ(hist, readFile(dir + "/map.hist"));
+	EXPECT_EQ(dist, readFile(dir + "/map.dist"));
+}
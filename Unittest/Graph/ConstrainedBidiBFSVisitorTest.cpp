@@ -211,4 +211,25 @@ TEST_F(ConstrainedBidiBFSVisitorTest, NoLimitForBranches)
 	ASSERT_TRUE(path2 == "0,1,3" || path2 == "0,2,3");
 }
 
+TEST_F(ConstrainedBidiBFSVisitorTest, LongPath)
+{
+	// long enough to force the depth tables to grow
+	const unsigned n = 1000;
+	Graph g;
+	for (unsigned i = 0; i + 1 < n; i++)
+		add_edge(i, i + 1, g);
+
+	ConstrainedBidiBFSVisitor<Graph>
+		visitor(g, 0, n - 1, 1, 1, n, NO_LIMIT, NO_LIMIT, NO_MEM_LIMIT);
+	bidirectionalBFS(g, 0, n - 1, visitor);
+
+	Path<V> uniquePath;
+	PathSearchResult result = visitor.uniquePathToGoal(uniquePath);
+
+	ASSERT_EQ(FOUND_PATH, result);
+	ASSERT_EQ(n, uniquePath.size());
+	for (unsigned i = 0; i < n; i++)
+		ASSERT_EQ(i, uniquePath[i]);
+}
+
 }
@@ -0,0 +1,139 @@
+#include "KAligner/KmerIndex.h"
+#include "gtest/gtest.h"
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/** Index the specified k-mer, each at position i of contig i. */
+static void assign(KmerIndex& index, const vector<string>& seqs)
+{
+	vector<char> keys(seqs.size() * Kmer::bytes());
+	vector<Position> positions;
+	for (unsigned i = 0; i < seqs.size(); ++i) {
+		char key[Kmer::NUM_BYTES];
+		Kmer(seqs[i]).serialize(key);
+		copy(key, key + Kmer::bytes(), &keys[i * Kmer::bytes()]);
+		positions.push_back(Position(i, i));
+	}
+	index.assign(keys, positions);
+}
+
+static size_t count(const KmerIndex& index, const string& seq)
+{
+	KmerIndex::Range range = index.equal_range(Kmer(seq));
+	return range.second - range.first;
+}
+
+TEST(KmerIndex, equal_range)
+{
+	Kmer::setLength(12);
+	vector<string> seqs;
+	seqs.push_back("ACGTACGTTTTT");
+	seqs.push_back("CCCCCCCCAAAA");
+	seqs.push_back("ACGTACGTTTTT");
+	seqs.push_back("ACGTACGTTTTA");
+	KmerIndex index;
+	assign(index, seqs);
+
+	ASSERT_EQ(4U, index.size());
+	EXPECT_EQ(1U, count(index, "CCCCCCCCAAAA"));
+	EXPECT_EQ(1U, count(index, "ACGTACGTTTTA"));
+	EXPECT_EQ(0U, count(index, "ACGTACGTTTTC"));
+	EXPECT_EQ(0U, count(index, "GGGGGGGGGGGG"));
+
+	// The positions of a k-mer are in decreasing order.
+	KmerIndex::Range range = index.equal_range(Kmer(seqs[0]));
+	ASSERT_EQ(2, range.second - range.first);
+	EXPECT_EQ(2U, range.first[0].contig);
+	EXPECT_EQ(0U, range.first[1].contig);
+}
+
+TEST(KmerIndex, removeDuplicates)
+{
+	Kmer::setLength(6);
+	vector<string> seqs;
+	seqs.push_back("AACCGG"); // 0
+	seqs.push_back("AAAAAC"); // 1
+	seqs.push_back("GTTTTT"); // 2: the reverse complement of 1
+	seqs.push_back("ACGTTC"); // 3
+	seqs.push_back("AACCGG"); // 4: the same k-mer as 0
+	seqs.push_back("ACGCGT"); // 5: a palindrome seen once
+	KmerIndex index;
+	assign(index, seqs);
+
+	KmerIndex::Duplicate dup;
+	ASSERT_TRUE(index.removeDuplicates(dup));
+	EXPECT_EQ(1U, dup.first.contig);
+	EXPECT_EQ(2U, dup.second.contig);
+	EXPECT_EQ("GTTTTT", dup.kmer.str());
+
+	ASSERT_EQ(4U, index.size());
+	EXPECT_EQ(2U, index.countDuplicates());
+	EXPECT_FALSE(index.equal_range(Kmer("ACGCGT")).first->isDuplicate());
+	EXPECT_EQ(1U, count(index, "AAAAAC"));
+	EXPECT_EQ(0U, count(index, "GTTTTT"));
+	EXPECT_TRUE(index.equal_range(Kmer("AAAAAC")).first->isDuplicate());
+	EXPECT_TRUE(index.equal_range(Kmer("AACCGG")).first->isDuplicate());
+	const Position* p = index.equal_range(Kmer("ACGTTC")).first;
+	EXPECT_FALSE(p->isDuplicate());
+	EXPECT_EQ(3U, p->contig);
+}
+
+TEST(KmerIndex, serialize)
+{
+	Kmer::setLength(9);
+	vector<string> seqs;
+	seqs.push_back("ACGTACGTA");
+	seqs.push_back("TTTTTTTTT");
+	seqs.push_back("ACGTACGTA");
+	KmerIndex index;
+	assign(index, seqs);
+
+	stringstream ss;
+	ss << index;
+	KmerIndex copy;
+	ss >> copy;
+	ASSERT_TRUE(ss.good());
+	ASSERT_EQ(index.size(), copy.size());
+	EXPECT_EQ(2U, count(copy, "ACGTACGTA"));
+	EXPECT_EQ(1U, count(copy, "TTTTTTTTT"));
+	EXPECT_EQ(0U, count(copy, "AAAAAAAAA"));
+}
+
+TEST(KmerIndex, truncated)
+{
+	Kmer::setLength(9);
+	vector<string> seqs;
+	seqs.push_back("ACGTACGTA");
+	seqs.push_back("TTTTTTTTT");
+	KmerIndex index;
+	assign(index, seqs);
+	ostringstream out;
+	out << index;
+	string s = out.str();
+
+	istringstream in(s.substr(0, s.size() - 1));
+	KmerIndex copy;
+	in >> copy;
+	EXPECT_TRUE(in.fail());
+}
+
+TEST(KmerIndex, differentK)
+{
+	Kmer::setLength(9);
+	vector<string> seqs;
+	seqs.push_back("ACGTACGTA");
+	KmerIndex index;
+	assign(index, seqs);
+	stringstream ss;
+	ss << index;
+
+	// A k-mer of 40 bases does not fit in the bytes of 9 bases.
+	Kmer::setLength(40);
+	KmerIndex copy;
+	ss >> copy;
+	EXPECT_TRUE(ss.fail());
+	Kmer::setLength(9);
+}
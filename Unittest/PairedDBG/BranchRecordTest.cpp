@@ -56,3 +56,51 @@ TEST(BranchRecordTest, Sequence)
 	shortBranchReverse.push_back(kmerPair1);
 	ASSERT_EQ("TAGNGAT", (Sequence)shortBranchReverse);
 }
+
+TEST(BranchRecordTest, Roll)
+{
+	Kmer::setLength(2);
+	unsigned delta = 2;
+	KmerPair::setLength(Kmer::length() * 2 + delta);
+
+	std::vector<KmerPair> kmerPairs;
+	kmerPairs.push_back(KmerPair("TA", "GA"));
+	kmerPairs.push_back(KmerPair("AG", "AT"));
+	kmerPairs.push_back(KmerPair("GG", "TT"));
+	kmerPairs.push_back(KmerPair("GC", "TC"));
+
+	for (extDirection dir = SENSE; dir <= ANTISENSE; ++dir) {
+		BranchRecord branch(dir);
+		for (unsigned i = 0; i < kmerPairs.size(); ++i) {
+			unsigned j = dir == SENSE ? i : kmerPairs.size() - 1 - i;
+			branch.push_back(std::make_pair(kmerPairs[j],
+						KmerPairData(SENSE, i + 1)));
+		}
+		ASSERT_EQ(kmerPairs.size(), branch.size());
+		EXPECT_EQ(10, branch.calculateBranchMultiplicity());
+
+		// Iterate forward and backward over the rolled k-mer pairs.
+		unsigned i = 0;
+		for (BranchRecord::const_iterator it = branch.begin();
+				it != branch.end(); ++it, ++i) {
+			EXPECT_TRUE(branch.exists(i, it->first));
+			EXPECT_EQ(i + 1, it->second.getMultiplicity());
+		}
+		EXPECT_EQ(branch.size(), i);
+		for (BranchRecord::const_iterator it = branch.rbegin();
+				it != branch.rend(); ++it)
+			EXPECT_EQ(--i + 1, it->second.getMultiplicity());
+
+		KmerPair last = branch.back().first;
+		branch.pop_back();
+		EXPECT_EQ(3U, branch.size());
+		EXPECT_TRUE(branch.exists(2, branch.back().first));
+		EXPECT_NE(last, branch.back().first);
+		EXPECT_EQ(dir == SENSE ? kmerPairs[2] : kmerPairs[1],
+				branch.back().first);
+		EXPECT_EQ(dir == SENSE ? kmerPairs[0] : kmerPairs[3],
+				branch.front().first);
+		EXPECT_EQ(dir == SENSE ? "TAGGGATT" : "AGGCATTC",
+				(Sequence)branch);
+	}
+}
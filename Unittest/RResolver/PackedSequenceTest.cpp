@@ -0,0 +1,92 @@
+#include "RResolver/Contigs.h"
+#include "gtest/gtest.h"
+#include <cstdlib>
+#include <string>
+
+using namespace std;
+
+namespace opt {
+	unsigned k; // used by ContigProperties
+	int format; // used by ContigProperties
+}
+
+/** Return a random sequence of the specified length, which includes
+ * runs of N, ambiguity codes and masked bases.
+ */
+static string randomSequence(unsigned n)
+{
+	static const char alphabet[] = "ACGTACGTACGTNacgtRYKM";
+	string s;
+	while (s.size() < n) {
+		char c = alphabet[rand() % (sizeof alphabet - 1)];
+		s.append(c == 'N' ? 1 + rand() % 5 : 1, c);
+	}
+	s.resize(n);
+	return s;
+}
+
+/** Check every substring of the packed sequence in both orientations.
+ */
+static void expectSameSequence(const string& s)
+{
+	PackedSequence packed(s);
+	ASSERT_EQ(s.size(), packed.size());
+	string rc = reverseComplement(s);
+	EXPECT_EQ(s, ContigSequence(packed, false).str());
+	EXPECT_EQ(rc, ContigSequence(packed, true).str());
+	for (size_t pos = 0; pos <= s.size(); ++pos) {
+		for (size_t n = 0; pos + n <= s.size(); ++n) {
+			EXPECT_EQ(s.substr(pos, n),
+					ContigSequence(packed, false).substr(pos, n));
+			EXPECT_EQ(rc.substr(pos, n),
+					ContigSequence(packed, true).substr(pos, n));
+		}
+	}
+}
+
+TEST(PackedSequence, roundTrip)
+{
+	expectSameSequence("");
+	expectSameSequence("ACGT");
+	// Cross the boundary of a 64-bit word.
+	expectSameSequence("ACGTTGCAACGTTGCAACGTTGCAACGTTGCAGT");
+
+	srand(1);
+	for (unsigned i = 0; i < 20; ++i) {
+		string s(1 + rand() % 200, 'A');
+		for (unsigned j = 0; j < s.size(); ++j)
+			s[j] = "ACGT"[rand() % 4];
+		PackedSequence packed(s);
+		EXPECT_EQ(s, ContigSequence(packed, false).str());
+	}
+}
+
+TEST(PackedSequence, exceptions)
+{
+	expectSameSequence("NNNN");
+	expectSameSequence("ACGTNNNNacgtRYACGTN");
+	expectSameSequence("NACGTNNaaNACGT");
+
+	srand(2);
+	for (unsigned i = 0; i < 20; ++i)
+		expectSameSequence(randomSequence(1 + rand() % 100));
+}
+
+TEST(PackedSequence, reverseComplement)
+{
+	PackedSequence packed("AACGTNacR");
+	EXPECT_EQ("YgtNACGTT", ContigSequence(packed, true).str());
+	EXPECT_EQ("gtNA", ContigSequence(packed, true).substr(1, 4));
+	EXPECT_EQ("NACGTT", ContigSequence(packed, true).substr(3));
+}
+
+TEST(PackedSequence, appendTo)
+{
+	PackedSequence packed("ACGTNNGG");
+	ContigSequence rc(packed, true);
+	Sequence s("TT");
+	rc.appendTo(s, 1, 3);
+	EXPECT_EQ("TTCNN", s);
+	rc.appendTo(s, 6);
+	EXPECT_EQ("TTCNNGT", s);
+}